@@ -112,7 +112,7 @@ public:
     fiff_int_t  kind;   /**< Tag number */
     fiff_int_t  type;   /**< Data type */
     fiff_int_t  size;   /**< How many bytes */
-    fiff_int_t  pos;    /**< Location in file; Note: the data is located at pos + FIFFC_DATA_OFFSET */
+    qint64      pos;    /**< Location in file; Note: the data is located at pos + FIFFC_DATA_OFFSET. Stored as unsigned 32 bit in directory tags, 64 bit for scanned files */
 
 // ### OLD STRUCT ###
 //    /** Directories are composed of these structures. *
@@ -64,6 +64,7 @@ FiffDirTree::FiffDirTree()
 , nent(-1)
 , nent_tree(-1)
 , nchild(-1)
+, m_bIndexed(false)
 {
 }
 
@@ -79,6 +80,9 @@ FiffDirTree::FiffDirTree(const FiffDirTree &p_FiffDirTree)
 , nent_tree(p_FiffDirTree.nent_tree)
 , children(p_FiffDirTree.children)
 , nchild(p_FiffDirTree.nchild)
+, m_bIndexed(p_FiffDirTree.m_bIndexed)
+, m_qHashTagIdx(p_FiffDirTree.m_qHashTagIdx)
+, m_qSetBlockKinds(p_FiffDirTree.m_qSetBlockKinds)
 {
 
 }
@@ -107,12 +111,23 @@ void FiffDirTree::clear()
     nent_tree = -1;
     children.clear();
     nchild = -1;
+    m_bIndexed = false;
+    m_qHashTagIdx.clear();
+    m_qSetBlockKinds.clear();
 }
 
 
 //*************************************************************************************************************
 
 bool FiffDirTree::copy_tree(FiffStream::SPtr p_pStreamIn, FiffId& in_id, QList<FiffDirTree>& p_Nodes, FiffStream::SPtr p_pStreamOut)
+{
+    return FiffDirTree::copy_tree(p_pStreamIn, in_id, p_Nodes, p_pStreamOut.data());
+}
+
+
+//*************************************************************************************************************
+
+bool FiffDirTree::copy_tree(FiffStream::SPtr p_pStreamIn, FiffId& in_id, QList<FiffDirTree>& p_Nodes, FiffStream* p_pStreamOut)
 {
     if(p_Nodes.size() <= 0)
         return false;
@@ -173,7 +188,7 @@ bool FiffDirTree::copy_tree(FiffStream::SPtr p_pStreamIn, FiffId& in_id, QList<F
             }
 
             //QDataStream out(p_pStreamOut);
-            FiffStream::SPtr out = p_pStreamOut;
+            FiffStream* out = p_pStreamOut;
             out->setByteOrder(QDataStream::BigEndian);
 
             *out << (qint32)tag->kind;
@@ -238,8 +253,11 @@ qint32 FiffDirTree::make_dir_tree(FiffStream* p_pStream, QList<FiffDirEntry>& p_
         }
         else if(p_Dir[current].kind == FIFF_BLOCK_END)
         {
-            FiffTag::read_tag(p_pStream, t_pTag, p_Dir[start].pos);
-            if (*t_pTag->toInt() == p_Tree.block)
+            //
+            //  Nested blocks are consumed by the recursion, so this is the end of the block we started;
+            //  no need to read the start tag again
+            //
+            if (p_Dir[start].kind == FIFF_BLOCK_START)
                 break;
         }
         else
@@ -281,6 +299,12 @@ qint32 FiffDirTree::make_dir_tree(FiffStream* p_pStream, QList<FiffDirEntry>& p_
     if(p_Tree.nent == 0)
         p_Tree.dir.clear();
 
+    //
+    // Index the whole tree once, when the root is done
+    //
+    if(start == 0)
+        p_Tree.build_index();
+
 //    qDebug() << "block =" << p_pTree->block << "nent =" << p_pTree->nent << "nchild =" << p_pTree->nchild;
 //    qDebug() << "end } " << block;
 
@@ -293,6 +317,13 @@ qint32 FiffDirTree::make_dir_tree(FiffStream* p_pStream, QList<FiffDirEntry>& p_
 QList<FiffDirTree> FiffDirTree::dir_tree_find(fiff_int_t p_kind) const
 {
     QList<FiffDirTree> nodes;
+
+    //
+    // Skip subtrees which do not contain the kind
+    //
+    if(m_bIndexed && !m_qSetBlockKinds.contains(p_kind))
+        return nodes;
+
     if(this->block == p_kind)
         nodes.append(*this);
 
@@ -308,6 +339,19 @@ QList<FiffDirTree> FiffDirTree::dir_tree_find(fiff_int_t p_kind) const
 
 bool FiffDirTree::find_tag(FiffStream* p_pStream, fiff_int_t findkind, FiffTag::SPtr& p_pTag) const
 {
+    if(m_bIndexed)
+    {
+        QHash<fiff_int_t, qint32>::const_iterator it = m_qHashTagIdx.constFind(findkind);
+        if(it != m_qHashTagIdx.constEnd())
+        {
+            FiffTag::read_tag(p_pStream,p_pTag,this->dir[it.value()].pos);
+            return true;
+        }
+        if (p_pTag)
+            p_pTag.clear();
+        return false;
+    }
+
     for (qint32 p = 0; p < this->nent; ++p)
     {
        if (this->dir[p].kind == findkind)
@@ -327,6 +371,9 @@ bool FiffDirTree::find_tag(FiffStream* p_pStream, fiff_int_t findkind, FiffTag::
 
 bool FiffDirTree::has_tag(fiff_int_t findkind)
 {
+    if(m_bIndexed)
+        return m_qHashTagIdx.contains(findkind);
+
     for(qint32 p = 0; p < this->nent; ++p)
         if(this->dir.at(p).kind == findkind)
             return true;
@@ -337,6 +384,9 @@ bool FiffDirTree::has_tag(fiff_int_t findkind)
 
 bool FiffDirTree::has_kind(fiff_int_t p_kind) const
 {
+    if(m_bIndexed)
+        return m_qSetBlockKinds.contains(p_kind);
+
     if(this->block == p_kind)
         return true;
 
@@ -347,3 +397,29 @@ bool FiffDirTree::has_kind(fiff_int_t p_kind) const
 
     return false;
 }
+
+
+//*************************************************************************************************************
+
+void FiffDirTree::build_index()
+{
+    m_qHashTagIdx.clear();
+    m_qSetBlockKinds.clear();
+
+    //
+    // First entry of each kind, like the linear search in find_tag
+    //
+    for(qint32 p = this->nent - 1; p >= 0; --p)
+        m_qHashTagIdx.insert(this->dir[p].kind, p);
+
+    m_qSetBlockKinds.insert(this->block);
+
+    QList<FiffDirTree>::iterator i;
+    for(i = this->children.begin(); i != this->children.end(); ++i)
+    {
+        (*i).build_index();
+        m_qSetBlockKinds.unite((*i).m_qSetBlockKinds);
+    }
+
+    m_bIndexed = true;
+}
@@ -55,7 +55,9 @@
 
 #include <QDebug>
 #include <QFile>
+#include <QHash>
 #include <QList>
+#include <QSet>
 #include <QSharedPointer>
 #include <QStringList>
 
@@ -124,6 +126,19 @@ public:
     */
     static bool copy_tree(QSharedPointer<FiffStream> p_pStreamIn, FiffId& in_id, QList<FiffDirTree>& p_Nodes, QSharedPointer<FiffStream> p_pStreamOut);
 
+    //=========================================================================================================
+    /**
+    * Copies directory subtrees from fidin to fidout, see copy_tree above. Used by streams writing into themselves.
+    *
+    * @param[in] p_pStreamIn    fiff file to copy from
+    * @param[in] in_id          file id description
+    * @param[out] p_Nodes       subtree directories to be copied
+    * @param[in] p_pStreamOut   fiff file to write to
+    *
+    * @return true if succeeded, false otherwise
+    */
+    static bool copy_tree(QSharedPointer<FiffStream> p_pStreamIn, FiffId& in_id, QList<FiffDirTree>& p_Nodes, FiffStream* p_pStreamOut);
+
     //=========================================================================================================
     /**
     * Returns true if directory tree structure contains no data.
@@ -198,6 +213,14 @@ public:
     */
     bool has_kind(fiff_int_t p_kind) const;
 
+    //=========================================================================================================
+    /**
+    * Builds the lookup index of this tree and all its children: tag kind -> first directory entry of each node and the
+    * set of block kinds contained in each subtree. make_dir_tree builds it once when a file is opened; it has to be
+    * rebuilt if dir or children are modified afterwards. Without an index the lookups fall back to linear scans.
+    */
+    void build_index();
+
 public:
     fiff_int_t          block;      /**< Block type for this directory */
     FiffId              id;         /**< Id of this block if any */
@@ -208,6 +231,11 @@ public:
     QList<FiffDirTree>  children;   /**< Child nodes */
     fiff_int_t          nchild;     /**< Number of child nodes */
 
+private:
+    bool                            m_bIndexed;         /**< Whether the lookup index below is valid */
+    QHash<fiff_int_t, qint32>       m_qHashTagIdx;      /**< Tag kind -> index of its first entry in dir */
+    QSet<fiff_int_t>                m_qSetBlockKinds;   /**< Block kinds of this node and all its children */
+
 // typedef struct _fiffDirNode {
 //  int                 type;    /**< Block type for this directory *
 //  fiffId              id;      /**< Id of this block if any *
@@ -278,7 +278,8 @@ bool FiffEvoked::read(QIODevice& p_IODevice, FiffEvoked& p_FiffEvoked, QVariant
     fiff_int_t nchan = 0;
     float sfreq = -1.0f;
     QList<FiffChInfo> chs;
-    fiff_int_t kind, pos, first=0, last=0;
+    fiff_int_t kind, first=0, last=0;
+    qint64 pos;
     FiffTag::SPtr t_pTag;
     QString comment("");
     qint32 k;
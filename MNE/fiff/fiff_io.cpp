@@ -259,7 +259,7 @@ bool FiffIO::write_raw(QIODevice &p_IODevice, const fiff_int_t idx) const {
         qDebug("Writing...");
         if (first_buffer) {
            if (first > 0)
-               outfid->write_int(FIFF_FIRST_SAMPLE,&first);
+               outfid->write_raw_first_sample(first);
            first_buffer = false;
         }
         outfid->write_raw_buffer(data,mult);
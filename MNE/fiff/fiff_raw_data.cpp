@@ -43,12 +43,233 @@
 #include "fiff_stream.h"
 #include "cstdlib"
 
+#include <utils/ioutils.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QMutexLocker>
+#include <QThread>
+#include <QtConcurrent>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <vector>
+#include <algorithm>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// SIMD INCLUDES
+//=============================================================================================================
+
+#if defined(__AVX2__)
+#define FIFF_RAW_USE_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FIFF_RAW_USE_SSE2
+#endif
+
+#if defined(FIFF_RAW_USE_AVX2)
+#include <immintrin.h>
+#elif defined(FIFF_RAW_USE_SSE2)
+#include <emmintrin.h>
+#endif
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // USED NAMESPACES
 //=============================================================================================================
 
 using namespace FIFFLIB;
+using namespace UTILSLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC DEFINITIONS
+//=============================================================================================================
+
+namespace
+{
+
+//=============================================================================================================
+/**
+* Converts n contiguous samples of one buffer column to double and optionally scales them per channel.
+* Specialized per storage type, using AVX2 or SSE2 conversions when available.
+*/
+inline void convert_scale(const qint16* src, const double* scale, double* out, qint64 n)
+{
+    qint64 i = 0;
+#if defined(FIFF_RAW_USE_AVX2)
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        __m256d d0 = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+        __m256d d1 = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+        if(scale)
+        {
+            d0 = _mm256_mul_pd(d0, _mm256_loadu_pd(scale + i));
+            d1 = _mm256_mul_pd(d1, _mm256_loadu_pd(scale + i + 4));
+        }
+        _mm256_storeu_pd(out + i, d0);
+        _mm256_storeu_pd(out + i + 4, d1);
+    }
+#elif defined(FIFF_RAW_USE_SSE2)
+    for(; i + 8 <= n; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        __m128d d0 = _mm_cvtepi32_pd(lo);
+        __m128d d1 = _mm_cvtepi32_pd(_mm_unpackhi_epi64(lo, lo));
+        __m128d d2 = _mm_cvtepi32_pd(hi);
+        __m128d d3 = _mm_cvtepi32_pd(_mm_unpackhi_epi64(hi, hi));
+        if(scale)
+        {
+            d0 = _mm_mul_pd(d0, _mm_loadu_pd(scale + i));
+            d1 = _mm_mul_pd(d1, _mm_loadu_pd(scale + i + 2));
+            d2 = _mm_mul_pd(d2, _mm_loadu_pd(scale + i + 4));
+            d3 = _mm_mul_pd(d3, _mm_loadu_pd(scale + i + 6));
+        }
+        _mm_storeu_pd(out + i, d0);
+        _mm_storeu_pd(out + i + 2, d1);
+        _mm_storeu_pd(out + i + 4, d2);
+        _mm_storeu_pd(out + i + 6, d3);
+    }
+#endif
+    for(; i < n; ++i)
+        out[i] = scale ? scale[i]*src[i] : (double)src[i];
+}
+
+
+//*************************************************************************************************************
+
+inline void convert_scale(const qint32* src, const double* scale, double* out, qint64 n)
+{
+    qint64 i = 0;
+#if defined(FIFF_RAW_USE_AVX2)
+    for(; i + 4 <= n; i += 4)
+    {
+        __m256d d = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(src + i)));
+        if(scale)
+            d = _mm256_mul_pd(d, _mm256_loadu_pd(scale + i));
+        _mm256_storeu_pd(out + i, d);
+    }
+#elif defined(FIFF_RAW_USE_SSE2)
+    for(; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128d d0 = _mm_cvtepi32_pd(v);
+        __m128d d1 = _mm_cvtepi32_pd(_mm_unpackhi_epi64(v, v));
+        if(scale)
+        {
+            d0 = _mm_mul_pd(d0, _mm_loadu_pd(scale + i));
+            d1 = _mm_mul_pd(d1, _mm_loadu_pd(scale + i + 2));
+        }
+        _mm_storeu_pd(out + i, d0);
+        _mm_storeu_pd(out + i + 2, d1);
+    }
+#endif
+    for(; i < n; ++i)
+        out[i] = scale ? scale[i]*src[i] : (double)src[i];
+}
+
+
+//*************************************************************************************************************
+
+inline void convert_scale(const float* src, const double* scale, double* out, qint64 n)
+{
+    qint64 i = 0;
+#if defined(FIFF_RAW_USE_AVX2)
+    for(; i + 4 <= n; i += 4)
+    {
+        __m256d d = _mm256_cvtps_pd(_mm_loadu_ps(src + i));
+        if(scale)
+            d = _mm256_mul_pd(d, _mm256_loadu_pd(scale + i));
+        _mm256_storeu_pd(out + i, d);
+    }
+#elif defined(FIFF_RAW_USE_SSE2)
+    for(; i + 4 <= n; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(src + i);
+        __m128d d0 = _mm_cvtps_pd(v);
+        __m128d d1 = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+        if(scale)
+        {
+            d0 = _mm_mul_pd(d0, _mm_loadu_pd(scale + i));
+            d1 = _mm_mul_pd(d1, _mm_loadu_pd(scale + i + 2));
+        }
+        _mm_storeu_pd(out + i, d0);
+        _mm_storeu_pd(out + i + 2, d1);
+    }
+#endif
+    for(; i < n; ++i)
+        out[i] = scale ? scale[i]*src[i] : (double)src[i];
+}
+
+
+//*************************************************************************************************************
+
+inline void swap_column(const qint16* src, qint16* dest, qint64 n)
+{
+    IOUtils::swap_bytes_16(src, dest, n);
+}
+
+inline void swap_column(const qint32* src, qint32* dest, qint64 n)
+{
+    IOUtils::swap_bytes_32(src, dest, n);
+}
+
+inline void swap_column(const float* src, float* dest, qint64 n)
+{
+    IOUtils::swap_bytes_32(src, dest, n);
+}
+
+
+//*************************************************************************************************************
+/**
+* Fused decode kernel: for each picked sample the buffer column is byte swapped if needed (into a small scratch
+* column which stays in L1), converted, picked by channel selection, scaled and written straight into the
+* destination column. Buffer and destination are both column major, so both are streamed contiguously.
+*/
+template<typename T>
+void decode_columns(const T* p_pSrc, bool p_bSwap, qint32 nchan, qint32 first_pick, qint32 picksamp, const qint32* p_pSel, qint32 nsel, const double* p_pScale, double* p_pOut, qint64 p_iOutStride)
+{
+    std::vector<T> t_vecColumn(p_bSwap || p_pSel ? nchan : 0);
+
+    for(qint32 c = 0; c < picksamp; ++c)
+    {
+        const T* t_pCol = p_pSrc + (qint64)(first_pick + c)*nchan;
+        double* t_pOutCol = p_pOut + (qint64)c*p_iOutStride;
+
+        if(p_bSwap)
+        {
+            swap_column(t_pCol, t_vecColumn.data(), nchan);
+            t_pCol = t_vecColumn.data();
+        }
+
+        if(!p_pSel)
+        {
+            convert_scale(t_pCol, p_pScale, t_pOutCol, nchan);
+        }
+        else
+        {
+            for(qint32 r = 0; r < nsel; ++r)
+                t_pOutCol[r] = p_pScale ? p_pScale[r]*t_pCol[p_pSel[r]] : (double)t_pCol[p_pSel[r]];
+        }
+    }
+}
+
+} // NAMESPACE
 
 
 //*************************************************************************************************************
@@ -59,6 +280,17 @@ using namespace FIFFLIB;
 FiffRawData::FiffRawData()
 : first_samp(-1)
 , last_samp(-1)
+, m_bParallelDecode(true)
+, m_bMemoryMapping(true)
+, m_bMultCacheValid(false)
+, m_pCacheCalsData(NULL)
+, m_iCacheCalsSize(0)
+, m_pCacheProjData(NULL)
+, m_iCacheProjRows(0)
+, m_iCacheProjCols(0)
+, m_pCacheCompData(NULL)
+, m_iCacheCompSize(0)
+, m_iCacheCompKind(-1)
 {
 
 }
@@ -69,6 +301,17 @@ FiffRawData::FiffRawData()
 FiffRawData::FiffRawData(QIODevice &p_IODevice)
 : first_samp(-1)
 , last_samp(-1)
+, m_bParallelDecode(true)
+, m_bMemoryMapping(true)
+, m_bMultCacheValid(false)
+, m_pCacheCalsData(NULL)
+, m_iCacheCalsSize(0)
+, m_pCacheProjData(NULL)
+, m_iCacheProjRows(0)
+, m_iCacheProjCols(0)
+, m_pCacheCompData(NULL)
+, m_iCacheCompSize(0)
+, m_iCacheCompKind(-1)
 {
     //setup FiffRawData object
     if(!FiffStream::setup_read_raw(p_IODevice, *this))
@@ -84,6 +327,7 @@ FiffRawData::FiffRawData(QIODevice &p_IODevice)
 
 FiffRawData::FiffRawData(const FiffRawData &p_FiffRawData)
 : file(p_FiffRawData.file)
+, part_files(p_FiffRawData.part_files)
 , info(p_FiffRawData.info)
 , first_samp(p_FiffRawData.first_samp)
 , last_samp(p_FiffRawData.last_samp)
@@ -91,11 +335,45 @@ FiffRawData::FiffRawData(const FiffRawData &p_FiffRawData)
 , rawdir(p_FiffRawData.rawdir)
 , proj(p_FiffRawData.proj)
 , comp(p_FiffRawData.comp)
+, m_bParallelDecode(p_FiffRawData.m_bParallelDecode)
+, m_bMemoryMapping(p_FiffRawData.m_bMemoryMapping)
+, m_bMultCacheValid(false)
+, m_pCacheCalsData(NULL)
+, m_iCacheCalsSize(0)
+, m_pCacheProjData(NULL)
+, m_iCacheProjRows(0)
+, m_iCacheProjCols(0)
+, m_pCacheCompData(NULL)
+, m_iCacheCompSize(0)
+, m_iCacheCompKind(-1)
 {
 
 }
 
 
+//*************************************************************************************************************
+
+FiffRawData& FiffRawData::operator= (const FiffRawData &p_FiffRawData)
+{
+    if(this != &p_FiffRawData)
+    {
+        file = p_FiffRawData.file;
+        part_files = p_FiffRawData.part_files;
+        info = p_FiffRawData.info;
+        first_samp = p_FiffRawData.first_samp;
+        last_samp = p_FiffRawData.last_samp;
+        cals = p_FiffRawData.cals;
+        rawdir = p_FiffRawData.rawdir;
+        proj = p_FiffRawData.proj;
+        comp = p_FiffRawData.comp;
+        m_bParallelDecode = p_FiffRawData.m_bParallelDecode;
+        m_bMemoryMapping = p_FiffRawData.m_bMemoryMapping;
+        invalidate_mult_cache();
+    }
+    return *this;
+}
+
+
 //*************************************************************************************************************
 
 FiffRawData::~FiffRawData()
@@ -113,8 +391,10 @@ void FiffRawData::clear()
     last_samp = -1;
     cals = RowVectorXd();
     rawdir.clear();
+    part_files.clear();
     proj = MatrixXd();
     comp.clear();
+    invalidate_mult_cache();
 }
 
 
@@ -122,11 +402,15 @@ void FiffRawData::clear()
 
 bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, fiff_int_t from, fiff_int_t to, const RowVectorXi& sel)
 {
-    bool projAvailable = true;
+    SparseMatrix<double> multSegment;
+    return this->read_raw_segment(data, times, multSegment, from, to, sel);
+}
+
 
-    if (this->proj.size() == 0)
-        projAvailable = false;
+//*************************************************************************************************************
 
+bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, SparseMatrix<double>& multSegment, fiff_int_t from, fiff_int_t to, const RowVectorXi& sel)
+{
     if(from == -1)
         from = this->first_samp;
     if(to == -1)
@@ -152,110 +436,37 @@ bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, fiff_int_t f
     qint32 dest  = 0;//1;
     qint32 i, k, r;
 
-    typedef Eigen::Triplet<double> T;
-    std::vector<T> tripletList;
-    tripletList.reserve(nchan);
-    for(i = 0; i < nchan; ++i)
-        tripletList.push_back(T(i, i, this->cals[i]));
-
-    SparseMatrix<double> cal(nchan, nchan);
-    cal.setFromTriplets(tripletList.begin(), tripletList.end());
-//    cal.makeCompressed();
-
-    MatrixXd mult_full;
     //
+    //  Calibration and projection/compensation operators are cached across calls
+    //
+    QSharedPointer<const SparseMatrix<double> > t_pCal, t_pMult;
+    this->update_mult_cache(sel, t_pCal, t_pMult);
+    const SparseMatrix<double>& cal = *t_pCal;
+    const SparseMatrix<double>& mult = *t_pMult;
+
     if (sel.size() == 0)
-    {
         data = MatrixXd(nchan, to-from+1);
-//            data->setZero();
-        if (projAvailable || this->comp.kind != -1)
-        {
-            if (!projAvailable)
-                mult_full = this->comp.data->data*cal;
-            else if (this->comp.kind == -1)
-                mult_full = this->proj*cal;
-            else
-                mult_full = this->proj*this->comp.data->data*cal;
-        }
-    }
     else
-    {
         data = MatrixXd(sel.size(),to-from+1);
-//            data->setZero();
-
-        MatrixXd selVect(sel.size(), nchan);
-
-        selVect.setZero();
-
-        if (!projAvailable && this->comp.kind == -1)
-        {
-            tripletList.clear();
-            tripletList.reserve(sel.size());
-            for(i = 0; i < sel.size(); ++i)
-                tripletList.push_back(T(i, i, this->cals[sel[i]]));
-            cal = SparseMatrix<double>(sel.size(), sel.size());
-            cal.setFromTriplets(tripletList.begin(), tripletList.end());
-        }
-        else
-        {
-            if (!projAvailable)
-            {
-                qDebug() << "This has to be debugged! #1";
-                for( i = 0; i  < sel.size(); ++i)
-                    selVect.row(i) = this->comp.data->data.block(sel[i],0,1,nchan);
-                mult_full = selVect*cal;
-            }
-            else if (this->comp.kind == -1)
-            {
-                for( i = 0; i  < sel.size(); ++i)
-                    selVect.row(i) = this->proj.block(sel[i],0,1,nchan);
-
-                mult_full = selVect*cal;
-            }
-            else
-            {
-                qDebug() << "This has to be debugged! #3";
-                for( i = 0; i  < sel.size(); ++i)
-                    selVect.row(i) = this->proj.block(sel[i],0,1,nchan);
-
-                mult_full = selVect*this->comp.data->data*cal;
-            }
-        }
-    }
 
     bool do_debug = false;
-    //
-    // Make mult sparse
-    //
-    tripletList.clear();
-    tripletList.reserve(mult_full.rows()*mult_full.cols());
-    for(i = 0; i < mult_full.rows(); ++i)
-        for(k = 0; k < mult_full.cols(); ++k)
-            if(mult_full(i,k) != 0)
-                tripletList.push_back(T(i, k, mult_full(i,k)));
-
-    SparseMatrix<double> mult(mult_full.rows(),mult_full.cols());
-    if(tripletList.size() > 0)
-        mult.setFromTriplets(tripletList.begin(), tripletList.end());
-//    mult.makeCompressed();
 
     //
-
-    FiffStream::SPtr fid;
-    if (!this->file->device()->isOpen())
-    {
-        if (!this->file->device()->open(QIODevice::ReadOnly))
-        {
-            printf("Cannot open file %s",this->info.filename.toUtf8().constData());
-        }
-        fid = this->file;
-    }
-    else
+    //  Per output row calibration factors for the fused decode kernel (only when no mult is applied)
+    //
+    qint32 nrows = data.rows();
+    VectorXd t_vecScale;
+    if (mult.cols() == 0)
     {
-        fid = this->file;
+        t_vecScale.resize(nrows);
+        for(r = 0; r < nrows; ++r)
+            t_vecScale[r] = this->cals[sel.size() == 0 ? r : sel[r]];
     }
 
-    MatrixXd one;
+    //
+    //  Collect the buffers we need, with their picks and their position in the output
+    //
+    QList<RawBufferJob> t_qListJobs;
     fiff_int_t first_pick, last_pick, picksamp;
     for(k = 0; k < this->rawdir.size(); ++k)
     {
@@ -265,88 +476,6 @@ bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, fiff_int_t f
         //
         if (thisRawDir.last > from)
         {
-            if (thisRawDir.ent.kind == -1)
-            {
-                //
-                //  Take the easy route: skip is translated to zeros
-                //
-                if(do_debug)
-                    printf("S");
-                if (sel.cols() <= 0)
-                    one.resize(nchan,thisRawDir.nsamp);
-                else
-                    one.resize(sel.cols(),thisRawDir.nsamp);
-
-                one.setZero();
-            }
-            else
-            {
-                FiffTag::SPtr t_pTag;
-                FiffTag::read_tag(fid.data(), t_pTag, thisRawDir.ent.pos);
-                //
-                //   Depending on the state of the projection and selection
-                //   we proceed a little bit differently
-                //
-                if (mult.cols() == 0)
-                {
-                    if (sel.cols() == 0)
-                    {
-                        if (t_pTag->type == FIFFT_DAU_PACK16)
-                            one = cal*(Map< MatrixDau16 >( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else if(t_pTag->type == FIFFT_INT)
-                            one = cal*(Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else if(t_pTag->type == FIFFT_FLOAT)
-                            one = cal*(Map< MatrixXf >( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else
-                            printf("Data Storage Format not known jet [1]!! Type: %d\n", t_pTag->type);
-                    }
-                    else
-                    {
-
-                        //ToDo find a faster solution for this!! --> make cal and mul sparse like in MATLAB
-                        MatrixXd newData(sel.cols(), thisRawDir.nsamp); //ToDo this can be done much faster, without newData
-
-                        if (t_pTag->type == FIFFT_DAU_PACK16)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixDau16 > ( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else if(t_pTag->type == FIFFT_INT)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else if(t_pTag->type == FIFFT_FLOAT)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixXf > ( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else
-                        {
-                            printf("Data Storage Format not known jet [2]!! Type: %d\n", t_pTag->type);
-                        }
-
-                        one = cal*newData;
-                    }
-                }
-                else
-                {
-                    if (t_pTag->type == FIFFT_DAU_PACK16)
-                        one = mult*(Map< MatrixDau16 >( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else if(t_pTag->type == FIFFT_INT)
-                        one = mult*(Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else if(t_pTag->type == FIFFT_FLOAT)
-                        one = mult*(Map< MatrixXf >( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else
-                        printf("Data Storage Format not known jet [3]!! Type: %d\n", t_pTag->type);
-                }
-            }
             //
             //  The picking logic is a bit complicated
             //
@@ -407,10 +536,20 @@ bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, fiff_int_t f
 
             if (picksamp > 0)
             {
-//                    for(r = 0; r < data->rows(); ++r)
-//                        for(c = 0; c < picksamp; ++c)
-//                            (*data)(r,dest + c) = one(r,first_pick + c);
-                data.block(0,dest,data.rows(),picksamp) = one.block(0, first_pick, data.rows(), picksamp);
+                RawBufferJob t_job;
+                t_job.iRawDirIdx = k;
+                t_job.bFileByteOrder = false;
+                t_job.nchan = nchan;
+                t_job.nsamp = thisRawDir.nsamp;
+                t_job.first_pick = first_pick;
+                t_job.picksamp = picksamp;
+                t_job.pSel = sel.size() == 0 ? NULL : sel.data();
+                t_job.nsel = sel.size();
+                t_job.pScale = mult.cols() == 0 ? t_vecScale.data() : NULL;
+                t_job.pMult = &mult;
+                t_job.pOut = data.data() + (qint64)dest*nrows;
+                t_job.nrows = nrows;
+                t_qListJobs.append(t_job);
 
                 dest += picksamp;
             }
@@ -425,6 +564,35 @@ bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, fiff_int_t f
         }
     }
 
+    //
+    //  Read the buffers in file order and decode them, a batch at a time in parallel if enabled.
+    //  The batches bound the number of buffers held in memory for long segments.
+    //
+    qint32 t_iNumThreads = m_bParallelDecode ? QThread::idealThreadCount() : 1;
+    qint32 t_iBatchSize = t_iNumThreads > 1 ? 4*t_iNumThreads : 1;
+    qint32 j;
+    for(k = 0; k < t_qListJobs.size(); k += t_iBatchSize)
+    {
+        qint32 t_iEnd = qMin(k + t_iBatchSize, t_qListJobs.size());
+
+        for(j = k; j < t_iEnd; ++j)
+        {
+            this->read_buffer_tag(t_qListJobs[j]);
+        }
+
+        if(t_iEnd - k > 1)
+            QtConcurrent::blockingMap(t_qListJobs.begin() + k, t_qListJobs.begin() + t_iEnd, &RawBufferJob::decode);
+        else
+            t_qListJobs[k].decode();
+
+        for(j = k; j < t_iEnd; ++j)
+            t_qListJobs[j].pTag.clear();
+    }
+
+    if(mult.cols()==0)
+        multSegment = cal;
+    else
+        multSegment = mult;
 //        fclose(fid);
 
     times = MatrixXd(1, to-from+1);
@@ -438,37 +606,227 @@ bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, fiff_int_t f
 
 //*************************************************************************************************************
 
-bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, SparseMatrix<double>& multSegment, fiff_int_t from, fiff_int_t to, const RowVectorXi& sel)
+bool FiffRawData::read_raw_segments(QList<MatrixXd>& data, const RowVectorXi& from, const RowVectorXi& to, const RowVectorXi& sel)
 {
-    bool projAvailable = true;
+    data.clear();
+    if(from.size() != to.size())
+    {
+        printf("Number of segment starts and ends do not match\n");
+        return false;
+    }
 
-    if (this->proj.size() == 0)
-        projAvailable = false;
+    qint32 nseg = from.size();
+    qint32 nchan = this->info.nchan;
+    qint32 i, j, k, r, s;
 
-    if(from == -1)
-        from = this->first_samp;
-    if(to == -1)
-        to = this->last_samp;
     //
-    //  Initial checks
+    //  Calibration and projection/compensation operators are shared by all segments
     //
-    if(from < this->first_samp)
-        from = this->first_samp;
-    if(to > this->last_samp)
-        to = this->last_samp;
+    QSharedPointer<const SparseMatrix<double> > t_pCal, t_pMult;
+    this->update_mult_cache(sel, t_pCal, t_pMult);
+    const SparseMatrix<double>& mult = *t_pMult;
+
+    qint32 nrows = sel.size() == 0 ? nchan : sel.size();
+    VectorXd t_vecScale;
+    if (mult.cols() == 0)
+    {
+        t_vecScale.resize(nrows);
+        for(r = 0; r < nrows; ++r)
+            t_vecScale[r] = this->cals[sel.size() == 0 ? r : sel[r]];
+    }
+
     //
-    if(from > to)
+    //  Segments outside of the data stay empty, the others are visited in order of their first sample
+    //
+    QList< QPair<fiff_int_t, qint32> > t_qListOrder;
+    for(s = 0; s < nseg; ++s)
     {
-        printf("No data in this range\n");
+        if(from[s] < this->first_samp || to[s] > this->last_samp || from[s] > to[s])
+        {
+            printf("Segment %d ... %d is outside of the data, skipped\n", from[s], to[s]);
+            data.append(MatrixXd());
+        }
+        else
+        {
+            data.append(MatrixXd(nrows, to[s] - from[s] + 1));
+            t_qListOrder.append(qMakePair(from[s], s));
+        }
+    }
+    std::sort(t_qListOrder.begin(), t_qListOrder.end());
+
+    if(t_qListOrder.isEmpty())
         return false;
+
+    printf("Reading %d segments...", t_qListOrder.size());
+
+    //
+    //  Every buffer overlapping any segment becomes one job, decoding the union of the samples needed
+    //
+    QList<RawBufferJob> t_qListJobs;
+    QList<fiff_int_t> t_qListJobFirst;  // first sample decoded by each job
+    QList<qint32> t_qListJobSeg;        // first entry of t_qListOrder which may overlap each job
+    qint32 t_iFirstActive = 0;
+    for(k = 0; k < this->rawdir.size() && t_iFirstActive < t_qListOrder.size(); ++k)
+    {
+        const FiffRawDir& thisRawDir = this->rawdir[k];
+
+        while(t_iFirstActive < t_qListOrder.size() && to[t_qListOrder[t_iFirstActive].second] < thisRawDir.first)
+            ++t_iFirstActive;
+
+        fiff_int_t t_iLo = thisRawDir.last + 1;
+        fiff_int_t t_iHi = thisRawDir.first - 1;
+        for(j = t_iFirstActive; j < t_qListOrder.size() && t_qListOrder[j].first <= thisRawDir.last; ++j)
+        {
+            s = t_qListOrder[j].second;
+            if(to[s] < thisRawDir.first)
+                continue;
+            t_iLo = qMin(t_iLo, qMax(from[s], thisRawDir.first));
+            t_iHi = qMax(t_iHi, qMin(to[s], thisRawDir.last));
+        }
+
+        if(t_iLo > t_iHi)
+            continue;
+
+        RawBufferJob t_job;
+        t_job.iRawDirIdx = k;
+        t_job.bFileByteOrder = false;
+        t_job.nchan = nchan;
+        t_job.nsamp = thisRawDir.nsamp;
+        t_job.first_pick = t_iLo - thisRawDir.first;
+        t_job.picksamp = t_iHi - t_iLo + 1;
+        t_job.pSel = sel.size() == 0 ? NULL : sel.data();
+        t_job.nsel = sel.size();
+        t_job.pScale = mult.cols() == 0 ? t_vecScale.data() : NULL;
+        t_job.pMult = &mult;
+        t_job.pOut = NULL;
+        t_job.nrows = nrows;
+        t_qListJobs.append(t_job);
+        t_qListJobFirst.append(t_iLo);
+        t_qListJobSeg.append(t_iFirstActive);
     }
-    printf("Reading %d ... %d  =  %9.3f ... %9.3f secs...", from, to, ((float)from)/this->info.sfreq, ((float)to)/this->info.sfreq);
+
     //
-    //  Initialize the data and calibration vector
+    //  Read and decode the buffers a batch at a time, then scatter them into all overlapping segments
     //
+    qint32 t_iNumThreads = m_bParallelDecode ? QThread::idealThreadCount() : 1;
+    qint32 t_iBatchSize = t_iNumThreads > 1 ? 4*t_iNumThreads : 1;
+    QList<MatrixXd> t_qListBuffers;
+    for(k = 0; k < t_qListJobs.size(); k += t_iBatchSize)
+    {
+        qint32 t_iEnd = qMin(k + t_iBatchSize, t_qListJobs.size());
+
+        t_qListBuffers.clear();
+        t_qListBuffers.reserve(t_iEnd - k);
+        for(j = k; j < t_iEnd; ++j)
+        {
+            t_qListBuffers.append(MatrixXd(nrows, t_qListJobs[j].picksamp));
+            t_qListJobs[j].pOut = t_qListBuffers.last().data();
+            this->read_buffer_tag(t_qListJobs[j]);
+        }
+
+        if(t_iEnd - k > 1)
+            QtConcurrent::blockingMap(t_qListJobs.begin() + k, t_qListJobs.begin() + t_iEnd, &RawBufferJob::decode);
+        else
+            t_qListJobs[k].decode();
+
+        for(j = k; j < t_iEnd; ++j)
+        {
+            t_qListJobs[j].pTag.clear();
+
+            const MatrixXd& t_matBuffer = t_qListBuffers[j - k];
+            fiff_int_t t_iLo = t_qListJobFirst[j];
+            fiff_int_t t_iHi = t_iLo + t_qListJobs[j].picksamp - 1;
+            for(i = t_qListJobSeg[j]; i < t_qListOrder.size() && t_qListOrder[i].first <= t_iHi; ++i)
+            {
+                s = t_qListOrder[i].second;
+                fiff_int_t a = qMax(t_iLo, from[s]);
+                fiff_int_t b = qMin(t_iHi, to[s]);
+                if(a > b)
+                    continue;
+                data[s].block(0, a - from[s], nrows, b - a + 1) = t_matBuffer.block(0, a - t_iLo, nrows, b - a + 1);
+            }
+        }
+    }
+
+    printf(" [done]\n");
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+void FiffRawData::read_buffer_tag(RawBufferJob& p_job)
+{
+    const FiffRawDir& thisRawDir = this->rawdir[p_job.iRawDirIdx];
+    //
+    //  Skips are translated to zeros, no tag to read
+    //
+    if (thisRawDir.ent.kind == -1)
+        return;
+    //
+    //  Buffers of split recordings may live in one of the continuation files
+    //
+    FiffStream* t_pFid = thisRawDir.part > 0 ? this->part_files[thisRawDir.part - 1].data() : this->file.data();
+    if (m_bMemoryMapping && !t_pFid->isMapped())
+        t_pFid->mapFile();
+    if (!t_pFid->isMapped() && !t_pFid->device()->isOpen())
+    {
+        if (!t_pFid->device()->open(QIODevice::ReadOnly))
+        {
+            printf("Cannot open file %s",t_pFid->streamName().toUtf8().constData());
+            return;
+        }
+    }
+    //
+    //  Read the buffer, as a view into the mapping if possible
+    //
+    if (t_pFid->isMapped() && FiffTag::read_tag_view(t_pFid, p_job.pTag, thisRawDir.ent.pos))
+        p_job.bFileByteOrder = true;
+    else
+        FiffTag::read_tag(t_pFid, p_job.pTag, thisRawDir.ent.pos);
+}
+
+
+//*************************************************************************************************************
+
+void FiffRawData::invalidate_mult_cache()
+{
+    QMutexLocker t_locker(&m_qMutexMultCache);
+    m_bMultCacheValid = false;
+    m_pCacheCal.clear();
+    m_pCacheMult.clear();
+}
+
+
+//*************************************************************************************************************
+
+bool FiffRawData::update_mult_cache(const RowVectorXi& sel, QSharedPointer<const SparseMatrix<double> >& p_pCal, QSharedPointer<const SparseMatrix<double> >& p_pMult)
+{
+    QMutexLocker t_locker(&m_qMutexMultCache);
+
+    //
+    //  Reuse the operators as long as calibration, projector, compensator and selection are the same objects,
+    //  changes in place have to be announced by invalidate_mult_cache
+    //
+    const MatrixXd* t_pComp = this->comp.kind != -1 ? &this->comp.data.constData()->data : NULL;
+    const double* t_pCompData = t_pComp ? t_pComp->data() : NULL;
+    qint64 t_iCompSize = t_pComp ? t_pComp->size() : 0;
+
+    if(m_bMultCacheValid
+            && m_pCacheCalsData == this->cals.data() && m_iCacheCalsSize == this->cals.size()
+            && m_pCacheProjData == this->proj.data() && m_iCacheProjRows == this->proj.rows() && m_iCacheProjCols == this->proj.cols()
+            && m_iCacheCompKind == this->comp.kind && m_pCacheCompData == t_pCompData && m_iCacheCompSize == t_iCompSize
+            && m_vecCacheSel.size() == sel.size() && (sel.size() == 0 || m_vecCacheSel == sel))
+    {
+        p_pCal = m_pCacheCal;
+        p_pMult = m_pCacheMult;
+        return false;
+    }
+
+    bool projAvailable = this->proj.size() != 0;
     qint32 nchan = this->info.nchan;
-    qint32 dest  = 0;//1;
-    qint32 i, k, r;
+    qint32 i, k;
 
     typedef Eigen::Triplet<double> T;
     std::vector<T> tripletList;
@@ -484,23 +842,18 @@ bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, SparseMatrix
     //
     if (sel.size() == 0)
     {
-        data = MatrixXd(nchan, to-from+1);
-//            data->setZero();
         if (projAvailable || this->comp.kind != -1)
         {
             if (!projAvailable)
-                mult_full = this->comp.data->data*cal;
+                mult_full = (*t_pComp)*cal;
             else if (this->comp.kind == -1)
                 mult_full = this->proj*cal;
             else
-                mult_full = this->proj*this->comp.data->data*cal;
+                mult_full = this->proj*(*t_pComp)*cal;
         }
     }
     else
     {
-        data = MatrixXd(sel.size(),to-from+1);
-//            data->setZero();
-
         MatrixXd selVect(sel.size(), nchan);
 
         selVect.setZero();
@@ -520,7 +873,7 @@ bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, SparseMatrix
             {
                 qDebug() << "This has to be debugged! #1";
                 for( i = 0; i  < sel.size(); ++i)
-                    selVect.row(i) = this->comp.data->data.block(sel[i],0,1,nchan);
+                    selVect.row(i) = (*t_pComp).block(sel[i],0,1,nchan);
                 mult_full = selVect*cal;
             }
             else if (this->comp.kind == -1)
@@ -536,12 +889,11 @@ bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, SparseMatrix
                 for( i = 0; i  < sel.size(); ++i)
                     selVect.row(i) = this->proj.block(sel[i],0,1,nchan);
 
-                mult_full = selVect*this->comp.data->data*cal;
+                mult_full = selVect*(*t_pComp)*cal;
             }
         }
     }
 
-    bool do_debug = false;
     //
     // Make mult sparse
     //
@@ -557,204 +909,101 @@ bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, SparseMatrix
         mult.setFromTriplets(tripletList.begin(), tripletList.end());
 //    mult.makeCompressed();
 
-    //
+    m_pCacheCal = QSharedPointer<const SparseMatrix<double> >(new SparseMatrix<double>(cal));
+    m_pCacheMult = QSharedPointer<const SparseMatrix<double> >(new SparseMatrix<double>(mult));
 
-    FiffStream::SPtr fid;
-    if (!this->file->device()->isOpen())
-    {
-        if (!this->file->device()->open(QIODevice::ReadOnly))
-        {
-            printf("Cannot open file %s",this->info.filename.toUtf8().constData());
-        }
-        fid = this->file;
-    }
-    else
+    m_pCacheCalsData = this->cals.data();
+    m_iCacheCalsSize = this->cals.size();
+    m_pCacheProjData = this->proj.data();
+    m_iCacheProjRows = this->proj.rows();
+    m_iCacheProjCols = this->proj.cols();
+    m_iCacheCompKind = this->comp.kind;
+    m_pCacheCompData = t_pCompData;
+    m_iCacheCompSize = t_iCompSize;
+    m_vecCacheSel = sel;
+    m_bMultCacheValid = true;
+
+    p_pCal = m_pCacheCal;
+    p_pMult = m_pCacheMult;
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+bool FiffRawData::decode_buffer(const FiffTag::SPtr& p_pTag, bool p_bFileByteOrder, qint32 nchan, qint32 nsamp, qint32 first_pick, qint32 picksamp, const qint32* p_pSel, qint32 nsel, const double* p_pScale, double* p_pOut, qint64 p_iOutStride)
+{
+    if(first_pick < 0 || picksamp < 0 || first_pick + picksamp > nsamp)
+        return false;
+
+    qint64 numel = (qint64)nchan*nsamp;
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    Q_UNUSED(p_bFileByteOrder);
+    bool t_bSwap = false;
+#else
+    bool t_bSwap = p_bFileByteOrder;
+#endif
+
+    switch(p_pTag->type)
     {
-        fid = this->file;
+        case FIFFT_DAU_PACK16:
+            if(p_pTag->size() < 2*numel)
+                return false;
+            decode_columns<qint16>((const qint16*)p_pTag->constData(), t_bSwap, nchan, first_pick, picksamp, p_pSel, nsel, p_pScale, p_pOut, p_iOutStride);
+            return true;
+        case FIFFT_INT:
+            if(p_pTag->size() < 4*numel)
+                return false;
+            decode_columns<qint32>((const qint32*)p_pTag->constData(), t_bSwap, nchan, first_pick, picksamp, p_pSel, nsel, p_pScale, p_pOut, p_iOutStride);
+            return true;
+        case FIFFT_FLOAT:
+            if(p_pTag->size() < 4*numel)
+                return false;
+            decode_columns<float>((const float*)p_pTag->constData(), t_bSwap, nchan, first_pick, picksamp, p_pSel, nsel, p_pScale, p_pOut, p_iOutStride);
+            return true;
+        default:
+            return false;
     }
+}
 
-    MatrixXd one;
-    fiff_int_t first_pick, last_pick, picksamp;
-    for(k = 0; k < this->rawdir.size(); ++k)
-    {
-        FiffRawDir thisRawDir = this->rawdir[k];
-        //
-        //  Do we need this buffer
-        //
-        if (thisRawDir.last > from)
-        {
-            if (thisRawDir.ent.kind == -1)
-            {
-                //
-                //  Take the easy route: skip is translated to zeros
-                //
-                if(do_debug)
-                    printf("S");
-                if (sel.cols() <= 0)
-                    one.resize(nchan,thisRawDir.nsamp);
-                else
-                    one.resize(sel.cols(),thisRawDir.nsamp);
 
-                one.setZero();
-            }
-            else
-            {
-                FiffTag::SPtr t_pTag;
-                FiffTag::read_tag(fid.data(), t_pTag, thisRawDir.ent.pos);
-                //
-                //   Depending on the state of the projection and selection
-                //   we proceed a little bit differently
-                //
-                if (mult.cols() == 0)
-                {
-                    if (sel.cols() == 0)
-                    {
-                        if (t_pTag->type == FIFFT_DAU_PACK16)
-                            one = cal*(Map< MatrixDau16 >( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else if(t_pTag->type == FIFFT_INT)
-                            one = cal*(Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else if(t_pTag->type == FIFFT_FLOAT)
-                            one = cal*(Map< MatrixXf >( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else
-                            printf("Data Storage Format not known jet [1]!! Type: %d\n", t_pTag->type);
-                    }
-                    else
-                    {
-
-                        //ToDo find a faster solution for this!! --> make cal and mul sparse like in MATLAB
-                        MatrixXd newData(sel.cols(), thisRawDir.nsamp); //ToDo this can be done much faster, without newData
-
-                        if (t_pTag->type == FIFFT_DAU_PACK16)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixDau16 > ( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else if(t_pTag->type == FIFFT_INT)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else if(t_pTag->type == FIFFT_FLOAT)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixXf > ( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else
-                        {
-                            printf("Data Storage Format not known jet [2]!! Type: %d\n", t_pTag->type);
-                        }
-
-                        one = cal*newData;
-                    }
-                }
-                else
-                {
-                    if (t_pTag->type == FIFFT_DAU_PACK16)
-                        one = mult*(Map< MatrixDau16 >( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else if(t_pTag->type == FIFFT_INT)
-                        one = mult*(Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else if(t_pTag->type == FIFFT_FLOAT)
-                        one = mult*(Map< MatrixXf >( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else
-                        printf("Data Storage Format not known jet [3]!! Type: %d\n", t_pTag->type);
-                }
-            }
-            //
-            //  The picking logic is a bit complicated
-            //
-            if (to >= thisRawDir.last && from <= thisRawDir.first)
-            {
-                //
-                //  We need the whole buffer
-                //
-                first_pick = 0;//1;
-                last_pick  = thisRawDir.nsamp - 1;
-                if (do_debug)
-                    printf("W");
-            }
-            else if (from > thisRawDir.first)
-            {
-                first_pick = from - thisRawDir.first;// + 1;
-                if(to < thisRawDir.last)
-                {
-                    //
-                    //  Something from the middle
-                    //
-//                    qDebug() << "This needs to be debugged!";
-                    last_pick = thisRawDir.nsamp + to - thisRawDir.last - 1;//is this alright?
-                    if (do_debug)
-                        printf("M");
-                }
-                else
-                {
-                    //
-                    //  From the middle to the end
-                    //
-                    last_pick = thisRawDir.nsamp - 1;
-                    if (do_debug)
-                        printf("E");
-                }
-            }
-            else
-            {
-                //
-                //  From the beginning to the middle
-                //
-                first_pick = 0;//1;
-                last_pick  = to - thisRawDir.first;// + 1;
-                if (do_debug)
-                    printf("B");
-            }
-            //
-            //  Now we are ready to pick
-            //
-            picksamp = last_pick - first_pick + 1;
+//*************************************************************************************************************
 
-            if(do_debug)
-            {
-                qDebug() << "first_pick: " << first_pick;
-                qDebug() << "last_pick: " << last_pick;
-                qDebug() << "picksamp: " << picksamp;
-            }
+void RawBufferJob::decode()
+{
+    Map<MatrixXd> t_matOut(pOut, nrows, picksamp);
 
-            if (picksamp > 0)
-            {
-//                    for(r = 0; r < data->rows(); ++r)
-//                        for(c = 0; c < picksamp; ++c)
-//                            (*data)(r,dest + c) = one(r,first_pick + c);
-                data.block(0,dest,data.rows(),picksamp) = one.block(0, first_pick, data.rows(), picksamp);
+    if(pTag.isNull())
+    {
+        t_matOut.setZero();
+        return;
+    }
 
-                dest += picksamp;
-            }
-        }
+    bool t_bDecoded;
+    if(pMult->cols() == 0)
+    {
         //
-        //  Done?
+        //   Convert, pick, calibrate and store in one pass
         //
-        if (thisRawDir.last >= to)
-        {
-            printf(" [done]\n");
-            break;
-        }
+        t_bDecoded = FiffRawData::decode_buffer(pTag, bFileByteOrder, nchan, nsamp, first_pick, picksamp, pSel, nsel, pScale, pOut, nrows);
     }
-
-    if(mult.cols()==0)
-        multSegment = cal;
     else
-        multSegment = mult;
-//        fclose(fid);
-
-    times = MatrixXd(1, to-from+1);
-
-    for (i = 0; i < times.cols(); ++i)
-        times(0, i) = ((float)(from+i)) / this->info.sfreq;
+    {
+        //
+        //   Decode only the picked samples, then apply the composite operator
+        //
+        MatrixXd t_matBuffer(nchan, picksamp);
+        t_bDecoded = FiffRawData::decode_buffer(pTag, bFileByteOrder, nchan, nsamp, first_pick, picksamp, NULL, 0, NULL, t_matBuffer.data(), nchan);
+        if(t_bDecoded)
+            t_matOut = (*pMult)*t_matBuffer;
+    }
 
-    return true;
+    if(!t_bDecoded)
+    {
+        printf("Data Storage Format not known jet [1]!! Type: %d\n", pTag->type);
+        t_matOut.setZero();
+    }
 }
 
 
@@ -63,6 +63,7 @@
 
 #include <QFile>
 #include <QList>
+#include <QMutex>
 #include <QSharedPointer>
 
 
@@ -75,6 +76,7 @@ namespace FIFFLIB
 {
 
 class FiffRawData;
+class FiffTag;
 
 
 //*************************************************************************************************************
@@ -85,6 +87,34 @@ class FiffRawData;
 using namespace Eigen;
 
 
+//=========================================================================================================
+/**
+* One raw data buffer to be decoded into its destination block by read_raw_segment, used for parallel decoding
+*/
+struct RawBufferJob
+{
+    QSharedPointer<FiffTag> pTag;           /**< The buffer tag, NULL for skips */
+    bool                    bFileByteOrder; /**< Whether the tag data are still in file byte order */
+    qint32                  iRawDirIdx;     /**< Index of the buffer in the raw directory */
+    qint32                  nchan;          /**< Number of channels in the buffer */
+    qint32                  nsamp;          /**< Number of samples in the buffer */
+    qint32                  first_pick;     /**< First sample of the buffer to use */
+    qint32                  picksamp;       /**< Number of samples to use */
+    const qint32*           pSel;           /**< Channel selection, NULL for all channels */
+    qint32                  nsel;           /**< Number of selected channels */
+    const double*           pScale;         /**< Calibration per output row, NULL if pMult is applied */
+    const SparseMatrix<double>* pMult;      /**< Composite operator, applied if it is not empty */
+    double*                 pOut;           /**< Destination of the first sample (column major) */
+    qint32                  nrows;          /**< Number of rows of the destination */
+
+    //=========================================================================================================
+    /**
+    * Decodes the buffer into its destination block. Skips and unknown formats are written as zeros.
+    */
+    void decode();
+};
+
+
 //=============================================================================================================
 /**
 *Provides fiff raw measurement data, including I/O routines.
@@ -111,6 +141,16 @@ public:
     */
     FiffRawData(const FiffRawData &p_FiffRawData);
 
+    //=========================================================================================================
+    /**
+    * Assignment operator. The cached operators aren't copied.
+    *
+    * @param[in] p_FiffRawData  FIFF raw measurement which should be assigned
+    *
+    * @return the assigned raw measurement
+    */
+    FiffRawData& operator= (const FiffRawData &p_FiffRawData);
+
     //=========================================================================================================
     /**
     * Constructs fiff raw data, by reading from a IO device.
@@ -191,8 +231,117 @@ public:
     */
     bool read_raw_segment_times(MatrixXd& data, MatrixXd& times, float from, float to, const RowVectorXi& sel = defaultRowVectorXi);
 
+    //=========================================================================================================
+    /**
+    * Reads several segments, e.g. epochs, in a single pass over the raw directory. Every buffer overlapping any of
+    * the segments is read and decoded once (in parallel if enabled) and scattered into all segments it overlaps.
+    * Segments which are not completely within first_samp ... last_samp are returned empty.
+    *
+    * @param[out] data      returns one data matrix (channels x samples) per segment
+    * @param[in] from       first sample of each segment
+    * @param[in] to         last sample of each segment
+    * @param[in] sel        channel selection vector (optional)
+    *
+    * @return true if at least one segment was read, false otherwise
+    */
+    bool read_raw_segments(QList<MatrixXd>& data, const RowVectorXi& from, const RowVectorXi& to, const RowVectorXi& sel = defaultRowVectorXi);
+
+    //=========================================================================================================
+    /**
+    * Discards the cached calibration/projection/compensation operator. The cache is keyed on the identity (data
+    * and size) of cals, proj and comp and on the channel selection, which is cheap to check on every read but
+    * doesn't see changes of their values in place. Call this after modifying cals, proj or comp without
+    * reallocating them, e.g. after make_projector into an existing proj of the same size.
+    */
+    void invalidate_mult_cache();
+
+    //=========================================================================================================
+    /**
+    * Enables or disables parallel decoding of the raw data buffers in read_raw_segment. The buffers are still read in
+    * file order; conversion, calibration and projection run concurrently for a batch of buffers. Enabled by default.
+    *
+    * @param[in] p_bParallel    whether to decode in parallel
+    */
+    inline void setParallelDecoding(bool p_bParallel);
+
+    //=========================================================================================================
+    /**
+    * Returns whether raw data buffers are decoded in parallel.
+    *
+    * @return true if parallel decoding is enabled
+    */
+    inline bool parallelDecoding() const;
+
+    //=========================================================================================================
+    /**
+    * Enables or disables memory mapping of the raw data files in read_raw_segment. Mapped files are read without
+    * copying the buffers (see FiffStream::mapFile); files which can't be mapped are read as before. The mapping is
+    * released with the stream or when its device is closed. Enabled by default.
+    *
+    * @param[in] p_bMemoryMapping   whether to memory map the raw data files
+    */
+    inline void setMemoryMapping(bool p_bMemoryMapping);
+
+    //=========================================================================================================
+    /**
+    * Returns whether the raw data files are memory mapped by read_raw_segment.
+    *
+    * @return true if memory mapping is enabled
+    */
+    inline bool memoryMapping() const;
+
+    //=========================================================================================================
+    /**
+    * Fused decode kernel for raw data buffers (DAU_PACK16, INT and FLOAT). Converts the picked samples, applies the
+    * channel selection and the per channel calibration and writes them directly into the destination, in a single
+    * pass over the buffer.
+    *
+    * @param[in] p_pTag             the buffer tag
+    * @param[in] p_bFileByteOrder   true if the tag data are still in file byte order (FiffTag::read_tag_view)
+    * @param[in] nchan              number of channels stored in the buffer
+    * @param[in] nsamp              number of samples stored in the buffer
+    * @param[in] first_pick         first sample of the buffer to decode
+    * @param[in] picksamp           number of samples to decode
+    * @param[in] p_pSel             channel selection (nsel entries), NULL to decode all channels
+    * @param[in] nsel               number of selected channels
+    * @param[in] p_pScale           per output row calibration factor, NULL for none
+    * @param[out] p_pOut            destination of the first decoded sample, column major
+    * @param[in] p_iOutStride       distance between two destination columns
+    *
+    * @return true if succeeded, false if the storage format is not supported or the tag is too small
+    */
+    static bool decode_buffer(const QSharedPointer<FiffTag>& p_pTag, bool p_bFileByteOrder, qint32 nchan, qint32 nsamp, qint32 first_pick, qint32 picksamp, const qint32* p_pSel, qint32 nsel, const double* p_pScale, double* p_pOut, qint64 p_iOutStride);
+
+private:
+    //=========================================================================================================
+    /**
+    * Rebuilds the cached calibration matrix and the sparse composite operator (proj * comp * cal) used by
+    * read_raw_segment, if the calibration, projector, compensator or channel selection changed since the last call
+    * (see invalidate_mult_cache), and returns them. Thread safe: the operators are returned as shared snapshots,
+    * a rebuild by another thread doesn't affect them.
+    *
+    * @param[in] sel        channel selection vector
+    * @param[out] p_pCal    the calibration matrix
+    * @param[out] p_pMult   the composite operator, empty if no proj/comp
+    *
+    * @return true if the operators were rebuilt, false if the cached ones are still valid
+    */
+    bool update_mult_cache(const RowVectorXi& sel, QSharedPointer<const SparseMatrix<double> >& p_pCal, QSharedPointer<const SparseMatrix<double> >& p_pMult);
+
+    //=========================================================================================================
+    /**
+    * Reads the tag of a raw buffer job from the file holding it (main or continuation file), as a view into the
+    * mapping if memory mapping is enabled and the file can be mapped. Leaves the tag empty for skips and unreadable
+    * files.
+    *
+    * @param[in, out] p_job     the job of the buffer to read
+    */
+    void read_buffer_tag(RawBufferJob& p_job);
+
+
 public:
     FiffStream::SPtr file;      /**< replaces fid */
+    QList<FiffStream::SPtr> part_files; /**< Continuation files of a recording split into several files, in order */
     FiffInfo info;              /**< Fiff measurement information */
     fiff_int_t first_samp;      /**< Do we have a skip ToDo... */
     fiff_int_t last_samp;       /**< Do we have a skip ToDo... */
@@ -200,8 +349,60 @@ public:
     QList<FiffRawDir> rawdir;   /**< Special fiff diretory entry for raw data. */
     MatrixXd proj;              /**< SSP operator to apply to the data. */
     FiffCtfComp comp;           /**< Compensator. */
+
+private:
+    bool m_bParallelDecode;                 /**< Whether buffers are decoded in parallel. */
+    bool m_bMemoryMapping;                  /**< Whether the raw data files are memory mapped. */
+    QMutex m_qMutexMultCache;               /**< Guards the cached operators below, reads may run concurrently. */
+    bool m_bMultCacheValid;                 /**< Whether the cached operators below are valid. */
+    QSharedPointer<const SparseMatrix<double> > m_pCacheCal;    /**< Cached calibration matrix (selected channels only if no mult). */
+    QSharedPointer<const SparseMatrix<double> > m_pCacheMult;   /**< Cached sparse composite operator, empty if no proj/comp. */
+    const double* m_pCacheCalsData;         /**< Data of cals the cache was built with. */
+    qint64 m_iCacheCalsSize;                /**< Size of cals the cache was built with. */
+    const double* m_pCacheProjData;         /**< Data of proj the cache was built with. */
+    qint64 m_iCacheProjRows;                /**< Rows of proj the cache was built with. */
+    qint64 m_iCacheProjCols;                /**< Columns of proj the cache was built with. */
+    const double* m_pCacheCompData;         /**< Data of the compensator the cache was built with. */
+    qint64 m_iCacheCompSize;                /**< Size of the compensator data the cache was built with. */
+    fiff_int_t m_iCacheCompKind;            /**< Compensator kind the cache was built with. */
+    RowVectorXi m_vecCacheSel;              /**< Channel selection the cache was built with. */
 };
 
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline void FiffRawData::setParallelDecoding(bool p_bParallel)
+{
+    m_bParallelDecode = p_bParallel;
+}
+
+
+//*************************************************************************************************************
+
+inline bool FiffRawData::parallelDecoding() const
+{
+    return m_bParallelDecode;
+}
+
+
+//*************************************************************************************************************
+
+inline void FiffRawData::setMemoryMapping(bool p_bMemoryMapping)
+{
+    m_bMemoryMapping = p_bMemoryMapping;
+}
+
+
+//*************************************************************************************************************
+
+inline bool FiffRawData::memoryMapping() const
+{
+    return m_bMemoryMapping;
+}
+
 } // NAMESPACE
 
 #endif // FIFF_RAW_DATA_H
@@ -109,6 +109,7 @@ public:
     fiff_int_t  first;  /**< first sample */
     fiff_int_t  last;   /**< last sample */
     fiff_int_t  nsamp;  /**< Number of samples */
+    qint32      part;   /**< File of a split recording holding the buffer; 0: FiffRawData::file, k: FiffRawData::part_files[k-1] */
 };
 
 } // NAMESPACE
@@ -0,0 +1,375 @@
+//=============================================================================================================
+/**
+* @file     fiff_raw_reader.cpp
+* @author   MNE-CPP authors
+* @version  1.0
+* @date     October, 2026
+*
+* @section  LICENSE
+*
+* Copyright (C) 2026, MNE-CPP authors. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Implementation of the FiffRawReader Class.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "fiff_raw_reader.h"
+#include "fiff_stream.h"
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QFile>
+#include <QMutexLocker>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+FiffRawReader::FiffRawReader(const FiffRawData& p_FiffRawData, fiff_int_t p_iBlockSize, qint32 p_iLookAhead, qint32 p_iLookBehind, const RowVectorXi& p_vecSel)
+: m_raw(p_FiffRawData)
+, m_vecSel(p_vecSel)
+, m_iBlockSize(p_iBlockSize > 0 ? p_iBlockSize : 1)
+, m_iNumBlocks(0)
+, m_iLookAhead(p_iLookAhead > 0 ? p_iLookAhead : 0)
+, m_iLookBehind(p_iLookBehind > 0 ? p_iLookBehind : 0)
+, m_bWrapAround(false)
+, m_iFirstBlock(0)
+, m_iLastBlock(0)
+, m_iDirection(1)
+, m_iLoadingBlock(-1)
+, m_bIsRunning(true)
+{
+    if(!m_raw.isEmpty() && m_raw.last_samp >= m_raw.first_samp)
+        m_iNumBlocks = blockOf(m_raw.last_samp) + 1;
+
+    //
+    //  The reader gets its own stream in the prefetch thread
+    //
+    m_raw.file.clear();
+
+    start();
+}
+
+
+//*************************************************************************************************************
+
+FiffRawReader::~FiffRawReader()
+{
+    stop();
+}
+
+
+//*************************************************************************************************************
+
+void FiffRawReader::stop()
+{
+    m_qMutex.lock();
+    m_bIsRunning = false;
+    m_qCondRequest.wakeAll();
+    m_qCondLoaded.wakeAll();
+    m_qMutex.unlock();
+
+    QThread::wait();
+}
+
+
+//*************************************************************************************************************
+
+bool FiffRawReader::read(MatrixXd& data, MatrixXd& times, fiff_int_t from, fiff_int_t to)
+{
+    if(from < m_raw.first_samp)
+        from = m_raw.first_samp;
+    if(to > m_raw.last_samp)
+        to = m_raw.last_samp;
+    if(from > to)
+    {
+        printf("No data in this range\n");
+        return false;
+    }
+
+    qint32 t_iFirstBlock = blockOf(from);
+    qint32 t_iLastBlock = blockOf(to);
+    qint32 b;
+
+    QMutexLocker t_locker(&m_qMutex);
+
+    moveWindow(t_iFirstBlock, t_iLastBlock);
+
+    //
+    //  Wait for the blocks of this segment
+    //
+    bool t_bComplete = false;
+    while(m_bIsRunning && !t_bComplete)
+    {
+        t_bComplete = true;
+        for(b = t_iFirstBlock; b <= t_iLastBlock; ++b)
+        {
+            if(!m_qMapBlocks.contains(b))
+            {
+                t_bComplete = false;
+                m_qCondLoaded.wait(&m_qMutex);
+                break;
+            }
+        }
+    }
+    if(!t_bComplete)
+        return false;
+
+    //
+    //  Assemble the segment from the blocks
+    //
+    data.resize(m_qMapBlocks.constFind(t_iFirstBlock).value().rows(), to - from + 1);
+
+    fiff_int_t t_iSample = from;
+    while(t_iSample <= to)
+    {
+        b = blockOf(t_iSample);
+        const MatrixXd& t_matBlock = m_qMapBlocks.constFind(b).value();
+        fiff_int_t t_iBlockFirst = m_raw.first_samp + b*m_iBlockSize;
+        fiff_int_t t_iOffset = t_iSample - t_iBlockFirst;
+        fiff_int_t t_iCount = qMin((fiff_int_t)(t_matBlock.cols() - t_iOffset), to - t_iSample + 1);
+        if(t_iCount <= 0 || t_matBlock.rows() != data.rows())
+        {
+            printf("FiffRawReader: Error assembling raw data segment\n");
+            return false;
+        }
+        data.block(0, t_iSample - from, data.rows(), t_iCount) = t_matBlock.block(0, t_iOffset, data.rows(), t_iCount);
+        t_iSample += t_iCount;
+    }
+
+    times = MatrixXd(1, to-from+1);
+    for(qint32 i = 0; i < times.cols(); ++i)
+        times(0, i) = ((float)(from+i)) / m_raw.info.sfreq;
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+void FiffRawReader::seek(fiff_int_t p_iSample)
+{
+    if(p_iSample < m_raw.first_samp)
+        p_iSample = m_raw.first_samp;
+    if(p_iSample > m_raw.last_samp)
+        p_iSample = m_raw.last_samp;
+
+    QMutexLocker t_locker(&m_qMutex);
+    qint32 t_iBlock = blockOf(p_iSample);
+    moveWindow(t_iBlock, t_iBlock);
+}
+
+
+//*************************************************************************************************************
+
+void FiffRawReader::setWrapAround(bool p_bWrapAround)
+{
+    QMutexLocker t_locker(&m_qMutex);
+    m_bWrapAround = p_bWrapAround;
+    moveWindow(m_iFirstBlock, m_iLastBlock);
+}
+
+
+//*************************************************************************************************************
+
+void FiffRawReader::setLookAhead(qint32 p_iLookAhead, qint32 p_iLookBehind)
+{
+    QMutexLocker t_locker(&m_qMutex);
+    m_iLookAhead = p_iLookAhead > 0 ? p_iLookAhead : 0;
+    m_iLookBehind = p_iLookBehind > 0 ? p_iLookBehind : 0;
+    moveWindow(m_iFirstBlock, m_iLastBlock);
+}
+
+
+//*************************************************************************************************************
+
+void FiffRawReader::run()
+{
+    //
+    //  Open an own stream to the file in this thread, mapped if possible
+    //
+    QFile t_file(m_raw.info.filename);
+    FiffStream::SPtr t_pStream(new FiffStream(&t_file));
+    if(!t_pStream->mapFile())
+        t_pStream->device()->open(QIODevice::ReadOnly);
+    m_raw.file = t_pStream;
+
+    //
+    //  Same for the continuation files of a split recording
+    //
+    for(qint32 i = 0; i < m_raw.part_files.size(); ++i)
+    {
+        FiffStream::SPtr t_pPart(new FiffStream(m_raw.part_files[i]->streamName()));
+        if(!t_pPart->mapFile())
+            t_pPart->device()->open(QIODevice::ReadOnly);
+        m_raw.part_files[i] = t_pPart;
+    }
+
+    MatrixXd t_matData, t_matTimes;
+
+    m_qMutex.lock();
+    while(m_bIsRunning)
+    {
+        //
+        //  Pick the most urgent block which is not loaded yet
+        //
+        qint32 t_iBlock = -1;
+        QList<qint32> t_qListWindow = window();
+        for(qint32 i = 0; i < t_qListWindow.size(); ++i)
+        {
+            if(!m_qMapBlocks.contains(t_qListWindow[i]))
+            {
+                t_iBlock = t_qListWindow[i];
+                break;
+            }
+        }
+
+        if(t_iBlock < 0)
+        {
+            m_qCondRequest.wait(&m_qMutex);
+            continue;
+        }
+
+        m_iLoadingBlock = t_iBlock;
+        m_qMutex.unlock();
+
+        fiff_int_t t_iFrom = m_raw.first_samp + t_iBlock*m_iBlockSize;
+        fiff_int_t t_iTo = qMin(t_iFrom + m_iBlockSize - 1, m_raw.last_samp);
+        if(!m_raw.read_raw_segment(t_matData, t_matTimes, t_iFrom, t_iTo, m_vecSel))
+        {
+            printf("FiffRawReader: Error reading block %d\n", t_iBlock);
+            t_matData.resize(m_vecSel.size() > 0 ? m_vecSel.size() : m_raw.info.nchan, t_iTo - t_iFrom + 1);
+            t_matData.setZero();
+        }
+
+        m_qMutex.lock();
+        m_iLoadingBlock = -1;
+
+        //
+        //  A seek may have moved the window meanwhile, keep the block only if it is still wanted
+        //
+        if(window().contains(t_iBlock))
+            m_qMapBlocks.insert(t_iBlock, t_matData);
+
+        m_qCondLoaded.wakeAll();
+    }
+    m_qMutex.unlock();
+
+    m_raw.file.clear();
+    m_raw.part_files.clear();
+}
+
+
+//*************************************************************************************************************
+
+QList<qint32> FiffRawReader::window() const
+{
+    QList<qint32> t_qListWindow;
+    qint32 b, i;
+
+    //
+    //  Requested blocks first, then in reading direction, then against it
+    //
+    for(b = m_iFirstBlock; b <= m_iLastBlock; ++b)
+        t_qListWindow.append(b);
+
+    qint32 t_iAheadStart = m_iDirection > 0 ? m_iLastBlock : m_iFirstBlock;
+    qint32 t_iBehindStart = m_iDirection > 0 ? m_iFirstBlock : m_iLastBlock;
+
+    for(i = 1; i <= m_iLookAhead + m_iLookBehind; ++i)
+    {
+        if(i <= m_iLookAhead)
+            b = t_iAheadStart + m_iDirection*i;
+        else
+            b = t_iBehindStart - m_iDirection*(i - m_iLookAhead);
+
+        if(b < 0 || b >= m_iNumBlocks)
+        {
+            if(!m_bWrapAround || m_iNumBlocks == 0)
+                continue;
+            b = ((b % m_iNumBlocks) + m_iNumBlocks) % m_iNumBlocks;
+        }
+
+        if(!t_qListWindow.contains(b))
+            t_qListWindow.append(b);
+    }
+
+    return t_qListWindow;
+}
+
+
+//*************************************************************************************************************
+
+void FiffRawReader::moveWindow(qint32 p_iFirstBlock, qint32 p_iLastBlock)
+{
+    if(m_bWrapAround && m_iNumBlocks > 0)
+    {
+        //
+        //  A jump across the ends, e.g. from the last block back to block 0, continues in the current direction:
+        //  take the shorter way around
+        //
+        qint32 t_iForward = ((p_iFirstBlock - m_iFirstBlock) % m_iNumBlocks + m_iNumBlocks) % m_iNumBlocks;
+        if(t_iForward > 0)
+            m_iDirection = 2*t_iForward <= m_iNumBlocks ? 1 : -1;
+    }
+    else if(p_iFirstBlock > m_iFirstBlock)
+        m_iDirection = 1;
+    else if(p_iLastBlock < m_iLastBlock)
+        m_iDirection = -1;
+
+    m_iFirstBlock = p_iFirstBlock;
+    m_iLastBlock = p_iLastBlock;
+
+    //
+    //  Drop the blocks which left the window, this also cancels their pending prefetch
+    //
+    QList<qint32> t_qListWindow = window();
+    QMap<qint32, MatrixXd>::iterator it = m_qMapBlocks.begin();
+    while(it != m_qMapBlocks.end())
+    {
+        if(t_qListWindow.contains(it.key()))
+            ++it;
+        else
+            it = m_qMapBlocks.erase(it);
+    }
+
+    m_qCondRequest.wakeAll();
+}
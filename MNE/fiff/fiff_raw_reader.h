@@ -0,0 +1,242 @@
+//=============================================================================================================
+/**
+* @file     fiff_raw_reader.h
+* @author   MNE-CPP authors
+* @version  1.0
+* @date     October, 2026
+*
+* @section  LICENSE
+*
+* Copyright (C) 2026, MNE-CPP authors. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    FiffRawReader class declaration.
+*
+*/
+
+#ifndef FIFF_RAW_READER_H
+#define FIFF_RAW_READER_H
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "fiff_global.h"
+#include "fiff_raw_data.h"
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Qt INCLUDES
+//=============================================================================================================
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QMap>
+#include <QList>
+#include <QSharedPointer>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE NAMESPACE FIFFLIB
+//=============================================================================================================
+
+namespace FIFFLIB
+{
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+
+
+//=============================================================================================================
+/**
+* Reads raw data for sequential consumers. The recording is divided into blocks of a fixed number of samples;
+* a background thread keeps the blocks around the current read position decoded in a bounded cache, so that
+* consecutive reads are served from memory. The look-ahead follows the read direction, and blocks which leave the
+* window (e.g. after a seek) are dropped before they are loaded.
+*
+* The reader opens its own stream to the raw file, so it can be used alongside the FiffRawData it was created from.
+* It is meant for a single consumer thread calling read() and seek().
+*
+* @brief Read-ahead prefetching raw data reader
+*/
+class FIFFSHARED_EXPORT FiffRawReader : public QThread
+{
+public:
+    typedef QSharedPointer<FiffRawReader> SPtr;               /**< Shared pointer type for FiffRawReader. */
+    typedef QSharedPointer<const FiffRawReader> ConstSPtr;    /**< Const shared pointer type for FiffRawReader. */
+
+    //=========================================================================================================
+    /**
+    * Constructs the reader and starts its prefetch thread at the beginning of the recording.
+    *
+    * @param[in] p_FiffRawData  The raw data to read; its measurement info, directory, projector and compensator are copied
+    * @param[in] p_iBlockSize   Number of samples per block
+    * @param[in] p_iLookAhead   Number of blocks to prefetch in reading direction
+    * @param[in] p_iLookBehind  Number of blocks to keep/prefetch against reading direction
+    * @param[in] p_vecSel       Channel selection (optional)
+    */
+    FiffRawReader(const FiffRawData& p_FiffRawData, fiff_int_t p_iBlockSize, qint32 p_iLookAhead = 2, qint32 p_iLookBehind = 1, const RowVectorXi& p_vecSel = defaultRowVectorXi);
+
+    //=========================================================================================================
+    /**
+    * Stops the prefetch thread and destroys the reader.
+    */
+    ~FiffRawReader();
+
+    //=========================================================================================================
+    /**
+    * Stops the prefetch thread. Pending and future reads return false.
+    */
+    void stop();
+
+    //=========================================================================================================
+    /**
+    * Reads a raw data segment. Blocks until the segment is available; the blocks around it are scheduled for prefetch.
+    *
+    * @param[out] data      returns the data matrix (channels x samples)
+    * @param[out] times     returns the time values corresponding to the samples
+    * @param[in] from       first sample to include
+    * @param[in] to         last sample to include
+    *
+    * @return true if succeeded, false otherwise
+    */
+    bool read(MatrixXd& data, MatrixXd& times, fiff_int_t from, fiff_int_t to);
+
+    //=========================================================================================================
+    /**
+    * Moves the read position to the block containing the given sample. Pending prefetches outside the new window
+    * are cancelled, the new window is prefetched.
+    *
+    * @param[in] p_iSample  sample to seek to
+    */
+    void seek(fiff_int_t p_iSample);
+
+    //=========================================================================================================
+    /**
+    * Sets whether the look-ahead wraps around at the end (and start) of the recording, e.g. for looped simulations.
+    *
+    * @param[in] p_bWrapAround  whether to wrap around
+    */
+    void setWrapAround(bool p_bWrapAround);
+
+    //=========================================================================================================
+    /**
+    * Sets the look-ahead in and against reading direction.
+    *
+    * @param[in] p_iLookAhead   Number of blocks to prefetch in reading direction
+    * @param[in] p_iLookBehind  Number of blocks to keep/prefetch against reading direction
+    */
+    void setLookAhead(qint32 p_iLookAhead, qint32 p_iLookBehind);
+
+    //=========================================================================================================
+    /**
+    * Returns the number of samples per block.
+    *
+    * @return the block size
+    */
+    inline fiff_int_t blockSize() const;
+
+protected:
+    //=========================================================================================================
+    /**
+    * The prefetch loop. Loads the most urgent missing block of the current window, one at a time.
+    */
+    virtual void run();
+
+private:
+    //=========================================================================================================
+    /**
+    * Returns the block which contains the given sample.
+    */
+    inline qint32 blockOf(fiff_int_t p_iSample) const;
+
+    //=========================================================================================================
+    /**
+    * Returns the blocks of the current window in the order they should be loaded. Needs m_qMutex to be locked.
+    */
+    QList<qint32> window() const;
+
+    //=========================================================================================================
+    /**
+    * Moves the window to the given blocks, drops cached blocks which left it and wakes the prefetch thread.
+    * With wrap around the reading direction follows the shorter way around, so a restart at block 0 after the
+    * last block keeps reading forward. Needs m_qMutex to be locked.
+    */
+    void moveWindow(qint32 p_iFirstBlock, qint32 p_iLastBlock);
+
+    FiffRawData         m_raw;              /**< Raw data, reopened with its own stream in the prefetch thread. */
+    RowVectorXi         m_vecSel;           /**< Channel selection. */
+    fiff_int_t          m_iBlockSize;       /**< Samples per block. */
+    qint32              m_iNumBlocks;       /**< Number of blocks in the recording. */
+    qint32              m_iLookAhead;       /**< Blocks to prefetch in reading direction. */
+    qint32              m_iLookBehind;      /**< Blocks to prefetch against reading direction. */
+    bool                m_bWrapAround;      /**< Whether the window wraps around at the ends. */
+
+    QMutex              m_qMutex;           /**< Guards the members below. */
+    QWaitCondition      m_qCondRequest;     /**< Signals the prefetch thread that the window changed. */
+    QWaitCondition      m_qCondLoaded;      /**< Signals readers that a block was loaded. */
+    QMap<qint32, MatrixXd> m_qMapBlocks;    /**< Decoded blocks of the current window. */
+    qint32              m_iFirstBlock;      /**< First block of the last request. */
+    qint32              m_iLastBlock;       /**< Last block of the last request. */
+    qint32              m_iDirection;       /**< Reading direction, 1 forward, -1 backward. */
+    qint32              m_iLoadingBlock;    /**< Block currently loaded by the prefetch thread, -1 if none. */
+    bool                m_bIsRunning;       /**< Whether the prefetch thread is running. */
+};
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline fiff_int_t FiffRawReader::blockSize() const
+{
+    return m_iBlockSize;
+}
+
+
+//*************************************************************************************************************
+
+inline qint32 FiffRawReader::blockOf(fiff_int_t p_iSample) const
+{
+    return (p_iSample - m_raw.first_samp) / m_iBlockSize;
+}
+
+} // NAMESPACE
+
+#endif // FIFF_RAW_READER_H
@@ -0,0 +1,214 @@
+//=============================================================================================================
+/**
+* @file     fiff_raw_writer.cpp
+* @author   MNE-CPP authors
+* @version  1.0
+* @date     October, 2026
+*
+* @section  LICENSE
+*
+* Copyright (C) 2026, MNE-CPP authors. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Implementation of the FiffRawWriter Class.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "fiff_raw_writer.h"
+#include "fiff_stream.h"
+#include "fiff_constants.h"
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QMutexLocker>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+FiffRawWriter::FiffRawWriter(FiffStream* p_pStream, qint32 p_iPoolSize)
+: m_pStream(p_pStream)
+, m_bIsRunning(true)
+, m_iWritten(0)
+, m_iDropped(0)
+, m_iMaxQueued(0)
+{
+    if(p_iPoolSize < 1)
+        p_iPoolSize = 1;
+
+    m_qVecBuffers.resize(p_iPoolSize);
+    m_qVecCals.resize(p_iPoolSize);
+    for(qint32 i = 0; i < p_iPoolSize; ++i)
+        m_qQueueFree.enqueue(i);
+
+    start();
+}
+
+
+//*************************************************************************************************************
+
+FiffRawWriter::~FiffRawWriter()
+{
+    stop();
+}
+
+
+//*************************************************************************************************************
+
+void FiffRawWriter::stop()
+{
+    m_qMutex.lock();
+    m_bIsRunning = false;
+    m_qCondFilled.wakeAll();
+    m_qMutex.unlock();
+
+    QThread::wait();
+}
+
+
+//*************************************************************************************************************
+
+bool FiffRawWriter::push(const MatrixXd& buf, const RowVectorXd& cals)
+{
+    if(cals.size() > 0 && buf.rows() != cals.cols())
+    {
+        printf("buffer and calibration sizes do not match\n");
+        return false;
+    }
+
+    m_qMutex.lock();
+    if(!m_bIsRunning || m_qQueueFree.isEmpty())
+    {
+        ++m_iDropped;
+        m_qMutex.unlock();
+        return false;
+    }
+    qint32 t_iIdx = m_qQueueFree.dequeue();
+    m_qMutex.unlock();
+
+    //
+    //  Copy outside the lock, the slot is owned by this thread until it is queued. Once the pool buffers have
+    //  their size no further allocations take place.
+    //
+    m_qVecBuffers[t_iIdx] = buf;
+    m_qVecCals[t_iIdx] = cals;
+
+    m_qMutex.lock();
+    m_qQueueFilled.enqueue(t_iIdx);
+    if(m_qQueueFilled.size() > m_iMaxQueued)
+        m_iMaxQueued = m_qQueueFilled.size();
+    m_qCondFilled.wakeOne();
+    m_qMutex.unlock();
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+qint64 FiffRawWriter::written() const
+{
+    QMutexLocker t_locker(&m_qMutex);
+    return m_iWritten;
+}
+
+
+//*************************************************************************************************************
+
+qint64 FiffRawWriter::dropped() const
+{
+    QMutexLocker t_locker(&m_qMutex);
+    return m_iDropped;
+}
+
+
+//*************************************************************************************************************
+
+qint32 FiffRawWriter::maxQueued() const
+{
+    QMutexLocker t_locker(&m_qMutex);
+    return m_iMaxQueued;
+}
+
+
+//*************************************************************************************************************
+
+void FiffRawWriter::run()
+{
+    MatrixXf t_matFloat;
+
+    m_qMutex.lock();
+    while(true)
+    {
+        while(m_bIsRunning && m_qQueueFilled.isEmpty())
+            m_qCondFilled.wait(&m_qMutex);
+
+        //
+        //  Drain the queue before leaving
+        //
+        if(m_qQueueFilled.isEmpty())
+            break;
+
+        qint32 t_iIdx = m_qQueueFilled.dequeue();
+        m_qMutex.unlock();
+
+        const MatrixXd& t_matBuf = m_qVecBuffers[t_iIdx];
+        const RowVectorXd& t_vecCals = m_qVecCals[t_iIdx];
+
+        //
+        //  Inverse calibration and conversion in one pass
+        //
+        if(t_vecCals.size() > 0)
+            t_matFloat = (t_vecCals.cwiseInverse().asDiagonal()*t_matBuf).cast<float>();
+        else
+            t_matFloat = t_matBuf.cast<float>();
+
+        //
+        //  Split aware write; a continuation file is started here in the writer thread, so that the device
+        //  is never swapped while another buffer is written
+        //
+        m_pStream->write_raw_float_buffer(t_matFloat);
+
+        m_qMutex.lock();
+        ++m_iWritten;
+        m_qQueueFree.enqueue(t_iIdx);
+    }
+    m_qMutex.unlock();
+}
@@ -0,0 +1,185 @@
+//=============================================================================================================
+/**
+* @file     fiff_raw_writer.h
+* @author   MNE-CPP authors
+* @version  1.0
+* @date     October, 2026
+*
+* @section  LICENSE
+*
+* Copyright (C) 2026, MNE-CPP authors. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    FiffRawWriter class declaration.
+*
+*/
+
+#ifndef FIFF_RAW_WRITER_H
+#define FIFF_RAW_WRITER_H
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "fiff_global.h"
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Qt INCLUDES
+//=============================================================================================================
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QQueue>
+#include <QSharedPointer>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE NAMESPACE FIFFLIB
+//=============================================================================================================
+
+namespace FIFFLIB
+{
+
+class FiffStream;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+
+
+//=============================================================================================================
+/**
+* Writes raw data buffers of a FiffStream from a dedicated thread. Buffers are copied into a preallocated pool and
+* queued; inverse calibration, conversion to float and the actual disk write happen in the writer thread, so an
+* acquisition loop never waits for the disk. If the pool is exhausted the buffer is dropped and counted.
+*
+* Created and owned by FiffStream::start_async_writing, see there. The buffers are written through
+* FiffStream::write_raw_float_buffer, so recordings are split into continuation files by the writer thread.
+*
+* @brief Asynchronous raw data buffer writer
+*/
+class FIFFSHARED_EXPORT FiffRawWriter : public QThread
+{
+public:
+    typedef QSharedPointer<FiffRawWriter> SPtr;               /**< Shared pointer type for FiffRawWriter. */
+    typedef QSharedPointer<const FiffRawWriter> ConstSPtr;    /**< Const shared pointer type for FiffRawWriter. */
+
+    //=========================================================================================================
+    /**
+    * Constructs the writer and starts its thread.
+    *
+    * @param[in] p_pStream      The stream to write to, a raw data block has to be started already
+    * @param[in] p_iPoolSize    Number of buffers which can be queued
+    */
+    FiffRawWriter(FiffStream* p_pStream, qint32 p_iPoolSize);
+
+    //=========================================================================================================
+    /**
+    * Writes all queued buffers, stops the writer thread and destroys the writer.
+    */
+    ~FiffRawWriter();
+
+    //=========================================================================================================
+    /**
+    * Writes all queued buffers and stops the writer thread.
+    */
+    void stop();
+
+    //=========================================================================================================
+    /**
+    * Queues a raw data buffer for writing. Does not block; if all pool buffers are in use the buffer is dropped.
+    *
+    * @param[in] buf        the buffer to write (channels x samples)
+    * @param[in] cals       calibration factors to invert before writing, empty to write the buffer as it is
+    *
+    * @return true if the buffer was queued, false if it was dropped
+    */
+    bool push(const MatrixXd& buf, const RowVectorXd& cals);
+
+    //=========================================================================================================
+    /**
+    * Returns the number of buffers written so far.
+    *
+    * @return the number of written buffers
+    */
+    qint64 written() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the number of buffers dropped because the pool was exhausted.
+    *
+    * @return the number of dropped buffers
+    */
+    qint64 dropped() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the highest number of buffers which were queued at the same time, a measure of the back pressure.
+    *
+    * @return the high water mark of the queue
+    */
+    qint32 maxQueued() const;
+
+protected:
+    //=========================================================================================================
+    /**
+    * The writer loop.
+    */
+    virtual void run();
+
+private:
+    FiffStream*         m_pStream;          /**< The stream to write to. */
+
+    QVector<MatrixXd>   m_qVecBuffers;      /**< Buffer pool. */
+    QVector<RowVectorXd> m_qVecCals;        /**< Calibration of each pool buffer. */
+    QQueue<qint32>      m_qQueueFree;       /**< Indices of free pool buffers. */
+    QQueue<qint32>      m_qQueueFilled;     /**< Indices of pool buffers waiting to be written, in order. */
+
+    mutable QMutex      m_qMutex;           /**< Guards the queues and counters. */
+    QWaitCondition      m_qCondFilled;      /**< Signals the writer thread that a buffer was queued. */
+    bool                m_bIsRunning;       /**< Whether the writer thread accepts buffers. */
+
+    qint64              m_iWritten;         /**< Number of written buffers. */
+    qint64              m_iDropped;         /**< Number of dropped buffers. */
+    qint32              m_iMaxQueued;       /**< High water mark of the queue. */
+};
+
+} // NAMESPACE
+
+#endif // FIFF_RAW_WRITER_H
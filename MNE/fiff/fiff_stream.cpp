@@ -46,8 +46,10 @@
 #include "fiff_info_base.h"
 #include "fiff_raw_data.h"
 #include "fiff_cov.h"
+#include "fiff_raw_writer.h"
 
 #include <utils/mnemath.h>
+#include <utils/ioutils.h>
 
 
 //*************************************************************************************************************
@@ -56,6 +58,18 @@
 //=============================================================================================================
 
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QtEndian>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <vector>
 
 
 //*************************************************************************************************************
@@ -67,6 +81,17 @@ using namespace FIFFLIB;
 using namespace UTILSLIB;
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC DEFINITIONS
+//=============================================================================================================
+
+static bool s_bDirCacheEnabled = false;
+
+#define FIFF_DIR_CACHE_MAGIC    0x46444952  /**< "FDIR" */
+#define FIFF_DIR_CACHE_VERSION  2   /**< 2: 64 bit tag positions */
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -74,6 +99,16 @@ using namespace UTILSLIB;
 
 FiffStream::FiffStream(QIODevice *p_pIODevice)
 : QDataStream(p_pIODevice)
+, m_iAsyncWritten(0)
+, m_iAsyncDropped(0)
+, m_iAsyncMaxQueued(0)
+, m_bRawFinished(false)
+, m_pMappedData(NULL)
+, m_iMappedSize(0)
+, m_iSplitSize(0)
+, m_iSplitCount(0)
+, m_iRawFirstSample(0)
+, m_iRawSamples(0)
 {
     this->setFloatingPointPrecision(QDataStream::SinglePrecision);
     this->setByteOrder(QDataStream::BigEndian);
@@ -85,6 +120,16 @@ FiffStream::FiffStream(QIODevice *p_pIODevice)
 
 FiffStream::FiffStream(QByteArray * a, QIODevice::OpenMode mode)
 : QDataStream(a, mode)
+, m_iAsyncWritten(0)
+, m_iAsyncDropped(0)
+, m_iAsyncMaxQueued(0)
+, m_bRawFinished(false)
+, m_pMappedData(NULL)
+, m_iMappedSize(0)
+, m_iSplitSize(0)
+, m_iSplitCount(0)
+, m_iRawFirstSample(0)
+, m_iRawSamples(0)
 {
     this->setFloatingPointPrecision(QDataStream::SinglePrecision);
     this->setByteOrder(QDataStream::BigEndian);
@@ -92,10 +137,43 @@ FiffStream::FiffStream(QByteArray * a, QIODevice::OpenMode mode)
 }
 
 
+//*************************************************************************************************************
+
+FiffStream::FiffStream(const QString& p_sFileName)
+: QDataStream()
+, m_iAsyncWritten(0)
+, m_iAsyncDropped(0)
+, m_iAsyncMaxQueued(0)
+, m_bRawFinished(false)
+, m_pMappedData(NULL)
+, m_iMappedSize(0)
+, m_pFile(new QFile(p_sFileName))
+, m_iSplitSize(0)
+, m_iSplitCount(0)
+, m_iRawFirstSample(0)
+, m_iRawSamples(0)
+{
+    this->setDevice(m_pFile.data());
+    this->setFloatingPointPrecision(QDataStream::SinglePrecision);
+    this->setByteOrder(QDataStream::BigEndian);
+    this->setVersion(QDataStream::Qt_5_0);
+}
+
+
 //*************************************************************************************************************
 
 FiffStream::~FiffStream()
 {
+    //
+    //   Write what is still queued while the device is alive
+    //
+    this->stop_async_writing();
+
+    //
+    //   Release the mapping while the device is alive
+    //
+    this->unmapFile();
+
     //ToDo check if all IO devices are closed outside --> don't do this here!!
 //    printf("DEBUG: check if FiffStream::IODevice is closed else where. Cause here it's not anymore.");
 
@@ -132,6 +210,16 @@ void FiffStream::end_file()
 
 void FiffStream::finish_writing_raw()
 {
+    //Held until the end tags are written, a concurrent write_raw_buffer_async waits and is rejected afterwards
+    QMutexLocker t_locker(&m_qMutexRawWriter);
+
+    //The GUI and the acquisition thread may both end a recording
+    if(m_bRawFinished)
+        return;
+
+    this->stop_raw_writer();
+    m_bRawFinished = true;
+
     this->end_block(FIFFB_RAW_DATA);
     this->end_block(FIFFB_MEAS);
     this->end_file();
@@ -139,6 +227,69 @@ void FiffStream::finish_writing_raw()
 }
 
 
+//*************************************************************************************************************
+
+bool FiffStream::start_async_writing(qint32 p_iPoolSize)
+{
+    QMutexLocker t_locker(&m_qMutexRawWriter);
+
+    if(!m_pRawWriter.isNull())
+        return false;
+
+    m_pRawWriter = QSharedPointer<FiffRawWriter>(new FiffRawWriter(this, p_iPoolSize));
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+void FiffStream::stop_async_writing()
+{
+    QMutexLocker t_locker(&m_qMutexRawWriter);
+
+    this->stop_raw_writer();
+}
+
+
+//*************************************************************************************************************
+
+void FiffStream::stop_raw_writer()
+{
+    if(m_pRawWriter.isNull())
+        return;
+
+    m_pRawWriter->stop();
+
+    m_iAsyncWritten += m_pRawWriter->written();
+    m_iAsyncDropped += m_pRawWriter->dropped();
+    m_iAsyncMaxQueued = qMax(m_iAsyncMaxQueued, m_pRawWriter->maxQueued());
+
+    if(m_pRawWriter->dropped() > 0)
+        printf("Asynchronous raw writer dropped %lld buffer(s)\n", (long long)m_pRawWriter->dropped());
+
+    m_pRawWriter.clear();
+}
+
+
+//*************************************************************************************************************
+
+void FiffStream::async_write_stats(qint64& p_iWritten, qint64& p_iDropped, qint32& p_iMaxQueued) const
+{
+    QMutexLocker t_locker(&m_qMutexRawWriter);
+
+    p_iWritten = m_iAsyncWritten;
+    p_iDropped = m_iAsyncDropped;
+    p_iMaxQueued = m_iAsyncMaxQueued;
+
+    if(!m_pRawWriter.isNull())
+    {
+        p_iWritten += m_pRawWriter->written();
+        p_iDropped += m_pRawWriter->dropped();
+        p_iMaxQueued = qMax(p_iMaxQueued, m_pRawWriter->maxQueued());
+    }
+}
+
+
 //*************************************************************************************************************
 
 bool FiffStream::get_evoked_entries(const QList<FiffDirTree> &evoked_node, QStringList &comments, QList<fiff_int_t> &aspect_kinds, QString &t)
@@ -148,7 +299,8 @@ bool FiffStream::get_evoked_entries(const QList<FiffDirTree> &evoked_node, QStri
     QList<FiffDirTree>::ConstIterator ev;
 
     FiffTag::SPtr t_pTag;
-    qint32 kind, pos, k;
+    qint32 kind, k;
+    qint64 pos;
 
     for(ev = evoked_node.begin(); ev != evoked_node.end(); ++ev)
     {
@@ -197,6 +349,62 @@ bool FiffStream::get_evoked_entries(const QList<FiffDirTree> &evoked_node, QStri
 }
 
 
+//*************************************************************************************************************
+
+bool FiffStream::mapFile()
+{
+    if(isMapped())
+        return true;
+    this->unmapFile();
+
+    //
+    //   Only files can be mapped, sockets stay on the regular read path
+    //
+    QFile* t_pFile = qobject_cast<QFile*>(this->device());
+    if(!t_pFile)
+        return false;
+
+    if(!t_pFile->isOpen() && !t_pFile->open(QIODevice::ReadOnly))
+    {
+        printf("Cannot open %s\n", t_pFile->fileName().toUtf8().constData());
+        return false;
+    }
+
+    qint64 t_iSize = t_pFile->size();
+    if(t_iSize <= 0)
+        return false;
+
+    uchar* t_pData = t_pFile->map(0, t_iSize);
+    if(!t_pData)
+    {
+        printf("Could not map %s into memory. Falling back to regular reads.\n", t_pFile->fileName().toUtf8().constData());
+        return false;
+    }
+
+    m_pMappedData = t_pData;
+    m_iMappedSize = t_iSize;
+    m_pMappedFile = t_pFile;
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+void FiffStream::unmapFile()
+{
+    if(!m_pMappedData)
+        return;
+
+    if(isMapped())
+        m_pMappedFile->unmap(m_pMappedData);
+
+    m_pMappedData = NULL;
+    m_iMappedSize = 0;
+    m_pMappedFile.clear();
+}
+
+
 //*************************************************************************************************************
 
 bool FiffStream::open(FiffDirTree& p_Tree, QList<FiffDirEntry>& p_Dir)
@@ -243,18 +451,21 @@ bool FiffStream::open(FiffDirTree& p_Tree, QList<FiffDirEntry>& p_Dir)
     printf("\nCreating tag directory for %s...", t_sFileName.toUtf8().constData());
 
     p_Dir.clear();
-    qint32 dirpos = *t_pTag->toInt();
-    if (dirpos > 0)
+    //
+    //   Positions are unsigned 32 bit in the file, -1 (FIFFV_NEXT_NONE) marks a missing directory
+    //
+    fiff_int_t t_iDirPos = *t_pTag->toInt();
+    if (t_iDirPos != 0 && t_iDirPos != FIFFV_NEXT_NONE)
     {
-        FiffTag::read_tag(this, t_pTag, dirpos);
+        FiffTag::read_tag(this, t_pTag, (quint32)t_iDirPos);
         p_Dir = t_pTag->toDirEntry();
     }
-    else
+    else if (!s_bDirCacheEnabled || !this->read_dir_cache(p_Dir))
     {
         qint32 k = 0;
         this->device()->seek(0);//fseek(fid,0,'bof');
         FiffDirEntry t_fiffDirEntry;
-        while (t_pTag->next >= 0)
+        while (t_pTag->next != FIFFV_NEXT_NONE)
         {
             t_fiffDirEntry.pos = this->device()->pos();//pos = ftell(fid);
             FiffTag::read_tag_info(this, t_pTag);
@@ -264,6 +475,9 @@ bool FiffStream::open(FiffDirTree& p_Tree, QList<FiffDirEntry>& p_Dir)
             t_fiffDirEntry.size = t_pTag->size();
             p_Dir.append(t_fiffDirEntry);
         }
+
+        if (s_bDirCacheEnabled)
+            this->write_dir_cache(p_Dir);
     }
     //
     //   Create the directory tree structure
@@ -281,6 +495,22 @@ bool FiffStream::open(FiffDirTree& p_Tree, QList<FiffDirEntry>& p_Dir)
 }
 
 
+//*************************************************************************************************************
+
+void FiffStream::setDirCacheEnabled(bool p_bEnabled)
+{
+    s_bDirCacheEnabled = p_bEnabled;
+}
+
+
+//*************************************************************************************************************
+
+bool FiffStream::dirCacheEnabled()
+{
+    return s_bDirCacheEnabled;
+}
+
+
 //*************************************************************************************************************
 
 QStringList FiffStream::read_bad_channels(const FiffDirTree& p_Node)
@@ -526,7 +756,8 @@ QList<FiffCtfComp> FiffStream::read_ctf_comp(const FiffDirTree& p_Node, const QL
     QList<FiffDirTree> t_qListComps = p_Node.dir_tree_find(FIFFB_MNE_CTF_COMP_DATA);
 
     qint32 i, k, p, col, row;
-    fiff_int_t kind, pos;
+    fiff_int_t kind;
+    qint64 pos;
     FiffTag::SPtr t_pTag;
     for (k = 0; k < t_qListComps.size(); ++k)
     {
@@ -693,7 +924,7 @@ bool FiffStream::read_meas_info_base(const FiffDirTree& p_Node, FiffInfoBase& p_
     QList<FiffChInfo> chs;
     FiffCoordTrans cand;
     fiff_int_t kind = -1;
-    fiff_int_t pos = -1;
+    qint64 pos = -1;
 
     for (qint32 k = 0; k < parent_meg[0].nent; ++k)
     {
@@ -788,7 +1019,7 @@ bool FiffStream::read_meas_info(const FiffDirTree& p_Node, FiffInfo& info, FiffD
     meas_date[1] = -1;
 
     fiff_int_t kind = -1;
-    fiff_int_t pos = -1;
+    qint64 pos = -1;
 
     for (qint32 k = 0; k < meas_info[0].nent; ++k)
     {
@@ -1364,51 +1595,118 @@ bool FiffStream::setup_read_raw(QIODevice &p_IODevice, FiffRawData& data, bool a
     //
     //   Process the directory
     //
+    QList<FiffRawDir> rawdir;
+    fiff_int_t first_samp = 0;
+    if(!read_raw_dir(p_pStream.data(), raw[0], info.nchan, 0, first_samp, rawdir))
+        return false;
+    data.first_samp = rawdir.size() > 0 ? rawdir[0].first : first_samp;
+    //
+    //   Chain the continuation files of a split recording
+    //
+    QStringList t_qListFiles;
+    t_qListFiles << QFileInfo(t_sFileName).absoluteFilePath();
+    QString t_sNextFileName = p_pStream->read_next_file_name(t_Tree);
+    while(!t_sNextFileName.isEmpty() && !t_qListFiles.contains(t_sNextFileName))
+    {
+        FiffStream::SPtr t_pPart(new FiffStream(t_sNextFileName));
+        FiffDirTree t_PartTree;
+        QList<FiffDirEntry> t_PartDir;
+        if(!t_pPart->open(t_PartTree, t_PartDir))
+        {
+            printf("Cannot open continuation file %s, data are truncated\n", t_sNextFileName.toUtf8().constData());
+            break;
+        }
+
+        QList<FiffDirTree> t_qListRaw = t_PartTree.dir_tree_find(FIFFB_RAW_DATA);
+        if(t_qListRaw.size() == 0)
+            t_qListRaw = t_PartTree.dir_tree_find(FIFFB_CONTINUOUS_DATA);
+        if(t_qListRaw.size() == 0 && allow_maxshield)
+            t_qListRaw = t_PartTree.dir_tree_find(FIFFB_SMSH_RAW_DATA);
+        if(t_qListRaw.size() == 0 || !read_raw_dir(t_pPart.data(), t_qListRaw[0], info.nchan, data.part_files.size() + 1, first_samp, rawdir))
+        {
+            printf("No raw data in continuation file %s, data are truncated\n", t_sNextFileName.toUtf8().constData());
+            t_pPart->device()->close();
+            break;
+        }
 
-    QList<FiffDirEntry> dir = raw[0].dir;
-    fiff_int_t nent = raw[0].nent;
-    fiff_int_t nchan = info.nchan;
+        printf("\tContinued in %s\n", t_sNextFileName.toUtf8().constData());
+        data.part_files.append(t_pPart);
+        t_qListFiles << t_sNextFileName;
+        t_sNextFileName = t_pPart->read_next_file_name(t_PartTree);
+        t_pPart->device()->close();
+    }
+    data.last_samp  = first_samp - 1;//ToDo -1 right or is that MATLAB syntax
+    //
+    //   Add the calibration factors
+    //
+    RowVectorXd cals(data.info.nchan);
+    cals.setZero();
+    for (qint32 k = 0; k < data.info.nchan; ++k)
+        cals[k] = data.info.chs[k].range*data.info.chs[k].cal;
+    //
+    data.cals       = cals;
+    data.rawdir     = rawdir;
+    //data->proj       = [];
+    //data.comp       = [];
+    //
+    printf("\tRange : %d ... %d  =  %9.3f ... %9.3f secs\n",
+           data.first_samp,data.last_samp,
+           (double)data.first_samp/data.info.sfreq,
+           (double)data.last_samp/data.info.sfreq);
+    printf("Ready.\n");
+    data.file->device()->close();
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+bool FiffStream::read_raw_dir(FiffStream* p_pStream, const FiffDirTree& p_Raw, fiff_int_t nchan, qint32 p_iPart, fiff_int_t& p_iFirstSamp, QList<FiffRawDir>& p_RawDir)
+{
+    const QList<FiffDirEntry>& dir = p_Raw.dir;
+    fiff_int_t nent = p_Raw.nent;
     fiff_int_t first = 0;
-    fiff_int_t first_samp = 0;
+    fiff_int_t first_samp = p_iFirstSamp;
     fiff_int_t first_skip = 0;
     //
-    //  Get first sample tag if it is there
+    //  Get first sample tag if it is there, continuation files carry on with the sample index of the previous file
     //
     FiffTag::SPtr t_pTag;
-    if (dir[first].kind == FIFF_FIRST_SAMPLE)
+    if (first < nent && dir[first].kind == FIFF_FIRST_SAMPLE)
     {
-        FiffTag::read_tag(p_pStream.data(), t_pTag, dir[first].pos);
-        first_samp = *t_pTag->toInt();
+        if (p_iPart == 0)
+        {
+            FiffTag::read_tag(p_pStream, t_pTag, dir[first].pos);
+            first_samp = *t_pTag->toInt();
+        }
         ++first;
     }
 
     //
     //  Omit initial skip
     //
-    if (dir.at(first).kind == FIFF_DATA_SKIP)
+    if (p_iPart == 0 && first < nent && dir.at(first).kind == FIFF_DATA_SKIP)
     {
         //
         //  This first skip can be applied only after we know the buffer size
         //
-        FiffTag::read_tag(p_pStream.data(), t_pTag, dir[first].pos);
+        FiffTag::read_tag(p_pStream, t_pTag, dir[first].pos);
         first_skip = *t_pTag->toInt();
         ++first;
     }
-    data.first_samp = first_samp;
     //
     //   Go through the remaining tags in the directory
     //
-    QList<FiffRawDir> rawdir;
 //        rawdir = struct('ent',{},'first',{},'last',{},'nsamp',{});
     fiff_int_t nskip = 0;
-    fiff_int_t ndir  = 0;
     fiff_int_t nsamp = 0;
     for (qint32 k = first; k < nent; ++k)
     {
-        FiffDirEntry ent = dir.at(k);
+        const FiffDirEntry& ent = dir.at(k);
         if (ent.kind == FIFF_DATA_SKIP)
         {
-            FiffTag::read_tag(p_pStream.data(), t_pTag, ent.pos);
+            FiffTag::read_tag(p_pStream, t_pTag, ent.pos);
             nskip = *t_pTag->toInt();
         }
         else if(ent.kind == FIFF_DATA_BUFFER)
@@ -1440,7 +1738,6 @@ bool FiffStream::setup_read_raw(QIODevice &p_IODevice, FiffRawData& data, bool a
             if (first_skip > 0)
             {
                 first_samp += nsamp*first_skip;
-                data.first_samp = first_samp;
                 first_skip = 0;
             }
             //
@@ -1452,10 +1749,10 @@ bool FiffStream::setup_read_raw(QIODevice &p_IODevice, FiffRawData& data, bool a
                 t_RawDir.first = first_samp;
                 t_RawDir.last  = first_samp + nskip*nsamp - 1;//ToDo -1 right or is that MATLAB syntax
                 t_RawDir.nsamp = nskip*nsamp;
-                rawdir.append(t_RawDir);
+                t_RawDir.part  = p_iPart;
+                p_RawDir.append(t_RawDir);
                 first_samp = first_samp + nskip*nsamp;
                 nskip = 0;
-                ++ndir;
             }
             //
             //  Add a data buffer
@@ -1465,36 +1762,47 @@ bool FiffStream::setup_read_raw(QIODevice &p_IODevice, FiffRawData& data, bool a
             t_RawDir.first = first_samp;
             t_RawDir.last  = first_samp + nsamp - 1;//ToDo -1 right or is that MATLAB syntax
             t_RawDir.nsamp = nsamp;
-            rawdir.append(t_RawDir);
+            t_RawDir.part  = p_iPart;
+            p_RawDir.append(t_RawDir);
             first_samp += nsamp;
-            ++ndir;
         }
     }
-    data.last_samp  = first_samp - 1;//ToDo -1 right or is that MATLAB syntax
-    //
-    //   Add the calibration factors
-    //
-    RowVectorXd cals(data.info.nchan);
-    cals.setZero();
-    for (qint32 k = 0; k < data.info.nchan; ++k)
-        cals[k] = data.info.chs[k].range*data.info.chs[k].cal;
-    //
-    data.cals       = cals;
-    data.rawdir     = rawdir;
-    //data->proj       = [];
-    //data.comp       = [];
-    //
-    printf("\tRange : %d ... %d  =  %9.3f ... %9.3f secs\n",
-           data.first_samp,data.last_samp,
-           (double)data.first_samp/data.info.sfreq,
-           (double)data.last_samp/data.info.sfreq);
-    printf("Ready.\n");
-    data.file->device()->close();
 
+    p_iFirstSamp = first_samp;
     return true;
 }
 
 
+//*************************************************************************************************************
+
+QString FiffStream::read_next_file_name(const FiffDirTree& p_Tree)
+{
+    QList<FiffDirTree> t_qListRefs = p_Tree.dir_tree_find(FIFFB_REF);
+    FiffTag::SPtr t_pTag;
+
+    for(qint32 k = 0; k < t_qListRefs.size(); ++k)
+    {
+        if(!t_qListRefs[k].find_tag(this, FIFF_REF_ROLE, t_pTag) || *t_pTag->toInt() != FIFFV_ROLE_NEXT_FILE)
+            continue;
+
+        if(!t_qListRefs[k].find_tag(this, FIFF_REF_FILE_NAME, t_pTag))
+            continue;
+
+        //
+        //  Names are relative to the current file; fall back to its directory for moved absolute names
+        //
+        QFileInfo t_fileInfo(this->streamName());
+        QFileInfo t_nextFileInfo(t_pTag->toString());
+        if(t_nextFileInfo.isRelative() || !t_nextFileInfo.exists())
+            t_nextFileInfo = QFileInfo(t_fileInfo.absoluteDir(), t_nextFileInfo.fileName());
+
+        return t_nextFileInfo.absoluteFilePath();
+    }
+
+    return QString();
+}
+
+
 //*************************************************************************************************************
 
 QStringList FiffStream::split_name_list(QString p_sNameList)
@@ -1541,6 +1849,35 @@ FiffStream::SPtr FiffStream::start_file(QIODevice& p_IODevice)
 //*************************************************************************************************************
 
 FiffStream::SPtr FiffStream::start_writing_raw(QIODevice &p_IODevice, const FiffInfo& info, RowVectorXd& cals, MatrixXi sel)
+{
+    //
+    //  Create the file and save the essentials
+    //
+    FiffStream::SPtr t_pStream = start_file(p_IODevice);//1, 2, 3
+    if(!t_pStream)
+        return t_pStream;
+
+    t_pStream->write_raw_header(info, cals, sel);
+
+    //
+    //  Remember the header for continuation files, files are split below 2 GB by default
+    //
+    t_pStream->m_pRawInfo = QSharedPointer<FiffInfo>(new FiffInfo(info));
+    t_pStream->m_matRawSel = sel;
+    t_pStream->m_sRawFileName = t_pStream->streamName();
+    t_pStream->m_iSplitCount = 0;
+    t_pStream->m_iRawFirstSample = 0;
+    t_pStream->m_iRawSamples = 0;
+    if(qobject_cast<QFile*>(&p_IODevice))
+        t_pStream->m_iSplitSize = FIFF_DEFAULT_SPLIT_SIZE;
+
+    return t_pStream;
+}
+
+
+//*************************************************************************************************************
+
+void FiffStream::write_raw_header(const FiffInfo& info, RowVectorXd& cals, MatrixXi& sel)
 {
     //
     //   We will always write floats
@@ -1563,20 +1900,19 @@ FiffStream::SPtr FiffStream::start_writing_raw(QIODevice &p_IODevice, const Fiff
     fiff_int_t nchan = chs.size();
 
     //
-    //  Create the file and save the essentials
+    //  Save the essentials
     //
-    FiffStream::SPtr t_pStream = start_file(p_IODevice);//1, 2, 3
-    t_pStream->start_block(FIFFB_MEAS);//4
-    t_pStream->write_id(FIFF_BLOCK_ID);//5
+    this->start_block(FIFFB_MEAS);//4
+    this->write_id(FIFF_BLOCK_ID);//5
     if(info.meas_id.version != -1)
     {
-        t_pStream->write_id(FIFF_PARENT_BLOCK_ID,info.meas_id);//6
+        this->write_id(FIFF_PARENT_BLOCK_ID,info.meas_id);//6
     }
     //
     //
     //    Measurement info
     //
-    t_pStream->start_block(FIFFB_MEAS_INFO);//7
+    this->start_block(FIFFB_MEAS_INFO);//7
     //
     //    Blocks from the original
     //
@@ -1596,7 +1932,7 @@ FiffStream::SPtr FiffStream::start_writing_raw(QIODevice &p_IODevice, const Fiff
         for(qint32 k = 0; k < blocks.size(); ++k)
         {
             QList<FiffDirTree> nodes = t_Tree.dir_tree_find(blocks[k]);
-            FiffDirTree::copy_tree(t_pStream2,t_Tree.id,nodes,t_pStream);
+            FiffDirTree::copy_tree(t_pStream2,t_Tree.id,nodes,this);
             if(blocks[k] == FIFFB_HPI_RESULT && nodes.size() > 0)
                 have_hpi_result = true;
 
@@ -1611,14 +1947,14 @@ FiffStream::SPtr FiffStream::start_writing_raw(QIODevice &p_IODevice, const Fiff
     //
     if (!info.acq_pars.isEmpty() || !info.acq_stim.isEmpty())
     {
-        t_pStream->start_block(FIFFB_DACQ_PARS);
+        this->start_block(FIFFB_DACQ_PARS);
         if (!info.acq_pars.isEmpty())
-            t_pStream->write_string(FIFF_DACQ_PARS, info.acq_pars);
+            this->write_string(FIFF_DACQ_PARS, info.acq_pars);
 
         if (!info.acq_stim.isEmpty())
-            t_pStream->write_string(FIFF_DACQ_STIM, info.acq_stim);
+            this->write_string(FIFF_DACQ_STIM, info.acq_stim);
 
-        t_pStream->end_block(FIFFB_DACQ_PARS);
+        this->end_block(FIFFB_DACQ_PARS);
     }
     //
     //    Coordinate transformations if the HPI result block was not there
@@ -1626,49 +1962,49 @@ FiffStream::SPtr FiffStream::start_writing_raw(QIODevice &p_IODevice, const Fiff
     if (!have_hpi_result)
     {
         if (!info.dev_head_t.isEmpty())
-            t_pStream->write_coord_trans(info.dev_head_t);
+            this->write_coord_trans(info.dev_head_t);
 
         if (!info.ctf_head_t.isEmpty())
-            t_pStream->write_coord_trans(info.ctf_head_t);
+            this->write_coord_trans(info.ctf_head_t);
     }
     //
     //    Polhemus data
     //
     if (info.dig.size() > 0 && !have_isotrak)
     {
-        t_pStream->start_block(FIFFB_ISOTRAK);
+        this->start_block(FIFFB_ISOTRAK);
         for (qint32 k = 0; k < info.dig.size(); ++k)
-            t_pStream->write_dig_point(info.dig[k]);
+            this->write_dig_point(info.dig[k]);
 
-        t_pStream->end_block(FIFFB_ISOTRAK);
+        this->end_block(FIFFB_ISOTRAK);
     }
     //
     //    Projectors
     //
-    t_pStream->write_proj(info.projs);
+    this->write_proj(info.projs);
     //
     //    CTF compensation info
     //
-    t_pStream->write_ctf_comp(info.comps);
+    this->write_ctf_comp(info.comps);
     //
     //    Bad channels
     //
     if (info.bads.size() > 0)
     {
-        t_pStream->start_block(FIFFB_MNE_BAD_CHANNELS);
-        t_pStream->write_name_list(FIFF_MNE_CH_NAME_LIST,info.bads);
-        t_pStream->end_block(FIFFB_MNE_BAD_CHANNELS);
+        this->start_block(FIFFB_MNE_BAD_CHANNELS);
+        this->write_name_list(FIFF_MNE_CH_NAME_LIST,info.bads);
+        this->end_block(FIFFB_MNE_BAD_CHANNELS);
     }
     //
     //    General
     //
-    t_pStream->write_float(FIFF_SFREQ,&info.sfreq);
-    t_pStream->write_float(FIFF_HIGHPASS,&info.highpass);
-    t_pStream->write_float(FIFF_LOWPASS,&info.lowpass);
-    t_pStream->write_int(FIFF_NCHAN,&nchan);
-    t_pStream->write_int(FIFF_DATA_PACK,&data_type);
+    this->write_float(FIFF_SFREQ,&info.sfreq);
+    this->write_float(FIFF_HIGHPASS,&info.highpass);
+    this->write_float(FIFF_LOWPASS,&info.lowpass);
+    this->write_int(FIFF_NCHAN,&nchan);
+    this->write_int(FIFF_DATA_PACK,&data_type);
     if (info.meas_date[0] != -1)
-        t_pStream->write_int(FIFF_MEAS_DATE,info.meas_date, 2);
+        this->write_int(FIFF_MEAS_DATE,info.meas_date, 2);
     //
     //    Channel info
     //
@@ -1682,17 +2018,15 @@ FiffStream::SPtr FiffStream::start_writing_raw(QIODevice &p_IODevice, const Fiff
         chs[k].scanno = k+1;//+1 because
         //chs[k].range  = 1.0f;//Why? -> cause its already calibrated through reading
         cals[k] = chs[k].cal;
-        t_pStream->write_ch_info(&chs[k]);
+        this->write_ch_info(&chs[k]);
     }
     //
     //
-    t_pStream->end_block(FIFFB_MEAS_INFO);
+    this->end_block(FIFFB_MEAS_INFO);
     //
     // Start the raw data
     //
-    t_pStream->start_block(FIFFB_RAW_DATA);
-
-    return t_pStream;
+    this->start_block(FIFFB_RAW_DATA);
 }
 
 
@@ -1977,10 +2311,7 @@ void FiffStream::write_double(fiff_int_t kind, const double* data, fiff_int_t ne
     *this << (qint32)datasize;
     *this << (qint32)FIFFV_NEXT_SEQ;
 
-//    this->setFloatingPointPrecision(QDataStream::SinglePrecision);
-
-    for(qint32 i = 0; i < nel; ++i)
-        *this << data[i];
+    this->write_swapped(data, nel, 8);
 }
 
 
@@ -1995,10 +2326,7 @@ void FiffStream::write_float(fiff_int_t kind, const float* data, fiff_int_t nel)
     *this << (qint32)datasize;
     *this << (qint32)FIFFV_NEXT_SEQ;
 
-//    this->setFloatingPointPrecision(QDataStream::SinglePrecision);
-
-    for(qint32 i = 0; i < nel; ++i)
-        *this << data[i];
+    this->write_swapped(data, nel, 4);
 }
 
 
@@ -2018,17 +2346,14 @@ void FiffStream::write_float_matrix(fiff_int_t kind, const MatrixXf& mat)
     *this << (qint32)datasize;
     *this << (qint32)FIFFV_NEXT_SEQ;
 
-    qint32 i;
-    for(i = 0; i < numel; ++i)
-        *this << mat.data()[i];
+    this->write_swapped(mat.data(), numel, 4);
 
     qint32 dims[3];
     dims[0] = mat.cols();
     dims[1] = mat.rows();
     dims[2] = 2;
 
-    for(i = 0; i < 3; ++i)
-        *this << dims[i];
+    this->write_swapped(dims, 3, 4);
 }
 
 
@@ -2082,16 +2407,17 @@ void FiffStream::write_float_sparse_ccs(fiff_int_t kind, const SparseMatrix<floa
     *this << (qint32)FIFFV_NEXT_SEQ;
 
     //
-    //  The data values
+    //  The data values and row indices, gathered for one bulk write each
     //
+    std::vector<float> vals(s.size());
+    std::vector<qint32> inds(s.size());
     for(i = 0; i < s.size(); ++i)
-        *this << s[i].value();
-
-    //
-    //  Row indices
-    //
-    for(i = 0; i < s.size(); ++i)
-        *this << s[i].row();
+    {
+        vals[i] = s[i].value();
+        inds[i] = s[i].row();
+    }
+    this->write_swapped(vals.data(), vals.size(), 4);
+    this->write_swapped(inds.data(), inds.size(), 4);
 
     //
     //  Pointers
@@ -2109,8 +2435,7 @@ void FiffStream::write_float_sparse_ccs(fiff_int_t kind, const SparseMatrix<floa
        if(ptrs[k-1] < 0)
           ptrs[k-1] = ptrs[k];
     //
-    for(i = 0; i < (quint32)ptrs.size(); ++i)
-        *this << ptrs[i];
+    this->write_swapped(ptrs.data(), ptrs.size(), 4);
     //
     //   Dimensions
     //
@@ -2120,8 +2445,7 @@ void FiffStream::write_float_sparse_ccs(fiff_int_t kind, const SparseMatrix<floa
     dims[2] = mat.cols();
     dims[3] = 2;
 
-    for(i = 0; i < 4; ++i)
-        *this << dims[i];
+    this->write_swapped(dims, 4, 4);
 }
 
 
@@ -2175,16 +2499,17 @@ void FiffStream::write_float_sparse_rcs(fiff_int_t kind, const SparseMatrix<floa
     *this << (qint32)FIFFV_NEXT_SEQ;
 
     //
-    //  The data values
-    //
-    for(i = 0; i < s.size(); ++i)
-        *this << s[i].value();
-
-    //
-    //  Column indices
+    //  The data values and column indices, gathered for one bulk write each
     //
+    std::vector<float> vals(s.size());
+    std::vector<qint32> inds(s.size());
     for(i = 0; i < s.size(); ++i)
-        *this << s[i].col();
+    {
+        vals[i] = s[i].value();
+        inds[i] = s[i].col();
+    }
+    this->write_swapped(vals.data(), vals.size(), 4);
+    this->write_swapped(inds.data(), inds.size(), 4);
 
     //
     //  Pointers
@@ -2204,8 +2529,7 @@ void FiffStream::write_float_sparse_rcs(fiff_int_t kind, const SparseMatrix<floa
           ptrs[k-1] = ptrs[k];
 
     //
-    for(i = 0; i < (quint32)ptrs.size(); ++i)
-        *this << ptrs[i];
+    this->write_swapped(ptrs.data(), ptrs.size(), 4);
 
     //
     //  Dimensions
@@ -2216,8 +2540,7 @@ void FiffStream::write_float_sparse_rcs(fiff_int_t kind, const SparseMatrix<floa
     dims[2] = mat.cols();
     dims[3] = 2;
 
-    for(i = 0; i < 4; ++i)
-        *this << dims[i];
+    this->write_swapped(dims, 4, 4);
 }
 
 
@@ -2343,8 +2666,7 @@ void FiffStream::write_int(fiff_int_t kind, const fiff_int_t* data, fiff_int_t n
     *this << (qint32)datasize;
     *this << (qint32)FIFFV_NEXT_SEQ;
 
-    for(qint32 i = 0; i < nel; ++i)
-        *this << data[i];
+    this->write_swapped(data, nel, 4);
 }
 
 
@@ -2364,17 +2686,14 @@ void FiffStream::write_int_matrix(fiff_int_t kind, const MatrixXi& mat)
     *this << (qint32)datasize;
     *this << (qint32)FIFFV_NEXT_SEQ;
 
-    qint32 i;
-    for(i = 0; i < numel; ++i)
-        *this << mat.data()[i];
+    this->write_swapped(mat.data(), numel, 4);
 
     qint32 dims[3];
     dims[0] = mat.cols();
     dims[1] = mat.rows();
     dims[2] = 2;
 
-    for(i = 0; i < 3; ++i)
-        *this << dims[i];
+    this->write_swapped(dims, 3, 4);
 }
 
 
@@ -2455,7 +2774,7 @@ bool FiffStream::write_raw_buffer(const MatrixXd& buf, const RowVectorXd& cals)
     inv_calsMat.setFromTriplets(tripletList.begin(), tripletList.end());
 
     MatrixXf tmp = (inv_calsMat*buf).cast<float>();
-    this->write_float(FIFF_DATA_BUFFER,tmp.data(),tmp.rows()*tmp.cols());
+    this->write_raw_float_buffer(tmp);
     return true;
 }
 
@@ -2475,7 +2794,7 @@ bool FiffStream::write_raw_buffer(const MatrixXd& buf, const SparseMatrix<double
         inv_mult.coeffRef(it.row(),it.col()) = 1/it.value();
 
     MatrixXf tmp = (inv_mult*buf).cast<float>();
-    this->write_float(FIFF_DATA_BUFFER,tmp.data(),tmp.rows()*tmp.cols());
+    this->write_raw_float_buffer(tmp);
     return true;
 }
 
@@ -2485,11 +2804,142 @@ bool FiffStream::write_raw_buffer(const MatrixXd& buf, const SparseMatrix<double
 bool FiffStream::write_raw_buffer(const MatrixXd& buf)
 {
     MatrixXf tmp = buf.cast<float>();
-    this->write_float(FIFF_DATA_BUFFER,tmp.data(),tmp.rows()*tmp.cols());
+    this->write_raw_float_buffer(tmp);
     return true;
 }
 
 
+//*************************************************************************************************************
+
+bool FiffStream::write_raw_buffer_async(const MatrixXd& buf, const RowVectorXd& cals)
+{
+    //The push only queues the buffer, the lock is held briefly
+    QMutexLocker t_locker(&m_qMutexRawWriter);
+
+    if(m_bRawFinished)
+        return false;
+
+    if(m_pRawWriter.isNull())
+        return cals.size() > 0 ? this->write_raw_buffer(buf, cals) : this->write_raw_buffer(buf);
+
+    return m_pRawWriter->push(buf, cals);
+}
+
+
+//*************************************************************************************************************
+
+void FiffStream::write_raw_float_buffer(const MatrixXf& buf)
+{
+    //
+    //   Tag header, data and the closing tags of a split have to fit into the current file
+    //
+    qint64 t_iBytes = 16 + 4*(qint64)buf.rows()*buf.cols() + 65536;
+    if(m_iSplitSize > 0 && m_iRawSamples > 0 && this->device()->pos() + t_iBytes > m_iSplitSize)
+        this->split_raw_file();
+
+    this->write_float(FIFF_DATA_BUFFER,buf.data(),buf.rows()*buf.cols());
+    m_iRawSamples += buf.cols();
+}
+
+
+//*************************************************************************************************************
+
+void FiffStream::write_raw_first_sample(fiff_int_t p_iFirstSample)
+{
+    this->write_int(FIFF_FIRST_SAMPLE,&p_iFirstSample);
+
+    //
+    //   Continuation files of split raw data carry on from the first sample of the current file
+    //
+    m_iRawFirstSample = p_iFirstSample;
+    m_iRawSamples = 0;
+}
+
+
+//*************************************************************************************************************
+
+void FiffStream::setSplitSize(qint64 p_iSplitSize)
+{
+    m_iSplitSize = p_iSplitSize > 0 ? p_iSplitSize : 0;
+}
+
+
+//*************************************************************************************************************
+
+bool FiffStream::split_raw_file()
+{
+    if(m_pRawInfo.isNull() || !qobject_cast<QFile*>(this->device()))
+        return false;
+
+    QString t_sNextFileName = split_file_name(m_sRawFileName, m_iSplitCount + 1);
+    QSharedPointer<QFile> t_pNextFile(new QFile(t_sNextFileName));
+    if(!t_pNextFile->open(QIODevice::WriteOnly))
+    {
+        printf("Cannot write to %s, continuing in %s\n", t_sNextFileName.toUtf8().constData(), this->streamName().toUtf8().constData());
+        m_iSplitSize = 0;
+        return false;
+    }
+
+    //
+    //   Link the next file and close this one
+    //
+    fiff_int_t data;
+    this->start_block(FIFFB_REF);
+    data = FIFFV_ROLE_NEXT_FILE;
+    this->write_int(FIFF_REF_ROLE,&data);
+    this->write_string(FIFF_REF_FILE_NAME, QFileInfo(t_sNextFileName).fileName());
+    data = m_iSplitCount + 1;
+    this->write_int(FIFF_REF_FILE_NUM,&data);
+    this->end_block(FIFFB_REF);
+
+    this->end_block(FIFFB_RAW_DATA);
+    this->end_block(FIFFB_MEAS);
+    this->end_file();
+    this->device()->close();
+
+    //
+    //   Continue with the same header, the sample index carries on
+    //
+    this->setDevice(t_pNextFile.data());
+    m_pFile = t_pNextFile;
+    ++m_iSplitCount;
+
+    this->write_id(FIFF_FILE_ID);
+    data = -1;
+    this->write_int(FIFF_DIR_POINTER,&data);
+    this->write_int(FIFF_FREE_LIST,&data);
+
+    RowVectorXd t_vecCals;
+    this->write_raw_header(*m_pRawInfo, t_vecCals, m_matRawSel);
+
+    this->write_raw_first_sample(m_iRawFirstSample + m_iRawSamples);
+
+    printf("Continuing raw data in %s\n", t_sNextFileName.toUtf8().constData());
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+QString FiffStream::split_file_name(const QString& p_sFileName, qint32 p_iPart)
+{
+    QString t_sFileName = p_sFileName;
+    if(t_sFileName.endsWith("_raw.fif"))
+    {
+        t_sFileName.chop(8);
+        return t_sFileName + QString("-%1_raw.fif").arg(p_iPart);
+    }
+    else if(t_sFileName.endsWith(".fif"))
+    {
+        t_sFileName.chop(4);
+        return t_sFileName + QString("-%1.fif").arg(p_iPart);
+    }
+
+    return t_sFileName + QString("-%1").arg(p_iPart);
+}
+
+
 //*************************************************************************************************************
 
 void FiffStream::write_string(fiff_int_t kind, const QString& data)
@@ -2517,3 +2967,110 @@ void FiffStream::write_rt_command(fiff_int_t command, const QString& data)
 
     this->writeRawData(data.toUtf8().constData(),datasize);
 }
+
+
+//*************************************************************************************************************
+
+void FiffStream::write_swapped(const void* data, qint64 nel, qint32 elemSize)
+{
+    if(nel <= 0)
+        return;
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    this->writeRawData((const char*)data, (int)(nel*elemSize));
+#else
+    //
+    //   Swap in chunks to keep the scratch buffer small and in cache
+    //
+    const qint64 chunk = 16384;
+    std::vector<char> buf((size_t)(qMin(nel, chunk)*elemSize));
+    const char* src = (const char*)data;
+    for(qint64 k = 0; k < nel; k += chunk)
+    {
+        qint64 n = qMin(chunk, nel - k);
+        switch(elemSize)
+        {
+        case 2:
+            IOUtils::swap_bytes_16(src, buf.data(), n);
+            break;
+        case 8:
+            IOUtils::swap_bytes_64(src, buf.data(), n);
+            break;
+        default:
+            IOUtils::swap_bytes_32(src, buf.data(), n);
+            break;
+        }
+        this->writeRawData(buf.data(), (int)(n*elemSize));
+        src += n*elemSize;
+    }
+#endif
+}
+
+
+//*************************************************************************************************************
+
+bool FiffStream::read_dir_cache(QList<FiffDirEntry>& p_Dir)
+{
+    QFile* t_pFile = qobject_cast<QFile*>(this->device());
+    if(!t_pFile)
+        return false;
+
+    QFileInfo t_fileInfo(*t_pFile);
+    QFile t_cacheFile(t_fileInfo.absoluteFilePath() + QString(".dir"));
+    if(!t_cacheFile.exists() || !t_cacheFile.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream t_in(&t_cacheFile);
+    t_in.setByteOrder(QDataStream::BigEndian);
+
+    quint32 t_iMagic, t_iVersion;
+    qint64 t_iSize, t_iMTime;
+    qint32 t_iNent;
+    t_in >> t_iMagic >> t_iVersion >> t_iSize >> t_iMTime >> t_iNent;
+
+    if(t_in.status() != QDataStream::Ok || t_iMagic != FIFF_DIR_CACHE_MAGIC || t_iVersion != FIFF_DIR_CACHE_VERSION
+            || t_iSize != t_fileInfo.size() || t_iMTime != t_fileInfo.lastModified().toMSecsSinceEpoch()
+            || t_iNent < 0 || (qint64)t_iNent*20 > t_cacheFile.size())
+        return false;
+
+    QList<FiffDirEntry> t_Dir;
+    t_Dir.reserve(t_iNent);
+    FiffDirEntry t_fiffDirEntry;
+    for(qint32 k = 0; k < t_iNent; ++k)
+    {
+        t_in >> t_fiffDirEntry.kind >> t_fiffDirEntry.type >> t_fiffDirEntry.size >> t_fiffDirEntry.pos;
+        t_Dir.append(t_fiffDirEntry);
+    }
+
+    if(t_in.status() != QDataStream::Ok)
+        return false;
+
+    p_Dir = t_Dir;
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+bool FiffStream::write_dir_cache(const QList<FiffDirEntry>& p_Dir)
+{
+    QFile* t_pFile = qobject_cast<QFile*>(this->device());
+    if(!t_pFile)
+        return false;
+
+    QFileInfo t_fileInfo(*t_pFile);
+    QFile t_cacheFile(t_fileInfo.absoluteFilePath() + QString(".dir"));
+    if(!t_cacheFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QDataStream t_out(&t_cacheFile);
+    t_out.setByteOrder(QDataStream::BigEndian);
+
+    t_out << (quint32)FIFF_DIR_CACHE_MAGIC << (quint32)FIFF_DIR_CACHE_VERSION;
+    t_out << (qint64)t_fileInfo.size() << (qint64)t_fileInfo.lastModified().toMSecsSinceEpoch();
+    t_out << (qint32)p_Dir.size();
+    for(qint32 k = 0; k < p_Dir.size(); ++k)
+        t_out << p_Dir[k].kind << p_Dir[k].type << p_Dir[k].size << p_Dir[k].pos;
+
+    return t_out.status() == QDataStream::Ok;
+}
@@ -81,11 +81,21 @@
 #include <QFile>
 #include <QIODevice>
 #include <QList>
+#include <QMutex>
+#include <QPointer>
 #include <QSharedPointer>
 #include <QString>
 #include <QStringList>
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define FIFF_DEFAULT_SPLIT_SIZE Q_INT64_C(2147483647)   /**< Raw data files are split below 2 GB, so that all positions fit a signed 32 bit integer */
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // DEFINE NAMESPACE FIFFLIB
@@ -103,6 +113,8 @@ class FiffStream;
 class FiffTag;
 class FiffCtfComp;
 class FiffRawData;
+class FiffRawDir;
+class FiffRawWriter;
 class FiffInfo;
 class FiffInfoBase;
 class FiffCov;
@@ -149,6 +161,15 @@ public:
     */
     explicit FiffStream(QByteArray * a, QIODevice::OpenMode mode);
 
+    //=========================================================================================================
+    /**
+    * Constructs a fiff stream on a file which is owned by the stream, e.g. a continuation file of a split recording.
+    * The file is not opened.
+    *
+    * @param[in] p_sFileName    The name of the fiff file
+    */
+    explicit FiffStream(const QString& p_sFileName);
+
     //=========================================================================================================
     /**
     * Destroys the FiffInfo.
@@ -178,11 +199,69 @@ public:
     /**
     * ### MNE toolbox root function ###: Implementation of the fiff_finish_writing_raw function
     *
-    * Finishes a raw file by writing all necessary end tags.
+    * Finishes a raw file by writing all necessary end tags. Buffers queued by an asynchronous writer are written first.
+    * Buffers passed to write_raw_buffer_async afterwards, e.g. by an acquisition thread which has not yet seen the
+    * end of the recording, are rejected. Further calls have no effect.
     *
     */
     void finish_writing_raw();
 
+    //=========================================================================================================
+    /**
+    * Starts asynchronous writing of raw data buffers (see write_raw_buffer_async). A dedicated thread writes the
+    * queued buffers; until stop_async_writing or finish_writing_raw is called no other tags must be written to
+    * this stream.
+    *
+    * @param[in] p_iPoolSize    Number of preallocated buffers which can be queued
+    *
+    * @return true if succeeded, false if asynchronous writing is already active
+    */
+    bool start_async_writing(qint32 p_iPoolSize = 16);
+
+    //=========================================================================================================
+    /**
+    * Writes all queued buffers and stops the asynchronous writer thread. Afterwards other tags can be written again.
+    */
+    void stop_async_writing();
+
+    //=========================================================================================================
+    /**
+    * Returns the statistics of the asynchronous writer, all zero if it was never started.
+    *
+    * @param[out] p_iWritten    number of buffers written
+    * @param[out] p_iDropped    number of buffers dropped because the pool was exhausted
+    * @param[out] p_iMaxQueued  highest number of buffers queued at the same time
+    */
+    void async_write_stats(qint64& p_iWritten, qint64& p_iDropped, qint32& p_iMaxQueued) const;
+
+    //=========================================================================================================
+    /**
+    * Sets the size at which raw data files started with start_writing_raw are split. When the next data buffer
+    * would exceed it, the current file is closed with a FIFFB_REF block pointing to the next file and writing
+    * continues in a continuation file (<name>-1_raw.fif, <name>-2_raw.fif, ...) with the same measurement info
+    * and a FIFF_FIRST_SAMPLE which carries on the sample index. start_writing_raw enables splitting at
+    * FIFF_DEFAULT_SPLIT_SIZE for files.
+    *
+    * @param[in] p_iSplitSize   Maximum file size in bytes, 0 to disable splitting
+    */
+    void setSplitSize(qint64 p_iSplitSize);
+
+    //=========================================================================================================
+    /**
+    * Returns the size at which raw data files are split, 0 if splitting is disabled.
+    *
+    * @return the split size in bytes
+    */
+    inline qint64 splitSize() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the number of continuation files started since start_writing_raw.
+    *
+    * @return the number of continuation files
+    */
+    inline qint32 splitCount() const;
+
     //=========================================================================================================
     /**
     * Helper to get all evoked entries
@@ -196,6 +275,43 @@ public:
     */
     bool get_evoked_entries(const QList<FiffDirTree> &evoked_node, QStringList &comments, QList<fiff_int_t> &aspect_kinds, QString &t);
 
+    //=========================================================================================================
+    /**
+    * Maps the whole underlying file into memory. While the stream is mapped, FiffTag::read_tag_view returns
+    * read-only views into the mapping instead of seeking and copying the tag data.
+    * Only plain QFile devices can be mapped. For all other devices (e.g. QTcpSocket) false is returned and
+    * the regular read path stays in use. The device is opened read-only if it is not open yet.
+    *
+    * @return true if the file is memory mapped, false otherwise
+    */
+    bool mapFile();
+
+    //=========================================================================================================
+    /**
+    * Releases the memory mapping established by mapFile. Tag views which were handed out before are invalid
+    * afterwards. Called by the destructor; closing the device releases the mapping as well.
+    */
+    void unmapFile();
+
+    //=========================================================================================================
+    /**
+    * Returns whether the underlying file is memory mapped.
+    *
+    * @return true if the file is memory mapped, false otherwise
+    */
+    inline bool isMapped() const;
+
+    //=========================================================================================================
+    /**
+    * Returns a read-only pointer into the memory mapped file. The data are in file byte order (big endian).
+    *
+    * @param[in] pos    byte offset within the file
+    * @param[in] size   number of bytes which have to be available starting at pos
+    *
+    * @return pointer to the mapped data, NULL if the file is not mapped or the range exceeds the file
+    */
+    inline const char* mappedData(qint64 pos, qint64 size) const;
+
     //=========================================================================================================
     /**
     * QFile::open
@@ -219,6 +335,25 @@ public:
     */
     bool open(FiffDirTree& p_Tree, QList<FiffDirEntry>& p_Dir);
 
+    //=========================================================================================================
+    /**
+    * Enables or disables the directory cache for files without a tag directory. When enabled, open() stores the
+    * directory it had to assemble by walking all tags in a sidecar file (<file>.dir), keyed by file size and
+    * modification time, and reuses it on subsequent opens. Disabled by default, since the sidecar file is written
+    * next to the data; applications which open the same files repeatedly enable it. Failures to write are ignored.
+    *
+    * @param[in] p_bEnabled     whether to use the directory cache
+    */
+    static void setDirCacheEnabled(bool p_bEnabled);
+
+    //=========================================================================================================
+    /**
+    * Returns whether the directory cache for files without a tag directory is used.
+    *
+    * @return true if the directory cache is enabled
+    */
+    static bool dirCacheEnabled();
+
     //=========================================================================================================
     /**
     * fiff_read_bad_channels
@@ -334,7 +469,8 @@ public:
     *
     * ### MNE toolbox root function ###
     *
-    * Read information about raw data file
+    * Read information about raw data file. Recordings which were split into several files are chained by following
+    * the FIFFB_REF next file links; the buffers of all files are presented with one continuous sample index.
     *
     * @param[in] p_IODevice        An fiff IO device like a fiff QFile or QTCPSocket
     * @param[out] data              The raw data information - contains the opened fiff file
@@ -642,6 +778,20 @@ public:
     */
     bool write_raw_buffer(const MatrixXd& buf, const RowVectorXd& cals);
 
+    //=========================================================================================================
+    /**
+    * Queues a raw buffer for the asynchronous writer (see start_async_writing). Returns immediately; the inverse
+    * calibration, the conversion and the disk write happen in the writer thread. Falls back to write_raw_buffer if
+    * asynchronous writing is not active. Thread safe against start_async_writing, stop_async_writing and
+    * finish_writing_raw; buffers pushed after finish_writing_raw are rejected.
+    *
+    * @param[in] buf        the buffer to write
+    * @param[in] cals       calibration factors, empty to write the buffer without calibration
+    *
+    * @return true if succeeded, false if the buffer was dropped or the file is already finished
+    */
+    bool write_raw_buffer_async(const MatrixXd& buf, const RowVectorXd& cals = RowVectorXd());
+
     //=========================================================================================================
     /**
     * fiff_write_raw_buffer
@@ -670,6 +820,15 @@ public:
     */
     bool write_raw_buffer(const MatrixXd& buf);
 
+    //=========================================================================================================
+    /**
+    * Writes the FIFF_FIRST_SAMPLE tag of a raw data block started with start_writing_raw. Continuation files of
+    * a split recording carry on the sample index from it.
+    *
+    * @param[in] p_iFirstSample     the first sample of the raw data
+    */
+    void write_raw_first_sample(fiff_int_t p_iFirstSample);
+
     //=========================================================================================================
     /**
     * fiff_write_string
@@ -691,8 +850,174 @@ public:
     * @param[in] data       The string data to write
     */
     void write_rt_command(fiff_int_t command, const QString& data);
+
+private:
+    friend class FiffRawWriter;    /**< The writer thread writes the buffers through write_raw_float_buffer, so that files are split */
+
+    //=========================================================================================================
+    /**
+    * Writes a block of native endian elements in file byte order (big endian). On little endian hosts the data are
+    * byte swapped chunk wise with the bulk IOUtils::swap_bytes_* routines and written with a single writeRawData
+    * call per chunk, instead of one QDataStream operator call per element.
+    *
+    * @param[in] data       the elements to write
+    * @param[in] nel        number of elements
+    * @param[in] elemSize   size of one element in bytes (2, 4 or 8)
+    */
+    void write_swapped(const void* data, qint64 nel, qint32 elemSize);
+
+    //=========================================================================================================
+    /**
+    * Writes the measurement info and starts the raw data block, i.e. everything start_writing_raw writes after
+    * the compulsory file header.
+    *
+    * @param[in] info       The measurement info block of the source file
+    * @param[out] cals      The calibration matrix
+    * @param[in, out] sel   Which channels will be included in the output file, all if empty
+    */
+    void write_raw_header(const FiffInfo& info, RowVectorXd& cals, MatrixXi& sel);
+
+    //=========================================================================================================
+    /**
+    * Writes a converted raw data buffer tag. Starts a continuation file beforehand if the buffer would exceed
+    * the split size.
+    *
+    * @param[in] buf        the buffer to write
+    */
+    void write_raw_float_buffer(const MatrixXf& buf);
+
+    //=========================================================================================================
+    /**
+    * Closes the current raw data file with a link to the next one and continues writing in a new continuation
+    * file, see setSplitSize.
+    *
+    * @return true if succeeded, false otherwise
+    */
+    bool split_raw_file();
+
+    //=========================================================================================================
+    /**
+    * Returns the name of a continuation file of a split recording, following the <name>-<part>_raw.fif scheme.
+    *
+    * @param[in] p_sFileName    name of the first file
+    * @param[in] p_iPart        number of the continuation file, starting at 1
+    *
+    * @return the name of the continuation file
+    */
+    static QString split_file_name(const QString& p_sFileName, qint32 p_iPart);
+
+    //=========================================================================================================
+    /**
+    * Adds the data buffers of a raw data block to the raw directory.
+    *
+    * @param[in] p_pStream          stream of the file holding the block
+    * @param[in] p_Raw              the raw data block
+    * @param[in] nchan              number of channels
+    * @param[in] p_iPart            file index within a split recording; continuation files (> 0) ignore their
+    *                               FIFF_FIRST_SAMPLE and initial skip and carry on the sample index
+    * @param[in, out] p_iFirstSamp  first sample of the block in, first sample after the block out
+    * @param[in, out] p_RawDir      the raw directory to append to
+    *
+    * @return true if succeeded, false otherwise
+    */
+    static bool read_raw_dir(FiffStream* p_pStream, const FiffDirTree& p_Raw, fiff_int_t nchan, qint32 p_iPart, fiff_int_t& p_iFirstSamp, QList<FiffRawDir>& p_RawDir);
+
+    //=========================================================================================================
+    /**
+    * Looks for a FIFFB_REF block linking the next file of a split recording.
+    *
+    * @param[in] p_Tree     the directory tree of the current file
+    *
+    * @return the absolute name of the next file, empty if there is none
+    */
+    QString read_next_file_name(const FiffDirTree& p_Tree);
+
+    //=========================================================================================================
+    /**
+    * Reads the cached directory of this file from its sidecar file, if it matches the current file size and
+    * modification time.
+    *
+    * @param[out] p_Dir     the cached sequential tag directory
+    *
+    * @return true if a valid cache was found, false otherwise
+    */
+    bool read_dir_cache(QList<FiffDirEntry>& p_Dir);
+
+    //=========================================================================================================
+    /**
+    * Writes the directory of this file to its sidecar file.
+    *
+    * @param[in] p_Dir      the sequential tag directory
+    *
+    * @return true if succeeded, false otherwise
+    */
+    bool write_dir_cache(const QList<FiffDirEntry>& p_Dir);
+
+    //=========================================================================================================
+    /**
+    * Writes all queued buffers and stops the asynchronous writer thread. m_qMutexRawWriter has to be held.
+    */
+    void stop_raw_writer();
+
+    QSharedPointer<FiffRawWriter> m_pRawWriter;    /**< Asynchronous raw buffer writer, NULL if not active. */
+    qint64  m_iAsyncWritten;    /**< Buffers written by previous asynchronous writers. */
+    qint64  m_iAsyncDropped;    /**< Buffers dropped by previous asynchronous writers. */
+    qint32  m_iAsyncMaxQueued;  /**< Queue high water mark of previous asynchronous writers. */
+    mutable QMutex m_qMutexRawWriter;   /**< Serializes pushes of write_raw_buffer_async with starting, stopping and finishing. */
+    bool    m_bRawFinished;     /**< Set by finish_writing_raw, later asynchronous buffers are rejected. */
+
+    uchar*  m_pMappedData;  /**< Start of the memory mapped file, NULL if the file is not mapped. */
+    qint64  m_iMappedSize;  /**< Size of the memory mapped region in bytes. */
+    QPointer<QFile> m_pMappedFile;  /**< File holding the mapping, NULL once it is destroyed. */
+
+    QSharedPointer<QFile>       m_pFile;            /**< File owned by the stream (continuation files), NULL otherwise. */
+    QSharedPointer<FiffInfo>    m_pRawInfo;         /**< Measurement info of the raw data being written, repeated in continuation files. */
+    MatrixXi    m_matRawSel;        /**< Channel selection of the raw data being written. */
+    QString     m_sRawFileName;     /**< Name of the first file of the raw data being written. */
+    qint64      m_iSplitSize;       /**< Size at which raw data files are split, 0: never. */
+    qint32      m_iSplitCount;      /**< Number of continuation files written. */
+    fiff_int_t  m_iRawFirstSample;  /**< FIFF_FIRST_SAMPLE of the current raw data file. */
+    fiff_int_t  m_iRawSamples;      /**< Samples written to the current raw data file. */
 };
 
+//*************************************************************************************************************
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline qint64 FiffStream::splitSize() const
+{
+    return m_iSplitSize;
+}
+
+
+//*************************************************************************************************************
+
+inline qint32 FiffStream::splitCount() const
+{
+    return m_iSplitCount;
+}
+
+
+//*************************************************************************************************************
+
+inline bool FiffStream::isMapped() const
+{
+    //Closing or destroying the file releases the mapping
+    return m_pMappedData != NULL && !m_pMappedFile.isNull() && m_pMappedFile->isOpen();
+}
+
+
+//*************************************************************************************************************
+
+inline const char* FiffStream::mappedData(qint64 pos, qint64 size) const
+{
+    if(!isMapped() || pos < 0 || size < 0 || pos + size > m_iMappedSize)
+        return NULL;
+
+    return (const char*)(m_pMappedData + pos);
+}
+
 } // NAMESPACE
 
 #endif // FIFF_STREAM_H
@@ -125,8 +125,8 @@ bool FiffTag::read_tag_data(FiffStream* p_pStream, FiffTag::SPtr& p_pTag, qint64
         FiffTag::convert_tag_data(p_pTag,FIFFV_BIG_ENDIAN,FIFFV_NATIVE_ENDIAN);
     }
 
-    if (p_pTag->next != FIFFV_NEXT_SEQ)
-        p_pStream->device()->seek(p_pTag->next);//fseek(fid,tag.next,'bof');
+    if (p_pTag->next != FIFFV_NEXT_SEQ && p_pTag->next != FIFFV_NEXT_NONE)
+        p_pStream->device()->seek((quint32)p_pTag->next);//fseek(fid,tag.next,'bof');
 
     return true;
 }
@@ -168,9 +168,9 @@ bool FiffTag::read_tag_info(FiffStream* p_pStream, FiffTag::SPtr &p_pTag, bool p
             {
                 p_pStream->device()->seek(p_pStream->device()->pos()+p_pTag->size()); //fseek(fid,tag.size,'cof');
             }
-            else if (p_pTag->next > 0)
+            else if (p_pTag->next != FIFFV_NEXT_NONE)
             {
-                p_pStream->device()->seek(p_pTag->next); //fseek(fid,tag.next,'bof');
+                p_pStream->device()->seek((quint32)p_pTag->next); //fseek(fid,tag.next,'bof');
             }
         }
     }
@@ -231,8 +231,42 @@ bool FiffTag::read_tag(FiffStream* p_pStream, FiffTag::SPtr& p_pTag, qint64 pos)
         FiffTag::convert_tag_data(p_pTag,FIFFV_BIG_ENDIAN,FIFFV_NATIVE_ENDIAN);
     }
 
-    if (p_pTag->next != FIFFV_NEXT_SEQ)
-        p_pStream->device()->seek(p_pTag->next);//fseek(fid,tag.next,'bof');
+    if (p_pTag->next != FIFFV_NEXT_SEQ && p_pTag->next != FIFFV_NEXT_NONE)
+        p_pStream->device()->seek((quint32)p_pTag->next);//fseek(fid,tag.next,'bof');
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+bool FiffTag::read_tag_view(FiffStream* p_pStream, FiffTag::SPtr& p_pTag, qint64 pos)
+{
+    const uchar* t_pHeader = (const uchar*)p_pStream->mappedData(pos, 16);
+    if(!t_pHeader)
+        return false;
+
+    //
+    // Read fiff tag header from mapping
+    //
+    FiffTag::SPtr t_pTag(new FiffTag());
+    t_pTag->kind = qFromBigEndian<qint32>(t_pHeader);
+    t_pTag->type = qFromBigEndian<qint32>(t_pHeader + 4);
+    qint32 size  = qFromBigEndian<qint32>(t_pHeader + 8);
+    t_pTag->next = qFromBigEndian<qint32>(t_pHeader + 12);
+
+    //
+    // Reference the data without copying it
+    //
+    if(size > 0)
+    {
+        const char* t_pData = p_pStream->mappedData(pos + 16, size);
+        if(!t_pData)
+            return false;
+        static_cast<QByteArray&>(*t_pTag) = QByteArray::fromRawData(t_pData, size);
+    }
+
+    p_pTag = t_pTag;
 
     return true;
 }
@@ -470,8 +504,6 @@ void FiffTag::convert_matrix_from_file_data(FiffTag::SPtr tag)
     int ndim;
     int k;
     int *dimp,*data,kind,np,nz;
-    float *fdata;
-    double *ddata;
     unsigned int tsize = tag->size();
 
     if (fiff_type_fundamental(tag->type) != FIFFTS_FS_MATRIX)
@@ -511,26 +543,22 @@ void FiffTag::convert_matrix_from_file_data(FiffTag::SPtr tag)
         /*
          * Take care of the indices
         */
-        for (data = (int *)(tag->data())+nz, k = 0; k < np; k++)
-            IOUtils::swap_intp(data+k);
+        data = (int *)(tag->data())+nz;
+        IOUtils::swap_bytes_32(data, data, np);
         np = nz;
     }
     /*
      * Now convert data...
      */
     kind = fiff_type_base(tag->type);
-    if (kind == FIFFT_INT) {
-        for (data = (int *)(tag->data()), k = 0; k < np; k++)
-            IOUtils::swap_intp(data+k);
-    }
-    else if (kind == FIFFT_FLOAT) {
-        for (fdata = (float *)(tag->data()), k = 0; k < np; k++)
-            IOUtils::swap_floatp(fdata+k);
-    }
-    else if (kind == FIFFT_DOUBLE) {
-        for (ddata = (double *)(tag->data()), k = 0; k < np; k++)
-            IOUtils::swap_doublep(ddata+k);
-    }
+    if (kind == FIFFT_INT || kind == FIFFT_FLOAT)
+        IOUtils::swap_bytes_32(tag->data(), tag->data(), np);
+    else if (kind == FIFFT_DOUBLE)
+        IOUtils::swap_bytes_64(tag->data(), tag->data(), np);
+    else if (kind == FIFFT_COMPLEX_FLOAT)
+        IOUtils::swap_bytes_32(tag->data(), tag->data(), 2*np);
+    else if (kind == FIFFT_COMPLEX_DOUBLE)
+        IOUtils::swap_bytes_64(tag->data(), tag->data(), 2*np);
     return;
 }
 
@@ -544,9 +572,7 @@ void FiffTag::convert_matrix_to_file_data(FiffTag::SPtr tag)
 {
     int ndim;
     int k;
-    int *dimp,*data,kind,np;
-    float *fdata;
-    double *ddata;
+    int *dimp,kind,np;
     unsigned int tsize = tag->size();
 
     if (fiff_type_fundamental(tag->type) != FIFFTS_FS_MATRIX)
@@ -588,26 +614,14 @@ void FiffTag::convert_matrix_to_file_data(FiffTag::SPtr tag)
     * Now convert data...
     */
     kind = fiff_type_base(tag->type);
-    if (kind == FIFFT_INT) {
-        for (data = (int *)(tag->data()), k = 0; k < np; k++)
-            IOUtils::swap_intp(data+k);
-    }
-    else if (kind == FIFFT_FLOAT) {
-        for (fdata = (float *)(tag->data()), k = 0; k < np; k++)
-            IOUtils::swap_floatp(fdata+k);
-    }
-    else if (kind == FIFFT_DOUBLE) {
-        for (ddata = (double *)(tag->data()), k = 0; k < np; k++)
-            IOUtils::swap_doublep(ddata+k);
-    }
-    else if (kind == FIFFT_COMPLEX_FLOAT) {
-        for (fdata = (float *)(tag->data()), k = 0; k < 2*np; k++)
-            IOUtils::swap_floatp(fdata+k);
-    }
-    else if (kind == FIFFT_COMPLEX_DOUBLE) {
-        for (ddata = (double *)(tag->data()), k = 0; k < 2*np; k++)
-            IOUtils::swap_doublep(ddata+k);
-    }
+    if (kind == FIFFT_INT || kind == FIFFT_FLOAT)
+        IOUtils::swap_bytes_32(tag->data(), tag->data(), np);
+    else if (kind == FIFFT_DOUBLE)
+        IOUtils::swap_bytes_64(tag->data(), tag->data(), np);
+    else if (kind == FIFFT_COMPLEX_FLOAT)
+        IOUtils::swap_bytes_32(tag->data(), tag->data(), 2*np);
+    else if (kind == FIFFT_COMPLEX_DOUBLE)
+        IOUtils::swap_bytes_64(tag->data(), tag->data(), 2*np);
     return;
 }
 
@@ -621,9 +635,7 @@ void FiffTag::convert_tag_data(FiffTag::SPtr tag, int from_endian, int to_endian
     char           *offset;
     fiff_int_t     *ithis;
     fiff_short_t   *sthis;
-    fiff_long_t    *lthis;
     float          *fthis;
-    double         *dthis;
 //    fiffDirEntry   dethis;
 //    fiffId         idthis;
 //    fiffChInfoRec* chthis;//FiffChInfo*     chthis;//ToDo adapt parsing to the new class
@@ -657,37 +669,32 @@ void FiffTag::convert_tag_data(FiffTag::SPtr tag, int from_endian, int to_endian
     case FIFFT_JULIAN :
     case FIFFT_UINT :
         np = tag->size()/sizeof(fiff_int_t);
-        for (ithis = (fiff_int_t *)tag->data(), k = 0; k < np; k++, ithis++)
-            IOUtils::swap_intp(ithis);
+        IOUtils::swap_bytes_32(tag->data(), tag->data(), np);
         break;
 
     case FIFFT_LONG :
     case FIFFT_ULONG :
         np = tag->size()/sizeof(fiff_long_t);
-        for (lthis = (fiff_long_t *)tag->data(), k = 0; k < np; k++, lthis++)
-            IOUtils::swap_longp(lthis);
+        IOUtils::swap_bytes_64(tag->data(), tag->data(), np);
         break;
 
     case FIFFT_SHORT :
     case FIFFT_DAU_PACK16 :
     case FIFFT_USHORT :
         np = tag->size()/sizeof(fiff_short_t);
-        for (sthis = (fiff_short_t *)tag->data(), k = 0; k < np; k++, sthis++)
-            *sthis = IOUtils::swap_short(*sthis);
+        IOUtils::swap_bytes_16(tag->data(), tag->data(), np);
         break;
 
     case FIFFT_FLOAT :
     case FIFFT_COMPLEX_FLOAT :
         np = tag->size()/sizeof(fiff_float_t);
-        for (fthis = (fiff_float_t *)tag->data(), k = 0; k < np; k++, fthis++)
-            IOUtils::swap_floatp(fthis);
+        IOUtils::swap_bytes_32(tag->data(), tag->data(), np);
         break;
 
     case FIFFT_DOUBLE :
     case FIFFT_COMPLEX_DOUBLE :
         np = tag->size()/sizeof(fiff_double_t);
-        for (dthis = (fiff_double_t *)tag->data(), k = 0; k < np; k++, dthis++)
-            IOUtils::swap_doublep(dthis);
+        IOUtils::swap_bytes_64(tag->data(), tag->data(), np);
         break;
 
     case FIFFT_OLD_PACK :
@@ -699,8 +706,7 @@ void FiffTag::convert_tag_data(FiffTag::SPtr tag, int from_endian, int to_endian
         IOUtils::swap_floatp(fthis+1);
         sthis = (short *)(fthis+2);
         np = (tag->size() - 2*sizeof(float))/sizeof(short);
-        for (k = 0; k < np; k++,sthis++)
-            *sthis = IOUtils::swap_short(*sthis);
+        IOUtils::swap_bytes_16(sthis, sthis, np);
         break;
 
     case FIFFT_DIR_ENTRY_STRUCT :
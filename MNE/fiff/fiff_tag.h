@@ -119,6 +119,7 @@
 #include <QFile>
 #include <QList>
 #include <QSharedPointer>
+#include <QtEndian>
 #include <QVector>
 
 
@@ -241,6 +242,21 @@ public:
     */
     static bool read_tag(FiffStream* p_pStream, FiffTag::SPtr& p_pTag, qint64 pos = -1);
 
+    //=========================================================================================================
+    /**
+    * Reads one tag from a memory mapped fif file without copying its data (see FiffStream::mapFile).
+    * The tag data is a read-only view into the mapping and is kept in file byte order (big endian), i.e.
+    * convert_tag_data is NOT applied. The view is valid as long as the stream stays mapped.
+    * The file position of the underlying device is not changed.
+    *
+    * @param[in] p_pStream opened and memory mapped fif file
+    * @param[out] p_pTag the read tag, data pointing into the mapping
+    * @param[in] pos position of the tag inside the fif file
+    *
+    * @return true if succeeded, false if the stream is not mapped or the tag lies outside of the mapping
+    */
+    static bool read_tag_view(FiffStream* p_pStream, FiffTag::SPtr& p_pTag, qint64 pos);
+
     //=========================================================================================================
     /**
     * Provides information about matrix coding
@@ -583,7 +599,8 @@ public:
     fiff_int_t  next;       /**< Pointer to the next object.
                              *   Zero if the object follows
                              *   sequentially in file.
-                             *   Negative at the end of file */
+                             *   FIFFV_NEXT_NONE (-1) at the end of file,
+                             *   otherwise an unsigned 32 bit file position */
 //    QByteArray* data;       /**< Pointer to the data.
 //                             *   This point to the data read or to be written. */
 private:
@@ -933,7 +950,7 @@ inline QList<FiffDirEntry> FiffTag::toDirEntry() const
             t_fiffDirEntry.kind = t_pInt32[k*4];//fread(fid,1,'int32');
             t_fiffDirEntry.type = t_pInt32[k*4+1];//fread(fid,1,'uint32');
             t_fiffDirEntry.size = t_pInt32[k*4+2];//fread(fid,1,'int32');
-            t_fiffDirEntry.pos  = t_pInt32[k*4+3];//fread(fid,1,'int32');
+            t_fiffDirEntry.pos  = (quint32)t_pInt32[k*4+3];//fread(fid,1,'uint32'); unsigned to address files up to 4 GB
             p_ListFiffDir.append(t_fiffDirEntry);
         }
     }
@@ -99,6 +99,7 @@ SOURCES += \
     minimumNorm/minimumnorm.cpp \
     rapMusic/rapmusic.cpp \
     rapMusic/pwlrapmusic.cpp \
+    rapMusic/rapmusicscan.cpp \
     rapMusic/dipole.cpp
 
 HEADERS +=\
@@ -107,6 +108,7 @@ HEADERS +=\
     minimumNorm/minimumnorm.h \
     rapMusic/rapmusic.h \
     rapMusic/pwlrapmusic.h \
+    rapMusic/rapmusicscan.h \
     rapMusic/dipole.h
 
 INCLUDEPATH += $${EIGEN_INCLUDE_DIR}
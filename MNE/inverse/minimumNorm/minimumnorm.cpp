@@ -43,6 +43,33 @@
 #include <mne/mne_sourceestimate.h>
 #include <fiff/fiff_evoked.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QSaveFile>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <algorithm>
+#include <vector>
+
 
 //*************************************************************************************************************
 //=============================================================================================================
@@ -62,6 +89,212 @@ using namespace MNELIB;
 using namespace INVERSELIB;
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC FUNCTIONS
+//=============================================================================================================
+
+namespace
+{
+
+//=============================================================================================================
+/**
+* sol = K*data for fixed orientations; for free orientations, whose kernel rows are grouped in x, y and z blocks,
+* the norm of the three blocks of K*data.
+*/
+template<typename T>
+void applyFusedKernel(const Matrix<T,Dynamic,Dynamic> &K, bool freeOri, const Matrix<T,Dynamic,Dynamic> &data, Matrix<T,Dynamic,Dynamic> &sol, Matrix<T,Dynamic,Dynamic> &work)
+{
+    if(!freeOri)
+    {
+        sol.resize(K.rows(), data.cols());
+        sol.noalias() = K*data;
+        return;
+    }
+
+    qint32 nsrc = K.rows()/3;
+    work.resize(K.rows(), data.cols());
+    work.noalias() = K*data;
+
+    sol.resize(nsrc, data.cols());
+    sol.array() = (work.topRows(nsrc).array().square()
+                   + work.middleRows(nsrc, nsrc).array().square()
+                   + work.bottomRows(nsrc).array().square()).sqrt();
+}
+
+//=============================================================================================================
+/**
+* Folds the noise normalization factor of each source into its kernel rows and groups free orientation rows in x,
+* y and z blocks. The fused kernel is stored in the precision of Kfused.
+*/
+template<typename T>
+void fuseKernel(const MatrixXd &K, const VectorXd &noiseNorm, qint32 numComp, Matrix<T,Dynamic,Dynamic> &Kfused)
+{
+    qint32 nsrc = K.rows()/numComp;
+    Kfused.resize(K.rows(), K.cols());
+    for(qint32 c = 0; c < numComp; ++c)
+        for(qint32 i = 0; i < nsrc; ++i)
+            Kfused.row(c*nsrc + i) = (noiseNorm[i] * K.row(i*numComp + c)).template cast<T>();
+}
+
+//=============================================================================================================
+/**
+* Adds dimensions and coefficients of a dense matrix to a hash.
+*/
+template<typename Derived>
+void hashMatrix(QCryptographicHash &p_hash, const PlainObjectBase<Derived> &p_mat)
+{
+    qint64 t_iDims[2] = { (qint64)p_mat.rows(), (qint64)p_mat.cols() };
+    p_hash.addData((const char*)t_iDims, sizeof(t_iDims));
+    p_hash.addData((const char*)p_mat.data(), p_mat.size()*sizeof(typename Derived::Scalar));
+}
+
+
+//=============================================================================================================
+/**
+* Chunk size of raw reads and writes, QDataStream takes int byte counts.
+*/
+const qint64 s_iRawChunkBytes = 1 << 30;
+
+
+//=============================================================================================================
+/**
+* Writes p_iBytes raw bytes in chunks.
+*/
+void writeRawBytes(QDataStream &p_stream, const char *p_pData, qint64 p_iBytes)
+{
+    for(qint64 t_iPos = 0; t_iPos < p_iBytes; t_iPos += s_iRawChunkBytes)
+        p_stream.writeRawData(p_pData + t_iPos, (int)qMin(s_iRawChunkBytes, p_iBytes - t_iPos));
+}
+
+
+//=============================================================================================================
+/**
+* Reads p_iBytes raw bytes in chunks. Returns false if the stream ends early.
+*/
+bool readRawBytes(QDataStream &p_stream, char *p_pData, qint64 p_iBytes)
+{
+    for(qint64 t_iPos = 0; t_iPos < p_iBytes; t_iPos += s_iRawChunkBytes)
+    {
+        int t_iChunk = (int)qMin(s_iRawChunkBytes, p_iBytes - t_iPos);
+        if(p_stream.readRawData(p_pData + t_iPos, t_iChunk) != t_iChunk)
+            return false;
+    }
+    return true;
+}
+
+
+//=============================================================================================================
+/**
+* Writes a dense matrix in binary form: dimensions followed by the raw coefficients.
+*/
+template<typename Derived>
+void writeMatrix(QDataStream &p_stream, const PlainObjectBase<Derived> &p_mat)
+{
+    p_stream << (qint64)p_mat.rows() << (qint64)p_mat.cols();
+    writeRawBytes(p_stream, (const char*)p_mat.data(), (qint64)p_mat.size()*(qint64)sizeof(typename Derived::Scalar));
+}
+
+
+//=============================================================================================================
+/**
+* Reads a dense matrix written by writeMatrix. The dimensions in the file are checked against the largest sizes
+* expected by the caller and against the bytes left in the file before anything is allocated.
+*/
+template<typename Derived>
+bool readMatrix(QDataStream &p_stream, PlainObjectBase<Derived> &p_mat, qint64 p_iMaxRows, qint64 p_iMaxCols)
+{
+    qint64 t_iRows, t_iCols;
+    p_stream >> t_iRows >> t_iCols;
+    if(p_stream.status() != QDataStream::Ok || t_iRows < 0 || t_iCols < 0 || t_iRows > p_iMaxRows || t_iCols > p_iMaxCols)
+        return false;
+    if((Derived::RowsAtCompileTime == 1 && t_iRows != 1) || (Derived::ColsAtCompileTime == 1 && t_iCols != 1))
+        return false;
+
+    //Both dimensions are bounded by the operator sizes, the product does not overflow
+    qint64 t_iBytes = t_iRows*t_iCols*(qint64)sizeof(typename Derived::Scalar);
+    if(t_iBytes > p_stream.device()->bytesAvailable())
+        return false;
+
+    p_mat.resize(t_iRows, t_iCols);
+    return readRawBytes(p_stream, (char*)p_mat.data(), t_iBytes);
+}
+
+
+//=============================================================================================================
+/**
+* Writes a sparse matrix as triplets.
+*/
+void writeSparse(QDataStream &p_stream, const SparseMatrix<double> &p_mat)
+{
+    VectorXi t_vecRows(p_mat.nonZeros()), t_vecCols(p_mat.nonZeros());
+    VectorXd t_vecValues(p_mat.nonZeros());
+    qint32 n = 0;
+    for(qint32 k = 0; k < p_mat.outerSize(); ++k)
+        for(SparseMatrix<double>::InnerIterator it(p_mat,k); it; ++it, ++n)
+        {
+            t_vecRows[n] = it.row();
+            t_vecCols[n] = it.col();
+            t_vecValues[n] = it.value();
+        }
+
+    p_stream << (qint64)p_mat.rows() << (qint64)p_mat.cols();
+    writeMatrix(p_stream, t_vecRows);
+    writeMatrix(p_stream, t_vecCols);
+    writeMatrix(p_stream, t_vecValues);
+}
+
+
+//=============================================================================================================
+/**
+* Reads a sparse matrix written by writeSparse, with the dimensions bounded like readMatrix.
+*/
+bool readSparse(QDataStream &p_stream, SparseMatrix<double> &p_mat, qint64 p_iMaxRows, qint64 p_iMaxCols)
+{
+    qint64 t_iRows, t_iCols;
+    p_stream >> t_iRows >> t_iCols;
+    if(p_stream.status() != QDataStream::Ok || t_iRows < 0 || t_iCols < 0 || t_iRows > p_iMaxRows || t_iCols > p_iMaxCols)
+        return false;
+
+    //At most one triplet per coefficient, the remaining file size bounds the triplets further
+    qint64 t_iMaxNonZeros = t_iRows*t_iCols;
+    VectorXi t_vecRows, t_vecCols;
+    VectorXd t_vecValues;
+    if(!readMatrix(p_stream, t_vecRows, t_iMaxNonZeros, 1) || !readMatrix(p_stream, t_vecCols, t_iMaxNonZeros, 1) || !readMatrix(p_stream, t_vecValues, t_iMaxNonZeros, 1))
+        return false;
+    if(t_vecRows.size() != t_vecValues.size() || t_vecCols.size() != t_vecValues.size())
+        return false;
+
+    typedef Eigen::Triplet<double> T;
+    std::vector<T> tripletList;
+    tripletList.reserve(t_vecValues.size());
+    for(qint32 i = 0; i < t_vecValues.size(); ++i)
+    {
+        if(t_vecRows[i] < 0 || t_vecRows[i] >= t_iRows || t_vecCols[i] < 0 || t_vecCols[i] >= t_iCols)
+            return false;
+        tripletList.push_back(T(t_vecRows[i], t_vecCols[i], t_vecValues[i]));
+    }
+
+    p_mat = SparseMatrix<double>(t_iRows, t_iCols);
+    p_mat.setFromTriplets(tripletList.begin(), tripletList.end());
+    return true;
+}
+
+} // NAMESPACE
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC MEMBERS
+//=============================================================================================================
+
+#define MNE_KERNEL_CACHE_MAGIC      0x4D4E454B  /**< "MNEK" */
+#define MNE_KERNEL_CACHE_VERSION    1           /**< Version of the kernel cache file layout */
+#define MNE_BATCH_MAX_COLS          4096        /**< Maximal number of concatenated data columns per kernel product of calculateInverseBatch */
+
+QString MinimumNorm::s_sKernelCacheDir;
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -70,6 +303,9 @@ using namespace INVERSELIB;
 MinimumNorm::MinimumNorm(const MNEInverseOperator &p_inverseOperator, float lambda, const QString method)
 : m_inverseOperator(p_inverseOperator)
 , inverseSetup(false)
+, m_bKernelFreeOri(false)
+, m_bSinglePrecision(false)
+, m_labelMode(LabelMeanFlip)
 {
     this->setRegularization(lambda);
     this->setMethod(method);
@@ -80,6 +316,9 @@ MinimumNorm::MinimumNorm(const MNEInverseOperator &p_inverseOperator, float lamb
 MinimumNorm::MinimumNorm(const MNEInverseOperator &p_inverseOperator, float lambda, bool dSPM, bool sLORETA)
 : m_inverseOperator(p_inverseOperator)
 , inverseSetup(false)
+, m_bKernelFreeOri(false)
+, m_bSinglePrecision(false)
+, m_labelMode(LabelMeanFlip)
 {
     this->setRegularization(lambda);
     this->setMethod(dSPM, sLORETA);
@@ -193,44 +432,120 @@ MNESourceEstimate MinimumNorm::calculateInverse(const MatrixXd &data, float tmin
         return MNESourceEstimate();
     }
 
-    MatrixXd sol = K * data; //apply imaging kernel
+    MatrixXd sol, work;
+    applyKernel(data, sol, work);
+
+    //Results
+    VectorXi p_vecVertices(inv.src[0].vertno.size() + inv.src[1].vertno.size());
+    p_vecVertices << inv.src[0].vertno, inv.src[1].vertno;
+
+//    VectorXi p_vecVertices();
+//    for(qint32 h = 0; h < inv.src.size(); ++h)
+//        t_qListVertices.push_back(inv.src[h].vertno);
+
+    return MNESourceEstimate(sol, p_vecVertices, tmin, tstep);
+
+}
+
+
+//*************************************************************************************************************
 
-    if (inv.source_ori == FIFFV_MNE_FREE_ORI)
+QList<MNESourceEstimate> MinimumNorm::calculateInverse(const MNEEpochDataList &p_epochs, const FiffInfo &p_info, bool pick_normal, bool parallel)
+{
+    if(!m_inverseOperator.check_ch_names(p_info))
     {
-        printf("combining the current components...");
-        MatrixXd sol1(sol.rows()/3,sol.cols());
-        for(qint32 i = 0; i < sol.cols(); ++i)
-        {
-            VectorXd* tmp = MNEMath::combine_xyz(sol.block(0,i,sol.rows(),1));
-            sol1.block(0,i,sol.rows()/3,1) = tmp->cwiseSqrt();
-            delete tmp;
-        }
-        sol.resize(sol1.rows(),sol1.cols());
-        sol = sol1;
+        qWarning("Channel name check failed.");
+        return QList<MNESourceEstimate>();
     }
 
-    if (m_bdSPM)
+    //
+    //   Single trials: one setup for all epochs
+    //
+    doInverseSetup(1, pick_normal);
+
+    VectorXi t_vecSel;
+    if(!kernelChannelSel(p_info.ch_names, t_vecSel))
     {
-        printf("(dSPM)...");
-        sol = inv.noisenorm*sol;
+        qWarning("Epoch channels do not contain all inverse operator channels.");
+        return QList<MNESourceEstimate>();
     }
-    else if (m_bsLORETA)
+
+    QList<const MatrixXd*> t_qListData;
+    QList<VectorXi> t_qListSel;
+    QList<float> t_qListTmin;
+    QList<float> t_qListTstep;
+    for(qint32 i = 0; i < p_epochs.size(); ++i)
     {
-        printf("(sLORETA)...");
-        sol = inv.noisenorm*sol;
+        t_qListData.append(&p_epochs[i]->epoch);
+        t_qListSel.append(t_vecSel);
+        t_qListTmin.append(p_epochs[i]->tmin);
+        t_qListTstep.append(1/p_info.sfreq);
     }
+
+    printf("Computing inverse of %d epochs...", p_epochs.size());
+    QList<MNESourceEstimate> t_qListStc = calculateInverseBatch(t_qListData, t_qListSel, t_qListTmin, t_qListTstep, parallel);
     printf("[done]\n");
 
-    //Results
-    VectorXi p_vecVertices(inv.src[0].vertno.size() + inv.src[1].vertno.size());
-    p_vecVertices << inv.src[0].vertno, inv.src[1].vertno;
+    return t_qListStc;
+}
 
-//    VectorXi p_vecVertices();
-//    for(qint32 h = 0; h < inv.src.size(); ++h)
-//        t_qListVertices.push_back(inv.src[h].vertno);
 
-    return MNESourceEstimate(sol, p_vecVertices, tmin, tstep);
+//*************************************************************************************************************
+
+QList<MNESourceEstimate> MinimumNorm::calculateInverse(const QList<FiffEvoked> &p_qListEvoked, bool pick_normal, bool parallel)
+{
+    QList<MNESourceEstimate> t_qListStc;
+    for(qint32 i = 0; i < p_qListEvoked.size(); ++i)
+        t_qListStc.append(MNESourceEstimate());
+
+    //
+    //   The noise normalization depends on the number of averages: group the evoked responses by nave
+    //
+    QMap<qint32, QList<qint32> > t_qMapNave;
+    for(qint32 i = 0; i < p_qListEvoked.size(); ++i)
+    {
+        if(!m_inverseOperator.check_ch_names(p_qListEvoked[i].info))
+        {
+            qWarning("Channel name check failed for evoked response %d.", i);
+            continue;
+        }
+        t_qMapNave[p_qListEvoked[i].nave].append(i);
+    }
+
+    QMap<qint32, QList<qint32> >::const_iterator it;
+    for(it = t_qMapNave.constBegin(); it != t_qMapNave.constEnd(); ++it)
+    {
+        doInverseSetup(it.key(), pick_normal);
+
+        QList<qint32> t_qListIdx;
+        QList<const MatrixXd*> t_qListData;
+        QList<VectorXi> t_qListSel;
+        QList<float> t_qListTmin;
+        QList<float> t_qListTstep;
+        for(qint32 j = 0; j < it.value().size(); ++j)
+        {
+            const FiffEvoked &t_evoked = p_qListEvoked[it.value()[j]];
+
+            VectorXi t_vecSel;
+            if(!kernelChannelSel(t_evoked.info.ch_names, t_vecSel))
+            {
+                qWarning("Evoked response %d does not contain all inverse operator channels.", it.value()[j]);
+                continue;
+            }
+
+            t_qListIdx.append(it.value()[j]);
+            t_qListData.append(&t_evoked.data);
+            t_qListSel.append(t_vecSel);
+            t_qListTmin.append(((float)t_evoked.first) / t_evoked.info.sfreq);
+            t_qListTstep.append(1/t_evoked.info.sfreq);
+        }
+
+        QList<MNESourceEstimate> t_qListBatch = calculateInverseBatch(t_qListData, t_qListSel, t_qListTmin, t_qListTstep, parallel);
+        for(qint32 j = 0; j < t_qListIdx.size(); ++j)
+            t_qListStc[t_qListIdx[j]] = t_qListBatch[j];
+    }
 
+    return t_qListStc;
 }
 
 
@@ -239,19 +554,626 @@ MNESourceEstimate MinimumNorm::calculateInverse(const MatrixXd &data, float tmin
 void MinimumNorm::doInverseSetup(qint32 nave, bool pick_normal)
 {
     //
-    //   Set up the inverse according to the parameters
+    //   Look up the kernel cache before preparing the inverse
     //
-    inv = m_inverseOperator.prepare_inverse_operator(nave, m_fLambda, m_bdSPM, m_bsLORETA);
+    QString t_sCacheFile = kernelCacheFile(nave, pick_normal);
+
+    if(!t_sCacheFile.isEmpty() && readKernelCache(t_sCacheFile, nave))
+        printf("Read inverse kernel from cache %s\n", t_sCacheFile.toLatin1().constData());
+    else
+    {
+        //
+        //   Set up the inverse according to the parameters
+        //
+        inv = m_inverseOperator.prepare_inverse_operator(nave, m_fLambda, m_bdSPM, m_bsLORETA);
+
+        printf("Computing inverse...");
+        inv.assemble_kernel(label, m_sMethod, pick_normal, K, noise_norm, vertno);
 
-    printf("Computing inverse...");
-    inv.assemble_kernel(label, m_sMethod, pick_normal, K, noise_norm, vertno);
+        if(!t_sCacheFile.isEmpty() && !writeKernelCache(t_sCacheFile))
+            printf("Could not write inverse kernel cache %s\n", t_sCacheFile.toLatin1().constData());
+    }
 
     std::cout << "K " << K.rows() << " x " << K.cols() << std::endl;
 
+    //
+    //   Fuse the kernel: the noise normalization is a positive factor per source, fold it into the kernel rows of
+    //   the source and group the x, y and z rows so that their norm can be taken in blocks
+    //
+    m_bKernelFreeOri = inv.source_ori == FIFFV_MNE_FREE_ORI && !pick_normal;
+    qint32 t_iNumComp = m_bKernelFreeOri ? 3 : 1;
+    qint32 t_iNumSrc = K.rows()/t_iNumComp;
+
+    //
+    //   Use the noise normalization assemble_kernel returned with the kernel, it matches the kernel sources
+    //
+    VectorXd t_vecNoiseNorm = VectorXd::Ones(t_iNumSrc);
+    if(m_bdSPM || m_bsLORETA)
+    {
+        if(noise_norm.rows() != t_iNumSrc || noise_norm.cols() != t_iNumSrc)
+        {
+            qWarning("Noise normalization (%d x %d) doesn't match the %d kernel sources -> inverse not set up.",
+                     (int)noise_norm.rows(), (int)noise_norm.cols(), t_iNumSrc);
+            inverseSetup = false;
+            return;
+        }
+
+        for(qint32 k = 0; k < noise_norm.outerSize(); ++k)
+            for(SparseMatrix<double>::InnerIterator it(noise_norm,k); it; ++it)
+                if(it.row() == it.col())
+                    t_vecNoiseNorm[it.row()] = it.value();
+    }
+
+    if(m_bSinglePrecision)
+    {
+        fuseKernel(K, t_vecNoiseNorm, t_iNumComp, m_matKernelFusedFloat);
+        m_matKernelFused.resize(0, 0);
+    }
+    else
+    {
+        fuseKernel(K, t_vecNoiseNorm, t_iNumComp, m_matKernelFused);
+        m_matKernelFusedFloat.resize(0, 0);
+    }
+
+    if(!m_qListLabels.isEmpty())
+        assembleLabelKernel();
+
+    //
+    //   Single precision: the double precision kernel and the eigen leads and fields are no longer needed
+    //
+    if(m_bSinglePrecision)
+    {
+        K.resize(0, 0);
+        inv.getKernel().resize(0, 0);
+        inv.eigen_leads = FiffNamedMatrix::SDPtr(new FiffNamedMatrix());
+        inv.eigen_fields = FiffNamedMatrix::SDPtr(new FiffNamedMatrix());
+    }
+
     inverseSetup = true;
 }
 
 
+//*************************************************************************************************************
+
+void MinimumNorm::setSinglePrecision(bool p_bSinglePrecision)
+{
+    m_bSinglePrecision = p_bSinglePrecision;
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::setKernelCacheDir(const QString &p_sDir)
+{
+    s_sKernelCacheDir = p_sDir;
+}
+
+
+//*************************************************************************************************************
+
+QString MinimumNorm::kernelCacheDir()
+{
+    return s_sKernelCacheDir;
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::setLabels(const QList<Label> &p_qListLabels, const QString &mode)
+{
+    if(mode.compare("mean") == 0)
+        m_labelMode = LabelMean;
+    else if(mode.compare("mean_flip") == 0)
+        m_labelMode = LabelMeanFlip;
+    else if(mode.compare("pca_flip") == 0)
+        m_labelMode = LabelPcaFlip;
+    else if(mode.compare("max") == 0)
+        m_labelMode = LabelMax;
+    else
+    {
+        qWarning("Label mode not recognized! - Using mean_flip");
+        m_labelMode = LabelMeanFlip;
+    }
+
+    m_qListLabels = p_qListLabels;
+
+    if(inverseSetup)
+        assembleLabelKernel();
+}
+
+
+//*************************************************************************************************************
+
+bool MinimumNorm::setLabels(const AnnotationSet &p_annotationSet, const SurfaceSet &p_surfSet, const QString &mode)
+{
+    QList<Label> t_qListLabels;
+    QList<RowVector4i> t_qListLabelRGBAs;
+    if(!p_annotationSet.toLabels(p_surfSet, t_qListLabels, t_qListLabelRGBAs))
+    {
+        qWarning("Annotation could not be converted to labels.");
+        return false;
+    }
+
+    setLabels(t_qListLabels, mode);
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+MatrixXd MinimumNorm::calculateLabelTimeCourses(const MatrixXd &data) const
+{
+    MatrixXd t_matTc = MatrixXd::Zero(m_qListLabelKernels.size(), data.cols());
+
+    if(!inverseSetup)
+    {
+        qWarning("Inverse not setup -> call doInverseSetup first!");
+        return t_matTc;
+    }
+
+    //
+    //   Labels reduced to a single row: one product for all of them
+    //
+    MatrixXd t_matLinear;
+    if(m_matLabelKernelLinear.rows() > 0)
+        t_matLinear = m_matLabelKernelLinear * data;
+
+    for(qint32 i = 0; i < m_qListLabelKernels.size(); ++i)
+    {
+        const LabelKernel &t_kernel = m_qListLabelKernels[i];
+
+        if(t_kernel.iLinearRow >= 0)
+        {
+            t_matTc.row(i) = t_matLinear.row(t_kernel.iLinearRow);
+            continue;
+        }
+
+        if(t_kernel.iNumSrc == 0 || t_kernel.matKernel.rows() == 0)
+            continue;
+
+        MatrixXd t_matLabelData, t_matWork;
+        if(m_bKernelFreeOri)
+            applyFusedKernel(t_kernel.matKernel, true, data, t_matLabelData, t_matWork);
+        else
+            t_matLabelData.noalias() = t_kernel.matKernel * data;
+
+        switch(m_labelMode)
+        {
+        case LabelMean:
+            t_matTc.row(i) = t_matLabelData.colwise().mean();
+            break;
+        case LabelMeanFlip:
+            t_matTc.row(i) = (t_kernel.vecFlip.transpose() * t_matLabelData) / t_kernel.iNumSrc;
+            break;
+        case LabelMax:
+            t_matTc.row(i) = t_matLabelData.cwiseAbs().colwise().maxCoeff();
+            break;
+        case LabelPcaFlip:
+        {
+            //
+            //   For fixed orientations the label data is U_k*M with the orthonormal basis U_k, so its singular values
+            //   and right singular vectors are those of M; the flip was projected onto the basis beforehand
+            //
+            JacobiSVD<MatrixXd> t_svd(t_matLabelData, ComputeThinU | ComputeThinV);
+            double t_dSign = t_svd.matrixU().col(0).dot(t_kernel.vecFlip) < 0 ? -1.0 : 1.0;
+            double t_dScale = t_svd.singularValues().norm() / sqrt((double)t_kernel.iNumSrc);
+            t_matTc.row(i) = t_dSign * t_dScale * t_svd.matrixV().col(0).transpose();
+            break;
+        }
+        }
+    }
+
+    return t_matTc;
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::applyKernel(const MatrixXd &data, MatrixXd &sol, MatrixXd &work) const
+{
+    if(m_bSinglePrecision)
+    {
+        MatrixXf t_matData = data.cast<float>();
+        MatrixXf t_matSol, t_matWork;
+        applyFusedKernel(m_matKernelFusedFloat, m_bKernelFreeOri, t_matData, t_matSol, t_matWork);
+        sol = t_matSol.cast<double>();
+        return;
+    }
+
+    applyFusedKernel(m_matKernelFused, m_bKernelFreeOri, data, sol, work);
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::applyKernel(const MatrixXf &data, MatrixXf &sol, MatrixXf &work) const
+{
+    if(!m_bSinglePrecision)
+    {
+        MatrixXd t_matData = data.cast<double>();
+        MatrixXd t_matSol, t_matWork;
+        applyFusedKernel(m_matKernelFused, m_bKernelFreeOri, t_matData, t_matSol, t_matWork);
+        sol = t_matSol.cast<float>();
+        return;
+    }
+
+    applyFusedKernel(m_matKernelFusedFloat, m_bKernelFreeOri, data, sol, work);
+}
+
+
+//*************************************************************************************************************
+
+QList<MNESourceEstimate> MinimumNorm::calculateInverseBatch(const QList<const MatrixXd*> &p_qListData, const QList<VectorXi> &p_qListSel, const QList<float> &p_qListTmin, const QList<float> &p_qListTstep, bool parallel) const
+{
+    qint32 i, k;
+    qint32 t_iNumItems = p_qListData.size();
+
+    QList<MNESourceEstimate> t_qListStc;
+    for(i = 0; i < t_iNumItems; ++i)
+        t_qListStc.append(MNESourceEstimate());
+
+    if(!inverseSetup)
+    {
+        qWarning("Inverse not setup -> call doInverseSetup first!");
+        return t_qListStc;
+    }
+
+    if(t_iNumItems == 0)
+        return t_qListStc;
+
+    VectorXi p_vecVertices(inv.src[0].vertno.size() + inv.src[1].vertno.size());
+    p_vecVertices << inv.src[0].vertno, inv.src[1].vertno;
+
+    //
+    //   Column offsets of the items within the concatenated data; pointers into the result list, so that the
+    //   blocks write their estimates without touching the list itself
+    //
+    VectorXi t_vecOffset(t_iNumItems + 1);
+    t_vecOffset[0] = 0;
+    std::vector<MNESourceEstimate*> t_vecStc(t_iNumItems);
+    for(i = 0; i < t_iNumItems; ++i)
+    {
+        t_vecOffset[i+1] = t_vecOffset[i] + (int)p_qListData[i]->cols();
+        t_vecStc[i] = &t_qListStc[i];
+    }
+
+    //
+    //   Group consecutive items into blocks of at most MNE_BATCH_MAX_COLS columns, which bounds the concatenated data
+    //   and the kernel product per block; wider items form a block of their own
+    //
+    QList<qint32> t_qListBlockStart;
+    for(i = 0; i < t_iNumItems; ++i)
+        if(t_qListBlockStart.isEmpty() || t_vecOffset[i+1] - t_vecOffset[t_qListBlockStart.last()] > MNE_BATCH_MAX_COLS)
+            t_qListBlockStart.append(i);
+    t_qListBlockStart.append(t_iNumItems);
+    qint32 t_iNumBlocks = t_qListBlockStart.size() - 1;
+
+    //
+    //   Blocks are distributed over the threads; within a parallel region Eigen runs each product single threaded.
+    //   Without parallel blocks the blocks are applied one after the other and Eigen parallelizes each product itself.
+    //
+    qint32 t_iNumThreads = 1;
+#ifdef _OPENMP
+    if(parallel)
+        t_iNumThreads = std::min(t_iNumBlocks, omp_get_max_threads());
+#else
+    Q_UNUSED(parallel);
+#endif
+
+    qint32 t_iNumChan = m_bSinglePrecision ? m_matKernelFusedFloat.cols() : m_matKernelFused.cols();
+
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(t_iNumThreads) private(i, k) if(t_iNumThreads > 1)
+#endif
+    {
+        //Buffers of this thread, reused by all of its blocks
+        MatrixXd t_matData, t_matSol, t_matWork;
+
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+        for(qint32 b = 0; b < t_iNumBlocks; ++b)
+        {
+            qint32 t_iFirst = t_qListBlockStart[b];
+            qint32 t_iLast = t_qListBlockStart[b+1];
+
+            t_matData.resize(t_iNumChan, t_vecOffset[t_iLast] - t_vecOffset[t_iFirst]);
+            for(i = t_iFirst; i < t_iLast; ++i)
+            {
+                if(p_qListSel[i].size() != t_iNumChan)
+                    continue;
+                qint32 t_iCol = t_vecOffset[i] - t_vecOffset[t_iFirst];
+                for(k = 0; k < t_iNumChan; ++k)
+                    t_matData.block(k, t_iCol, 1, p_qListData[i]->cols()) = p_qListData[i]->row(p_qListSel[i][k]);
+            }
+
+            applyKernel(t_matData, t_matSol, t_matWork);
+
+            for(i = t_iFirst; i < t_iLast; ++i)
+            {
+                if(p_qListSel[i].size() != t_iNumChan)
+                    continue;
+                *t_vecStc[i] = MNESourceEstimate(t_matSol.middleCols(t_vecOffset[i] - t_vecOffset[t_iFirst], p_qListData[i]->cols()), p_vecVertices, p_qListTmin[i], p_qListTstep[i]);
+            }
+        }
+    }
+
+    return t_qListStc;
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::assembleLabelKernel()
+{
+    qint32 t_iNumComp = m_bKernelFreeOri ? 3 : 1;
+    qint32 t_iNumKernelSrc = (m_bSinglePrecision ? m_matKernelFusedFloat.rows() : m_matKernelFused.rows())/t_iNumComp;
+    qint32 t_iNumChan = m_bSinglePrecision ? m_matKernelFusedFloat.cols() : m_matKernelFused.cols();
+    bool t_bLinear = !m_bKernelFreeOri && (m_labelMode == LabelMean || m_labelMode == LabelMeanFlip);
+
+    m_qListLabelKernels.clear();
+    m_matLabelKernelLinear.resize(0, t_iNumChan);
+    QList<qint32> t_qListLinear;
+
+    for(qint32 i = 0; i < m_qListLabels.size(); ++i)
+    {
+        const Label &t_label = m_qListLabels[i];
+
+        LabelKernel t_kernel;
+        t_kernel.iLinearRow = -1;
+
+        VectorXi t_vecSel;
+        QList<VectorXi> t_qListVertno = inv.src.label_src_vertno_sel(t_label, t_vecSel);
+        t_kernel.iNumSrc = t_vecSel.size();
+
+        if(t_kernel.iNumSrc == 0 || t_vecSel.maxCoeff() >= t_iNumKernelSrc || (t_label.hemi != 0 && t_label.hemi != 1))
+        {
+            qWarning("Label %s contains no sources of the inverse operator.", t_label.name.toLatin1().constData());
+            t_kernel.iNumSrc = 0;
+            m_qListLabelKernels.append(t_kernel);
+            continue;
+        }
+
+        //
+        //   Sign flip: orientation of the source normals relative to their dominant direction
+        //
+        const VectorXi &t_vecVertno = t_qListVertno[t_label.hemi];
+        MatrixXd t_matOri(t_vecVertno.size(), 3);
+        for(qint32 j = 0; j < t_vecVertno.size(); ++j)
+            t_matOri.row(j) = inv.src[t_label.hemi].nn.row(t_vecVertno[j]).cast<double>();
+        JacobiSVD<MatrixXd> t_svdOri(t_matOri, ComputeThinV);
+        VectorXd t_vecDir = t_matOri * t_svdOri.matrixV().col(0);
+        t_kernel.vecFlip = VectorXd::Ones(t_kernel.iNumSrc);
+        for(qint32 j = 0; j < t_kernel.iNumSrc && j < t_vecDir.size(); ++j)
+            if(t_vecDir[j] < 0)
+                t_kernel.vecFlip[j] = -1.0;
+
+        //
+        //   Kernel rows of the label sources, x, y and z blocks as in the fused kernel
+        //
+        MatrixXd t_matRows(t_iNumComp*t_kernel.iNumSrc, t_iNumChan);
+        for(qint32 c = 0; c < t_iNumComp; ++c)
+            for(qint32 j = 0; j < t_kernel.iNumSrc; ++j)
+                if(m_bSinglePrecision)
+                    t_matRows.row(c*t_kernel.iNumSrc + j) = m_matKernelFusedFloat.row(c*t_iNumKernelSrc + t_vecSel[j]).cast<double>();
+                else
+                    t_matRows.row(c*t_kernel.iNumSrc + j) = m_matKernelFused.row(c*t_iNumKernelSrc + t_vecSel[j]);
+
+        if(t_bLinear)
+        {
+            //
+            //   Mean (flip) of fixed orientation sources is linear: a single row
+            //
+            RowVectorXd t_vecRow = m_labelMode == LabelMean ? RowVectorXd(t_matRows.colwise().mean())
+                                                             : RowVectorXd(t_kernel.vecFlip.transpose() * t_matRows / t_kernel.iNumSrc);
+            t_kernel.iLinearRow = t_qListLinear.size();
+            t_qListLinear.append(i);
+            m_matLabelKernelLinear.conservativeResize(t_qListLinear.size(), t_iNumChan);
+            m_matLabelKernelLinear.row(t_kernel.iLinearRow) = t_vecRow;
+        }
+        else if(!m_bKernelFreeOri && m_labelMode == LabelPcaFlip)
+        {
+            //
+            //   Rows = U_k*S_k*V_k': keep the basis S_k*V_k' (rank <= nchan) and project the flip onto U_k
+            //
+            VectorXd t_vecS;
+            MatrixXd t_matU, t_matV;
+            MNEMath::svd_gram(t_matRows, t_vecS, t_matU, t_matV);
+            qint32 r;
+            for(r = 0; r < t_vecS.size() && t_vecS[r] > 0; ++r);
+            t_kernel.matKernel = t_vecS.head(r).asDiagonal() * t_matV.leftCols(r).transpose();
+            t_kernel.vecFlip = t_matU.leftCols(r).transpose() * t_kernel.vecFlip;
+        }
+        else
+            t_kernel.matKernel = t_matRows;
+
+        m_qListLabelKernels.append(t_kernel);
+    }
+
+    printf("Assembled label kernels of %d labels.\n", m_qListLabelKernels.size());
+}
+
+
+//*************************************************************************************************************
+
+QString MinimumNorm::kernelCacheFile(qint32 nave, bool pick_normal)
+{
+    if(s_sKernelCacheDir.isEmpty())
+        return QString();
+
+    //
+    //   Content hash of the operator, the const accesses do not detach its shared data
+    //
+    if(m_baOperatorHash.isEmpty())
+    {
+        const MNEInverseOperator &t_inv = m_inverseOperator;
+        QCryptographicHash t_hash(QCryptographicHash::Sha1);
+
+        hashMatrix(t_hash, t_inv.sing);
+        hashMatrix(t_hash, t_inv.eigen_leads.constData()->data);
+        hashMatrix(t_hash, t_inv.eigen_fields.constData()->data);
+        hashMatrix(t_hash, t_inv.source_cov.constData()->data);
+        hashMatrix(t_hash, t_inv.noise_cov.constData()->data);
+        hashMatrix(t_hash, t_inv.noise_cov.constData()->eig);
+        hashMatrix(t_hash, t_inv.noise_cov.constData()->eigvec);
+        t_hash.addData(t_inv.noise_cov.constData()->names.join(",").toUtf8());
+
+        qint32 t_iParams[5] = { t_inv.nave, t_inv.source_ori, t_inv.eigen_leads_weighted ? 1 : 0, t_inv.noise_cov.constData()->diag ? 1 : 0, t_inv.projs.size() };
+        t_hash.addData((const char*)t_iParams, sizeof(t_iParams));
+        for(qint32 i = 0; i < t_inv.projs.size(); ++i)
+        {
+            t_hash.addData(t_inv.projs[i].active ? "1" : "0", 1);
+            hashMatrix(t_hash, t_inv.projs[i].data.constData()->data);
+            t_hash.addData(t_inv.projs[i].data.constData()->col_names.join(",").toUtf8());
+        }
+        for(qint32 h = 0; h < t_inv.src.size(); ++h)
+            hashMatrix(t_hash, t_inv.src[h].vertno);
+
+        m_baOperatorHash = t_hash.result();
+    }
+
+    //
+    //   Setup parameters
+    //
+    QCryptographicHash t_hash(QCryptographicHash::Sha1);
+    t_hash.addData(m_baOperatorHash);
+
+    qint32 t_iParams[3] = { nave, pick_normal ? 1 : 0, label.hemi };
+    t_hash.addData((const char*)t_iParams, sizeof(t_iParams));
+    t_hash.addData((const char*)&m_fLambda, sizeof(m_fLambda));
+    t_hash.addData(m_sMethod.toUtf8());
+    hashMatrix(t_hash, label.vertices);
+
+    return QDir(s_sKernelCacheDir).filePath(QString(t_hash.result().toHex()) + ".mnek");
+}
+
+
+//*************************************************************************************************************
+
+bool MinimumNorm::readKernelCache(const QString &p_sFileName, qint32 nave)
+{
+    QFile t_file(p_sFileName);
+    if(!t_file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream t_stream(&t_file);
+    t_stream.setByteOrder(QDataStream::LittleEndian);
+
+    quint32 t_iMagic;
+    qint32 t_iVersion;
+    t_stream >> t_iMagic >> t_iVersion;
+    if(t_iMagic != MNE_KERNEL_CACHE_MAGIC || t_iVersion != MNE_KERNEL_CACHE_VERSION)
+        return false;
+
+    MNEInverseOperator t_inv(m_inverseOperator);
+    MatrixXd t_K;
+    SparseMatrix<double> t_noise_norm;
+    QList<VectorXi> t_vertno;
+
+    //
+    //   Largest sizes the operator can produce: nsource x ncomp kernel rows, one column per noise covariance channel
+    //
+    const MNEInverseOperator &t_invConst = m_inverseOperator;
+    qint64 t_iMaxSrc = qMax(3*(qint64)t_invConst.nsource, (qint64)t_invConst.eigen_leads.constData()->data.rows());
+    qint64 t_iNumChan = qMax((qint64)t_invConst.nchan, (qint64)t_invConst.noise_cov.constData()->dim);
+
+    qint32 t_iNumVertno;
+    bool t_bOk = readMatrix(t_stream, t_K, t_iMaxSrc, t_iNumChan) && readSparse(t_stream, t_noise_norm, t_iMaxSrc, t_iMaxSrc);
+    t_stream >> t_iNumVertno;
+    t_bOk = t_bOk && t_iNumVertno >= 0 && t_iNumVertno <= m_inverseOperator.src.size();
+    for(qint32 i = 0; t_bOk && i < t_iNumVertno; ++i)
+    {
+        VectorXi t_vec;
+        t_bOk = readMatrix(t_stream, t_vec, t_iMaxSrc, 1);
+        t_vertno.append(t_vec);
+    }
+    t_bOk = t_bOk && readSparse(t_stream, t_inv.noisenorm, t_iMaxSrc, t_iMaxSrc)
+                  && readMatrix(t_stream, t_inv.reginv, t_iNumChan, 1)
+                  && readMatrix(t_stream, t_inv.whitener, t_iNumChan, t_iNumChan)
+                  && readMatrix(t_stream, t_inv.proj, t_iNumChan, t_iNumChan);
+
+    if(!t_bOk || t_stream.status() != QDataStream::Ok)
+    {
+        printf("Inverse kernel cache %s is corrupt, recomputing.\n", p_sFileName.toLatin1().constData());
+        return false;
+    }
+
+    //
+    //   Scale the covariances as prepare_inverse_operator does
+    //
+    float scale = ((float)t_inv.nave)/((float)nave);
+    t_inv.noise_cov->data  *= scale;
+    t_inv.noise_cov->eig   *= scale;
+    t_inv.source_cov->data *= scale;
+    if (t_inv.eigen_leads_weighted)
+        t_inv.eigen_leads->data *= sqrt(scale);
+    t_inv.nave = nave;
+    t_inv.getKernel() = t_K;
+
+    inv = t_inv;
+    K = t_K;
+    noise_norm = t_noise_norm;
+    vertno = t_vertno;
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+bool MinimumNorm::writeKernelCache(const QString &p_sFileName) const
+{
+    if(!QDir().mkpath(QFileInfo(p_sFileName).absolutePath()))
+        return false;
+
+    //
+    //   Written to a temporary file and renamed on commit, readers never see partial files
+    //
+    QSaveFile t_file(p_sFileName);
+    if(!t_file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream t_stream(&t_file);
+    t_stream.setByteOrder(QDataStream::LittleEndian);
+
+    t_stream << (quint32)MNE_KERNEL_CACHE_MAGIC << (qint32)MNE_KERNEL_CACHE_VERSION;
+    writeMatrix(t_stream, K);
+    writeSparse(t_stream, noise_norm);
+    t_stream << (qint32)vertno.size();
+    for(qint32 i = 0; i < vertno.size(); ++i)
+        writeMatrix(t_stream, vertno[i]);
+    writeSparse(t_stream, inv.noisenorm);
+    writeMatrix(t_stream, inv.reginv);
+    writeMatrix(t_stream, inv.whitener);
+    writeMatrix(t_stream, inv.proj);
+
+    if(t_stream.status() != QDataStream::Ok)
+    {
+        t_file.cancelWriting();
+        return false;
+    }
+
+    return t_file.commit();
+}
+
+
+//*************************************************************************************************************
+
+bool MinimumNorm::kernelChannelSel(const QStringList &p_qListChNames, VectorXi &p_vecSel) const
+{
+    const QStringList &t_qListKernelNames = inv.noise_cov->names;
+    p_vecSel.resize(t_qListKernelNames.size());
+    for(qint32 i = 0; i < t_qListKernelNames.size(); ++i)
+    {
+        p_vecSel[i] = p_qListChNames.indexOf(t_qListKernelNames[i]);
+        if(p_vecSel[i] < 0)
+            return false;
+    }
+    return true;
+}
+
+
 //*************************************************************************************************************
 
 const char* MinimumNorm::getName() const
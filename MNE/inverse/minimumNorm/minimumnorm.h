@@ -45,9 +45,17 @@
 #include "../IInverseAlgorithm.h"
 
 #include <mne/mne_inverse_operator.h>
+#include <mne/mne_epoch_data_list.h>
+#include <mne/mne_sourceestimate.h>
+#include <fiff/fiff_evoked.h>
 #include <fs/label.h>
+#include <fs/annotationset.h>
+#include <fs/surfaceset.h>
 
+#include <QByteArray>
+#include <QList>
 #include <QSharedPointer>
+#include <QString>
 
 
 //*************************************************************************************************************
@@ -127,8 +135,143 @@ public:
 
     virtual MNESourceEstimate calculateInverse(const MatrixXd &data, float tmin, float tstep) const;
 
+    //=========================================================================================================
+    /**
+    * Computes single trial L2-norm inverse solutions of all epochs with one kernel setup (nave = 1). The epochs are
+    * concatenated and applied to the kernel in large blocks instead of one small product per epoch; with OpenMP the
+    * blocks are processed in parallel.
+    *
+    * @param[in] p_epochs       The epochs, their rows correspond to the channels of p_info.
+    * @param[in] p_info         Measurement info of the epoch channels.
+    * @param[in] pick_normal    If True, rather than pooling the orientations by taking the norm, only the
+    *                           radial component is kept. This is only applied when working with loose orientations.
+    * @param[in] parallel       Whether to split the epochs into parallel blocks (one per thread).
+    *
+    * @return the source estimates, one per epoch (empty ones for epochs which could not be processed)
+    */
+    QList<MNESourceEstimate> calculateInverse(const MNEEpochDataList &p_epochs, const FiffInfo &p_info, bool pick_normal = false, bool parallel = true);
+
+    //=========================================================================================================
+    /**
+    * Computes L2-norm inverse solutions of several evoked responses (e.g. conditions). Evoked responses with the same
+    * number of averages share one kernel setup and are applied to it as one concatenated block, see above.
+    *
+    * @param[in] p_qListEvoked  Evoked data.
+    * @param[in] pick_normal    If True, rather than pooling the orientations by taking the norm, only the
+    *                           radial component is kept. This is only applied when working with loose orientations.
+    * @param[in] parallel       Whether to split the evoked responses into parallel blocks (one per thread).
+    *
+    * @return the source estimates, one per evoked response (empty ones for responses which could not be processed)
+    */
+    QList<MNESourceEstimate> calculateInverse(const QList<FiffEvoked> &p_qListEvoked, bool pick_normal = false, bool parallel = true);
+
     virtual void doInverseSetup(qint32 nave, bool pick_normal = false);
 
+    //=========================================================================================================
+    /**
+    * Sets the directory of the on-disk kernel cache. doInverseSetup looks up the prepared kernel there before
+    * computing it and stores newly computed kernels. The cache key is a content hash of the inverse operator together
+    * with nave, lambda2, method, pick_normal and label, so changed operators never hit stale entries. Kernels of
+    * operators which change continuously (e.g. real-time estimates) should not be cached. Disabled by default.
+    *
+    * @param[in] p_sDir     Cache directory, an empty string disables the cache.
+    */
+    static void setKernelCacheDir(const QString &p_sDir);
+
+    //=========================================================================================================
+    /**
+    * Returns the directory of the on-disk kernel cache.
+    *
+    * @return the cache directory, empty if the cache is disabled
+    */
+    static QString kernelCacheDir();
+
+    //=========================================================================================================
+    /**
+    * Sets the labels for label time course extraction (see calculateLabelTimeCourses). The label kernel is reduced
+    * from the assembled imaging kernel and rebuilt with every doInverseSetup. For fixed orientations (or pick_normal)
+    * and the modes "mean" and "mean_flip" each label becomes a single kernel row, i.e. the whole kernel shrinks to
+    * nLabels x nchan; "pca_flip" keeps a basis of at most nchan rows per label. Otherwise the kernel rows of the label
+    * sources are kept, which is still a fraction of the full kernel.
+    *
+    * @param[in] p_qListLabels  The labels.
+    * @param[in] mode           How to combine the sources of a label ("mean" | "mean_flip" | "pca_flip" | "max").
+    */
+    void setLabels(const QList<Label> &p_qListLabels, const QString &mode = QString("mean_flip"));
+
+    //=========================================================================================================
+    /**
+    * Sets the labels of an annotation (e.g. the Desikan or Destrieux atlas) for label time course extraction, see above.
+    *
+    * @param[in] p_annotationSet    The annotation set.
+    * @param[in] p_surfSet          The surfaces the annotation labels are read from.
+    * @param[in] mode               How to combine the sources of a label ("mean" | "mean_flip" | "pca_flip" | "max").
+    *
+    * @return true if the annotation could be converted to labels, false otherwise
+    */
+    bool setLabels(const AnnotationSet &p_annotationSet, const SurfaceSet &p_surfSet, const QString &mode = QString("mean_flip"));
+
+    //=========================================================================================================
+    /**
+    * Computes the time courses of the labels set by setLabels directly from the data, without computing the source
+    * estimates of all sources.
+    *
+    * @param[in] data       Data matrix (channels x samples), its rows in the channel order of the kernel.
+    *
+    * @return the label time courses (labels x samples)
+    */
+    MatrixXd calculateLabelTimeCourses(const MatrixXd &data) const;
+
+    //=========================================================================================================
+    /**
+    * Get the labels of the label time courses.
+    *
+    * @return the labels set by setLabels
+    */
+    inline const QList<Label>& getLabels() const;
+
+    //=========================================================================================================
+    /**
+    * Applies the imaging kernel with noise normalization folded in (see doInverseSetup) and, for free orientations,
+    * combines the x, y and z components to their norm in one pass over the kernel result. No memory is allocated
+    * once sol and work have the right size, so callers applying the inverse to a stream of data blocks keep both.
+    *
+    * @param[in] data       Data matrix (channels x samples)
+    * @param[out] sol       Source amplitudes (sources x samples)
+    * @param[in, out] work  Workspace for the free orientation components
+    */
+    void applyKernel(const MatrixXd &data, MatrixXd &sol, MatrixXd &work) const;
+
+    //=========================================================================================================
+    /**
+    * Single precision variant of applyKernel above. Without single precision storage (see setSinglePrecision) the
+    * data are applied to the double precision kernel and the result is converted.
+    *
+    * @param[in] data       Data matrix (channels x samples)
+    * @param[out] sol       Source amplitudes (sources x samples)
+    * @param[in, out] work  Workspace for the free orientation components
+    */
+    void applyKernel(const MatrixXf &data, MatrixXf &sol, MatrixXf &work) const;
+
+    //=========================================================================================================
+    /**
+    * Sets single precision storage. With single precision doInverseSetup keeps only the float copy of the fused
+    * kernel and releases the double precision kernel as well as the eigen leads and fields of the prepared operator;
+    * the kernel is applied in float. The kernel itself is still computed in double precision. getKernel() returns
+    * an empty matrix in this mode. Takes effect with the next doInverseSetup.
+    *
+    * @param[in] p_bSinglePrecision     Whether to store and apply the kernel in single precision.
+    */
+    void setSinglePrecision(bool p_bSinglePrecision);
+
+    //=========================================================================================================
+    /**
+    * Returns whether the kernel is stored and applied in single precision.
+    *
+    * @return true if single precision storage is set
+    */
+    inline bool isSinglePrecision() const;
+
 
     virtual const char* getName() const;
 
@@ -170,6 +313,91 @@ public:
     inline MatrixXd& getKernel();
 
 private:
+    //=========================================================================================================
+    /**
+    * Applies the current kernel to a batch of data matrices: the picked channels of consecutive items are
+    * concatenated column-wise into blocks of bounded width and each block is applied with a single applyKernel
+    * call.
+    *
+    * @param[in] p_qListData    Data matrices
+    * @param[in] p_qListSel     Rows of each data matrix in kernel channel order
+    * @param[in] p_qListTmin    Start time of each item
+    * @param[in] p_qListTstep   Sampling interval of each item
+    * @param[in] parallel       Whether to process the blocks in parallel
+    *
+    * @return the source estimates, one per item
+    */
+    QList<MNESourceEstimate> calculateInverseBatch(const QList<const MatrixXd*> &p_qListData, const QList<VectorXi> &p_qListSel, const QList<float> &p_qListTmin, const QList<float> &p_qListTstep, bool parallel) const;
+
+    //=========================================================================================================
+    /**
+    * Looks up the rows of the kernel channels (the noise covariance channels of the set up operator) in a channel list.
+    *
+    * @param[in] p_qListChNames Channel names of the data
+    * @param[out] p_vecSel      Row of each kernel channel in the data
+    *
+    * @return true if all kernel channels are present, false otherwise
+    */
+    bool kernelChannelSel(const QStringList &p_qListChNames, VectorXi &p_vecSel) const;
+
+    //=========================================================================================================
+    /**
+    * Reduces the fused imaging kernel to the label kernels of m_qListLabels.
+    */
+    void assembleLabelKernel();
+
+    //=========================================================================================================
+    /**
+    * Returns the kernel cache file of the current operator and setup parameters.
+    *
+    * @param[in] nave           Number of averages
+    * @param[in] pick_normal    Whether only the normal components are kept
+    *
+    * @return the cache file name, empty if the cache is disabled
+    */
+    QString kernelCacheFile(qint32 nave, bool pick_normal);
+
+    //=========================================================================================================
+    /**
+    * Restores the prepared operator and the assembled kernel from a cache file.
+    *
+    * @param[in] p_sFileName    The cache file
+    * @param[in] nave           Number of averages the kernel was prepared for
+    *
+    * @return true if the cache file was read, false otherwise
+    */
+    bool readKernelCache(const QString &p_sFileName, qint32 nave);
+
+    //=========================================================================================================
+    /**
+    * Stores the prepared operator parts and the assembled kernel in a cache file.
+    *
+    * @param[in] p_sFileName    The cache file
+    *
+    * @return true if the cache file was written, false otherwise
+    */
+    bool writeKernelCache(const QString &p_sFileName) const;
+
+    //=========================================================================================================
+    /**
+    * Reduced kernel of one label.
+    */
+    struct LabelKernel
+    {
+        qint32      iNumSrc;    /**< Number of sources within the label */
+        qint32      iLinearRow; /**< Row in m_matLabelKernelLinear for labels reduced to one row, -1 otherwise */
+        MatrixXd    matKernel;  /**< Kernel rows of the label sources (x, y, z blocks for free orientations) or the pca basis */
+        VectorXd    vecFlip;    /**< Sign flip of the label sources, projected onto the pca basis for "pca_flip" */
+    };
+
+    enum LabelMode
+    {
+        LabelMean,      /**< Average of the sources */
+        LabelMeanFlip,  /**< Average of the sign flipped sources */
+        LabelPcaFlip,   /**< First principal component, scaled and sign flipped */
+        LabelMax        /**< Maximal absolute value of the sources */
+    };
+
     MNEInverseOperator m_inverseOperator;   /**< The inverse operator */
     float m_fLambda;                        /**< Regularization parameter */
     QString m_sMethod;                      /**< Selected method */
@@ -182,6 +410,18 @@ private:
     QList<VectorXi> vertno;                 /**< The vertices numbers */
     Label label;                            /**< The corresponding labels */
     MatrixXd K;                             /**< Imaging kernel */
+    MatrixXd m_matKernelFused;              /**< Imaging kernel with noise normalization folded in, free orientation rows grouped as x, y, z blocks */
+    MatrixXf m_matKernelFusedFloat;         /**< Single precision m_matKernelFused, only kept with single precision storage */
+    bool m_bKernelFreeOri;                  /**< Whether m_matKernelFused has three components per source */
+    bool m_bSinglePrecision;                /**< Whether only m_matKernelFusedFloat is kept */
+
+    QList<Label> m_qListLabels;                 /**< Labels of the label time courses */
+    LabelMode m_labelMode;                      /**< How to combine the sources of a label */
+    QList<LabelKernel> m_qListLabelKernels;     /**< Reduced kernels of m_qListLabels */
+    MatrixXd m_matLabelKernelLinear;            /**< Single row label kernels, applied as one product */
+
+    QByteArray m_baOperatorHash;                /**< Content hash of m_inverseOperator, computed on first use of the kernel cache */
+    static QString s_sKernelCacheDir;           /**< Directory of the kernel cache, empty if disabled */
 
 };
 
@@ -196,6 +436,14 @@ inline MatrixXd& MinimumNorm::getKernel()
 }
 
 
+//*************************************************************************************************************
+
+inline bool MinimumNorm::isSinglePrecision() const
+{
+    return m_bSinglePrecision;
+}
+
+
 //*************************************************************************************************************
 
 inline MNEInverseOperator& MinimumNorm::getPreparedInverseOperator()
@@ -203,6 +451,14 @@ inline MNEInverseOperator& MinimumNorm::getPreparedInverseOperator()
     return inv;
 }
 
+
+//*************************************************************************************************************
+
+inline const QList<Label>& MinimumNorm::getLabels() const
+{
+    return m_qListLabels;
+}
+
 } //NAMESPACE
 
 #endif // MINIMUMNORM_H
@@ -152,6 +152,20 @@ public:
 
     virtual const char* getName() const;
 
+protected:
+    //=========================================================================================================
+    /**
+    * Searches the maximal correlated dipole pair by a Powell search, which starts at the given pair or, if none
+    * is given, at the pairs of grid point 2.
+    *
+    * @param[in] p_scan             The correlation scan of the projected gain matrix.
+    * @param[in, out] p_iIdx1       The first dipole of the start pair (-1 = none), returns the first dipole of the found pair.
+    * @param[in, out] p_iIdx2       The second dipole of the start pair (-1 = none), returns the second dipole of the found pair.
+    *
+    * @return the correlation of the found pair.
+    */
+    virtual double searchPair(const RapMusicScan& p_scan, int& p_iIdx1, int& p_iIdx2) const;
+
 };
 
 //*************************************************************************************************************
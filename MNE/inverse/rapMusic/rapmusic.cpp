@@ -46,6 +46,15 @@
 #endif
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Eigenvalues>
+#include <Eigen/QR>
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // USED NAMESPACES
@@ -70,6 +79,10 @@ RapMusic::RapMusic()
 , m_bIsInit(false)
 , m_iSamplesStcWindow(-1)
 , m_fStcOverlap(-1)
+, m_bSinglePrecision(false)
+, m_bStreaming(false)
+, m_iSubspaceDim(-1)
+, m_iStreamWindowCount(0)
 {
 }
 
@@ -87,6 +100,10 @@ RapMusic::RapMusic(MNEForwardSolution& p_pFwd, bool p_bSparsed, int p_iN, double
 , m_bIsInit(false)
 , m_iSamplesStcWindow(-1)
 , m_fStcOverlap(-1)
+, m_bSinglePrecision(false)
+, m_bStreaming(false)
+, m_iSubspaceDim(-1)
+, m_iStreamWindowCount(0)
 {
     //Init
     init(p_pFwd, p_bSparsed, p_iN, p_dThr);
@@ -136,15 +153,15 @@ bool RapMusic::init(MNEForwardSolution& p_pFwd, bool p_bSparsed, int p_iN, doubl
 
 
     //Lead Field check
-    if ( p_pFwd.sol->data.cols() % 3 != 0 )
+    if ( p_pFwd.gainCols() % 3 != 0 )
     {
         std::cout << "Gain matrix is not associated with a 3D grid!\n";
         return false;
     }
 
-    m_iNumGridPoints = p_pFwd.sol->data.cols()/3;
+    m_iNumGridPoints = p_pFwd.gainCols()/3;
 
-    m_iNumChannels = p_pFwd.sol->data.rows();
+    m_iNumChannels = p_pFwd.gainRows();
 
 //    m_pMappedMatLeadField = new Eigen::Map<MatrixXT>
 //        (   p_pMatLeadField->data(),
@@ -152,6 +169,16 @@ bool RapMusic::init(MNEForwardSolution& p_pFwd, bool p_bSparsed, int p_iN, doubl
 //            p_pMatLeadField->cols() );
 
     m_ForwardSolution = p_pFwd;
+    m_matGainFloat.resize(0, 0);
+    //A forward solution read in single precision is scanned in single precision
+    if(p_pFwd.isSinglePrecision())
+    {
+        m_bSinglePrecision = true;
+        m_matGainFloat = *p_pFwd.sol_float;
+        m_ForwardSolution.sol_float.clear();
+    }
+    updateGainStorage();
+    resetStreaming();
 
     //##### Calc lead field combination #####
 
@@ -209,6 +236,9 @@ MNESourceEstimate RapMusic::calculateInverse(const FiffEvoked &p_fiffEvoked, boo
 {
     Q_UNUSED(pick_normal);
 
+    if(m_bStreaming)
+        return calculateInverseStreaming(p_fiffEvoked);
+
     MNESourceEstimate p_sourceEstimate;
 
     if(p_fiffEvoked.data.rows() != m_iNumChannels)
@@ -405,15 +435,29 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
     clock_t start, end;
     start = clock();
 
-//    //Map HPCMatrix to Eigen Matrix
-//    Eigen::Map<MatrixXT>
-//        t_MappedMatMeasurement(	p_pMatMeasurement->data(),
-//        p_pMatMeasurement->rows(),
-//        p_pMatMeasurement->cols() );
-
     //Calculate the signal subspace (t_pMatPhi_s)
-    MatrixXT* t_pMatPhi_s = NULL;//(m_iNumChannels, m_iN < t_r ? m_iN : t_r);
-    int t_r = calcPhi_s(/*(MatrixXT)*/p_matMeasurement, t_pMatPhi_s);
+    MatrixXT* t_pMatPhi_s = NULL;
+    calcPhi_s(p_matMeasurement, t_pMatPhi_s);
+
+    searchSources(*t_pMatPhi_s, p_RapDipoles);
+
+    end = clock();
+
+    float t_fElapsedTime = ( (float)(end-start) / (float)CLOCKS_PER_SEC ) * 1000.0f;
+    std::cout << "Total Time Elapsed: " << t_fElapsedTime << " ms" << std::endl << std::endl;
+
+    //garbage collecting
+    delete t_pMatPhi_s;
+
+    return p_SourceEstimate;
+}
+
+
+//*************************************************************************************************************
+
+void RapMusic::searchSources(const MatrixXT& p_matPhi_s, QList< DipolePair<double> > &p_RapDipoles, const QList< DipolePair<double> > &p_WarmStart) const
+{
+    int t_r = p_matPhi_s.cols();
 
     int t_iMaxSearch = m_iN < t_r ? m_iN : t_r; //The smallest of Rank and Iterations
 
@@ -434,34 +478,18 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
     MatrixXT t_matA_k_1(m_iNumChannels, t_iMaxSearch);
     t_matA_k_1.setZero();
 
-//    if (m_pMatGrid != NULL)
-//    {
-//        if(p_pRapDipoles != NULL)
-//            p_pRapDipoles->initRapDipoles(m_pMatGrid);
-//        else
-//            p_pRapDipoles = new RapDipoles<T>(m_pMatGrid);
-//    }
-//    else
-//    {
-//        if(p_pRapDipoles != NULL)
-//            delete p_pRapDipoles;
-
-//        p_pRapDipoles = new RapDipoles<T>();
-//    }
     p_RapDipoles.clear();
 
-    std::cout << "##### Calculation of RAP MUSIC started ######\n\n";
+    std::cout << "##### Calculation of " << getName() << " started ######\n\n";
 
-    MatrixXT t_matProj_Phi_s(t_matOrthProj.rows(), t_pMatPhi_s->cols());
+    MatrixXT t_matProj_Phi_s(t_matOrthProj.rows(), p_matPhi_s.cols());
     //new Version: Calculate projection before
-    MatrixXT t_matProj_LeadField(m_ForwardSolution.sol->data.rows(), m_ForwardSolution.sol->data.cols());
+    MatrixXT t_matProj_LeadField;
+    MatrixXf t_matProj_LeadFieldFloat;
 
     for(int r = 0; r < t_iMaxSearch ; ++r)
     {
-        t_matProj_Phi_s = t_matOrthProj*(*t_pMatPhi_s);
-
-        //new Version: Calculating Projection before
-        t_matProj_LeadField = t_matOrthProj * m_ForwardSolution.sol->data;//Subtract the found sources from the current found source
+        t_matProj_Phi_s = t_matOrthProj*p_matPhi_s;
 
         //###First Option###
         //Step 1: lt. Mosher 1998 -> Maybe tmp_Proj_Phi_S is already orthogonal -> so no SVD needed -> U_B = tmp_Proj_Phi_S;
@@ -469,54 +497,59 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
         MatrixXT t_matU_B;
         useFullRank(t_svdProj_Phi_S.matrixU(), t_svdProj_Phi_S.singularValues().asDiagonal(), t_matU_B);
 
-        //Inits
-        VectorXT t_vecRoh(m_iNumLeadFieldCombinations,1);
-        t_vecRoh.setZero();
-
         //subcorr benchmark
         //Stop the time
         clock_t start_subcorr, end_subcorr;
         start_subcorr = clock();
 
-        //Multithreading correlation calculation
-        #ifdef _OPENMP
-        #pragma omp parallel num_threads(m_iMaxNumThreads)
-        #endif
+        //Correlations out of the cached Gram blocks of the projected gain matrix; the projector of the first
+        //iteration is the identity -> scan the gain matrix itself
+        RapMusicScan t_scan;
+        if(r == 0)
         {
-        #ifdef _OPENMP
-        #pragma omp for
-        #endif
-            for(int i = 0; i < m_iNumLeadFieldCombinations; i++)
+            if(m_bSinglePrecision)
+                t_scan.init(m_matGainFloat, t_matU_B);
+            else
             {
-                //new Version: calculate matrix multiplication before
-                //Create Lead Field combinations -> It would be better to use a pointer construction, to increase performance
-                MatrixX6T t_matProj_G(t_matProj_LeadField.rows(),6);
-
-                int idx1 = m_ppPairIdxCombinations[i]->x1;
-                int idx2 = m_ppPairIdxCombinations[i]->x2;
+                Q_ASSERT(m_ForwardSolution.sol->data.size() > 0);//sol->data is released with single precision storage
+                t_scan.init(m_ForwardSolution.sol->data, t_matU_B);
+            }
+        }
+        else
+        {
+            //Subtract the found sources from the current found source
+            projectGainMatrix(t_matOrthProj, t_matProj_LeadField, t_matProj_LeadFieldFloat);
 
-                RapMusic::getGainMatrixPair(t_matProj_LeadField, t_matProj_G, idx1, idx2);
+            if(m_bSinglePrecision)
+                t_scan.init(t_matProj_LeadFieldFloat, t_matU_B);
+            else
+                t_scan.init(t_matProj_LeadField, t_matU_B);
+        }
 
-                t_vecRoh(i) = RapMusic::subcorr(t_matProj_G, t_matU_B);//t_vecRoh holds the correlations roh_k
-            }
+        //Search the maximal correlated pair, starting at the corresponding pair of the warm start if given
+        int t_iIdx1 = -1;
+        int t_iIdx2 = -1;
+        if(r < p_WarmStart.size())
+        {
+            t_iIdx1 = p_WarmStart[r].m_iIdx1;
+            t_iIdx2 = p_WarmStart[r].m_iIdx2;
         }
 
+        double t_val_roh_k = searchPair(t_scan, t_iIdx1, t_iIdx2);
 
-//         if(r==0)
-//         {
-//             std::fstream filestr;
-//             std::stringstream filename;
-//             filename << "Roh_gold.txt";
-//
-//             filestr.open ( filename.str().c_str(), std::fstream::out);
-//             for(int i = 0; i < m_iNumLeadFieldCombinations; ++i)
-//             {
-//               filestr << t_vecRoh(i) << "\n";
-//             }
-//             filestr.close();
-//
-//             //exit(0);
-//         }
+        //The warm started pair lost its correlation -> the sources moved away, search again from scratch
+        if(r < p_WarmStart.size() && (t_val_roh_k < m_dThreshold || t_val_roh_k < STREAM_RESCAN_RATIO*p_WarmStart[r].m_vCorrelation))
+        {
+            int t_iScanIdx1 = -1;
+            int t_iScanIdx2 = -1;
+            double t_val_scan_roh_k = searchPair(t_scan, t_iScanIdx1, t_iScanIdx2);
+            if(t_val_scan_roh_k > t_val_roh_k)
+            {
+                t_val_roh_k = t_val_scan_roh_k;
+                t_iIdx1 = t_iScanIdx1;
+                t_iIdx2 = t_iScanIdx2;
+            }
+        }
 
         //subcorr benchmark
         end_subcorr = clock();
@@ -524,29 +557,16 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
         float t_fSubcorrElapsedTime = ( (float)(end_subcorr-start_subcorr) / (float)CLOCKS_PER_SEC ) * 1000.0f;
         std::cout << "Time Elapsed: " << t_fSubcorrElapsedTime << " ms" << std::endl;
 
-        //Find the maximum of correlation - can't put this in the for loop because it's running in different threads.
-        double t_val_roh_k;
-
-        VectorXT::Index t_iMaxIdx;
-
-        t_val_roh_k = t_vecRoh.maxCoeff(&t_iMaxIdx);//p_vecCor = ^roh_k
-
-        //get positions in sparsed leadfield from index combinations;
-        int t_iIdx1 = m_ppPairIdxCombinations[t_iMaxIdx]->x1;
-        int t_iIdx2 = m_ppPairIdxCombinations[t_iMaxIdx]->x2;
-
         // (Idx+1) because of MATLAB positions -> starting with 1 not with 0
         std::cout << "Iteration: " << r+1 << " of " << t_iMaxSearch
             << "; Correlation: " << t_val_roh_k<< "; Position (Idx+1): " << t_iIdx1+1 << " - " << t_iIdx2+1 <<"\n\n";
 
-        //Calculations with the max correlated dipole pair G_k_1 -> ToDo Obsolet when taking direkt Projected Lead Field
-        MatrixX6T t_matG_k_1(m_ForwardSolution.sol->data.rows(),6);
-        RapMusic::getGainMatrixPair(m_ForwardSolution.sol->data, t_matG_k_1, t_iIdx1, t_iIdx2);
+        //Calculations with the max correlated dipole pair G_k_1
+        MatrixX6T t_matG_k_1(m_iNumChannels,6);
+        gainMatrixPair(m_ForwardSolution.sol->data, m_matGainFloat, t_matG_k_1, t_iIdx1, t_iIdx2);
 
         MatrixX6T t_matProj_G_k_1(t_matOrthProj.rows(), t_matG_k_1.cols());
         t_matProj_G_k_1 = t_matOrthProj * t_matG_k_1;//Subtract the found sources from the current found source
-//         MatrixX6T t_matProj_G_k_1(t_matProj_LeadField.rows(), 6);
-//         getLeadFieldPair(t_matProj_LeadField, t_matProj_G_k_1, t_iIdx1, t_iIdx2);
 
         //Calculate source direction
         //source direction (p_pMatPhi) for current source r (phi_k_1)
@@ -569,22 +589,204 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
 
         //Calculate new orthogonal Projector (Pi_k_1)
         calcOrthProj(t_matA_k_1, t_matOrthProj);
+    }
+
+    std::cout << "##### Calculation of " << getName() << " completed ######"<< std::endl << std::endl << std::endl;
+}
+
+
+//*************************************************************************************************************
+
+double RapMusic::searchPair(const RapMusicScan& p_scan, int& p_iIdx1, int& p_iIdx2) const
+{
+    //Warm start -> track the pair of the previous window by a local search
+    if(p_iIdx1 >= 0 && p_iIdx1 < m_iNumGridPoints && p_iIdx2 >= 0 && p_iIdx2 < m_iNumGridPoints)
+        return p_scan.localSearch(p_iIdx1, p_iIdx2, m_iMaxNumThreads);
+
+    VectorXT t_vecRoh;
+    p_scan.scan(t_vecRoh, m_iMaxNumThreads);//t_vecRoh holds the correlations roh_k
+
+    //Find the maximum of correlation - can't put this in the for loop because it's running in different threads.
+    VectorXT::Index t_iMaxIdx;
+    double t_val_roh_k = t_vecRoh.maxCoeff(&t_iMaxIdx);//p_vecCor = ^roh_k
+
+    //get positions in sparsed leadfield from index combinations;
+    p_iIdx1 = m_ppPairIdxCombinations[t_iMaxIdx]->x1;
+    p_iIdx2 = m_ppPairIdxCombinations[t_iMaxIdx]->x2;
 
-        //garbage collecting
-        //ToDo
+    return t_val_roh_k;
+}
+
+
+//*************************************************************************************************************
+
+MNESourceEstimate RapMusic::calculateInverseStreaming(const FiffEvoked &p_fiffEvoked)
+{
+    MNESourceEstimate p_sourceEstimate;
+
+    if(!m_bIsInit)
+    {
+        std::cout << "RAP MUSIC wasn't initialized!";
+        return p_sourceEstimate;
     }
 
-    std::cout << "##### Calculation of RAP MUSIC completed ######"<< std::endl << std::endl << std::endl;
+    if(p_fiffEvoked.data.rows() != m_iNumChannels)
+    {
+        std::cout << "Number of FiffEvoked channels (" << p_fiffEvoked.data.rows() << ") doesn't match the number of channels (" << m_iNumChannels << ") of the forward solution." << std::endl;
+        return p_sourceEstimate;
+    }
 
-    end = clock();
+    const MatrixXd& t_matData = p_fiffEvoked.data;
+    qint32 t_iNumSteps = t_matData.cols();
 
-    float t_fElapsedTime = ( (float)(end-start) / (float)CLOCKS_PER_SEC ) * 1000.0f;
-    std::cout << "Total Time Elapsed: " << t_fElapsedTime << " ms" << std::endl << std::endl;
+    p_sourceEstimate.data = MatrixXd::Zero(m_ForwardSolution.nsource, t_iNumSteps);
 
-    //garbage collecting
-    delete t_pMatPhi_s;
+    //Results
+    p_sourceEstimate.vertices = VectorXi(m_ForwardSolution.src[0].vertno.size() + m_ForwardSolution.src[1].vertno.size());
+    p_sourceEstimate.vertices << m_ForwardSolution.src[0].vertno, m_ForwardSolution.src[1].vertno;
 
-    return p_SourceEstimate;
+    p_sourceEstimate.times = p_fiffEvoked.times;
+    p_sourceEstimate.tmin = p_fiffEvoked.times[0];
+    p_sourceEstimate.tstep = p_fiffEvoked.times[1] - p_fiffEvoked.times[0];
+
+    //Window and hop size (if samples per stc aren't set -> use full window)
+    qint32 t_iWindow = (m_iSamplesStcWindow > 3 && m_iSamplesStcWindow < t_iNumSteps) ? m_iSamplesStcWindow : t_iNumSteps;
+    qint32 t_iSamplesOverlap = m_fStcOverlap > 0 ? (qint32)floor(((float)t_iWindow)*m_fStcOverlap) : 0;
+    qint32 t_iHop = t_iWindow - t_iSamplesOverlap > 0 ? t_iWindow - t_iSamplesOverlap : 1;
+
+    //The covariance is rebuilt at the start of each evoked, the tracked subspace and dipoles are carried over
+    m_matStreamCov = MatrixXT::Zero(m_iNumChannels, m_iNumChannels);
+
+    qint32 t_iStart = 0;
+    qint32 t_iEnd = 0;
+    qint32 t_iResultSample = 0;
+    bool first = true;
+    bool last = false;
+
+    while(!last)
+    {
+        qint32 t_iNewStart = first ? 0 : t_iStart + t_iHop;
+        if(t_iNewStart + t_iWindow >= t_iNumSteps)
+        {
+            last = true;
+            t_iNewStart = t_iNumSteps - t_iWindow;
+        }
+        qint32 t_iNewEnd = t_iNewStart + t_iWindow;
+
+        //Rank-k updates of F*F^T: add the samples which entered the window, remove those which left it
+        bool t_bNewWindow = t_iNewStart >= t_iEnd;
+        if(t_bNewWindow)
+        {
+            m_matStreamCov.noalias() = t_matData.middleCols(t_iNewStart, t_iWindow) * t_matData.middleCols(t_iNewStart, t_iWindow).transpose();
+        }
+        else
+        {
+            if(t_iNewStart > t_iStart)
+                m_matStreamCov.noalias() -= t_matData.middleCols(t_iStart, t_iNewStart-t_iStart) * t_matData.middleCols(t_iStart, t_iNewStart-t_iStart).transpose();
+            if(t_iNewEnd > t_iEnd)
+                m_matStreamCov.noalias() += t_matData.middleCols(t_iEnd, t_iNewEnd-t_iEnd) * t_matData.middleCols(t_iEnd, t_iNewEnd-t_iEnd).transpose();
+        }
+
+        t_iStart = t_iNewStart;
+        t_iEnd = t_iNewEnd;
+
+        //Track the signal subspace and warm-start the search at the dipoles of the previous window
+        MatrixXT t_matPhi_s;
+        trackSignalSubspace(t_matPhi_s, t_bNewWindow);
+
+        //Search from scratch at regular intervals, a warm start could miss sources which appear elsewhere
+        if(m_iStreamWindowCount >= STREAM_RESCAN_INTERVAL)
+        {
+            m_qListStreamDipoles.clear();
+            m_iStreamWindowCount = 0;
+        }
+        ++m_iStreamWindowCount;
+
+        QList< DipolePair<double> > t_RapDipoles;
+        searchSources(t_matPhi_s, t_RapDipoles, m_qListStreamDipoles);
+        m_qListStreamDipoles = t_RapDipoles;
+
+        //Assign Result
+        qint32 t_iResultEnd = last ? t_iNumSteps : t_iStart + t_iHop;
+        if(t_iResultEnd > t_iResultSample)
+        {
+            for(qint32 i = 0; i < t_RapDipoles.size(); ++i)
+            {
+                double dip1 = sqrt( pow(t_RapDipoles[i].m_Dipole1.phi_x(),2) +
+                                    pow(t_RapDipoles[i].m_Dipole1.phi_y(),2) +
+                                    pow(t_RapDipoles[i].m_Dipole1.phi_z(),2) ) * t_RapDipoles[i].m_vCorrelation;
+
+                double dip2 = sqrt( pow(t_RapDipoles[i].m_Dipole2.phi_x(),2) +
+                                    pow(t_RapDipoles[i].m_Dipole2.phi_y(),2) +
+                                    pow(t_RapDipoles[i].m_Dipole2.phi_z(),2) ) * t_RapDipoles[i].m_vCorrelation;
+
+                p_sourceEstimate.data.block(t_RapDipoles[i].m_iIdx1, t_iResultSample, 1, t_iResultEnd-t_iResultSample).setConstant(dip1);
+                p_sourceEstimate.data.block(t_RapDipoles[i].m_iIdx2, t_iResultSample, 1, t_iResultEnd-t_iResultSample).setConstant(dip2);
+            }
+            t_iResultSample = t_iResultEnd;
+        }
+
+        first = false;
+    }
+
+    return p_sourceEstimate;
+}
+
+
+//*************************************************************************************************************
+
+int RapMusic::trackSignalSubspace(MatrixXT& p_matPhi_s, bool p_bNewWindow)
+{
+    int t_iDim = m_iSubspaceDim > 0 ? m_iSubspaceDim : m_iN;
+    if(t_iDim > m_iNumChannels)
+        t_iDim = m_iNumChannels;
+    if(t_iDim < 1)
+        t_iDim = 1;
+
+    VectorXT t_vecLambda;
+    bool t_bSettled = false;
+
+    if(!p_bNewWindow && m_matStreamBasis.rows() == m_iNumChannels && m_matStreamBasis.cols() == t_iDim)
+    {
+        //Subspace tracking: orthogonal iterations with the updated F*F^T, each followed by a Rayleigh-Ritz step,
+        //until the subspace doesn't change anymore
+        for(int i = 0; i < STREAM_SUBSPACE_MAX_ITER && !t_bSettled; ++i)
+        {
+            MatrixXT t_matY = m_matStreamCov * m_matStreamBasis;
+            Eigen::HouseholderQR<MatrixXT> t_qrY(t_matY);
+            MatrixXT t_matQ = t_qrY.householderQ() * MatrixXT::Identity(m_iNumChannels, t_iDim);
+
+            MatrixXT t_matT = t_matQ.transpose() * m_matStreamCov * t_matQ;
+            Eigen::SelfAdjointEigenSolver<MatrixXT> t_eigT(t_matT);
+            MatrixXT t_matBasis = t_matQ * t_eigT.eigenvectors().rowwise().reverse();
+            t_vecLambda = t_eigT.eigenvalues().reverse();
+
+            //Part of the new basis which lies outside of the previous subspace
+            MatrixXT t_matChange = t_matBasis - m_matStreamBasis * (m_matStreamBasis.transpose() * t_matBasis);
+            t_bSettled = t_matChange.norm() < STREAM_SUBSPACE_TOL;
+
+            m_matStreamBasis = t_matBasis;
+        }
+    }
+
+    if(!t_bSettled)
+    {
+        //No tracked subspace yet, a non-overlapping window or the iteration didn't settle -> full decomposition
+        Eigen::SelfAdjointEigenSolver<MatrixXT> t_eigCov(m_matStreamCov);
+        m_matStreamBasis = t_eigCov.eigenvectors().rightCols(t_iDim).rowwise().reverse();
+        t_vecLambda = t_eigCov.eigenvalues().tail(t_iDim).reverse();
+    }
+
+    //Eigenvalues of F*F^T are the singular values of calcPhi_s -> same rank criterion as getRank
+    int t_r;
+    for(t_r = t_iDim-1; t_r > 0; t_r--)
+        if (t_vecLambda(t_r) > 0.00001)
+            break;
+    t_r++;
+
+    p_matPhi_s = m_matStreamBasis.leftCols(t_r);
+
+    return t_r;
 }
 
 
@@ -866,6 +1068,52 @@ void RapMusic::getGainMatrixPair(   const MatrixXT& p_matGainMarix,
 }
 
 
+//*************************************************************************************************************
+
+void RapMusic::getGainMatrixPair(   const MatrixXf& p_matGainMarix,
+                                    MatrixX6T& p_matGainMarix_Pair,
+                                    int p_iIdx1, int p_iIdx2)
+{
+    p_matGainMarix_Pair.block(0,0,p_matGainMarix.rows(),3) = p_matGainMarix.block(0, p_iIdx1*3, p_matGainMarix.rows(), 3).cast<double>();
+
+    p_matGainMarix_Pair.block(0,3,p_matGainMarix.rows(),3) = p_matGainMarix.block(0, p_iIdx2*3, p_matGainMarix.rows(), 3).cast<double>();
+}
+
+
+//*************************************************************************************************************
+
+void RapMusic::updateGainStorage()
+{
+    const FiffNamedMatrix* t_pSol = m_ForwardSolution.sol.constData();
+
+    if(m_bSinglePrecision && m_matGainFloat.size() == 0 && t_pSol->data.size() > 0)
+    {
+        m_matGainFloat = t_pSol->data.cast<float>();
+        //Release the reference to the double precision gain matrix, which may be shared with the caller
+        m_ForwardSolution.sol = FiffNamedMatrix::SDPtr(new FiffNamedMatrix(t_pSol->nrow, t_pSol->ncol, t_pSol->row_names, t_pSol->col_names, MatrixXd()));
+    }
+    else if(!m_bSinglePrecision && m_matGainFloat.size() > 0)
+    {
+        m_ForwardSolution.sol->data = m_matGainFloat.cast<double>();
+        m_matGainFloat.resize(0, 0);
+    }
+}
+
+
+//*************************************************************************************************************
+
+void RapMusic::projectGainMatrix(const MatrixXT& p_matOrthProj, MatrixXT& p_matProj, MatrixXf& p_matProjFloat) const
+{
+    if(m_bSinglePrecision)
+        p_matProjFloat.noalias() = p_matOrthProj.cast<float>() * m_matGainFloat;
+    else
+    {
+        Q_ASSERT(m_ForwardSolution.sol->data.size() > 0);//sol->data is released with single precision storage
+        p_matProj.noalias() = p_matOrthProj * m_ForwardSolution.sol->data;
+    }
+}
+
+
 //*************************************************************************************************************
 
 void RapMusic::insertSource(    int p_iDipoleIdx1, int p_iDipoleIdx2,
@@ -907,3 +1155,33 @@ void RapMusic::setStcAttr(int p_iSampStcWin, float p_fStcOverlap)
     m_iSamplesStcWindow = p_iSampStcWin;
     m_fStcOverlap = p_fStcOverlap;
 }
+
+
+//*************************************************************************************************************
+
+void RapMusic::setStreaming(bool p_bStreaming, int p_iSubspaceDim)
+{
+    m_bStreaming = p_bStreaming;
+    m_iSubspaceDim = p_iSubspaceDim;
+    resetStreaming();
+}
+
+
+//*************************************************************************************************************
+
+void RapMusic::resetStreaming()
+{
+    m_matStreamCov.resize(0, 0);
+    m_matStreamBasis.resize(0, 0);
+    m_qListStreamDipoles.clear();
+    m_iStreamWindowCount = 0;
+}
+
+
+//*************************************************************************************************************
+
+void RapMusic::setSinglePrecision(bool p_bSinglePrecision)
+{
+    m_bSinglePrecision = p_bSinglePrecision;
+    updateGainStorage();
+}
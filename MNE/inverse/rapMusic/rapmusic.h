@@ -44,6 +44,7 @@
 #include "../IInverseAlgorithm.h"
 
 #include "dipole.h"
+#include "rapmusicscan.h"
 
 #include <mne/mne_forwardsolution.h>
 #include <mne/mne_sourceestimate.h>
@@ -87,6 +88,11 @@ using namespace MNELIB;
 #define NOT_TRANSPOSED   0  /**< Defines NOT_TRANSPOSED */
 #define IS_TRANSPOSED   1   /**< Defines IS_TRANSPOSED */
 
+#define STREAM_SUBSPACE_MAX_ITER    10      /**< Maximal number of orthogonal iterations per streaming window */
+#define STREAM_SUBSPACE_TOL         1e-6    /**< Subspace change below which the orthogonal iteration has settled */
+#define STREAM_RESCAN_RATIO         0.5     /**< Fraction of the previous correlation below which a warm started search is repeated from scratch */
+#define STREAM_RESCAN_INTERVAL      20      /**< Number of streaming windows after which the search is started from scratch */
+
 
 //=============================================================================================================
 /**
@@ -153,7 +159,8 @@ public:
 
     //=========================================================================================================
     /**
-    * Initializes the RAP MUSIC algorithm with the given model.
+    * Initializes the RAP MUSIC algorithm with the given model. A forward solution holding its gain matrix in single
+    * precision (MNEForwardSolution::sol_float) switches this instance to single precision storage.
     *
     * @param[in] p_Fwd          The model which contains the gain matrix and its corresponding Grid matrix.
     * @param[in] p_bSparsed     True when sparse matrices should be used.
@@ -183,7 +190,133 @@ public:
     */
     void setStcAttr(int p_iSampStcWin, float p_fStcOverlap);
 
+    //=========================================================================================================
+    /**
+    * Sets single precision storage of the gain matrix. The gain matrix is kept as float and this instance releases
+    * its reference to the double precision gain of the forward solution; the projection of the gain matrix is
+    * computed and stored in float, as are the Gram products of the pair scan (see RapMusicScan). The 6 x 6
+    * subproblems of the dipole pairs are solved in double.
+    * The float copy is converted from the loaded double precision gain, so the peak memory isn't reduced; pass a
+    * forward solution read in single precision (see MNEForwardSolution::read) to init to avoid the double copy.
+    * Switching back to double precision restores the gain matrix from the float copy.
+    *
+    * @param[in] p_bSinglePrecision     Whether to store and project the gain matrix in single precision.
+    */
+    void setSinglePrecision(bool p_bSinglePrecision);
+
+    //=========================================================================================================
+    /**
+    * Returns whether the gain matrix is stored in single precision.
+    *
+    * @return true if single precision storage is set
+    */
+    inline bool isSinglePrecision() const;
+
+    //=========================================================================================================
+    /**
+    * Sets the streaming mode, which is used by calculateInverse(const FiffEvoked&) for overlapping localization
+    * windows (see setStcAttr). Instead of a full SVD per window, F*F^T is updated by adding the samples which
+    * enter the window and removing those which leave it, and the signal subspace is tracked by orthogonal
+    * iterations starting at the subspace of the previous window until it settles. Windows which don't overlap
+    * their predecessor get a full eigendecomposition. The search of each window starts at the dipole pairs of
+    * the previous window, also across consecutive calls. It is repeated from scratch when the correlation of a
+    * warm started pair falls below the threshold or far below its previous correlation, and every
+    * STREAM_RESCAN_INTERVAL windows. Sets back the streaming state.
+    *
+    * @param[in] p_bStreaming       Whether to use the streaming mode.
+    * @param[in] p_iSubspaceDim     Dimension of the tracked signal subspace (default -1 = number of sources to find).
+    */
+    void setStreaming(bool p_bStreaming, int p_iSubspaceDim = -1);
+
+    //=========================================================================================================
+    /**
+    * Returns whether the streaming mode is set.
+    *
+    * @return true if the streaming mode is set
+    */
+    inline bool isStreaming() const;
+
+    //=========================================================================================================
+    /**
+    * Sets back the streaming state: the tracked signal subspace and the dipole pairs of the previous window.
+    */
+    void resetStreaming();
+
 protected:
+    //=========================================================================================================
+    /**
+    * Streaming version of calculateInverse(const FiffEvoked&), see setStreaming.
+    *
+    * @param[in] p_fiffEvoked   The evoked data.
+    *
+    * @return the source estimate.
+    */
+    MNESourceEstimate calculateInverseStreaming(const FiffEvoked &p_fiffEvoked);
+
+    //=========================================================================================================
+    /**
+    * Updates the tracked signal subspace with the current F*F^T (m_matStreamCov).
+    *
+    * @param[out] p_matPhi_s    The signal subspace.
+    * @param[in] p_bNewWindow   Whether the window doesn't overlap the previous one -> full eigendecomposition.
+    *
+    * @return   The rank of the signal subspace.
+    */
+    int trackSignalSubspace(MatrixXT& p_matPhi_s, bool p_bNewWindow);
+
+    //=========================================================================================================
+    /**
+    * Searches the sources of the given signal subspace.
+    *
+    * @param[in] p_matPhi_s     The signal subspace.
+    * @param[out] p_RapDipoles  The list of the found dipole pairs.
+    * @param[in] p_WarmStart    Dipole pairs at which the searches of the corresponding iterations start. A warm
+    *                           started search which loses its correlation is repeated from scratch.
+    */
+    void searchSources(const MatrixXT& p_matPhi_s, QList< DipolePair<double> > &p_RapDipoles, const QList< DipolePair<double> > &p_WarmStart = QList< DipolePair<double> >()) const;
+
+    //=========================================================================================================
+    /**
+    * Searches the maximal correlated dipole pair. RAP MUSIC scans all pairs, a given start pair is tracked by a
+    * local search.
+    *
+    * @param[in] p_scan             The correlation scan of the projected gain matrix.
+    * @param[in, out] p_iIdx1       The first dipole of the start pair (-1 = none), returns the first dipole of the found pair.
+    * @param[in, out] p_iIdx2       The second dipole of the start pair (-1 = none), returns the second dipole of the found pair.
+    *
+    * @return the correlation of the found pair.
+    */
+    virtual double searchPair(const RapMusicScan& p_scan, int& p_iIdx1, int& p_iIdx2) const;
+
+    //=========================================================================================================
+    /**
+    * Moves the gain matrix of m_ForwardSolution to the storage selected by m_bSinglePrecision.
+    */
+    void updateGainStorage();
+
+    //=========================================================================================================
+    /**
+    * Projects the gain matrix with an orthogonal projector, in the precision of the gain matrix storage.
+    *
+    * @param[in] p_matOrthProj      The orthogonal projector.
+    * @param[out] p_matProj         The projected gain matrix (double precision storage).
+    * @param[out] p_matProjFloat    The projected gain matrix (single precision storage).
+    */
+    void projectGainMatrix(const MatrixXT& p_matOrthProj, MatrixXT& p_matProj, MatrixXf& p_matProjFloat) const;
+
+    //=========================================================================================================
+    /**
+    * Returns the gain matrix pair of the given indices of the gain matrix or of its projection
+    * (see projectGainMatrix), in the precision of the gain matrix storage.
+    *
+    * @param[in] p_matGain          The gain matrix (double precision storage).
+    * @param[in] p_matGainFloat     The gain matrix (single precision storage).
+    * @param[out] p_matGainPair     Gain matrix combination (dimension: m x 6)
+    * @param[in] p_iIdx1            first gain matrix index point
+    * @param[in] p_iIdx2            second gain matrix index point
+    */
+    inline void gainMatrixPair(const MatrixXT& p_matGain, const MatrixXf& p_matGainFloat, MatrixX6T& p_matGainPair, int p_iIdx1, int p_iIdx2) const;
+
     //=========================================================================================================
     /**
     * Computes the signal subspace Phi_s out of the measurement F.
@@ -298,6 +431,19 @@ protected:
                                     MatrixX6T& p_matGainMarix_Pair,
                                     int p_iIdx1, int p_iIdx2);
 
+    //=========================================================================================================
+    /**
+    * Returns a gain matrix pair for the given indices of a single precision gain matrix, see above.
+    *
+    * @param[in]    p_matGainMarix The Lead Field matrix.
+    * @param[out]   p_matGainMarix_Pair   Lead Field combination (dimension: m x 6)
+    * @param[in]    p_iIdx1 first Lead Field index point
+    * @param[in]    p_iIdx2 second Lead Field index point
+    */
+    static void getGainMatrixPair(  const MatrixXf& p_matGainMarix,
+                                    MatrixX6T& p_matGainMarix_Pair,
+                                    int p_iIdx1, int p_iIdx2);
+
     //=========================================================================================================
     /**
     * Adds a new correlated dipole pair to th RapDipoles. This function is called by the RAP MUSIC Algorithm.
@@ -330,6 +476,16 @@ protected:
 
     bool m_bIsInit; /**< Wether the algorithm is initialized. */
 
+    bool m_bSinglePrecision;    /**< Whether the gain matrix is stored in single precision. */
+    MatrixXf m_matGainFloat;    /**< Single precision gain matrix, replaces m_ForwardSolution.sol->data if m_bSinglePrecision is set. */
+
+    bool m_bStreaming;                                  /**< Whether the streaming mode is set. */
+    int m_iSubspaceDim;                                 /**< Dimension of the tracked signal subspace (-1 = m_iN). */
+    MatrixXT m_matStreamCov;                            /**< F*F^T of the current streaming window. */
+    MatrixXT m_matStreamBasis;                          /**< Tracked signal subspace basis. */
+    QList< DipolePair<double> > m_qListStreamDipoles;   /**< Dipole pairs of the previous streaming window. */
+    int m_iStreamWindowCount;                           /**< Number of streaming windows since the last search from scratch. */
+
     //Stc stuff
     int m_iSamplesStcWindow;    /**< Number of samples per localization window */
     float m_fStcOverlap;        /**< Percentage of localization window overlap */
@@ -417,6 +573,33 @@ inline RapMusic::MatrixXT RapMusic::makeSquareMat(const MatrixXT& p_matF)
     return p_matF*p_matF.transpose();
 }
 
+
+//*************************************************************************************************************
+
+inline bool RapMusic::isSinglePrecision() const
+{
+    return m_bSinglePrecision;
+}
+
+
+//*************************************************************************************************************
+
+inline bool RapMusic::isStreaming() const
+{
+    return m_bStreaming;
+}
+
+
+//*************************************************************************************************************
+
+inline void RapMusic::gainMatrixPair(const MatrixXT& p_matGain, const MatrixXf& p_matGainFloat, MatrixX6T& p_matGainPair, int p_iIdx1, int p_iIdx2) const
+{
+    if(m_bSinglePrecision)
+        RapMusic::getGainMatrixPair(p_matGainFloat, p_matGainPair, p_iIdx1, p_iIdx2);
+    else
+        RapMusic::getGainMatrixPair(p_matGain, p_matGainPair, p_iIdx1, p_iIdx2);
+}
+
 } //NAMESPACE
 
 #endif // RAPMUSIC_H
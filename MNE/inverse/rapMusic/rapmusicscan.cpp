@@ -0,0 +1,342 @@
+//=============================================================================================================
+/**
+* @file     rapmusicscan.cpp
+* @author   MNE-CPP authors
+* @version  1.0
+* @date     October, 2026
+*
+* @section  LICENSE
+*
+* Copyright (C) 2026, MNE-CPP authors. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Implementation of the RapMusicScan Class.
+*
+*/
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "rapmusicscan.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Eigenvalues>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace INVERSELIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC DEFINITIONS
+//=============================================================================================================
+
+#define SCAN_TILE_SIZE 64   /**< Number of dipoles per tile of the pair scan. */
+
+namespace
+{
+
+typedef Matrix<double, 6, 6> Matrix6d;
+
+} // anonymous namespace
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+RapMusicScan::RapMusicScan()
+: m_pMatProjGain(NULL)
+, m_pMatProjGainFloat(NULL)
+, m_iNumDipoles(0)
+{
+}
+
+
+//*************************************************************************************************************
+
+void RapMusicScan::init(const MatrixXd& p_matProjGain, const MatrixXd& p_matU_B)
+{
+    m_pMatProjGain = &p_matProjGain;
+    m_pMatProjGainFloat = NULL;
+    initCache(p_matProjGain, p_matU_B);
+}
+
+
+//*************************************************************************************************************
+
+void RapMusicScan::init(const MatrixXf& p_matProjGain, const MatrixXd& p_matU_B)
+{
+    m_pMatProjGain = NULL;
+    m_pMatProjGainFloat = &p_matProjGain;
+    initCache(p_matProjGain, p_matU_B);
+}
+
+
+//*************************************************************************************************************
+
+template<typename T>
+void RapMusicScan::initCache(const Matrix<T, Dynamic, Dynamic>& p_matProjGain, const MatrixXd& p_matU_B)
+{
+    m_iNumDipoles = p_matProjGain.cols()/3;
+
+    Matrix<T, Dynamic, Dynamic> t_matU_B = p_matU_B.cast<T>();
+    m_matGU_B = (p_matProjGain.transpose() * t_matU_B).template cast<double>();
+
+    m_matGram.resize(3, 3*m_iNumDipoles);
+    m_matGU_BBt.resize(3, 3*m_iNumDipoles);
+    for(int i = 0; i < m_iNumDipoles; ++i)
+    {
+        m_matGram.block<3,3>(0, 3*i) = (p_matProjGain.middleCols(3*i, 3).transpose() * p_matProjGain.middleCols(3*i, 3)).template cast<double>();
+        m_matGU_BBt.block<3,3>(0, 3*i) = m_matGU_B.middleRows(3*i, 3) * m_matGU_B.middleRows(3*i, 3).transpose();
+    }
+}
+
+
+//*************************************************************************************************************
+
+void RapMusicScan::crossGram(int p_iFirst1, int p_iNum1, int p_iFirst2, int p_iNum2, MatrixXd& p_matCross) const
+{
+    if(m_pMatProjGainFloat)
+        p_matCross = (m_pMatProjGainFloat->middleCols(3*p_iFirst1, 3*p_iNum1).transpose() *
+                      m_pMatProjGainFloat->middleCols(3*p_iFirst2, 3*p_iNum2)).cast<double>();
+    else
+        p_matCross.noalias() = m_pMatProjGain->middleCols(3*p_iFirst1, 3*p_iNum1).transpose() *
+                               m_pMatProjGain->middleCols(3*p_iFirst2, 3*p_iNum2);
+}
+
+
+//*************************************************************************************************************
+
+void RapMusicScan::scan(VectorXd& p_vecRoh, int p_iNumThreads) const
+{
+    p_vecRoh = VectorXd::Zero(m_iNumDipoles*(m_iNumDipoles+1)/2);
+
+    int t_iNumTiles = (m_iNumDipoles + SCAN_TILE_SIZE - 1)/SCAN_TILE_SIZE;
+    int t_iNumTilePairs = t_iNumTiles*(t_iNumTiles+1)/2;
+
+    Q_UNUSED(p_iNumThreads);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(p_iNumThreads)
+    #endif
+    for(int t = 0; t < t_iNumTilePairs; ++t)
+    {
+        //tile pairs are ordered like the dipole pairs (upper triangle including the diagonal)
+        int ii = t_iNumTiles*(t_iNumTiles+1)/2-1-t;
+        int K = (int)floor((sqrt((double)(8*ii+1))-1)/2);
+        int t_iTile1 = t_iNumTiles-1-K;
+        int t_iTile2 = (t-t_iNumTiles*(t_iNumTiles+1)/2 + (K+1)*(K+2)/2)+t_iTile1;
+
+        int t_iFirst1 = t_iTile1*SCAN_TILE_SIZE;
+        int t_iNum1 = std::min(SCAN_TILE_SIZE, m_iNumDipoles - t_iFirst1);
+        int t_iFirst2 = t_iTile2*SCAN_TILE_SIZE;
+        int t_iNum2 = std::min(SCAN_TILE_SIZE, m_iNumDipoles - t_iFirst2);
+
+        MatrixXd t_matCross;
+        crossGram(t_iFirst1, t_iNum1, t_iFirst2, t_iNum2, t_matCross);
+
+        for(int i = 0; i < t_iNum1; ++i)
+        {
+            int t_iIdx1 = t_iFirst1 + i;
+            for(int j = (t_iTile1 == t_iTile2 ? i : 0); j < t_iNum2; ++j)
+            {
+                int t_iIdx2 = t_iFirst2 + j;
+                p_vecRoh(pairIndex(m_iNumDipoles, t_iIdx1, t_iIdx2)) = pairCorrelation(t_iIdx1, t_iIdx2, t_matCross.block<3,3>(3*i, 3*j));
+            }
+        }
+    }
+}
+
+
+//*************************************************************************************************************
+
+double RapMusicScan::correlation(int p_iIdx1, int p_iIdx2) const
+{
+    MatrixXd t_matCross;
+    crossGram(p_iIdx1, 1, p_iIdx2, 1, t_matCross);
+
+    return pairCorrelation(p_iIdx1, p_iIdx2, t_matCross);
+}
+
+
+//*************************************************************************************************************
+
+double RapMusicScan::localSearch(int& p_iIdx1, int& p_iIdx2, int p_iNumThreads) const
+{
+    //Rows which were already scanned -> their pairs with the following rows are known
+    std::vector<VectorXd> t_vecRows;
+    std::vector<int> t_vecRowIdx(m_iNumDipoles, -1);
+
+    int t_iRow = p_iIdx1;
+    int t_iBest1 = p_iIdx1;
+    int t_iBest2 = p_iIdx2;
+    double t_dBest = -1;
+
+    while(t_vecRowIdx[t_iRow] < 0)
+    {
+        VectorXd t_vecRoh;
+        scanRow(t_iRow, t_vecRows, t_vecRowIdx, t_vecRoh, p_iNumThreads);
+
+        t_vecRowIdx[t_iRow] = (int)t_vecRows.size();
+        t_vecRows.push_back(t_vecRoh);
+
+        VectorXd::Index t_iIdxMax;
+        double t_dRoh = t_vecRoh.maxCoeff(&t_iIdxMax);
+
+        if(t_dRoh <= t_dBest)
+            break;
+
+        t_dBest = t_dRoh;
+        t_iBest1 = t_iRow;
+        t_iBest2 = (int)t_iIdxMax;
+
+        //continue with the pairs of the partner
+        t_iRow = t_iBest2;
+    }
+
+    p_iIdx1 = std::min(t_iBest1, t_iBest2);
+    p_iIdx2 = std::max(t_iBest1, t_iBest2);
+
+    return t_dBest;
+}
+
+
+//*************************************************************************************************************
+
+void RapMusicScan::scanRow(int p_iIdx, const std::vector<VectorXd>& p_vecRows, const std::vector<int>& p_vecRowIdx, VectorXd& p_vecRoh, int p_iNumThreads) const
+{
+    bool t_bMemo = !p_vecRowIdx.empty();
+
+    //cross Gram blocks of the row, one product per contiguous range of dipoles which weren't scanned yet,
+    //shared by all threads
+    MatrixXd t_matCross(3, 3*m_iNumDipoles);
+    MatrixXd t_matRange;
+    int t_iFirst = 0;
+    while(t_iFirst < m_iNumDipoles)
+    {
+        if(t_bMemo && p_vecRowIdx[t_iFirst] >= 0)
+        {
+            ++t_iFirst;
+            continue;
+        }
+
+        int t_iNum = 1;
+        while(t_iFirst + t_iNum < m_iNumDipoles && !(t_bMemo && p_vecRowIdx[t_iFirst + t_iNum] >= 0))
+            ++t_iNum;
+
+        crossGram(p_iIdx, 1, t_iFirst, t_iNum, t_matRange);
+        t_matCross.middleCols(3*t_iFirst, 3*t_iNum) = t_matRange;
+
+        t_iFirst += t_iNum;
+    }
+
+    p_vecRoh.resize(m_iNumDipoles);
+
+    Q_UNUSED(p_iNumThreads);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for num_threads(p_iNumThreads)
+    #endif
+    for(int j = 0; j < m_iNumDipoles; ++j)
+    {
+        if(t_bMemo && p_vecRowIdx[j] >= 0)
+            p_vecRoh(j) = p_vecRows[p_vecRowIdx[j]](p_iIdx);
+        else
+            p_vecRoh(j) = pairCorrelation(p_iIdx, j, t_matCross.block<3,3>(0, 3*j));
+    }
+}
+
+
+//*************************************************************************************************************
+
+double RapMusicScan::pairCorrelation(int p_iIdx1, int p_iIdx2, const Matrix3d& p_matCrossIJ) const
+{
+    //Gram matrix of the pair G = [G_i G_j]
+    Matrix6d t_matH;
+    t_matH.topLeftCorner<3,3>() = m_matGram.block<3,3>(0, 3*p_iIdx1);
+    t_matH.topRightCorner<3,3>() = p_matCrossIJ;
+    t_matH.bottomLeftCorner<3,3>() = p_matCrossIJ.transpose();
+    t_matH.bottomRightCorner<3,3>() = m_matGram.block<3,3>(0, 3*p_iIdx2);
+
+    //G^T G = V Lambda V^T -> U_A = G V Lambda^-1/2; eigenvalues are in increasing order
+    SelfAdjointEigenSolver<Matrix6d> t_eigH(t_matH);
+    const Matrix<double, 6, 1>& t_vecLambda = t_eigH.eigenvalues();
+
+    if(t_vecLambda(5) <= 0)
+        return 0;
+
+    //lt. Mosher 1998: Only Retain those Components of U_A that correspond to nonzero singular values (see RapMusic::getRank)
+    int t_iRank;
+    for(t_iRank = 5; t_iRank > 0; --t_iRank)
+        if(t_vecLambda(5-t_iRank) > 0 && sqrt(t_vecLambda(5-t_iRank)) > 0.00001)
+            break;
+    ++t_iRank;
+
+    //G^T U_B U_B^T G
+    Matrix3d t_matPij = m_matGU_B.middleRows<3>(3*p_iIdx1) * m_matGU_B.middleRows<3>(3*p_iIdx2).transpose();
+    Matrix6d t_matP;
+    t_matP.topLeftCorner<3,3>() = m_matGU_BBt.block<3,3>(0, 3*p_iIdx1);
+    t_matP.topRightCorner<3,3>() = t_matPij;
+    t_matP.bottomLeftCorner<3,3>() = t_matPij.transpose();
+    t_matP.bottomRightCorner<3,3>() = m_matGU_BBt.block<3,3>(0, 3*p_iIdx2);
+
+    //C = U_A^T U_B = Lambda^-1/2 V^T G^T U_B -> the squared largest singular value of C is the largest
+    //eigenvalue of C C^T = W^T P W with W = V Lambda^-1/2, restricted to the retained components
+    Matrix6d t_matW = Matrix6d::Zero();
+    for(int k = 6-t_iRank; k < 6; ++k)
+        t_matW.col(k) = t_eigH.eigenvectors().col(k) / sqrt(t_vecLambda(k));
+
+    Matrix6d t_matCCt = t_matW.transpose() * t_matP * t_matW;
+
+    SelfAdjointEigenSolver<Matrix6d> t_eigC(t_matCCt, EigenvaluesOnly);
+    double t_dSigma2 = t_eigC.eigenvalues()(5);
+
+    return t_dSigma2 > 0 ? sqrt(t_dSigma2) : 0;
+}
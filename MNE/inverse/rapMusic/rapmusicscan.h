@@ -0,0 +1,254 @@
+//=============================================================================================================
+/**
+* @file     rapmusicscan.h
+* @author   MNE-CPP authors
+* @version  1.0
+* @date     October, 2026
+*
+* @section  LICENSE
+*
+* Copyright (C) 2026, MNE-CPP authors. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    RapMusicScan class declaration.
+*
+*/
+
+#ifndef RAPMUSICSCAN_H
+#define RAPMUSICSCAN_H
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "../inverse_global.h"
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <vector>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE NAMESPACE INVERSELIB
+//=============================================================================================================
+
+namespace INVERSELIB
+{
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+
+
+//=============================================================================================================
+/**
+* Scans the subspace correlations of all dipole pairs of a projected gain matrix. The correlation of a pair
+* (i,j) is the largest singular value of U_A^T * U_B, with U_A the orthonormal basis of the m x 6 pair block
+* G = [G_i G_j]. It only depends on the Gram matrix G^T * G and on G^T * U_B, which are assembled from cached
+* 3 x 3 blocks G_i^T * G_j and 3 x r blocks G_i^T * U_B. Each pair is thus solved as a 6 x 6 eigenproblem
+* without copying m-length columns. The cross Gram blocks are computed tile by tile, one matrix product per
+* pair of dipole tiles.
+*
+* The projected gain matrix is referenced, not copied, and has to outlive the scan.
+*
+* @brief Gram block subspace correlation scan of RAP MUSIC dipole pairs.
+*/
+class INVERSESHARED_EXPORT RapMusicScan
+{
+public:
+
+    //=========================================================================================================
+    /**
+    * Default constructor creates an empty scan which still needs to be initialized.
+    */
+    RapMusicScan();
+
+    //=========================================================================================================
+    /**
+    * Initializes the scan with a double precision projected gain matrix.
+    *
+    * @param[in] p_matProjGain  The projected gain matrix (m x 3N).
+    * @param[in] p_matU_B       The orthonormal basis of the projected signal subspace (m x r).
+    */
+    void init(const MatrixXd& p_matProjGain, const MatrixXd& p_matU_B);
+
+    //=========================================================================================================
+    /**
+    * Initializes the scan with a single precision projected gain matrix. The Gram products are computed in
+    * single precision, the 6 x 6 subproblems are solved in double precision.
+    *
+    * @param[in] p_matProjGain  The projected gain matrix (m x 3N).
+    * @param[in] p_matU_B       The orthonormal basis of the projected signal subspace (m x r).
+    */
+    void init(const MatrixXf& p_matProjGain, const MatrixXd& p_matU_B);
+
+    //=========================================================================================================
+    /**
+    * Returns the number of dipoles.
+    *
+    * @return the number of dipoles N.
+    */
+    inline int numDipoles() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the index of the pair (i,j), i <= j, in the pair list of RapMusic::calcPairCombinations.
+    *
+    * @param[in] p_iPoints  The number of dipoles N.
+    * @param[in] p_iIdx1    Index of the first dipole.
+    * @param[in] p_iIdx2    Index of the second dipole.
+    *
+    * @return the pair index.
+    */
+    static inline int pairIndex(int p_iPoints, int p_iIdx1, int p_iIdx2);
+
+    //=========================================================================================================
+    /**
+    * Computes the subspace correlations of all N(N+1)/2 dipole pairs.
+    *
+    * @param[out] p_vecRoh          The correlations, ordered like the pair list of RapMusic::calcPairCombinations.
+    * @param[in] p_iNumThreads      The number of threads to use.
+    */
+    void scan(VectorXd& p_vecRoh, int p_iNumThreads = 1) const;
+
+    //=========================================================================================================
+    /**
+    * Computes the subspace correlation of a single dipole pair.
+    *
+    * @param[in] p_iIdx1    Index of the first dipole.
+    * @param[in] p_iIdx2    Index of the second dipole.
+    *
+    * @return the subspace correlation of the pair.
+    */
+    double correlation(int p_iIdx1, int p_iIdx2) const;
+
+    //=========================================================================================================
+    /**
+    * Searches a local maximum of the pair correlations, starting at the given pair. The pairs of one dipole are
+    * scanned, the search then continues with the partner of the maximal correlated pair until the correlation
+    * doesn't increase anymore (Powell search). The correlations of the scanned dipoles are kept, so that pairs
+    * which were already visited aren't evaluated again.
+    *
+    * @param[in, out] p_iIdx1       The first dipole of the start pair, returns the first dipole of the found pair.
+    * @param[in, out] p_iIdx2       The second dipole of the start pair, returns the second dipole of the found pair.
+    * @param[in] p_iNumThreads      The number of threads to use.
+    *
+    * @return the subspace correlation of the found pair.
+    */
+    double localSearch(int& p_iIdx1, int& p_iIdx2, int p_iNumThreads = 1) const;
+
+private:
+    //=========================================================================================================
+    /**
+    * Computes the subspace correlations of all pairs which contain the given dipole. Pairs with already scanned
+    * dipoles are copied; the cross Gram blocks of the remaining dipoles are computed with one matrix product per
+    * contiguous range of them and shared by all threads.
+    *
+    * @param[in] p_iIdx             Index of the dipole.
+    * @param[in] p_vecRows          Correlations of already scanned dipoles.
+    * @param[in] p_vecRowIdx        Position of each dipole in p_vecRows (-1 = not scanned), or empty.
+    * @param[out] p_vecRoh          The correlations of the pairs (p_iIdx, j).
+    * @param[in] p_iNumThreads      The number of threads to use.
+    */
+    void scanRow(int p_iIdx, const std::vector<VectorXd>& p_vecRows, const std::vector<int>& p_vecRowIdx, VectorXd& p_vecRoh, int p_iNumThreads) const;
+
+    //=========================================================================================================
+    /**
+    * Caches the diagonal Gram blocks and the U_B products of all dipoles.
+    *
+    * @param[in] p_matProjGain  The projected gain matrix (m x 3N).
+    * @param[in] p_matU_B       The orthonormal basis of the projected signal subspace (m x r).
+    */
+    template<typename T>
+    void initCache(const Matrix<T, Dynamic, Dynamic>& p_matProjGain, const MatrixXd& p_matU_B);
+
+    //=========================================================================================================
+    /**
+    * Computes the cross Gram block G_I^T * G_J of two dipole ranges.
+    *
+    * @param[in] p_iFirst1      First dipole of range I.
+    * @param[in] p_iNum1        Number of dipoles of range I.
+    * @param[in] p_iFirst2      First dipole of range J.
+    * @param[in] p_iNum2        Number of dipoles of range J.
+    * @param[out] p_matCross    The cross Gram block (3 p_iNum1 x 3 p_iNum2).
+    */
+    void crossGram(int p_iFirst1, int p_iNum1, int p_iFirst2, int p_iNum2, MatrixXd& p_matCross) const;
+
+    //=========================================================================================================
+    /**
+    * Solves the 6 x 6 subproblem of the pair (i,j).
+    *
+    * @param[in] p_iIdx1        Index of the first dipole.
+    * @param[in] p_iIdx2        Index of the second dipole.
+    * @param[in] p_matCrossIJ   The cross Gram block G_i^T * G_j (3 x 3).
+    *
+    * @return the subspace correlation of the pair.
+    */
+    double pairCorrelation(int p_iIdx1, int p_iIdx2, const Matrix3d& p_matCrossIJ) const;
+
+    const MatrixXd* m_pMatProjGain;         /**< The referenced double precision projected gain matrix. */
+    const MatrixXf* m_pMatProjGainFloat;    /**< The referenced single precision projected gain matrix. */
+
+    int m_iNumDipoles;      /**< Number of dipoles N. */
+    MatrixXd m_matGram;     /**< Diagonal Gram blocks G_i^T * G_i (3 x 3N). */
+    MatrixXd m_matGU_B;     /**< U_B products G^T * U_B (3N x r). */
+    MatrixXd m_matGU_BBt;   /**< Diagonal blocks G_i^T * U_B * U_B^T * G_i (3 x 3N). */
+};
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline int RapMusicScan::numDipoles() const
+{
+    return m_iNumDipoles;
+}
+
+
+//*************************************************************************************************************
+
+inline int RapMusicScan::pairIndex(int p_iPoints, int p_iIdx1, int p_iIdx2)
+{
+    //rows of the upper triangle before p_iIdx1 hold p_iPoints, p_iPoints-1, ... pairs
+    return p_iIdx1*p_iPoints - p_iIdx1*(p_iIdx1-1)/2 + (p_iIdx2 - p_iIdx1);
+}
+
+} //NAMESPACE
+
+#endif // RAPMUSICSCAN_H
@@ -46,6 +46,7 @@
 
 #include "mne_inverse_operator.h"
 #include "mne_forwardsolution.h"
+#include "mne_forwardsolution_view.h"
 #include "mne_hemisphere.h"
 #include "mne_sourcespace.h"
 #include "mne_surface.h"
@@ -88,6 +88,7 @@ SOURCES += \
     mne.cpp \
     mne_sourcespace.cpp \
     mne_forwardsolution.cpp \
+    mne_forwardsolution_view.cpp \
     mne_sourceestimate.cpp \
     mne_hemisphere.cpp \
     mne_inverse_operator.cpp \
@@ -105,6 +106,7 @@ HEADERS += \
     mne_sourcespace.h \
     mne_hemisphere.h \
     mne_forwardsolution.h \
+    mne_forwardsolution_view.h \
     mne_sourceestimate.h \
     mne_inverse_operator.h \
     mne_epoch_data.h \
@@ -72,6 +72,73 @@ MNEEpochDataList::~MNEEpochDataList()
 }
 
 
+//*************************************************************************************************************
+
+MNEEpochDataList MNEEpochDataList::readEpochs(FiffRawData& raw, const MatrixXi& events, float tmin, float tmax, qint32 event, const RowVectorXi& picks)
+{
+    MNEEpochDataList data;
+
+    //
+    //    Select the desired events
+    //
+    qint32 p, count = 0;
+    RowVectorXi selected(events.rows());
+    for (p = 0; p < events.rows(); ++p)
+    {
+        if (events(p,1) == 0 && events(p,2) == event)
+        {
+            selected[count] = p;
+            ++count;
+        }
+    }
+
+    if (count == 0)
+    {
+        printf("No desired events found.\n");
+        return data;
+    }
+    printf("%d matching events found\n",count);
+
+    //
+    //    Read all segments in one pass
+    //
+    RowVectorXi from(count), to(count);
+    fiff_int_t event_samp;
+    for (p = 0; p < count; ++p)
+    {
+        event_samp = events(selected[p],0);
+        from[p] = event_samp + tmin*raw.info.sfreq;
+        to[p]   = event_samp + floor(tmax*raw.info.sfreq + 0.5);
+    }
+
+    QList<MatrixXd> t_qListSegments;
+    if (!raw.read_raw_segments(t_qListSegments, from, to, picks))
+    {
+        printf("Can't read the event data segments\n");
+        return data;
+    }
+
+    for (p = 0; p < count; ++p)
+    {
+        if (t_qListSegments[p].size() == 0)
+            continue;
+
+        MNEEpochData::SPtr epoch(new MNEEpochData());
+        epoch->epoch = t_qListSegments[p];
+        epoch->event = event;
+        epoch->tmin = ((float)(from[p])-(float)(raw.first_samp))/raw.info.sfreq;
+        epoch->tmax = ((float)(to[p])-(float)(raw.first_samp))/raw.info.sfreq;
+        data.append(epoch);
+
+        t_qListSegments[p] = MatrixXd();
+    }
+
+    printf("%d epochs read\n", data.size());
+
+    return data;
+}
+
+
 //*************************************************************************************************************
 
 FiffEvoked MNEEpochDataList::average(FiffInfo& info, fiff_int_t first, fiff_int_t last, VectorXi sel, bool proj)
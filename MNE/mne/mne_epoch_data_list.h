@@ -43,6 +43,7 @@
 
 #include <fiff/fiff_types.h>
 #include <fiff/fiff_evoked.h>
+#include <fiff/fiff_raw_data.h>
 
 
 //*************************************************************************************************************
@@ -101,6 +102,23 @@ public:
     */
     ~MNEEpochDataList();
 
+    //=========================================================================================================
+    /**
+    * Reads the epochs of all matching events in a single pass over the raw data (see
+    * FiffRawData::read_raw_segments). Buffers shared by neighbouring epochs are read and decoded only once.
+    * Epochs which are not completely within the raw data are omitted.
+    *
+    * @param[in] raw        the raw data
+    * @param[in] events     event matrix (sample, previous value, new value) per row
+    * @param[in] tmin       start time of the epochs relative to the event in seconds
+    * @param[in] tmax       end time of the epochs relative to the event in seconds
+    * @param[in] event      event code of the epochs to read
+    * @param[in] picks      channel selection vector (optional)
+    *
+    * @return the epochs
+    */
+    static MNEEpochDataList readEpochs(FiffRawData& raw, const MatrixXi& events, float tmin, float tmax, qint32 event, const RowVectorXi& picks = defaultRowVectorXi);
+
     //=========================================================================================================
     /**
     * Averages epoch list.
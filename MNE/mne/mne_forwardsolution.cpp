@@ -39,6 +39,7 @@
 //=============================================================================================================
 
 #include "mne_forwardsolution.h"
+#include "mne_forwardsolution_view.h"
 
 
 //*************************************************************************************************************
@@ -58,10 +59,19 @@
 //=============================================================================================================
 
 #include <iostream>
+#include <algorithm>
 #include <QtConcurrent>
 #include <QFuture>
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Eigenvalues>
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // USED NAMESPACES
@@ -72,6 +82,147 @@ using namespace UTILSLIB;
 using namespace FSLIB;
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC DEFINITIONS
+//=============================================================================================================
+
+#define SOURCE_BLOCK_SIZE 256   /**< Sources processed by one thread in the per-source forward operations. */
+
+namespace
+{
+
+//=============================================================================================================
+/**
+* Sources of a free-orientation gain matrix processed by one thread when computing the depth weighting. For every
+* source k the largest eigenvalue of the 3x3 matrix G_k'G_k is computed.
+*/
+struct DepthPriorBlock
+{
+    const MatrixXd* pGain;      /**< Gain matrix, three columns per source */
+    VectorXd*       pD;         /**< Largest eigenvalue per source, each block writes its own segment */
+    qint32          iFirst;     /**< First source of the block */
+    qint32          iSources;   /**< Number of sources of the block */
+
+    void compute()
+    {
+        Matrix3d t_matGtG;
+        SelfAdjointEigenSolver<Matrix3d> t_eigSolver;
+        for(qint32 k = iFirst; k < iFirst + iSources; ++k)
+        {
+            t_matGtG.noalias() = pGain->middleCols<3>(3*k).transpose() * pGain->middleCols<3>(3*k);
+            t_eigSolver.computeDirect(t_matGtG, EigenvaluesOnly);
+            (*pD)[k] = t_eigSolver.eigenvalues().maxCoeff();
+        }
+    }
+};
+
+
+//=============================================================================================================
+/**
+* Sources of a forward matrix processed by one thread when rotating it into the source orientation frames. Source k
+* occupies 3*iComp input columns, ordered (orientation, component), iComp being 1 for sol and 3 for sol_grad. The
+* input columns of one component are read as a nchan x 3 map and multiplied by the 3x3 surface frame (surf_ori) or
+* by the 3x1 normal (fixed orientation). This is the same as multiplying with the block diagonal rotation matrix.
+* T is double for sol->data and float for sol_float.
+*/
+template<typename T>
+struct SourceRotationBlock
+{
+    typedef Matrix<T, Dynamic, Dynamic> MatrixXT;  /**< Forward matrix type */
+
+    const MatrixXT*     pIn;        /**< Forward matrix in the cartesian source frames */
+    MatrixXT*           pOut;       /**< Rotated forward matrix, each block writes its own columns */
+    const MatrixX3f*    pOri;       /**< Source normals: 3 rows (frame) per source or 1 row (normal) per source */
+    bool                bFixed;     /**< Whether to project on the normal instead of rotating into the frame */
+    qint32              iComp;      /**< Components per orientation */
+    qint32              iFirst;     /**< First source of the block */
+    qint32              iSources;   /**< Number of sources of the block */
+
+    void compute()
+    {
+        const qint32 t_iRows = pIn->rows();
+        const qint32 t_iOutOri = bFixed ? 1 : 3;
+        Matrix<T, 3, 3> t_matFrame;
+        Matrix<T, 3, 1> t_vecNormal;
+        for(qint32 k = iFirst; k < iFirst + iSources; ++k)
+        {
+            if(bFixed)
+                t_vecNormal = pOri->row(k).transpose().template cast<T>();
+            else
+                t_matFrame = pOri->template block<3,3>(3*k, 0).transpose().template cast<T>();
+
+            for(qint32 b = 0; b < iComp; ++b)
+            {
+                Map<const Matrix<T, Dynamic, 3>, 0, OuterStride<> > t_matG(pIn->data() + (qint64)(3*k*iComp + b)*t_iRows, t_iRows, 3, OuterStride<>(iComp*t_iRows));
+                if(bFixed)
+                    pOut->col(k*iComp + b).noalias() = t_matG * t_vecNormal;
+                else
+                {
+                    Map<Matrix<T, Dynamic, 3>, 0, OuterStride<> > t_matGRot(pOut->data() + (qint64)(t_iOutOri*k*iComp + b)*t_iRows, t_iRows, 3, OuterStride<>(iComp*t_iRows));
+                    t_matGRot.noalias() = t_matG * t_matFrame;
+                }
+            }
+        }
+    }
+};
+
+
+//=============================================================================================================
+/**
+* Rotates a forward matrix into the source orientation frames, see SourceRotationBlock. The sources are split into
+* blocks of SOURCE_BLOCK_SIZE which are processed in parallel.
+*
+* @param[in] p_matIn    Forward matrix in the cartesian source frames
+* @param[in] p_matOri   Source frames (3 rows per source) or source normals (1 row per source)
+* @param[in] p_bFixed   Whether to project on the normals (fixed orientation) or to rotate into the frames
+* @param[in] p_iComp    Components per orientation, 1 for sol and 3 for sol_grad
+*
+* @return the rotated forward matrix
+*/
+template<typename T>
+Matrix<T, Dynamic, Dynamic> rotateSources(const Matrix<T, Dynamic, Dynamic>& p_matIn, const MatrixX3f& p_matOri, bool p_bFixed, qint32 p_iComp)
+{
+    qint32 t_iSources = p_matIn.cols() / (3*p_iComp);
+    Matrix<T, Dynamic, Dynamic> t_matOut(p_matIn.rows(), p_bFixed ? t_iSources*p_iComp : p_matIn.cols());
+
+    QList< SourceRotationBlock<T> > t_qListBlocks;
+    for(qint32 k = 0; k < t_iSources; k += SOURCE_BLOCK_SIZE)
+    {
+        SourceRotationBlock<T> t_block;
+        t_block.pIn = &p_matIn;
+        t_block.pOut = &t_matOut;
+        t_block.pOri = &p_matOri;
+        t_block.bFixed = p_bFixed;
+        t_block.iComp = p_iComp;
+        t_block.iFirst = k;
+        t_block.iSources = std::min((qint32)SOURCE_BLOCK_SIZE, t_iSources - k);
+        t_qListBlocks.append(t_block);
+    }
+    QtConcurrent::blockingMap(t_qListBlocks, &SourceRotationBlock<T>::compute);
+
+    return t_matOut;
+}
+
+
+//=============================================================================================================
+/**
+* Rotates the gain matrix of a forward solution, in the precision it is stored in (sol->data or sol_float).
+*
+* @param[in, out] p_fwd     Forward solution
+* @param[in] p_bFixed       Whether to project on the normals (fixed orientation) or to rotate into the frames
+*/
+void rotateGain(MNEForwardSolution& p_fwd, bool p_bFixed)
+{
+    if(p_fwd.isSinglePrecision())
+        p_fwd.sol_float = QSharedPointer<const MatrixXf>(new MatrixXf(rotateSources<float>(*p_fwd.sol_float, p_fwd.source_nn, p_bFixed, 1)));
+    else
+        p_fwd.sol->data = rotateSources<double>(p_fwd.sol->data, p_fwd.source_nn, p_bFixed, 1);
+}
+
+} // NAMESPACE
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -96,7 +247,7 @@ MNEForwardSolution::MNEForwardSolution()
 
 //*************************************************************************************************************
 
-MNEForwardSolution::MNEForwardSolution(QIODevice &p_IODevice, bool force_fixed, bool surf_ori, const QStringList& include, const QStringList& exclude, bool bExcludeBads)
+MNEForwardSolution::MNEForwardSolution(QIODevice &p_IODevice, bool force_fixed, bool surf_ori, const QStringList& include, const QStringList& exclude, bool bExcludeBads, bool single_precision)
 : source_ori(-1)
 , surf_ori(surf_ori)
 , coord_frame(-1)
@@ -109,7 +260,7 @@ MNEForwardSolution::MNEForwardSolution(QIODevice &p_IODevice, bool force_fixed,
 , source_rr(MatrixX3f::Zero(0,3))
 , source_nn(MatrixX3f::Zero(0,3))
 {
-    if(!read(p_IODevice, *this, force_fixed, surf_ori, include, exclude, bExcludeBads))
+    if(!read(p_IODevice, *this, force_fixed, surf_ori, include, exclude, bExcludeBads, single_precision))
     {
         printf("\tForward solution not found.\n");//ToDo Throw here
         return;
@@ -128,6 +279,7 @@ MNEForwardSolution::MNEForwardSolution(const MNEForwardSolution &p_MNEForwardSol
 , nchan(p_MNEForwardSolution.nchan)
 , sol(p_MNEForwardSolution.sol)
 , sol_grad(p_MNEForwardSolution.sol_grad)
+, sol_float(p_MNEForwardSolution.sol_float)
 , mri_head_t(p_MNEForwardSolution.mri_head_t)
 , src(p_MNEForwardSolution.src)
 , source_rr(p_MNEForwardSolution.source_rr)
@@ -157,6 +309,7 @@ void MNEForwardSolution::clear()
     nchan = -1;
     sol = FiffNamedMatrix::SDPtr(new FiffNamedMatrix());
     sol_grad = FiffNamedMatrix::SDPtr(new FiffNamedMatrix());
+    sol_float.clear();
     mri_head_t.clear();
     src.clear();
     source_rr = MatrixX3f(0,3);
@@ -277,12 +430,15 @@ MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const Annotation
                 idcs.conservativeResize(c);
 
                 //get selected G
-                MatrixXd t_G(this->sol->data.rows(), idcs.rows()*3);
+                MatrixXd t_G(this->gainRows(), idcs.rows()*3);
                 MatrixXd t_G_Whitened_Roi(t_G_Whitened.rows(), idcs.rows()*3);
 
                 for(qint32 j = 0; j < idcs.rows(); ++j)
                 {
-                    t_G.block(0, j*3, t_G.rows(), 3) = this->sol->data.block(0, (idcs[j]+offset)*3, t_G.rows(), 3);
+                    if(this->isSinglePrecision())
+                        t_G.block(0, j*3, t_G.rows(), 3) = this->sol_float->block(0, (idcs[j]+offset)*3, t_G.rows(), 3).cast<double>();
+                    else
+                        t_G.block(0, j*3, t_G.rows(), 3) = this->sol->data.block(0, (idcs[j]+offset)*3, t_G.rows(), 3);
                     if(t_bUseWhitened)
                         t_G_Whitened_Roi.block(0, j*3, t_G_Whitened_Roi.rows(), 3) = t_G_Whitened.block(0, (idcs[j]+offset)*3, t_G_Whitened_Roi.rows(), 3);
                 }
@@ -480,9 +636,9 @@ MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const Annotation
         totalNumOfClust += p_fwdOut.src[h].cluster_info.clusterVertnos.size();
 
     if(this->isFixedOrient())
-        p_D = MatrixXd::Zero(this->sol->data.cols(), totalNumOfClust);
+        p_D = MatrixXd::Zero(this->gainCols(), totalNumOfClust);
     else
-        p_D = MatrixXd::Zero(this->sol->data.cols(), totalNumOfClust*3);
+        p_D = MatrixXd::Zero(this->gainCols(), totalNumOfClust*3);
 
     QList<VectorXi> t_vertnos = this->src.get_vertno();
 
@@ -689,7 +845,10 @@ MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const Annotation
     //
     // Put it all together
     //
-    p_fwdOut.sol->data = t_G_new;
+    if(p_fwdOut.isSinglePrecision())
+        p_fwdOut.sol_float = QSharedPointer<const MatrixXf>(new MatrixXf(t_G_new.cast<float>()));
+    else
+        p_fwdOut.sol->data = t_G_new;
     p_fwdOut.sol->ncol = t_G_new.cols();
 
     p_fwdOut.nsource = p_fwdOut.sol->ncol/3;
@@ -705,7 +864,7 @@ MNEForwardSolution MNEForwardSolution::reduce_forward_solution(qint32 p_iNumDipo
     MNEForwardSolution p_fwdOut = MNEForwardSolution(*this);
 
     bool isFixed = p_fwdOut.isFixedOrient();
-    qint32 np = isFixed ? p_fwdOut.sol->data.cols() : p_fwdOut.sol->data.cols()/3;
+    qint32 np = isFixed ? p_fwdOut.gainCols() : p_fwdOut.gainCols()/3;
 
     if(p_iNumDipoles > np)
         return p_fwdOut;
@@ -722,13 +881,13 @@ MNEForwardSolution MNEForwardSolution::reduce_forward_solution(qint32 p_iNumDipo
 
     if(isFixed)
     {
-        p_D = MatrixXd::Zero(p_fwdOut.sol->data.cols(), p_iNumDipoles);
+        p_D = MatrixXd::Zero(p_fwdOut.gainCols(), p_iNumDipoles);
         for(qint32 i = 0; i < p_iNumDipoles; ++i)
             p_D(sel[i], i) = 1;
     }
     else
     {
-        p_D = MatrixXd::Zero(p_fwdOut.sol->data.cols(), p_iNumDipoles*3);
+        p_D = MatrixXd::Zero(p_fwdOut.gainCols(), p_iNumDipoles*3);
         for(qint32 i = 0; i < p_iNumDipoles; ++i)
             for(qint32 j = 0; j < 3; ++j)
                 p_D((sel[i]*3)+j, (i*3)+j) = 1;
@@ -782,7 +941,10 @@ MNEForwardSolution MNEForwardSolution::reduce_forward_solution(qint32 p_iNumDipo
 //    //vertno end
 
     // New gain matrix
-    p_fwdOut.sol->data = this->sol->data * p_D;
+    if(this->isSinglePrecision())
+        p_fwdOut.sol_float = QSharedPointer<const MatrixXf>(new MatrixXf((*this->sol_float) * p_D.cast<float>()));
+    else
+        p_fwdOut.sol->data = this->sol->data * p_D;
 
     MatrixX3f rr(p_iNumDipoles,3);
 
@@ -798,7 +960,7 @@ MNEForwardSolution MNEForwardSolution::reduce_forward_solution(qint32 p_iNumDipo
     p_fwdOut.source_rr = rr;
     p_fwdOut.source_nn = nn;
 
-    p_fwdOut.sol->ncol =  p_fwdOut.sol->data.cols();
+    p_fwdOut.sol->ncol =  p_fwdOut.gainCols();
 
     p_fwdOut.nsource = p_iNumDipoles;
 
@@ -821,20 +983,25 @@ FiffCov MNEForwardSolution::compute_depth_prior(const MatrixXd &Gain, const Fiff
     // Compute the gain matrix
     if(is_fixed_ori)
     {
-        d = (G.array().square()).rowwise().sum(); //ToDo: is this correct - is G squared?
+        d = G.colwise().squaredNorm().transpose();
 //            d = np.sum(G ** 2, axis=0)
     }
     else
     {
         qint32 n_pos = G.cols() / 3;
         d = VectorXd::Zero(n_pos);
-        MatrixXd Gk;
-        for (qint32 k = 0; k < n_pos; ++k)
+
+        QList<DepthPriorBlock> t_qListBlocks;
+        for (qint32 k = 0; k < n_pos; k += SOURCE_BLOCK_SIZE)
         {
-            Gk = G.block(0,3*k, G.rows(), 3);
-            JacobiSVD<MatrixXd> svd(Gk.transpose()*Gk);
-            d[k] = svd.singularValues().maxCoeff();
+            DepthPriorBlock t_block;
+            t_block.pGain = &G;
+            t_block.pD = &d;
+            t_block.iFirst = k;
+            t_block.iSources = std::min((qint32)SOURCE_BLOCK_SIZE, n_pos - k);
+            t_qListBlocks.append(t_block);
         }
+        QtConcurrent::blockingMap(t_qListBlocks, &DepthPriorBlock::compute);
     }
 
     // ToDo Currently the fwd solns never have "patch_areas" defined
@@ -895,16 +1062,7 @@ FiffCov MNEForwardSolution::compute_depth_prior(const MatrixXd &Gain, const Fiff
     else
     {
         depth_prior.data.resize(wpp.rows()*3, 1);
-        qint32 idx = 0;
-        double v;
-        for(qint32 i = 0; i < wpp.rows(); ++i)
-        {
-            idx = i*3;
-            v = wpp[i];
-            depth_prior.data(idx, 0) = v;
-            depth_prior.data(idx+1, 0) = v;
-            depth_prior.data(idx+2, 0) = v;
-        }
+        Map<MatrixXd>(depth_prior.data.data(), 3, wpp.rows()) = wpp.transpose().replicate(3, 1);
     }
 
     depth_prior.kind = FIFFV_MNE_DEPTH_PRIOR_COV;
@@ -920,12 +1078,17 @@ FiffCov MNEForwardSolution::compute_depth_prior(const MatrixXd &Gain, const Fiff
 
 FiffCov MNEForwardSolution::compute_orient_prior(float loose)
 {
-    bool is_fixed_ori = this->isFixedOrient();
-    qint32 n_sources = this->sol->data.cols();
+    return MNEForwardSolution::compute_orient_prior(this->sol.constData()->data.cols(), this->isFixedOrient(), this->surf_ori, loose);
+}
+
+
+//*************************************************************************************************************
 
+FiffCov MNEForwardSolution::compute_orient_prior(qint32 n_sources, bool is_fixed_ori, bool surf_ori, float loose)
+{
     if (0 <= loose && loose <= 1)
     {
-        if(loose < 1 && !this->surf_ori)
+        if(loose < 1 && !surf_ori)
         {
             printf("\tForward operator is not oriented in surface coordinates. loose parameter should be None not %f.", loose);//ToDo Throw here
             loose = 1;
@@ -953,8 +1116,7 @@ FiffCov MNEForwardSolution::compute_orient_prior(float loose)
     if(!is_fixed_ori && (0 <= loose && loose <= 1))
     {
         printf("\tApplying loose dipole orientations. Loose value of %f.\n", loose);
-        for(qint32 i = 0; i < n_sources; i+=3)
-            orient_prior.data.block(i,0,2,1).array() *= loose;
+        Map<MatrixXd>(orient_prior.data.data(), 3, n_sources/3).topRows(2).array() *= loose;
 
         orient_prior.kind = FIFFV_MNE_ORIENT_PRIOR_COV;
         orient_prior.diag = true;
@@ -969,63 +1131,7 @@ FiffCov MNEForwardSolution::compute_orient_prior(float loose)
 
 MNEForwardSolution MNEForwardSolution::pick_channels(const QStringList& include, const QStringList& exclude) const
 {
-    MNEForwardSolution fwd(*this);
-
-    if(include.size() == 0 && exclude.size() == 0)
-        return fwd;
-
-    RowVectorXi sel = FiffInfo::pick_channels(fwd.sol->row_names, include, exclude);
-
-    // Do we have something?
-    quint32 nuse = sel.size();
-
-    if (nuse == 0)
-    {
-        printf("Nothing remains after picking. Returning original forward solution.\n");
-        return fwd;
-    }
-    printf("\t%d out of %d channels remain after picking\n", nuse, fwd.nchan);
-
-    //   Pick the correct rows of the forward operator
-    MatrixXd newData(nuse, fwd.sol->data.cols());
-    for(quint32 i = 0; i < nuse; ++i)
-        newData.row(i) = fwd.sol->data.row(sel[i]);
-
-    fwd.sol->data = newData;
-    fwd.sol->nrow = nuse;
-
-    QStringList ch_names;
-    for(qint32 i = 0; i < sel.cols(); ++i)
-        ch_names << fwd.sol->row_names[sel(i)];
-    fwd.nchan = nuse;
-    fwd.sol->row_names = ch_names;
-
-    QList<FiffChInfo> chs;
-    for(qint32 i = 0; i < sel.cols(); ++i)
-        chs.append(fwd.info.chs[sel(i)]);
-    fwd.info.chs = chs;
-    fwd.info.nchan = nuse;
-
-    QStringList bads;
-    for(qint32 i = 0; i < fwd.info.bads.size(); ++i)
-        if(ch_names.contains(fwd.info.bads[i]))
-            bads.append(fwd.info.bads[i]);
-    fwd.info.bads = bads;
-
-    if(!fwd.sol_grad->isEmpty())
-    {
-        newData.resize(nuse, fwd.sol_grad->data.cols());
-        for(quint32 i = 0; i < nuse; ++i)
-            newData.row(i) = fwd.sol_grad->data.row(sel[i]);
-        fwd.sol_grad->data = newData;
-        fwd.sol_grad->nrow = nuse;
-        QStringList row_names;
-        for(qint32 i = 0; i < sel.cols(); ++i)
-            row_names << fwd.sol_grad->row_names[sel(i)];
-        fwd.sol_grad->row_names = row_names;
-    }
-
-    return fwd;
+    return MNEForwardSolutionView(*this).pick_channels(include, exclude).materialize();
 }
 
 
@@ -1033,51 +1139,7 @@ MNEForwardSolution MNEForwardSolution::pick_channels(const QStringList& include,
 
 MNEForwardSolution MNEForwardSolution::pick_regions(const QList<Label> &p_qListLabels) const
 {
-    VectorXi selVertices;
-
-    qint32 iSize = 0;
-    for(qint32 i = 0; i < p_qListLabels.size(); ++i)
-    {
-        VectorXi currentSelection;
-        this->src.label_src_vertno_sel(p_qListLabels[i], currentSelection);
-
-        selVertices.conservativeResize(iSize+currentSelection.size());
-        selVertices.block(iSize,0,currentSelection.size(),1) = currentSelection;
-        iSize = selVertices.size();
-    }
-
-    MNEMath::sort(selVertices, false);
-
-    MNEForwardSolution selectedFwd(*this);
-
-    MatrixX3f rr(selVertices.size(),3);
-    MatrixX3f nn(selVertices.size(),3);
-
-    for(qint32 i = 0; i < selVertices.size(); ++i)
-    {
-        rr.block(i, 0, 1, 3) = selectedFwd.source_rr.row(selVertices[i]);
-        nn.block(i, 0, 1, 3) = selectedFwd.source_nn.row(selVertices[i]);
-    }
-
-    selectedFwd.source_rr = rr;
-    selectedFwd.source_nn = nn;
-
-    VectorXi selSolIdcs = tripletSelection(selVertices);
-    MatrixXd G(selectedFwd.sol->data.rows(),selSolIdcs.size());
-//    selectedFwd.sol_grad; //ToDo
-    qint32 rows = G.rows();
-
-    for(qint32 i = 0; i < selSolIdcs.size(); ++i)
-        G.block(0, i, rows, 1) = selectedFwd.sol->data.col(selSolIdcs[i]);
-
-    selectedFwd.sol->data = G;
-    selectedFwd.sol->nrow = selectedFwd.sol->data.rows();
-    selectedFwd.sol->ncol = selectedFwd.sol->data.cols();
-    selectedFwd.nsource = selectedFwd.sol->ncol / 3;
-
-    selectedFwd.src = selectedFwd.src.pick_regions(p_qListLabels);
-
-    return selectedFwd;
+    return MNEForwardSolutionView(*this).pick_regions(p_qListLabels).materialize();
 }
 
 
@@ -1085,13 +1147,7 @@ MNEForwardSolution MNEForwardSolution::pick_regions(const QList<Label> &p_qListL
 
 MNEForwardSolution MNEForwardSolution::pick_types(bool meg, bool eeg, const QStringList& include, const QStringList& exclude) const
 {
-    RowVectorXi sel = info.pick_types(meg, eeg, false, include, exclude);
-
-    QStringList include_ch_names;
-    for(qint32 i = 0; i < sel.cols(); ++i)
-        include_ch_names << info.ch_names[sel[i]];
-
-    return this->pick_channels(include_ch_names);
+    return MNEForwardSolutionView(*this).pick_types(meg, eeg, include, exclude).materialize();
 }
 
 
@@ -1099,97 +1155,13 @@ MNEForwardSolution MNEForwardSolution::pick_types(bool meg, bool eeg, const QStr
 
 void MNEForwardSolution::prepare_forward(const FiffInfo &p_info, const FiffCov &p_noise_cov, bool p_pca, FiffInfo &p_outFwdInfo, MatrixXd &gain, FiffCov &p_outNoiseCov, MatrixXd &p_outWhitener, qint32 &p_outNumNonZero) const
 {
-    QStringList fwd_ch_names, ch_names;
-    for(qint32 i = 0; i < this->info.chs.size(); ++i)
-        fwd_ch_names << this->info.chs[i].ch_name;
-
-    ch_names.clear();
-    for(qint32 i = 0; i < p_info.chs.size(); ++i)
-        if(     !p_info.bads.contains(p_info.chs[i].ch_name)
-            &&  !p_noise_cov.bads.contains(p_info.chs[i].ch_name)
-            &&  fwd_ch_names.contains(p_info.chs[i].ch_name))
-            ch_names << p_info.chs[i].ch_name;
-
-    qint32 n_chan = ch_names.size();
-    printf("Computing inverse operator with %d channels.\n", n_chan);
-
-    //
-    //   Handle noise cov
-    //
-    p_outNoiseCov = p_noise_cov.prepare_noise_cov(p_info, ch_names);
-
-    //   Omit the zeroes due to projection
-    p_outNumNonZero = 0;
-    VectorXi t_vecNonZero = VectorXi::Zero(n_chan);
-    for(qint32 i = 0; i < p_outNoiseCov.eig.rows(); ++i)
-    {
-        if(p_outNoiseCov.eig[i] > 0)
-        {
-            t_vecNonZero[p_outNumNonZero] = i;
-            ++p_outNumNonZero;
-        }
-    }
-    if(p_outNumNonZero > 0)
-        t_vecNonZero.conservativeResize(p_outNumNonZero);
-
-    if(p_outNumNonZero > 0)
-    {
-        if (p_pca)
-        {
-            qWarning("Warning in MNEForwardSolution::prepare_forward: if (p_pca) havent been debugged.");
-            p_outWhitener = MatrixXd::Zero(n_chan, p_outNumNonZero);
-            // Rows of eigvec are the eigenvectors
-            for(qint32 i = 0; i < p_outNumNonZero; ++i)
-                p_outWhitener.col(t_vecNonZero[i]) = p_outNoiseCov.eigvec.col(t_vecNonZero[i]).array() / sqrt(p_outNoiseCov.eig(t_vecNonZero[i]));
-            printf("\tReducing data rank to %d.\n", p_outNumNonZero);
-        }
-        else
-        {
-            printf("Creating non pca whitener.\n");
-            p_outWhitener = MatrixXd::Zero(n_chan, n_chan);
-            for(qint32 i = 0; i < p_outNumNonZero; ++i)
-                p_outWhitener(t_vecNonZero[i],t_vecNonZero[i]) = 1.0 / sqrt(p_outNoiseCov.eig(t_vecNonZero[i]));
-            // Cols of eigvec are the eigenvectors
-            p_outWhitener *= p_outNoiseCov.eigvec;
-        }
-    }
-
-    VectorXi fwd_idx = VectorXi::Zero(ch_names.size());
-    VectorXi info_idx = VectorXi::Zero(ch_names.size());
-    qint32 idx;
-    qint32 count_fwd_idx = 0;
-    qint32 count_info_idx = 0;
-    for(qint32 i = 0; i < ch_names.size(); ++i)
-    {
-        idx = fwd_ch_names.indexOf(ch_names[i]);
-        if(idx > -1)
-        {
-            fwd_idx[count_fwd_idx] = idx;
-            ++count_fwd_idx;
-        }
-        idx = p_info.ch_names.indexOf(ch_names[i]);
-        if(idx > -1)
-        {
-            info_idx[count_info_idx] = idx;
-            ++count_info_idx;
-        }
-    }
-    fwd_idx.conservativeResize(count_fwd_idx);
-    info_idx.conservativeResize(count_info_idx);
-
-    gain.resize(count_fwd_idx, this->sol->data.cols());
-    for(qint32 i = 0; i < count_fwd_idx; ++i)
-        gain.row(i) = this->sol->data.row(fwd_idx[i]);
-
-    p_outFwdInfo = p_info.pick_info(info_idx);
-
-    printf("\tTotal rank is %d\n", p_outNumNonZero);
+    MNEForwardSolutionView(*this).prepare_forward(p_info, p_noise_cov, p_pca, p_outFwdInfo, gain, p_outNoiseCov, p_outWhitener, p_outNumNonZero);
 }
 
 
 //*************************************************************************************************************
 
-bool MNEForwardSolution::read(QIODevice& p_IODevice, MNEForwardSolution& fwd, bool force_fixed, bool surf_ori, const QStringList& include, const QStringList& exclude, bool bExcludeBads)
+bool MNEForwardSolution::read(QIODevice& p_IODevice, MNEForwardSolution& fwd, bool force_fixed, bool surf_ori, const QStringList& include, const QStringList& exclude, bool bExcludeBads, bool single_precision)
 {
     FiffStream::SPtr t_pStream(new FiffStream(&p_IODevice));
     FiffDirTree t_Tree;
@@ -1283,6 +1255,9 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice, MNEForwardSolution& fwd, bo
         else
             ori = QString("free");
         printf("\tRead MEG forward solution (%d sources, %d channels, %s orientations)\n", megfwd.nsource,megfwd.nchan,ori.toUtf8().constData());
+        //Convert each part as soon as it is read, only one part is held in double precision at a time
+        if(single_precision)
+            megfwd.to_single_precision();
     }
     MNEForwardSolution eegfwd;
     if (read_one(t_pStream.data(), eegnode, eegfwd))
@@ -1292,6 +1267,8 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice, MNEForwardSolution& fwd, bo
         else
             ori = QString("free");
         printf("\tRead EEG forward solution (%d sources, %d channels, %s orientations)\n", eegfwd.nsource,eegfwd.nchan,ori.toUtf8().constData());
+        if(single_precision)
+            eegfwd.to_single_precision();
     }
 
     //
@@ -1301,7 +1278,7 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice, MNEForwardSolution& fwd, bo
 
     if (!megfwd.isEmpty() && !eegfwd.isEmpty())
     {
-        if (megfwd.sol->data.cols() != eegfwd.sol->data.cols() ||
+        if (megfwd.sol->ncol != eegfwd.sol->ncol ||
                 megfwd.source_ori != eegfwd.source_ori ||
                 megfwd.nsource != eegfwd.nsource ||
                 megfwd.coord_frame != eegfwd.coord_frame)
@@ -1312,10 +1289,20 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice, MNEForwardSolution& fwd, bo
         }
 
         fwd = MNEForwardSolution(megfwd);
-        fwd.sol->data = MatrixXd(megfwd.sol->nrow + eegfwd.sol->nrow, megfwd.sol->ncol);
+        if(single_precision)
+        {
+            MatrixXf* t_pMatSol = new MatrixXf(megfwd.sol->nrow + eegfwd.sol->nrow, megfwd.sol->ncol);
+            t_pMatSol->block(0,0,megfwd.sol->nrow,megfwd.sol->ncol) = *megfwd.sol_float;
+            t_pMatSol->block(megfwd.sol->nrow,0,eegfwd.sol->nrow,eegfwd.sol->ncol) = *eegfwd.sol_float;
+            fwd.sol_float = QSharedPointer<const MatrixXf>(t_pMatSol);
+        }
+        else
+        {
+            fwd.sol->data = MatrixXd(megfwd.sol->nrow + eegfwd.sol->nrow, megfwd.sol->ncol);
 
-        fwd.sol->data.block(0,0,megfwd.sol->nrow,megfwd.sol->ncol) = megfwd.sol->data;
-        fwd.sol->data.block(megfwd.sol->nrow,0,eegfwd.sol->nrow,eegfwd.sol->ncol) = eegfwd.sol->data;
+            fwd.sol->data.block(0,0,megfwd.sol->nrow,megfwd.sol->ncol) = megfwd.sol->data;
+            fwd.sol->data.block(megfwd.sol->nrow,0,eegfwd.sol->nrow,eegfwd.sol->ncol) = eegfwd.sol->data;
+        }
         fwd.sol->nrow = megfwd.sol->nrow + eegfwd.sol->nrow;
         fwd.sol->row_names.append(eegfwd.sol->row_names);
 
@@ -1403,8 +1390,8 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice, MNEForwardSolution& fwd, bo
         {
             for(qint32 q = 0; q < t_SourceSpace[k].nuse; ++q)
             {
-                fwd.source_rr.block(q,0,1,3) = t_SourceSpace[k].rr.block(t_SourceSpace[k].vertno(q),0,1,3);
-                fwd.source_nn.block(q,0,1,3) = t_SourceSpace[k].nn.block(t_SourceSpace[k].vertno(q),0,1,3);
+                fwd.source_rr.block(q+nuse,0,1,3) = t_SourceSpace[k].rr.block(t_SourceSpace[k].vertno(q),0,1,3);
+                fwd.source_nn.block(q+nuse,0,1,3) = t_SourceSpace[k].nn.block(t_SourceSpace[k].vertno(q),0,1,3);
             }
             nuse += t_SourceSpace[k].nuse;
         }
@@ -1415,23 +1402,17 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice, MNEForwardSolution& fwd, bo
         {
             printf("\tChanging to fixed-orientation forward solution...");
 
-            MatrixXd tmp = fwd.source_nn.transpose().cast<double>();
-            SparseMatrix<double>* fix_rot = MNEMath::make_block_diag(tmp,1);
-            fwd.sol->data *= (*fix_rot);
+            // sol * fix_rot, fix_rot being the block diagonal of the source normals
+            rotateGain(fwd, true);
             fwd.sol->ncol  = fwd.nsource;
             fwd.source_ori = FIFFV_MNE_FIXED_ORI;
 
             if (!fwd.sol_grad->isEmpty())
             {
-                SparseMatrix<double> t_matKron;
-                SparseMatrix<double> t_eye(3,3);
-                for (qint32 i = 0; i < 3; ++i)
-                    t_eye.insert(i,i) = 1.0f;
-                t_matKron = kroneckerProduct(*fix_rot,t_eye);//kron(fix_rot,eye(3));
-                fwd.sol_grad->data *= t_matKron;
+                // sol_grad * kron(fix_rot,eye(3))
+                fwd.sol_grad->data = rotateSources<double>(fwd.sol_grad->data, fwd.source_nn, true, 3);
                 fwd.sol_grad->ncol   = 3*fwd.nsource;
             }
-            delete fix_rot;
             printf("[done]\n");
         }
     }
@@ -1480,13 +1461,11 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice, MNEForwardSolution& fwd, bo
                 else
                     nn = t_SourceSpace[k].nn.block(t_SourceSpace[k].vertno(p),0,1,3).transpose();
 
-                Matrix3f tmp = Matrix3f::Identity(nn.rows(), nn.rows()) - nn*nn.transpose();
+                Matrix3f tmp = Matrix3f::Identity() - nn*nn.transpose();
 
-                JacobiSVD<MatrixXf> t_svd(tmp, Eigen::ComputeThinU);
-                //Sort singular values and singular vectors
-                VectorXf t_s = t_svd.singularValues();
-                MatrixXf U = t_svd.matrixU();
-                MNEMath::sort<float>(t_s, U);
+                //Singular values are sorted in decreasing order by JacobiSVD
+                JacobiSVD<Matrix3f> t_svd(tmp, Eigen::ComputeFullU);
+                Matrix3f U = t_svd.matrixU();
 
                 //
                 //  Make sure that ez is in the direction of nn
@@ -1498,21 +1477,14 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice, MNEForwardSolution& fwd, bo
             }
             nuse += t_SourceSpace[k].nuse;
         }
-        MatrixXd tmp = fwd.source_nn.transpose().cast<double>();
-        SparseMatrix<double>* surf_rot = MNEMath::make_block_diag(tmp,3);
-
-        fwd.sol->data *= *surf_rot;
+        // sol * surf_rot, surf_rot being the block diagonal of the source frames
+        rotateGain(fwd, false);
 
         if (!fwd.sol_grad->isEmpty())
         {
-            SparseMatrix<double> t_matKron;
-            SparseMatrix<double> t_eye(3,3);
-            for (qint32 i = 0; i < 3; ++i)
-                t_eye.insert(i,i) = 1.0f;
-            t_matKron = kroneckerProduct(*surf_rot,t_eye);//kron(surf_rot,eye(3));
-            fwd.sol_grad->data *= t_matKron;
+            // sol_grad * kron(surf_rot,eye(3))
+            fwd.sol_grad->data = rotateSources<double>(fwd.sol_grad->data, fwd.source_nn, false, 3);
         }
-        delete surf_rot;
         printf("[done]\n");
     }
     else
@@ -1819,11 +1791,53 @@ void MNEForwardSolution::to_fixed_ori()
         qWarning("Warning: Only surface-oriented, free-orientation forward solutions can be converted to fixed orientaton.\n");//ToDo: Throw here//qCritical//qFatal
         return;
     }
-    qint32 count = 0;
-    for(qint32 i = 2; i < this->sol->data.cols(); i += 3)
-        this->sol->data.col(count) = this->sol->data.col(i);//ToDo: is this right? - just take z?
-    this->sol->data.conservativeResize(this->sol->data.rows(), count);
+    // In surface coordinates the z-axis of each source frame is the surface normal
+    qint32 n_sources = this->gainCols() / 3;
+    if(this->isSinglePrecision())
+    {
+        const MatrixXf &t_matSol = *this->sol_float;
+        this->sol_float = QSharedPointer<const MatrixXf>(new MatrixXf(Map<const MatrixXf, 0, OuterStride<> >(t_matSol.data() + 2*t_matSol.rows(), t_matSol.rows(), n_sources, OuterStride<>(3*t_matSol.rows()))));
+    }
+    else
+    {
+        MatrixXd t_matFixed = Map<const MatrixXd, 0, OuterStride<> >(this->sol->data.data() + 2*this->sol->data.rows(), this->sol->data.rows(), n_sources, OuterStride<>(3*this->sol->data.rows()));
+        this->sol->data.swap(t_matFixed);
+    }
     this->sol->ncol = this->sol->ncol / 3;
+    if(this->source_nn.rows() == 3*n_sources)
+    {
+        MatrixX3f t_matNormals(n_sources, 3);
+        for(qint32 k = 0; k < n_sources; ++k)
+            t_matNormals.row(k) = this->source_nn.row(3*k+2);
+        this->source_nn = t_matNormals;
+    }
     this->source_ori = FIFFV_MNE_FIXED_ORI;
     printf("\tConverted the forward solution into the fixed-orientation mode.\n");
 }
+
+
+//*************************************************************************************************************
+
+void MNEForwardSolution::to_single_precision()
+{
+    if(this->isSinglePrecision())
+        return;
+
+    this->sol_float = QSharedPointer<const MatrixXf>(new MatrixXf(this->sol.constData()->data.cast<float>()));
+
+    // Replace sol by a data-less copy, a detach would duplicate the double gain matrix of shared copies
+    const FiffNamedMatrix *t_pSol = this->sol.constData();
+    this->sol = FiffNamedMatrix::SDPtr(new FiffNamedMatrix(t_pSol->nrow, t_pSol->ncol, t_pSol->row_names, t_pSol->col_names, MatrixXd()));
+}
+
+
+//*************************************************************************************************************
+
+void MNEForwardSolution::to_double_precision()
+{
+    if(!this->isSinglePrecision())
+        return;
+
+    this->sol->data = this->sol_float->cast<double>();
+    this->sol_float.clear();
+}
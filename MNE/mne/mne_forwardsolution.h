@@ -156,7 +156,8 @@ struct RegionData
         // Kmeans Reduction
         RegionDataOut p_RegionDataOut;
 
-        KMeans t_kMeans(t_sDistMeasure, QString("sample"), 5);
+        KMeans t_kMeans(t_sDistMeasure, QString("plus"), 5);
+        t_kMeans.setMiniBatch(512); // regions with more than 1024 sources are fitted on mini-batches first
 
         if(bUseWhitened)
         {
@@ -225,9 +226,10 @@ public:
     * @param[in] include       Include these channels (optional)
     * @param[in] exclude       Exclude these channels (optional)
     * @param[in] bExcludeBads  If true bads are also read; default = false (optional)
+    * @param[in] single_precision   Keep the gain matrix in single precision (sol_float); default = false (optional)
     *
     */
-    MNEForwardSolution(QIODevice &p_IODevice, bool force_fixed = false, bool surf_ori = false, const QStringList& include = defaultQStringList, const QStringList& exclude = defaultQStringList, bool bExcludeBads = false);
+    MNEForwardSolution(QIODevice &p_IODevice, bool force_fixed = false, bool surf_ori = false, const QStringList& include = defaultQStringList, const QStringList& exclude = defaultQStringList, bool bExcludeBads = false, bool single_precision = false);
 
     //=========================================================================================================
     /**
@@ -275,6 +277,19 @@ public:
     */
     FiffCov compute_orient_prior(float loose = 0.2);
 
+    //=========================================================================================================
+    /**
+    * Compute orientation prior for a gain matrix with the given number of columns, see above.
+    *
+    * @param[in] n_sources      Number of gain matrix columns.
+    * @param[in] is_fixed_ori   Fixed orientation?
+    * @param[in] surf_ori       Surface oriented?
+    * @param[in] loose          The loose orientation parameter.
+    *
+    * @return Orientation priors.
+    */
+    static FiffCov compute_orient_prior(qint32 n_sources, bool is_fixed_ori, bool surf_ori, float loose);
+
     //=========================================================================================================
     /**
     * Compute weighting for depth prior. ToDo move this to FiffCov
@@ -315,6 +330,30 @@ public:
     */
     inline bool isFixedOrient() const;
 
+    //=========================================================================================================
+    /**
+    * Is the gain matrix stored in single precision (sol_float) instead of sol->data?
+    *
+    * @return true if the gain matrix is held in single precision, false otherwise
+    */
+    inline bool isSinglePrecision() const;
+
+    //=========================================================================================================
+    /**
+    * Number of rows (channels) of the gain matrix, independent of the storage precision.
+    *
+    * @return number of gain matrix rows
+    */
+    inline qint32 gainRows() const;
+
+    //=========================================================================================================
+    /**
+    * Number of columns (source components) of the gain matrix, independent of the storage precision.
+    *
+    * @return number of gain matrix columns
+    */
+    inline qint32 gainCols() const;
+
     //=========================================================================================================
     /**
     * mne.fiff.pick_channels_forward
@@ -438,10 +477,13 @@ public:
     * @param[in] include       Include these channels (optional)
     * @param[in] exclude       Exclude these channels (optional)
     * @param[in] bExcludeBads  If true bads are also read; default = false (optional)
+    * @param[in] single_precision   Keep the gain matrix in single precision (sol_float); default = false (optional).
+    *                               The MEG and EEG parts are converted as soon as they are read and merged, rotated
+    *                               and picked in float, so only one part is held in double precision at a time.
     *
     * @return true if succeeded, false otherwise
     */
-    static bool read(QIODevice& p_IODevice, MNEForwardSolution& fwd, bool force_fixed = false, bool surf_ori = false, const QStringList& include = defaultQStringList, const QStringList& exclude = defaultQStringList, bool bExcludeBads = true);
+    static bool read(QIODevice& p_IODevice, MNEForwardSolution& fwd, bool force_fixed = false, bool surf_ori = false, const QStringList& include = defaultQStringList, const QStringList& exclude = defaultQStringList, bool bExcludeBads = true, bool single_precision = false);
 
     //ToDo readFromStream
 
@@ -471,6 +513,20 @@ public:
     */
     void to_fixed_ori();
 
+    //=========================================================================================================
+    /**
+    * Moves the gain matrix from sol->data to sol_float. sol keeps its dimensions and names but holds no data
+    * afterwards, which halves the memory of large forward solutions. sol_grad is not converted. The double
+    * precision matrix has to be loaded before, read the forward solution with single_precision to avoid it.
+    */
+    void to_single_precision();
+
+    //=========================================================================================================
+    /**
+    * Moves the gain matrix from sol_float back to sol->data.
+    */
+    void to_double_precision();
+
     //=========================================================================================================
     /**
     * overloading the stream out operator<<
@@ -507,8 +563,9 @@ public:
     fiff_int_t coord_frame;             /**< Coil coordinate system definition */
     fiff_int_t nsource;                 /**< Number of source dipoles */
     fiff_int_t nchan;                   /**< Number of channels */
-    FiffNamedMatrix::SDPtr sol;         /**< Forward solution */
+    FiffNamedMatrix::SDPtr sol;         /**< Forward solution, sol->data is empty if isSinglePrecision() -> use sol_float, gainRows and gainCols */
     FiffNamedMatrix::SDPtr sol_grad;    /**< ToDo... */
+    QSharedPointer<const MatrixXf> sol_float;   /**< Single precision gain matrix, replaces sol->data if set; shared between copies */
     FiffCoordTrans mri_head_t;          /**< MRI head coordinate transformation */
     MNESourceSpace src;                 /**< Geometric description of the source spaces (hemispheres) */
     MatrixX3f source_rr;                /**< Source locations */
@@ -542,6 +599,30 @@ inline bool MNEForwardSolution::isFixedOrient() const
 }
 
 
+//*************************************************************************************************************
+
+inline bool MNEForwardSolution::isSinglePrecision() const
+{
+    return !this->sol_float.isNull();
+}
+
+
+//*************************************************************************************************************
+
+inline qint32 MNEForwardSolution::gainRows() const
+{
+    return this->isSinglePrecision() ? (qint32)this->sol_float->rows() : (qint32)this->sol->data.rows();
+}
+
+
+//*************************************************************************************************************
+
+inline qint32 MNEForwardSolution::gainCols() const
+{
+    return this->isSinglePrecision() ? (qint32)this->sol_float->cols() : (qint32)this->sol->data.cols();
+}
+
+
 //*************************************************************************************************************
 
 inline std::ostream& operator<<(std::ostream& out, const MNELIB::MNEForwardSolution &p_MNEForwardSolution)
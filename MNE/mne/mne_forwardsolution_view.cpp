@@ -0,0 +1,478 @@
+//=============================================================================================================
+/**
+* @file     mne_forwardsolution_view.cpp
+* @author   MNE-CPP authors
+* @version  1.0
+* @date     October, 2026
+*
+* @section  LICENSE
+*
+* Copyright (C) 2026, MNE-CPP authors. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief     MNEForwardSolutionView class definition.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "mne_forwardsolution_view.h"
+
+#include <utils/mnemath.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <vector>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace MNELIB;
+using namespace UTILSLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE LOCAL HELPERS
+//=============================================================================================================
+
+namespace
+{
+
+//=============================================================================================================
+/**
+* Gathers the picked rows and source columns of a gain matrix in double or single precision.
+*
+* @param[in] p_matIn            Matrix of the underlying forward solution.
+* @param[in] p_vecRows          Rows of the view to gather.
+* @param[in] p_vecRowSel        Rows of the picked channels in p_matIn.
+* @param[in] p_vecSrcSel        Picked sources.
+* @param[in] p_iNumSrcTotal     Number of sources of the underlying forward solution.
+* @param[in] p_bAllSources      True if all sources are picked.
+* @param[out] p_matOut          The gathered matrix.
+*/
+template<typename T>
+void gatherColumns(const Matrix<T,Dynamic,Dynamic> &p_matIn, const VectorXi &p_vecRows, const VectorXi &p_vecRowSel, const VectorXi &p_vecSrcSel, qint32 p_iNumSrcTotal, bool p_bAllSources, Matrix<T,Dynamic,Dynamic> &p_matOut)
+{
+    qint32 t_iColsPerSrc = p_iNumSrcTotal > 0 ? p_matIn.cols() / p_iNumSrcTotal : 1;
+
+    p_matOut.resize(p_vecRows.size(), p_bAllSources ? p_matIn.cols() : t_iColsPerSrc*p_vecSrcSel.size());
+
+    //   Column by column, the storage order of both matrices
+    for(qint32 j = 0; j < p_matOut.cols(); ++j)
+    {
+        qint32 t_iCol = p_bAllSources ? j : p_vecSrcSel[j/t_iColsPerSrc]*t_iColsPerSrc + j%t_iColsPerSrc;
+        const T *t_pIn = p_matIn.data() + (qint64)t_iCol*p_matIn.rows();
+        for(qint32 i = 0; i < p_vecRows.size(); ++i)
+            p_matOut(i, j) = t_pIn[p_vecRowSel[p_vecRows[i]]];
+    }
+}
+
+} // NAMESPACE
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+MNEForwardSolutionView::MNEForwardSolutionView()
+{
+}
+
+
+//*************************************************************************************************************
+
+MNEForwardSolutionView::MNEForwardSolutionView(const MNEForwardSolution &p_fwd)
+: m_fwd(p_fwd)
+{
+    m_vecRowSel.resize(p_fwd.gainRows());
+    for(qint32 i = 0; i < m_vecRowSel.size(); ++i)
+        m_vecRowSel[i] = i;
+
+    m_vecSrcSel.resize(p_fwd.isFixedOrient() ? p_fwd.gainCols() : p_fwd.gainCols()/3);
+    for(qint32 i = 0; i < m_vecSrcSel.size(); ++i)
+        m_vecSrcSel[i] = i;
+}
+
+
+//*************************************************************************************************************
+
+QStringList MNEForwardSolutionView::ch_names() const
+{
+    QStringList t_qListChNames;
+    for(qint32 i = 0; i < m_vecRowSel.size(); ++i)
+        t_qListChNames << m_fwd.sol->row_names[m_vecRowSel[i]];
+    return t_qListChNames;
+}
+
+
+//*************************************************************************************************************
+
+FiffInfoBase MNEForwardSolutionView::info() const
+{
+    RowVectorXi t_vecSel = m_vecRowSel.transpose();
+    FiffInfoBase t_info = m_fwd.info.pick_info(&t_vecSel);
+
+    QStringList t_qListBads;
+    for(qint32 i = 0; i < t_info.bads.size(); ++i)
+        if(t_info.ch_names.contains(t_info.bads[i]))
+            t_qListBads.append(t_info.bads[i]);
+    t_info.bads = t_qListBads;
+
+    return t_info;
+}
+
+
+//*************************************************************************************************************
+
+MNEForwardSolutionView MNEForwardSolutionView::pick_channels(const QStringList& include, const QStringList& exclude) const
+{
+    MNEForwardSolutionView t_view(*this);
+
+    if(include.size() == 0 && exclude.size() == 0)
+        return t_view;
+
+    RowVectorXi sel = FiffInfoBase::pick_channels(ch_names(), include, exclude);
+
+    // Do we have something?
+    qint32 nuse = sel.size();
+
+    if (nuse == 0)
+    {
+        printf("Nothing remains after picking. Returning original forward solution.\n");
+        return t_view;
+    }
+    printf("\t%d out of %d channels remain after picking\n", nuse, this->nchan());
+
+    t_view.m_vecRowSel.resize(nuse);
+    for(qint32 i = 0; i < nuse; ++i)
+        t_view.m_vecRowSel[i] = m_vecRowSel[sel[i]];
+
+    return t_view;
+}
+
+
+//*************************************************************************************************************
+
+MNEForwardSolutionView MNEForwardSolutionView::pick_regions(const QList<Label> &p_qListLabels) const
+{
+    MNEForwardSolutionView t_view(*this);
+
+    VectorXi selVertices;
+
+    qint32 iSize = 0;
+    for(qint32 i = 0; i < p_qListLabels.size(); ++i)
+    {
+        VectorXi currentSelection;
+        m_fwd.src.label_src_vertno_sel(p_qListLabels[i], currentSelection);
+
+        selVertices.conservativeResize(iSize+currentSelection.size());
+        selVertices.block(iSize,0,currentSelection.size(),1) = currentSelection;
+        iSize = selVertices.size();
+    }
+
+    MNEMath::sort(selVertices, false);
+
+    //
+    //   Keep the sources which are still picked, once
+    //
+    std::vector<bool> t_vecPicked(m_fwd.isFixedOrient() ? m_fwd.gainCols() : m_fwd.gainCols()/3, false);
+    for(qint32 i = 0; i < m_vecSrcSel.size(); ++i)
+        t_vecPicked[m_vecSrcSel[i]] = true;
+
+    t_view.m_vecSrcSel.resize(selVertices.size());
+    qint32 count = 0;
+    for(qint32 i = 0; i < selVertices.size(); ++i)
+    {
+        if(selVertices[i] < (qint32)t_vecPicked.size() && t_vecPicked[selVertices[i]])
+        {
+            t_view.m_vecSrcSel[count] = selVertices[i];
+            t_vecPicked[selVertices[i]] = false;
+            ++count;
+        }
+    }
+    t_view.m_vecSrcSel.conservativeResize(count);
+    t_view.m_qListRegionPicks.append(p_qListLabels);
+
+    return t_view;
+}
+
+
+//*************************************************************************************************************
+
+MNEForwardSolutionView MNEForwardSolutionView::pick_types(bool meg, bool eeg, const QStringList& include, const QStringList& exclude) const
+{
+    FiffInfoBase t_info = this->info();
+    RowVectorXi sel = t_info.pick_types(meg, eeg, false, include, exclude);
+
+    QStringList include_ch_names;
+    for(qint32 i = 0; i < sel.cols(); ++i)
+        include_ch_names << t_info.ch_names[sel[i]];
+
+    return this->pick_channels(include_ch_names);
+}
+
+
+//*************************************************************************************************************
+
+void MNEForwardSolutionView::gain(const VectorXi &p_vecRows, MatrixXd &p_matGain) const
+{
+    if(m_fwd.isSinglePrecision())
+    {
+        MatrixXf t_matGain;
+        gather(*m_fwd.sol_float, p_vecRows, t_matGain);
+        p_matGain = t_matGain.cast<double>();
+    }
+    else
+        gather(m_fwd.sol->data, p_vecRows, p_matGain);
+}
+
+
+//*************************************************************************************************************
+
+void MNEForwardSolutionView::gain(MatrixXd &p_matGain) const
+{
+    VectorXi t_vecRows(m_vecRowSel.size());
+    for(qint32 i = 0; i < t_vecRows.size(); ++i)
+        t_vecRows[i] = i;
+
+    gain(t_vecRows, p_matGain);
+}
+
+
+//*************************************************************************************************************
+
+FiffCov MNEForwardSolutionView::compute_orient_prior(float loose) const
+{
+    return MNEForwardSolution::compute_orient_prior(this->ncol(), m_fwd.isFixedOrient(), m_fwd.surf_ori, loose);
+}
+
+
+//*************************************************************************************************************
+
+void MNEForwardSolutionView::prepare_forward(const FiffInfo &p_info, const FiffCov &p_noise_cov, bool p_pca, FiffInfo &p_outFwdInfo, MatrixXd &gain, FiffCov &p_outNoiseCov, MatrixXd &p_outWhitener, qint32 &p_outNumNonZero) const
+{
+    QStringList fwd_ch_names, ch_names;
+    for(qint32 i = 0; i < m_vecRowSel.size(); ++i)
+        fwd_ch_names << m_fwd.info.chs[m_vecRowSel[i]].ch_name;
+
+    ch_names.clear();
+    for(qint32 i = 0; i < p_info.chs.size(); ++i)
+        if(     !p_info.bads.contains(p_info.chs[i].ch_name)
+            &&  !p_noise_cov.bads.contains(p_info.chs[i].ch_name)
+            &&  fwd_ch_names.contains(p_info.chs[i].ch_name))
+            ch_names << p_info.chs[i].ch_name;
+
+    qint32 n_chan = ch_names.size();
+    printf("Computing inverse operator with %d channels.\n", n_chan);
+
+    //
+    //   Handle noise cov
+    //
+    p_outNoiseCov = p_noise_cov.prepare_noise_cov(p_info, ch_names);
+
+    //   Omit the zeroes due to projection
+    p_outNumNonZero = 0;
+    VectorXi t_vecNonZero = VectorXi::Zero(n_chan);
+    for(qint32 i = 0; i < p_outNoiseCov.eig.rows(); ++i)
+    {
+        if(p_outNoiseCov.eig[i] > 0)
+        {
+            t_vecNonZero[p_outNumNonZero] = i;
+            ++p_outNumNonZero;
+        }
+    }
+    if(p_outNumNonZero > 0)
+        t_vecNonZero.conservativeResize(p_outNumNonZero);
+
+    if(p_outNumNonZero > 0)
+    {
+        if (p_pca)
+        {
+            qWarning("Warning in MNEForwardSolution::prepare_forward: if (p_pca) havent been debugged.");
+            p_outWhitener = MatrixXd::Zero(n_chan, p_outNumNonZero);
+            // Rows of eigvec are the eigenvectors
+            for(qint32 i = 0; i < p_outNumNonZero; ++i)
+                p_outWhitener.col(t_vecNonZero[i]) = p_outNoiseCov.eigvec.col(t_vecNonZero[i]).array() / sqrt(p_outNoiseCov.eig(t_vecNonZero[i]));
+            printf("\tReducing data rank to %d.\n", p_outNumNonZero);
+        }
+        else
+        {
+            printf("Creating non pca whitener.\n");
+            p_outWhitener = MatrixXd::Zero(n_chan, n_chan);
+            for(qint32 i = 0; i < p_outNumNonZero; ++i)
+                p_outWhitener(t_vecNonZero[i],t_vecNonZero[i]) = 1.0 / sqrt(p_outNoiseCov.eig(t_vecNonZero[i]));
+            // Cols of eigvec are the eigenvectors
+            p_outWhitener *= p_outNoiseCov.eigvec;
+        }
+    }
+
+    VectorXi fwd_idx = VectorXi::Zero(ch_names.size());
+    VectorXi info_idx = VectorXi::Zero(ch_names.size());
+    qint32 idx;
+    qint32 count_fwd_idx = 0;
+    qint32 count_info_idx = 0;
+    for(qint32 i = 0; i < ch_names.size(); ++i)
+    {
+        idx = fwd_ch_names.indexOf(ch_names[i]);
+        if(idx > -1)
+        {
+            fwd_idx[count_fwd_idx] = idx;
+            ++count_fwd_idx;
+        }
+        idx = p_info.ch_names.indexOf(ch_names[i]);
+        if(idx > -1)
+        {
+            info_idx[count_info_idx] = idx;
+            ++count_info_idx;
+        }
+    }
+    fwd_idx.conservativeResize(count_fwd_idx);
+    info_idx.conservativeResize(count_info_idx);
+
+    //   Only the gain matrix rows of the used channels are gathered from the shared storage
+    this->gain(fwd_idx, gain);
+
+    p_outFwdInfo = p_info.pick_info(info_idx);
+
+    printf("\tTotal rank is %d\n", p_outNumNonZero);
+}
+
+
+//*************************************************************************************************************
+
+MNEForwardSolution MNEForwardSolutionView::materialize(bool p_bWithGain) const
+{
+    const FiffNamedMatrix *t_pSol = m_fwd.sol.constData();
+
+    bool t_bAllRows = m_vecRowSel.size() == m_fwd.gainRows();
+    for(qint32 i = 0; t_bAllRows && i < m_vecRowSel.size(); ++i)
+        t_bAllRows = m_vecRowSel[i] == i;
+
+    //   Nothing picked: share the gain storage
+    if(t_bAllRows && allSources())
+        return m_fwd;
+
+    MNEForwardSolution t_fwd(m_fwd);
+
+    VectorXi t_vecRows(m_vecRowSel.size());
+    for(qint32 i = 0; i < t_vecRows.size(); ++i)
+        t_vecRows[i] = i;
+
+    //
+    //   Channels
+    //
+    t_fwd.info = this->info();
+    t_fwd.nchan = this->nchan();
+
+    //
+    //   Gain matrices: assembled into new storage, the shared storage is never detached
+    //
+    FiffNamedMatrix::SDPtr t_pNewSol(new FiffNamedMatrix());
+    t_pNewSol->nrow = this->nchan();
+    t_pNewSol->ncol = allSources() ? t_pSol->ncol : this->ncol();
+    t_pNewSol->row_names = this->ch_names();
+    if(allSources())
+        t_pNewSol->col_names = t_pSol->col_names;
+    else if(t_pSol->col_names.size() == m_fwd.gainCols())
+        for(qint32 i = 0; i < this->ncol(); ++i)
+            t_pNewSol->col_names << t_pSol->col_names[m_fwd.isFixedOrient() ? m_vecSrcSel[i] : 3*m_vecSrcSel[i/3] + i%3];
+    if(p_bWithGain && m_fwd.isSinglePrecision())
+    {
+        MatrixXf *t_pMatGain = new MatrixXf;
+        gather(*m_fwd.sol_float, t_vecRows, *t_pMatGain);
+        t_fwd.sol_float = QSharedPointer<const MatrixXf>(t_pMatGain);
+    }
+    else if(p_bWithGain)
+        gather(t_pSol->data, t_vecRows, t_pNewSol->data);
+    else
+        t_fwd.sol_float.clear();
+    t_fwd.sol = t_pNewSol;
+
+    const FiffNamedMatrix *t_pSolGrad = m_fwd.sol_grad.constData();
+    if(!t_pSolGrad->isEmpty())
+    {
+        FiffNamedMatrix::SDPtr t_pNewSolGrad(new FiffNamedMatrix());
+        t_pNewSolGrad->nrow = this->nchan();
+        t_pNewSolGrad->ncol = allSources() ? t_pSolGrad->ncol : 3*this->ncol();
+        if(t_pSolGrad->row_names.size() == t_pSolGrad->data.rows())
+            for(qint32 i = 0; i < m_vecRowSel.size(); ++i)
+                t_pNewSolGrad->row_names << t_pSolGrad->row_names[m_vecRowSel[i]];
+        if(allSources())
+            t_pNewSolGrad->col_names = t_pSolGrad->col_names;
+        if(p_bWithGain)
+            gather(t_pSolGrad->data, t_vecRows, t_pNewSolGrad->data);
+        t_fwd.sol_grad = t_pNewSolGrad;
+    }
+
+    //
+    //   Sources
+    //
+    if(!allSources())
+    {
+        qint32 t_iNumSrc = this->nsource();
+        t_fwd.nsource = t_iNumSrc;
+
+        t_fwd.source_rr.resize(t_iNumSrc, 3);
+        for(qint32 i = 0; i < t_iNumSrc; ++i)
+            t_fwd.source_rr.row(i) = m_fwd.source_rr.row(m_vecSrcSel[i]);
+
+        //   Free orientations have three normals per source
+        qint32 t_iNumNn = m_fwd.source_nn.rows() == 3*m_fwd.source_rr.rows() ? 3 : 1;
+        t_fwd.source_nn.resize(t_iNumNn*t_iNumSrc, 3);
+        for(qint32 i = 0; i < t_iNumSrc; ++i)
+            t_fwd.source_nn.block(t_iNumNn*i, 0, t_iNumNn, 3) = m_fwd.source_nn.block(t_iNumNn*m_vecSrcSel[i], 0, t_iNumNn, 3);
+
+        for(qint32 i = 0; i < m_qListRegionPicks.size(); ++i)
+            t_fwd.src = t_fwd.src.pick_regions(m_qListRegionPicks[i]);
+    }
+
+    return t_fwd;
+}
+
+
+//*************************************************************************************************************
+
+void MNEForwardSolutionView::gather(const MatrixXd &p_matIn, const VectorXi &p_vecRows, MatrixXd &p_matOut) const
+{
+    qint32 t_iNumSrcTotal = m_fwd.isFixedOrient() ? m_fwd.gainCols() : m_fwd.gainCols()/3;
+    gatherColumns(p_matIn, p_vecRows, m_vecRowSel, m_vecSrcSel, t_iNumSrcTotal, allSources(), p_matOut);
+}
+
+
+//*************************************************************************************************************
+
+void MNEForwardSolutionView::gather(const MatrixXf &p_matIn, const VectorXi &p_vecRows, MatrixXf &p_matOut) const
+{
+    qint32 t_iNumSrcTotal = m_fwd.isFixedOrient() ? m_fwd.gainCols() : m_fwd.gainCols()/3;
+    gatherColumns(p_matIn, p_vecRows, m_vecRowSel, m_vecSrcSel, t_iNumSrcTotal, allSources(), p_matOut);
+}
@@ -0,0 +1,380 @@
+//=============================================================================================================
+/**
+* @file     mne_forwardsolution_view.h
+* @author   MNE-CPP authors
+* @version  1.0
+* @date     October, 2026
+*
+* @section  LICENSE
+*
+* Copyright (C) 2026, MNE-CPP authors. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief     MNEForwardSolutionView class declaration.
+*
+*/
+
+#ifndef MNE_FORWARDSOLUTION_VIEW_H
+#define MNE_FORWARDSOLUTION_VIEW_H
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "mne_global.h"
+#include "mne_forwardsolution.h"
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Qt INCLUDES
+//=============================================================================================================
+
+#include <QList>
+#include <QStringList>
+#include <QSharedPointer>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE NAMESPACE MNELIB
+//=============================================================================================================
+
+namespace MNELIB
+{
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace FIFFLIB;
+using namespace FSLIB;
+
+
+//=============================================================================================================
+/**
+* A channel and region pick of a forward solution which does not copy the gain matrix. The view shares the gain
+* storage of the forward solution it was created from and holds the picked channel rows and sources as index maps.
+* Picks on a view compose the index maps. The picked gain matrix or a real forward solution are only assembled on
+* demand, see gain, prepare_forward and materialize.
+*
+* @brief Index view of a picked forward solution
+*/
+class MNESHARED_EXPORT MNEForwardSolutionView
+{
+public:
+    typedef QSharedPointer<MNEForwardSolutionView> SPtr;            /**< Shared pointer type for MNEForwardSolutionView. */
+    typedef QSharedPointer<const MNEForwardSolutionView> ConstSPtr; /**< Const shared pointer type for MNEForwardSolutionView. */
+
+    //=========================================================================================================
+    /**
+    * Default constructor, creates an empty view.
+    */
+    MNEForwardSolutionView();
+
+    //=========================================================================================================
+    /**
+    * Creates a view of all channels and sources of a forward solution. The gain matrix is shared, not copied.
+    *
+    * @param[in] p_fwd      The forward solution.
+    */
+    explicit MNEForwardSolutionView(const MNEForwardSolution &p_fwd);
+
+    //=========================================================================================================
+    /**
+    * Returns true if the view contains no channels.
+    *
+    * @return true if the view is empty.
+    */
+    inline bool isEmpty() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the forward solution the view was created from.
+    *
+    * @return the underlying forward solution
+    */
+    inline const MNEForwardSolution& forward() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the number of picked channels, i.e. the number of rows of the picked gain matrix.
+    *
+    * @return the number of picked channels
+    */
+    inline qint32 nchan() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the number of picked sources.
+    *
+    * @return the number of picked sources
+    */
+    inline qint32 nsource() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the number of columns of the picked gain matrix.
+    *
+    * @return the number of picked gain matrix columns
+    */
+    inline qint32 ncol() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the rows of the picked channels in the gain matrix of the underlying forward solution.
+    *
+    * @return the channel row map
+    */
+    inline const VectorXi& rowSel() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the picked sources of the underlying forward solution.
+    *
+    * @return the source map
+    */
+    inline const VectorXi& sourceSel() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the names of the picked channels.
+    *
+    * @return the channel names
+    */
+    QStringList ch_names() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the measurement info of the picked channels.
+    *
+    * @return the picked measurement info
+    */
+    FiffInfoBase info() const;
+
+    //=========================================================================================================
+    /**
+    * mne.fiff.pick_channels_forward, see MNEForwardSolution::pick_channels. Only the channel row map is changed.
+    *
+    * @param[in] include    List of channels to include. (if None, include all available).
+    * @param[in] exclude    Channels to exclude (if None, do not exclude any).
+    *
+    * @return the view of the picked channels
+    */
+    MNEForwardSolutionView pick_channels(const QStringList& include = defaultQStringList, const QStringList& exclude = defaultQStringList) const;
+
+    //=========================================================================================================
+    /**
+    * Reduces the view to the sources within the given regions, see MNEForwardSolution::pick_regions. Only the source
+    * map is changed.
+    *
+    * @param[in] p_qListLabels  ROIs
+    *
+    * @return the view of the picked regions
+    */
+    MNEForwardSolutionView pick_regions(const QList<Label> &p_qListLabels) const;
+
+    //=========================================================================================================
+    /**
+    * mne.fiff.pick_types_forward, see MNEForwardSolution::pick_types. Only the channel row map is changed.
+    *
+    * @param[in] meg        Include MEG channels
+    * @param[in] eeg        Include EEG channels
+    * @param[in] include    Additional channels to include (if empty, do not add any)
+    * @param[in] exclude    Channels to exclude (if empty, do not exclude any)
+    *
+    * @return the view of the picked channels
+    */
+    MNEForwardSolutionView pick_types(bool meg, bool eeg, const QStringList& include = defaultQStringList, const QStringList& exclude = defaultQStringList) const;
+
+    //=========================================================================================================
+    /**
+    * Assembles rows of the picked gain matrix.
+    *
+    * @param[in] p_vecRows      Rows of the view to assemble.
+    * @param[out] p_matGain     The assembled gain matrix rows.
+    */
+    void gain(const VectorXi &p_vecRows, MatrixXd &p_matGain) const;
+
+    //=========================================================================================================
+    /**
+    * Assembles the picked gain matrix.
+    *
+    * @param[out] p_matGain     The picked gain matrix.
+    */
+    void gain(MatrixXd &p_matGain) const;
+
+    //=========================================================================================================
+    /**
+    * Computes the orientation prior of the picked sources, see MNEForwardSolution::compute_orient_prior.
+    *
+    * @param[in] loose  The loose orientation parameter
+    *
+    * @return the orientation prior
+    */
+    FiffCov compute_orient_prior(float loose = 0.2) const;
+
+    //=========================================================================================================
+    /**
+    * Prepares the picked forward solution for the inverse computation, see MNEForwardSolution::prepare_forward.
+    * Only the gain matrix rows of the channels used are assembled.
+    *
+    * @param[in] p_info             Fiff measurement info
+    * @param[in] p_noise_cov        Noise covariance matrix
+    * @param[in] p_pca              calculates a pca whitener
+    * @param[out] p_outFwdInfo      Forward solution info
+    * @param[out] gain              Gain matrix
+    * @param[out] p_outNoiseCov     noise covariance matrix
+    * @param[out] p_outWhitener     Whitener
+    * @param[out] p_outNumNonZero   the rank (non zeros)
+    */
+    void prepare_forward(const FiffInfo &p_info, const FiffCov &p_noise_cov, bool p_pca, FiffInfo &p_outFwdInfo, MatrixXd &gain, FiffCov &p_outNoiseCov, MatrixXd &p_outWhitener, qint32 &p_outNumNonZero) const;
+
+    //=========================================================================================================
+    /**
+    * Assembles a forward solution of the picked channels and sources. Views without picks return a shallow copy of
+    * the underlying forward solution, sharing its gain storage. Otherwise the picked rows and columns are gathered
+    * into newly allocated matrices once, without copying the whole gain matrix before.
+    *
+    * @param[in] p_bWithGain    If false, only the picked description (info, source spaces, sources, names and
+    *                           dimensions) is assembled and the gain matrices stay empty, e.g. for
+    *                           MNEInverseOperator::make_inverse_operator, which gets the gain matrix separately.
+    *
+    * @return the picked forward solution
+    */
+    MNEForwardSolution materialize(bool p_bWithGain = true) const;
+
+private:
+    //=========================================================================================================
+    /**
+    * Gathers rows of the view from a matrix with a fixed number of columns per source of the underlying forward
+    * solution.
+    *
+    * @param[in] p_matIn        Matrix of the underlying forward solution (sol or sol_grad data).
+    * @param[in] p_vecRows      Rows of the view to gather.
+    * @param[out] p_matOut      The gathered matrix.
+    */
+    void gather(const MatrixXd &p_matIn, const VectorXi &p_vecRows, MatrixXd &p_matOut) const;
+
+    //=========================================================================================================
+    /**
+    * Single precision overload of gather, for forward solutions storing the gain matrix in sol_float.
+    *
+    * @param[in] p_matIn        Single precision gain matrix of the underlying forward solution.
+    * @param[in] p_vecRows      Rows of the view to gather.
+    * @param[out] p_matOut      The gathered matrix.
+    */
+    void gather(const MatrixXf &p_matIn, const VectorXi &p_vecRows, MatrixXf &p_matOut) const;
+
+    //=========================================================================================================
+    /**
+    * Returns whether all sources of the underlying forward solution are picked.
+    *
+    * @return true if no region pick was applied.
+    */
+    inline bool allSources() const;
+
+    MNEForwardSolution  m_fwd;                      /**< The underlying forward solution, sharing its gain storage. */
+    VectorXi            m_vecRowSel;                /**< Rows of the picked channels in the underlying gain matrix. */
+    VectorXi            m_vecSrcSel;                /**< Picked sources of the underlying forward solution, ascending. */
+    QList< QList<Label> > m_qListRegionPicks;       /**< Region picks applied in order, to pick the source spaces. */
+};
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline bool MNEForwardSolutionView::isEmpty() const
+{
+    return m_vecRowSel.size() == 0;
+}
+
+
+//*************************************************************************************************************
+
+inline const MNEForwardSolution& MNEForwardSolutionView::forward() const
+{
+    return m_fwd;
+}
+
+
+//*************************************************************************************************************
+
+inline qint32 MNEForwardSolutionView::nchan() const
+{
+    return m_vecRowSel.size();
+}
+
+
+//*************************************************************************************************************
+
+inline qint32 MNEForwardSolutionView::nsource() const
+{
+    return m_vecSrcSel.size();
+}
+
+
+//*************************************************************************************************************
+
+inline qint32 MNEForwardSolutionView::ncol() const
+{
+    return m_fwd.isFixedOrient() ? m_vecSrcSel.size() : 3*m_vecSrcSel.size();
+}
+
+
+//*************************************************************************************************************
+
+inline const VectorXi& MNEForwardSolutionView::rowSel() const
+{
+    return m_vecRowSel;
+}
+
+
+//*************************************************************************************************************
+
+inline const VectorXi& MNEForwardSolutionView::sourceSel() const
+{
+    return m_vecSrcSel;
+}
+
+
+//*************************************************************************************************************
+
+inline bool MNEForwardSolutionView::allSources() const
+{
+    return m_qListRegionPicks.isEmpty();
+}
+
+} // NAMESPACE
+
+#endif // MNE_FORWARDSOLUTION_VIEW_H
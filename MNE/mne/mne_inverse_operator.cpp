@@ -53,6 +53,37 @@ using namespace UTILSLIB;
 using namespace MNELIB;
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC DEFINITIONS
+//=============================================================================================================
+
+#define NOISE_NORM_BLOCK_ROWS 2048  /**< Rows of the eigen leads per noise normalization block. */
+
+namespace
+{
+
+//=============================================================================================================
+/**
+* Rows of the eigen leads processed by one thread when computing the noise normalization factors
+*/
+struct NoiseNormBlock
+{
+    const MatrixXd* pLeads;     /**< Eigen leads */
+    const VectorXd* pWeight2;   /**< Squared noise weights */
+    VectorXd*       pNorm2;     /**< Squared row norms of the weighted eigen leads, each block writes its own segment */
+    qint32          iFirst;     /**< First row of the block */
+    qint32          iRows;      /**< Number of rows of the block */
+
+    void compute()
+    {
+        pNorm2->segment(iFirst, iRows).noalias() = pLeads->middleRows(iFirst, iRows).cwiseAbs2() * (*pWeight2);
+    }
+};
+
+} // NAMESPACE
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -729,7 +760,8 @@ MNEInverseOperator MNEInverseOperator::make_inverse_operator(const FiffInfo &inf
     }
     else
     {
-        p_depth_prior->data = MatrixXd::Ones(gain.cols(), gain.cols());
+        p_depth_prior = FiffCov::SDPtr(new FiffCov());
+        p_depth_prior->data = MatrixXd::Ones(gain.cols(), 1);
         p_depth_prior->kind = FIFFV_MNE_DEPTH_PRIOR_COV;
         p_depth_prior->diag = true;
         p_depth_prior->dim = gain.cols();
@@ -754,6 +786,7 @@ MNEInverseOperator MNEInverseOperator::make_inverse_operator(const FiffInfo &inf
                 ++count;
             }
             p_depth_prior->data.conservativeResize(count, 1);
+            p_depth_prior->dim = count;
 
 //            forward = deepcopy(forward)
             forward.to_fixed_ori();
@@ -761,75 +794,159 @@ MNEInverseOperator MNEInverseOperator::make_inverse_operator(const FiffInfo &inf
             forward.prepare_forward(info, p_outNoiseCov, false, gain_info, gain, p_outNoiseCov, whitener, n_nzero);
         }
     }
+
+    // Orientation prior for loose orientations
+    FiffCov::SDPtr p_orient_prior;
+    if(!is_fixed_ori)
+        p_orient_prior = FiffCov::SDPtr(new FiffCov(forward.compute_orient_prior(loose)));
+
+    return make_inverse_operator(info, forward, gain_info, gain, p_outNoiseCov, whitener, n_nzero, p_depth_prior, p_orient_prior, depth);
+}
+
+
+//*************************************************************************************************************
+
+MNEInverseOperator MNEInverseOperator::make_inverse_operator(const FiffInfo &info, const MNEForwardSolution& forward, const FiffInfo& gain_info, const MatrixXd& gain, const FiffCov& p_outNoiseCov, const MatrixXd& whitener, qint32 n_nzero, const FiffCov::SDPtr& p_depth_prior, const FiffCov::SDPtr& p_orient_prior, float depth, MatrixXd* p_pGainRGt)
+{
+    MNEInverseOperator p_MNEInverseOperator;
+
     printf("\tComputing inverse operator with %d channels.\n", gain_info.ch_names.size());
 
     //
     // 6. Compose the source covariance matrix
     //
     printf("\tCreating the source covariance matrix\n");
-    FiffCov::SDPtr p_source_cov = p_depth_prior;
+    FiffCov::SDPtr p_source_cov = FiffCov::SDPtr(new FiffCov(*p_depth_prior));
 
     // apply loose orientations
-    FiffCov::SDPtr p_orient_prior;
-    if(!is_fixed_ori)
-    {
-        p_orient_prior = FiffCov::SDPtr(new FiffCov(forward.compute_orient_prior(loose)));
+    if(p_orient_prior)
         p_source_cov->data.array() *= p_orient_prior->data.array();
-    }
 
     // 7. Apply fMRI weighting (not done)
 
-    //
-    // 8. Apply the linear projection to the forward solution
-    // 9. Apply whitening to the forward computation matrix
-    //
-    printf("\tWhitening the forward solution.\n");
-    gain = whitener*gain;
-
     // 10. Exclude the source space points within the labels (not done)
 
-    //
-    // 11. Do appropriate source weighting to the forward computation matrix
-    //
-
-    // Adjusting Source Covariance matrix to make trace of G*R*G' equal
-    // to number of sensors.
-    printf("\tAdjusting source covariance matrix.\n");
     RowVectorXd source_std = p_source_cov->data.array().sqrt().transpose();
+    double trace_GRGT = 0;
+    double scaling_source_cov = 1.0;
+    VectorXd p_sing;
+    MatrixXd t_U, t_V;
+    bool t_bDecomposed = false;
+
+    if(p_pGainRGt)
+    {
+        //
+        // 8. - 12. on the cached G*R*G': the whitened and weighted Gram matrix is W*(G*R*G')*W', the eigen leads
+        //          are recovered as R^0.5*G'*W'*U*diag(1/s) without whitening the whole lead field.
+        //
+        if(p_pGainRGt->rows() != gain.rows())
+        {
+            printf("\tCaching the source weighted Gram matrix of the forward solution.\n");
+            MatrixXd t_matGainStd = gain * source_std.transpose().asDiagonal();
+            p_pGainRGt->setZero(gain.rows(), gain.rows());
+            p_pGainRGt->selfadjointView<Lower>().rankUpdate(t_matGainStd);
+        }
 
-    for(qint32 i = 0; i < gain.rows(); ++i)
-        gain.row(i) = gain.row(i).array() * source_std.array();
+        printf("\tWhitening the cached Gram matrix.\n");
+        MatrixXd t_matGram = whitener * (p_pGainRGt->selfadjointView<Lower>() * whitener.transpose());
 
-    double trace_GRGT = (gain * gain.transpose()).trace();//pow(gain.norm(), 2);
-    double scaling_source_cov = (double)n_nzero / trace_GRGT;
+        trace_GRGT = t_matGram.trace();
+        scaling_source_cov = (double)n_nzero / trace_GRGT;
+        t_matGram *= scaling_source_cov;
 
-    p_source_cov->data.array() *= scaling_source_cov;
+        printf("Computing eigen decomposition of whitened and weighted Gram matrix.\n");
+        SelfAdjointEigenSolver<MatrixXd> t_eig(t_matGram);
+        if(t_eig.info() == Success)
+        {
+            qint32 m = t_matGram.rows();
+            qint32 i, r;
 
-    gain.array() *= sqrt(scaling_source_cov);
+            //
+            //  Eigenvalues are ascending, singular values descending
+            //
+            p_sing.resize(m);
+            t_U.resize(m, m);
+            for(i = 0; i < m; ++i)
+            {
+                p_sing[i] = sqrt(std::max(t_eig.eigenvalues()[m-1-i], 0.0));
+                t_U.col(i) = t_eig.eigenvectors().col(m-1-i);
+            }
 
-    // now np.trace(np.dot(gain, gain.T)) == n_nzero
-    // logger.info(np.trace(np.dot(gain, gain.T)), n_nzero)
+            for(r = 0; r < m && p_sing[r] > 1e-6*p_sing[0]; ++r);
 
-    //
-    // 12. Decompose the combined matrix
-    //
-    printf("Computing SVD of whitened and weighted lead field matrix.\n");
-    JacobiSVD<MatrixXd> svd(gain, ComputeThinU | ComputeThinV);
-    std::cout << "ToDo Sorting Necessary?" << std::endl;
-    VectorXd p_sing = svd.singularValues();
-    MatrixXd t_U = svd.matrixU();
-    MNEMath::sort<double>(p_sing, t_U);
-    FiffNamedMatrix::SDPtr p_eigen_fields = FiffNamedMatrix::SDPtr(new FiffNamedMatrix( svd.matrixU().cols(),
-                                                                                        svd.matrixU().rows(),
+            MatrixXd t_matWU = whitener.transpose() * t_U.leftCols(r);
+            t_V.resize(gain.cols(), m);
+            t_V.leftCols(r).noalias() = gain.transpose() * t_matWU;
+            VectorXd t_vecRowScale = sqrt(scaling_source_cov) * source_std.transpose();
+            for(i = 0; i < r; ++i)
+                t_V.col(i) = t_V.col(i).cwiseProduct(t_vecRowScale) / p_sing[i];
+            t_V.rightCols(m-r).setZero();
+            p_sing.tail(m-r).setZero();
+
+            //
+            //  Same accuracy check as MNEMath::svd_gram: the eigen leads have to be orthonormal
+            //
+            t_bDecomposed = true;
+            if(r > 0)
+            {
+                MatrixXd t_matVtV = t_V.leftCols(r).transpose()*t_V.leftCols(r);
+                t_matVtV.diagonal().array() -= 1.0;
+                t_bDecomposed = t_matVtV.cwiseAbs().maxCoeff() < 1e-6;
+            }
+        }
+
+        if(!t_bDecomposed)
+            printf("Cached Gram matrix decomposition not accurate enough, decomposing the lead field.\n");
+    }
+
+    if(!t_bDecomposed)
+    {
+        //
+        // 8. Apply the linear projection to the forward solution
+        // 9. Apply whitening to the forward computation matrix
+        //
+        printf("\tWhitening the forward solution.\n");
+        MatrixXd t_matGain = whitener*gain;
+
+        //
+        // 11. Do appropriate source weighting to the forward computation matrix
+        //
+
+        // Adjusting Source Covariance matrix to make trace of G*R*G' equal
+        // to number of sensors.
+        printf("\tAdjusting source covariance matrix.\n");
+        for(qint32 i = 0; i < t_matGain.rows(); ++i)
+            t_matGain.row(i) = t_matGain.row(i).array() * source_std.array();
+
+        trace_GRGT = t_matGain.squaredNorm();//trace(gain * gain') without forming the product
+        scaling_source_cov = (double)n_nzero / trace_GRGT;
+
+        t_matGain.array() *= sqrt(scaling_source_cov);
+
+        // now np.trace(np.dot(gain, gain.T)) == n_nzero
+        // logger.info(np.trace(np.dot(gain, gain.T)), n_nzero)
+
+        //
+        // 12. Decompose the combined matrix
+        //
+        //  The lead field is wide (channels x sources): decompose the small Gram matrix gain*gain' instead of running
+        //  a JacobiSVD on the whole matrix. MNEMath::svd_gram checks the result and falls back to JacobiSVD if needed.
+        //  Singular values come sorted in descending order.
+        //
+        printf("Computing SVD of whitened and weighted lead field matrix.\n");
+        MNEMath::svd_gram(t_matGain, p_sing, t_U, t_V);
+    }
+
+    p_source_cov->data.array() *= scaling_source_cov;
+
+    FiffNamedMatrix::SDPtr p_eigen_fields = FiffNamedMatrix::SDPtr(new FiffNamedMatrix( t_U.cols(),
+                                                                                        t_U.rows(),
                                                                                         defaultQStringList,
                                                                                         gain_info.ch_names,
                                                                                         t_U.transpose() ));
 
-    p_sing = svd.singularValues();
-    MatrixXd t_V = svd.matrixV();
-    MNEMath::sort<double>(p_sing, t_V);
-    FiffNamedMatrix::SDPtr p_eigen_leads = FiffNamedMatrix::SDPtr(new FiffNamedMatrix( svd.matrixV().rows(),
-                                                                                       svd.matrixV().cols(),
+    FiffNamedMatrix::SDPtr p_eigen_leads = FiffNamedMatrix::SDPtr(new FiffNamedMatrix( t_V.rows(),
+                                                                                       t_V.cols(),
                                                                                        defaultQStringList,
                                                                                        defaultQStringList,
                                                                                        t_V ));
@@ -872,15 +989,12 @@ MNEInverseOperator MNEInverseOperator::make_inverse_operator(const FiffInfo &inf
     else
         p_iMethods = FIFFV_MNE_EEG;
 
-    // We set this for consistency with mne C code written inverses
-    if(depth == 0)
-        p_depth_prior = FiffCov::SDPtr();
-
     p_MNEInverseOperator.eigen_fields = p_eigen_fields;
     p_MNEInverseOperator.eigen_leads = p_eigen_leads;
     p_MNEInverseOperator.sing = p_sing;
     p_MNEInverseOperator.nave = p_nave;
-    p_MNEInverseOperator.depth_prior = p_depth_prior;
+    // We set this for consistency with mne C code written inverses
+    p_MNEInverseOperator.depth_prior = depth == 0 ? FiffCov::SDPtr() : p_depth_prior;
     p_MNEInverseOperator.source_cov = p_source_cov;
     p_MNEInverseOperator.noise_cov = FiffCov::SDPtr(new FiffCov(p_outNoiseCov));
     p_MNEInverseOperator.orient_prior = p_orient_prior;
@@ -945,7 +1059,7 @@ MNEInverseOperator MNEInverseOperator::prepare_inverse_operator(qint32 nave ,flo
     //
 //    if(inv.whitener)
 //        delete inv.whitener;
-    inv.whitener = MatrixXd::Zero(inv.noise_cov->dim, inv.noise_cov->dim);
+    VectorXd t_vecWhiten = VectorXd::Zero(inv.noise_cov->dim);
 
     qint32 nnzero, k;
     if (inv.noise_cov->diag == 0)
@@ -959,14 +1073,14 @@ MNEInverseOperator MNEInverseOperator::prepare_inverse_operator(qint32 nave ,flo
         {
             if (inv.noise_cov->eig[k] > 0)
             {
-                inv.whitener(k,k) = 1.0/sqrt(inv.noise_cov->eig[k]);
+                t_vecWhiten[k] = 1.0/sqrt(inv.noise_cov->eig[k]);
                 ++nnzero;
             }
         }
         //
-        //   Rows of eigvec are the eigenvectors
+        //   Rows of eigvec are the eigenvectors: scale them instead of multiplying with a dense diagonal matrix
         //
-        inv.whitener *= inv.noise_cov->eigvec;
+        inv.whitener = t_vecWhiten.asDiagonal() * inv.noise_cov->eigvec;
         printf("\tCreated the whitener using a full noise covariance matrix (%d small eigenvalues omitted)\n", inv.noise_cov->dim - nnzero);
     }
     else
@@ -974,8 +1088,8 @@ MNEInverseOperator MNEInverseOperator::prepare_inverse_operator(qint32 nave ,flo
         //
         //   No need to omit the zeroes due to projection
         //
-        for (k = 0; k < inv.noise_cov->dim; ++k)
-            inv.whitener(k,k) = 1.0/sqrt(inv.noise_cov->data(k,0));
+        t_vecWhiten = inv.noise_cov->data.col(0).cwiseSqrt().cwiseInverse();
+        inv.whitener = t_vecWhiten.asDiagonal();
 
         printf("\tCreated the whitener using a diagonal noise covariance matrix (%d small eigenvalues discarded)\n",ncomp);
     }
@@ -984,7 +1098,6 @@ MNEInverseOperator MNEInverseOperator::prepare_inverse_operator(qint32 nave ,flo
     //
     if (dSPM || sLORETA)
     {
-        VectorXd noise_norm = VectorXd::Zero(inv.eigen_leads->nrow);
         VectorXd noise_weight;
         if (dSPM)
         {
@@ -997,33 +1110,29 @@ MNEInverseOperator MNEInverseOperator::prepare_inverse_operator(qint32 nave ,flo
            VectorXd tmp = (VectorXd::Constant(inv.sing.size(), 1) + inv.sing.cwiseProduct(inv.sing)/lambda2);
            noise_weight = inv.reginv.cwiseProduct(tmp.cwiseSqrt());
         }
-        VectorXd one;
-        if (inv.eigen_leads_weighted)
-        {
-           for (k = 0; k < inv.eigen_leads->nrow; ++k)
-           {
-              one = inv.eigen_leads->data.block(k,0,1,inv.eigen_leads->data.cols()).cwiseProduct(noise_weight);
-              noise_norm[k] = sqrt(one.dot(one));
-           }
-        }
-        else
+
+        //
+        //   Squared row norms of eigen_leads*diag(noise_weight) = eigen_leads.^2*noise_weight.^2, in parallel row blocks
+        //
+        VectorXd t_vecWeight2 = noise_weight.cwiseAbs2();
+        const MatrixXd &t_matLeads = inv.eigen_leads.constData()->data; // const access, no detach of the shared leads
+        VectorXd noise_norm2(t_matLeads.rows());
+
+        QList<NoiseNormBlock> t_qListBlocks;
+        for(k = 0; k < noise_norm2.size(); k += NOISE_NORM_BLOCK_ROWS)
         {
-//            qDebug() << 32;
-            double c;
-            for (k = 0; k < inv.eigen_leads->nrow; ++k)
-            {
-//                qDebug() << 321;
-                c = sqrt(inv.source_cov->data(k,0));
-//                qDebug() << 322;
-//                qDebug() << "inv.eigen_leads->data" << inv.eigen_leads->data.rows() << "x" << inv.eigen_leads->data.cols();
-//                qDebug() << "noise_weight" << noise_weight.rows() << "x" << noise_weight.cols();
-                one = c*(inv.eigen_leads->data.row(k).transpose()).cwiseProduct(noise_weight);//ToDo eigenleads data -> pointer
-                noise_norm[k] = sqrt(one.dot(one));
-//                qDebug() << 324;
-            }
+            NoiseNormBlock t_block;
+            t_block.pLeads = &t_matLeads;
+            t_block.pWeight2 = &t_vecWeight2;
+            t_block.pNorm2 = &noise_norm2;
+            t_block.iFirst = k;
+            t_block.iRows = std::min((qint32)NOISE_NORM_BLOCK_ROWS, (qint32)noise_norm2.size() - k);
+            t_qListBlocks.append(t_block);
         }
+        QtConcurrent::blockingMap(t_qListBlocks, &NoiseNormBlock::compute);
 
-//        qDebug() << 4;
+        if (!inv.eigen_leads_weighted)
+            noise_norm2.array() *= inv.source_cov.constData()->data.col(0).array();
 
         //
         //   Compute the final result
@@ -1039,17 +1148,17 @@ MNEInverseOperator MNEInverseOperator::prepare_inverse_operator(qint32 nave ,flo
             //   Even in this case return only one noise-normalization factor
             //   per source location
             //
-            VectorXd* t = MNEMath::combine_xyz(noise_norm.transpose());
-            noise_norm_new = t->cwiseSqrt();//double otherwise values are getting too small
-            delete t;
+            noise_norm_new = Map<MatrixXd>(noise_norm2.data(), 3, noise_norm2.size()/3).colwise().sum().transpose().cwiseSqrt();
             //
             //   This would replicate the same value on three consequtive
             //   entries
             //
             //   noise_norm = kron(sqrt(mne_combine_xyz(noise_norm)),ones(3,1));
         }
-        VectorXd vOnes = VectorXd::Ones(noise_norm_new.size());
-        VectorXd tmp = vOnes.cwiseQuotient(noise_norm_new.cwiseAbs());
+        else
+            noise_norm_new = noise_norm2.cwiseSqrt();
+
+        VectorXd tmp = noise_norm_new.cwiseInverse();
 //        if(inv.noisenorm)
 //            delete inv.noisenorm;
 
@@ -146,7 +146,8 @@ struct RegionMT
         // Kmeans Reduction
         RegionMTOut p_RegionMTOut;
 
-        KMeans t_kMeans(t_sDistMeasure, QString("sample"), 5);
+        KMeans t_kMeans(t_sDistMeasure, QString("plus"), 5);
+        t_kMeans.setMiniBatch(512); // regions with more than 1024 sources are fitted on mini-batches first
 
         t_kMeans.calculate(this->matRoiMT, this->nClusters, p_RegionMTOut.roiIdx, p_RegionMTOut.ctrs, p_RegionMTOut.sumd, p_RegionMTOut.D);
 
@@ -293,6 +294,30 @@ public:
     */
     static MNEInverseOperator make_inverse_operator(const FiffInfo &info, MNEForwardSolution forward, const FiffCov& p_noise_cov, float loose = 0.2f, float depth = 0.8f, bool fixed = false, bool limit_depth_chs = true);
 
+    //=========================================================================================================
+    /**
+    * Assembles the inverse operator from a prepared forward solution, i.e. the noise covariance dependent steps 6 to 12
+    * of make_inverse_operator above. Callers which receive new noise covariances for an unchanged channel set (e.g.
+    * RTINVLIB::RtInvOp) keep gain, depth and orientation prior and hand in a cache for G*R*G' (R being the unscaled
+    * source covariance). With the cache, whitening, trace scaling and decomposition work on the small channel x channel
+    * Gram matrix and the lead field is touched only once to recover the eigen leads.
+    *
+    * @param[in] info               The measurement info, see make_inverse_operator above.
+    * @param[in] forward            Forward operator the gain was prepared from.
+    * @param[in] gain_info          Info of the channels selected by MNEForwardSolution::prepare_forward.
+    * @param[in] gain               Gain matrix of the selected channels (not whitened).
+    * @param[in] p_outNoiseCov      The prepared noise covariance matrix.
+    * @param[in] whitener           The whitener of the prepared noise covariance matrix.
+    * @param[in] n_nzero            Number of non-zero eigenvalues of the noise covariance matrix.
+    * @param[in] p_depth_prior      Depth prior (all ones if no depth weighting is performed).
+    * @param[in] p_orient_prior     Orientation prior, NULL for fixed orientations.
+    * @param[in] depth              Depth weighting coefficient, 0 stores no depth prior with the operator.
+    * @param[in, out] p_pGainRGt    Cache of G*R*G' (lower triangle). Computed if empty, it has to be cleared whenever gain or priors change (optional).
+    *
+    * @return the assembled inverse operator
+    */
+    static MNEInverseOperator make_inverse_operator(const FiffInfo &info, const MNEForwardSolution& forward, const FiffInfo& gain_info, const MatrixXd& gain, const FiffCov& p_outNoiseCov, const MatrixXd& whitener, qint32 n_nzero, const FiffCov::SDPtr& p_depth_prior, const FiffCov::SDPtr& p_orient_prior, float depth, MatrixXd* p_pGainRGt = NULL);
+
     //=========================================================================================================
     /**
     * mne_prepare_inverse_operator
@@ -99,7 +99,8 @@ HEADERS +=  \
         rtinvop.h \
         rtave.h \
     rtnoise.h \
-    rthpis.h
+    rthpis.h \
+    rtkernelholder.h
 
 INCLUDEPATH += $${EIGEN_INCLUDE_DIR}
 INCLUDEPATH += $${MNE_INCLUDE_DIR}
@@ -51,6 +51,15 @@
 #include <QDebug>
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define RTINV_LOOSE 0.2f    /**< Loose orientation weight of the real-time inverse operator. */
+#define RTINV_DEPTH 0.8f    /**< Depth weighting exponent of the real-time inverse operator. */
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // USED NAMESPACES
@@ -67,6 +76,7 @@ RtInvOp::RtInvOp(FiffInfo::SPtr &p_pFiffInfo, MNEForwardSolution::SPtr &p_pFwd,
 : QThread(parent)
 , m_pFiffInfo(p_pFiffInfo)
 , m_pFwd(p_pFwd)
+, m_bFwdPicked(false)
 {
     qRegisterMetaType<MNEInverseOperator::SPtr>("MNEInverseOperator::SPtr");
 }
@@ -113,17 +123,61 @@ void RtInvOp::run()
 
     while(m_bIsRunning)
     {
-        if(m_vecNoiseCov.size() > 0)
+        //
+        // Only the latest noise covariance matters, older ones are superseded
+        //
+        mutex.lock();
+        bool t_bNewCov = !m_vecNoiseCov.isEmpty();
+        FiffCov t_noiseCov;
+        if(t_bNewCov)
         {
-            // Restrict forward solution as necessary for MEG
-            MNEForwardSolution t_forwardMeg = m_pFwd->pick_types(true, false);
+            t_noiseCov = m_vecNoiseCov.last();
+            m_vecNoiseCov.clear();
+        }
+        mutex.unlock();
 
-            mutex.lock();
-            MNEInverseOperator::SPtr t_invOpMeg(new MNEInverseOperator(*m_pFiffInfo.data(), t_forwardMeg, m_vecNoiseCov[0], 0.2f, 0.8f));
-            m_vecNoiseCov.pop_front();
-            mutex.unlock();
+        if(t_bNewCov)
+            emit invOperatorCalculated(updateInvOp(t_noiseCov));
+        else
+            msleep(10);
+    }
+}
 
-            emit invOperatorCalculated(t_invOpMeg);
-        }
+
+//*************************************************************************************************************
+
+MNEInverseOperator::SPtr RtInvOp::updateInvOp(const FiffCov &p_noiseCov)
+{
+    // Restrict forward solution as necessary for MEG, the gain matrix is not copied
+    if(!m_bFwdPicked)
+    {
+        m_fwdMegView = MNEForwardSolutionView(*m_pFwd).pick_types(true, false);
+        m_fwdMeg = m_fwdMegView.materialize(false);
+        m_bFwdPicked = true;
+        m_qListChNames.clear();
+
+        m_pOrientPrior = FiffCov::SDPtr();
+        if(!m_fwdMeg.isFixedOrient())
+            m_pOrientPrior = FiffCov::SDPtr(new FiffCov(m_fwdMegView.compute_orient_prior(RTINV_LOOSE)));
     }
+
+    FiffInfo t_gainInfo;
+    MatrixXd t_matGain;
+    MatrixXd t_matWhitener;
+    qint32 t_iNumNonZero;
+    FiffCov t_noiseCov;
+    m_fwdMegView.prepare_forward(*m_pFiffInfo.data(), p_noiseCov, false, t_gainInfo, t_matGain, t_noiseCov, t_matWhitener, t_iNumNonZero);
+
+    //
+    // The depth prior and the Gram matrix depend on the selected channels only
+    //
+    if(t_gainInfo.ch_names != m_qListChNames)
+    {
+        MatrixXd t_matPatchAreas;
+        m_pDepthPrior = FiffCov::SDPtr(new FiffCov(MNEForwardSolution::compute_depth_prior(t_matGain, t_gainInfo, m_fwdMeg.isFixedOrient(), RTINV_DEPTH, 10.0, t_matPatchAreas, true)));
+        m_matGainRGt.resize(0, 0);
+        m_qListChNames = t_gainInfo.ch_names;
+    }
+
+    return MNEInverseOperator::SPtr(new MNEInverseOperator(MNEInverseOperator::make_inverse_operator(*m_pFiffInfo.data(), m_fwdMeg, t_gainInfo, t_matGain, t_noiseCov, t_matWhitener, t_iNumNonZero, m_pDepthPrior, m_pOrientPrior, RTINV_DEPTH, &m_matGainRGt)));
 }
@@ -57,6 +57,7 @@
 //=============================================================================================================
 
 #include <mne/mne_forwardsolution.h>
+#include <mne/mne_forwardsolution_view.h>
 #include <mne/mne_inverse_operator.h>
 
 
@@ -169,6 +170,18 @@ protected:
     virtual void run();
 
 private:
+    //=========================================================================================================
+    /**
+    * Computes the inverse operator for a new noise covariance. The picked forward solution, depth and orientation prior
+    * and the source weighted Gram matrix of the gain are kept across updates; they are only recomputed when the
+    * selected channel set (e.g. the bad channels) changes.
+    *
+    * @param[in] p_noiseCov     Noise covariance estimation
+    *
+    * @return the inverse operator
+    */
+    MNEInverseOperator::SPtr updateInvOp(const FiffCov &p_noiseCov);
+
     QMutex      mutex;                  /**< Provides access serialization between threads. */
     bool        m_bIsRunning;           /**< Whether RtInv is running. */
 
@@ -176,6 +189,14 @@ private:
 
     FiffInfo::SPtr m_pFiffInfo;         /**< The fiff measurement information. */
     MNEForwardSolution::SPtr m_pFwd;    /**< The forward solution. */
+
+    MNEForwardSolutionView m_fwdMegView;    /**< MEG pick of the forward solution, sharing its gain matrix. */
+    MNEForwardSolution m_fwdMeg;            /**< Description of the MEG pick without gain matrix, for the inverse operator. */
+    bool m_bFwdPicked;                      /**< Whether m_fwdMegView and m_fwdMeg are valid. */
+    QStringList m_qListChNames;         /**< Channels the cached priors and m_matGainRGt belong to. */
+    FiffCov::SDPtr m_pDepthPrior;       /**< Cached depth prior. */
+    FiffCov::SDPtr m_pOrientPrior;      /**< Cached orientation prior, NULL for fixed orientations. */
+    MatrixXd m_matGainRGt;              /**< Cached G*R*G' of the unwhitened gain and the unscaled source covariance. */
 };
 
 //*************************************************************************************************************
@@ -0,0 +1,183 @@
+//=============================================================================================================
+/**
+* @file     rtkernelholder.h
+* @author   MNE-CPP authors
+* @version  1.0
+* @date     October, 2026
+*
+* @section  LICENSE
+*
+* Copyright (C) 2026, MNE-CPP authors. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief     RtKernelHolder class declaration.
+*
+*/
+
+#ifndef RTKERNELHOLDER_H
+#define RTKERNELHOLDER_H
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "rtinv_global.h"
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QAtomicPointer>
+#include <QSharedPointer>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE NAMESPACE RTINVLIB
+//=============================================================================================================
+
+namespace RTINVLIB
+{
+
+//=============================================================================================================
+/**
+* Hands inverse kernels (e.g. a set up MinimumNorm) from the thread computing them to a single consumer thread
+* which applies them to the data. The producer publishes a new kernel with one atomic exchange; the consumer picks it up
+* with another one at the start of its next block. Neither side ever waits for the other: the expensive kernel setup
+* is done before publishing, and a kernel which is replaced while still in use stays alive through its reference count
+* until the consumer drops it (read-copy-update). A kernel published while an older one is still pending supersedes it.
+*
+* @brief Lock-free hot-swap of reference counted kernels between two threads
+*/
+template<class T>
+class RtKernelHolder
+{
+public:
+    typedef QSharedPointer<RtKernelHolder> SPtr;             /**< Shared pointer type for RtKernelHolder. */
+    typedef QSharedPointer<const RtKernelHolder> ConstSPtr;  /**< Const shared pointer type for RtKernelHolder. */
+
+    //=========================================================================================================
+    /**
+    * Creates an empty kernel holder.
+    */
+    RtKernelHolder();
+
+    //=========================================================================================================
+    /**
+    * Destroys the kernel holder and a pending kernel, if any.
+    */
+    ~RtKernelHolder();
+
+    //=========================================================================================================
+    /**
+    * Publishes a new kernel. May be called from any thread.
+    *
+    * @param[in] p_pKernel  The kernel which replaces the current one
+    */
+    void publish(const QSharedPointer<T> &p_pKernel);
+
+    //=========================================================================================================
+    /**
+    * Returns the latest published kernel. Must only be called from the consumer thread. The returned reference keeps
+    * the kernel valid for as long as it is held, independent of later publications.
+    *
+    * @return the current kernel, NULL if none was published yet
+    */
+    QSharedPointer<T> acquire();
+
+    //=========================================================================================================
+    /**
+    * Drops the current and pending kernel. Must only be called from the consumer thread.
+    */
+    void reset();
+
+private:
+    RtKernelHolder(const RtKernelHolder &);             /**< Not copyable. */
+    RtKernelHolder& operator=(const RtKernelHolder &);  /**< Not copyable. */
+
+    QAtomicPointer< QSharedPointer<T> > m_pPending;     /**< Published kernel, not yet taken over by the consumer. */
+    QSharedPointer<T>                   m_pCurrent;     /**< Kernel in use by the consumer, only touched by the consumer. */
+};
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+template<class T>
+RtKernelHolder<T>::RtKernelHolder()
+: m_pPending(0)
+{
+}
+
+
+//*************************************************************************************************************
+
+template<class T>
+RtKernelHolder<T>::~RtKernelHolder()
+{
+    delete m_pPending.fetchAndStoreAcquire(0);
+}
+
+
+//*************************************************************************************************************
+
+template<class T>
+void RtKernelHolder<T>::publish(const QSharedPointer<T> &p_pKernel)
+{
+    //
+    // The exchange hands out exclusive ownership: whatever comes back was never seen by the consumer
+    //
+    delete m_pPending.fetchAndStoreOrdered(new QSharedPointer<T>(p_pKernel));
+}
+
+
+//*************************************************************************************************************
+
+template<class T>
+QSharedPointer<T> RtKernelHolder<T>::acquire()
+{
+    QSharedPointer<T>* t_pPending = m_pPending.fetchAndStoreAcquire(0);
+    if(t_pPending)
+    {
+        m_pCurrent = *t_pPending;
+        delete t_pPending;
+    }
+    return m_pCurrent;
+}
+
+
+//*************************************************************************************************************
+
+template<class T>
+void RtKernelHolder<T>::reset()
+{
+    delete m_pPending.fetchAndStoreAcquire(0);
+    m_pCurrent.clear();
+}
+
+} // NAMESPACE
+
+#endif // RTKERNELHOLDER_H
@@ -57,6 +57,30 @@
 #include <Eigen/Core>
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// SIMD INCLUDES
+//=============================================================================================================
+
+#if defined(__AVX2__)
+#define IOUTILS_USE_AVX2
+#endif
+#if defined(__SSSE3__)
+#define IOUTILS_USE_SSSE3
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IOUTILS_USE_SSE2
+#endif
+
+#if defined(IOUTILS_USE_AVX2)
+#include <immintrin.h>
+#elif defined(IOUTILS_USE_SSSE3)
+#include <tmmintrin.h>
+#elif defined(IOUTILS_USE_SSE2)
+#include <emmintrin.h>
+#endif
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // USED NAMESPACES
@@ -236,3 +260,144 @@ void IOUtils::swap_doublep(double *source)
 
     return;
 }
+
+
+//*************************************************************************************************************
+
+void IOUtils::swap_bytes_16(const void *source, void *dest, qint64 n)
+{
+    const unsigned char *csource = (const unsigned char *)source;
+    unsigned char *cdest = (unsigned char *)dest;
+    unsigned char c0, c1;
+    qint64 k = 0;
+
+#if defined(IOUTILS_USE_AVX2)
+    const __m256i mask256 = _mm256_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14,
+                                             1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+    for(; k + 16 <= n; k += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(csource + 2*k));
+        _mm256_storeu_si256((__m256i *)(cdest + 2*k), _mm256_shuffle_epi8(v, mask256));
+    }
+#endif
+#if defined(IOUTILS_USE_SSSE3)
+    const __m128i mask = _mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+    for(; k + 8 <= n; k += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(csource + 2*k));
+        _mm_storeu_si128((__m128i *)(cdest + 2*k), _mm_shuffle_epi8(v, mask));
+    }
+#elif defined(IOUTILS_USE_SSE2)
+    for(; k + 8 <= n; k += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(csource + 2*k));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *)(cdest + 2*k), v);
+    }
+#endif
+
+    for(; k < n; ++k)
+    {
+        c0 = csource[2*k];
+        c1 = csource[2*k+1];
+        cdest[2*k]   = c1;
+        cdest[2*k+1] = c0;
+    }
+}
+
+
+//*************************************************************************************************************
+
+void IOUtils::swap_bytes_32(const void *source, void *dest, qint64 n)
+{
+    const unsigned char *csource = (const unsigned char *)source;
+    unsigned char *cdest = (unsigned char *)dest;
+    unsigned char c0, c1, c2, c3;
+    qint64 k = 0;
+
+#if defined(IOUTILS_USE_AVX2)
+    const __m256i mask256 = _mm256_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
+                                             3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
+    for(; k + 8 <= n; k += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(csource + 4*k));
+        _mm256_storeu_si256((__m256i *)(cdest + 4*k), _mm256_shuffle_epi8(v, mask256));
+    }
+#endif
+#if defined(IOUTILS_USE_SSSE3)
+    const __m128i mask = _mm_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
+    for(; k + 4 <= n; k += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(csource + 4*k));
+        _mm_storeu_si128((__m128i *)(cdest + 4*k), _mm_shuffle_epi8(v, mask));
+    }
+#elif defined(IOUTILS_USE_SSE2)
+    for(; k + 4 <= n; k += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(csource + 4*k));
+        // swap the 16 bit words within each 32 bit element, then the bytes within each word
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *)(cdest + 4*k), v);
+    }
+#endif
+
+    for(; k < n; ++k)
+    {
+        c0 = csource[4*k];
+        c1 = csource[4*k+1];
+        c2 = csource[4*k+2];
+        c3 = csource[4*k+3];
+        cdest[4*k]   = c3;
+        cdest[4*k+1] = c2;
+        cdest[4*k+2] = c1;
+        cdest[4*k+3] = c0;
+    }
+}
+
+
+//*************************************************************************************************************
+
+void IOUtils::swap_bytes_64(const void *source, void *dest, qint64 n)
+{
+    const unsigned char *csource = (const unsigned char *)source;
+    unsigned char *cdest = (unsigned char *)dest;
+    unsigned char c[8];
+    qint64 k = 0;
+    int i;
+
+#if defined(IOUTILS_USE_AVX2)
+    const __m256i mask256 = _mm256_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8,
+                                             7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+    for(; k + 4 <= n; k += 4)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(csource + 8*k));
+        _mm256_storeu_si256((__m256i *)(cdest + 8*k), _mm256_shuffle_epi8(v, mask256));
+    }
+#endif
+#if defined(IOUTILS_USE_SSSE3)
+    const __m128i mask = _mm_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+    for(; k + 2 <= n; k += 2)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(csource + 8*k));
+        _mm_storeu_si128((__m128i *)(cdest + 8*k), _mm_shuffle_epi8(v, mask));
+    }
+#elif defined(IOUTILS_USE_SSE2)
+    for(; k + 2 <= n; k += 2)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(csource + 8*k));
+        // reverse the 16 bit words within each 64 bit element, then the bytes within each word
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(0,1,2,3)), _MM_SHUFFLE(0,1,2,3));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *)(cdest + 8*k), v);
+    }
+#endif
+
+    for(; k < n; ++k)
+    {
+        for(i = 0; i < 8; ++i)
+            c[i] = csource[8*k+i];
+        for(i = 0; i < 8; ++i)
+            cdest[8*k+i] = c[7-i];
+    }
+}
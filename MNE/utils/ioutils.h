@@ -194,6 +194,42 @@ public:
     * @return swapped double
     */
     static void swap_doublep(double *source);
+
+    //=========================================================================================================
+    /**
+    * Bulk byte swap of 2 byte elements (short, unsigned short, dau_pack16).
+    * Uses SSE2/SSSE3/AVX2 shuffles when the compiler targets them and falls back to a scalar loop otherwise.
+    * source and dest may be identical (in-place swap) but must not overlap otherwise.
+    *
+    * @param[in] source     elements to swap
+    * @param[out] dest      swapped elements
+    * @param[in] n          number of elements
+    */
+    static void swap_bytes_16(const void *source, void *dest, qint64 n);
+
+    //=========================================================================================================
+    /**
+    * Bulk byte swap of 4 byte elements (int, unsigned int, float, complex float components).
+    * Uses SSE2/SSSE3/AVX2 shuffles when the compiler targets them and falls back to a scalar loop otherwise.
+    * source and dest may be identical (in-place swap) but must not overlap otherwise.
+    *
+    * @param[in] source     elements to swap
+    * @param[out] dest      swapped elements
+    * @param[in] n          number of elements
+    */
+    static void swap_bytes_32(const void *source, void *dest, qint64 n);
+
+    //=========================================================================================================
+    /**
+    * Bulk byte swap of 8 byte elements (long, double, complex double components).
+    * Uses SSE2/SSSE3/AVX2 shuffles when the compiler targets them and falls back to a scalar loop otherwise.
+    * source and dest may be identical (in-place swap) but must not overlap otherwise.
+    *
+    * @param[in] source     elements to swap
+    * @param[out] dest      swapped elements
+    * @param[in] n          number of elements
+    */
+    static void swap_bytes_64(const void *source, void *dest, qint64 n);
 };
 
 //*************************************************************************************************************
@@ -47,7 +47,6 @@
 //=============================================================================================================
 
 #include <math.h>
-#include <iostream>
 #include <algorithm>
 #include <vector>
 #include <time.h>
@@ -59,6 +58,7 @@
 //=============================================================================================================
 
 #include <QDebug>
+#include <QtConcurrent>
 
 
 //*************************************************************************************************************
@@ -69,6 +69,60 @@
 using namespace UTILSLIB;
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// LOCAL HELPERS
+//=============================================================================================================
+
+namespace
+{
+
+/**
+* Squared norms of the rows of X, accumulated column by column to stream through the column major storage.
+*
+* @param[in] X  Input data (rows = points; cols = p dimensional space)
+*
+* @return the squared row norms
+*/
+VectorXd squaredRowNorms(const MatrixXd& X)
+{
+    VectorXd norms = VectorXd::Zero(X.rows());
+    for(qint32 j = 0; j < X.cols(); ++j)
+        norms += X.col(j).cwiseAbs2();
+    return norms;
+}
+
+} // anonymous namespace
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE NESTED STRUCTS
+//=============================================================================================================
+
+/**
+* One K-Means replicate. Each replicate runs on its own copy of the KMeans object, which holds the iteration state
+* and the random generator, so that the replicates can be computed in parallel.
+*/
+struct KMeans::Replicate
+{
+    KMeans              kMeans;     /**< Copy of the KMeans object, holds the replicate state */
+    const MatrixXd*     pX;         /**< Input data */
+    const RowVectorXd*  pXmins;     /**< Minimal coordinates, uniform initialization */
+    const RowVectorXd*  pXmaxs;     /**< Maximal coordinates, uniform initialization */
+    VectorXi            idx;        /**< Resulting cluster indeces */
+    MatrixXd            C;          /**< Resulting centroids */
+    VectorXd            sumD;       /**< Resulting cluster-wise sums of distances */
+    MatrixXd            D;          /**< Resulting distances */
+    bool                bSuccess;   /**< Whether the replicate finished without an empty cluster error */
+
+    void compute()
+    {
+        bSuccess = kMeans.replicate(*pX, *pXmins, *pXmaxs, idx, C, sumD, D);
+    }
+};
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -81,6 +135,8 @@ KMeans::KMeans(QString distance, QString start, qint32 replicates, QString empty
 , m_sEmptyact(emptyact)
 , m_iMaxit(maxit)
 , m_bOnline(online)
+, m_iBatchSize(0)
+, m_iRandState(1)
 {
     // Assume one replicate
     if (m_iReps < 1)
@@ -95,9 +151,6 @@ bool KMeans::calculate( MatrixXd X, qint32 kClusters, VectorXi& idx, MatrixXd& C
     if (kClusters < 1)
         return false;
 
-    //Init random generator
-    srand ( time(NULL) );
-
 // n points in p dimensional space
     k = kClusters;
     n = X.rows();
@@ -105,13 +158,13 @@ bool KMeans::calculate( MatrixXd X, qint32 kClusters, VectorXi& idx, MatrixXd& C
 
     if(m_sDistance.compare("cosine") == 0)
     {
-//        Xnorm = sqrt(sum(X.^2, 2));
-//        if any(min(Xnorm) <= eps(max(Xnorm)))
-//            error(['Some points have small relative magnitudes, making them ', ...
-//                   'effectively zero.\nEither remove those points, or choose a ', ...
-//                   'distance other than ''cosine''.']);
-//        end
-//        X = X ./ Xnorm(:,ones(1,p));
+        VectorXd Xnorm = X.rowwise().norm();
+        if(Xnorm.minCoeff() <= std::numeric_limits<double>::epsilon() * Xnorm.maxCoeff())
+        {
+            printf("Error: Some points have small relative magnitudes, making them effectively zero. Either remove those points, or choose a distance other than cosine.\n");
+            return false;
+        }
+        X.array() /= Xnorm.replicate(1,p).array();
     }
     else if(m_sDistance.compare("correlation")==0)
     {
@@ -148,175 +201,289 @@ bool KMeans::calculate( MatrixXd X, qint32 kClusters, VectorXi& idx, MatrixXd& C
     //
     // Done with input argument processing, begin clustering
     //
-    if (m_bOnline)
+
+    //Init random generator, each replicate gets its own seed
+    quint32 t_iSeed = (quint32)time(NULL);
+
+    QList<Replicate> t_qListReplicates;
+    for(qint32 rep = 0; rep < m_iReps; ++rep)
     {
-        Del = MatrixXd(n,k);
-        Del.fill(std::numeric_limits<double>::quiet_NaN());// reassignment criterion
+        Replicate t_replicate;
+        t_replicate.kMeans = *this;
+        t_replicate.kMeans.m_iRandState = (t_iSeed + rep) * 2654435761u;
+        if(t_replicate.kMeans.m_iRandState == 0)
+            t_replicate.kMeans.m_iRandState = 1;
+        t_replicate.pX = &X;
+        t_replicate.pXmins = &Xmins;
+        t_replicate.pXmaxs = &Xmaxs;
+        t_replicate.bSuccess = false;
+        t_qListReplicates.append(t_replicate);
     }
 
+    if(m_iReps > 1)
+        QtConcurrent::blockingMap(t_qListReplicates, &Replicate::compute);
+    else
+        t_qListReplicates[0].compute();
+
+    // Return the best solution; if an empty cluster error occurred in one of multiple replicates, move on to
+    // the next replicate. Error only when all replicates fail.
     double totsumDBest = std::numeric_limits<double>::max();
+    qint32 t_iBest = -1;
     emptyErrCnt = 0;
-
-    VectorXi idxBest;
-    MatrixXd Cbest;
-    VectorXd sumDBest;
-    MatrixXd Dbest;
-
     for(qint32 rep = 0; rep < m_iReps; ++rep)
     {
-        if (m_sStart.compare("uniform") == 0)
+        if(!t_qListReplicates[rep].bSuccess)
         {
-            C = MatrixXd::Zero(k,p);
-            for(qint32 i = 0; i < k; ++i)
-                for(qint32 j = 0; j < p; ++j)
-                    C(i,j) = unifrnd(Xmins[j], Xmaxs[j]);
-            // For 'cosine' and 'correlation', these are uniform inside a subset
-            // of the unit hypersphere.  Still need to center them for
-            // 'correlation'.  (Re)normalization for 'cosine'/'correlation' is
-            // done at each iteration.
-            if (m_sDistance.compare("correlation") == 0)
-                C.array() -= (C.array().rowwise().sum()/p).replicate(1, p).array();
+            ++emptyErrCnt;
+            continue;
         }
-        else if (m_sStart.compare("sample") == 0)
+
+        if(t_qListReplicates[rep].kMeans.totsumD < totsumDBest)
         {
-            C = MatrixXd::Zero(k,p);
-            for(qint32 i = 0; i < k; ++i)
-                C.block(i,0,1,p) = X.block(rand() % n, 0, 1, p);
-            // DEBUG
-//            C.block(0,0,1,p) = X.block(2, 0, 1, p);
-//            C.block(1,0,1,p) = X.block(7, 0, 1, p);
-//            C.block(2,0,1,p) = X.block(17, 0, 1, p);
+            totsumDBest = t_qListReplicates[rep].kMeans.totsumD;
+            t_iBest = rep;
         }
-    //    else if (start.compare("cluster") == 0)
-    //    {
-    //        Xsubset = X(randsample(n,floor(.1*n)),:);
-    //        [dum, C] = kmeans(Xsubset, k, varargin{:}, 'start','sample', 'replicates',1);
-    //    }
-    //    else if (start.compare("numeric") == 0)
-    //    {
-    //        C = CC(:,:,rep);
-    //    }
-
-        // Compute the distance from every point to each cluster centroid and the
-        // initial assignment of points to clusters
-        D = distfun(X, C);//, 0);
-        idx = VectorXi::Zero(D.rows());
-        d = VectorXd::Zero(D.rows());
+    }
+
+    if(t_iBest < 0)
+        return false;
+
+    idx = t_qListReplicates[t_iBest].idx;
+    C = t_qListReplicates[t_iBest].C;
+    sumD = t_qListReplicates[t_iBest].sumD;
+    D = t_qListReplicates[t_iBest].D;
+    totsumD = totsumDBest;
+
+//if hadNaNs
+//    idx = statinsertnan(wasnan, idx);
+//end
+    return true;
+}
 
-        for(qint32 i = 0; i < D.rows(); ++i)
-            d[i] = D.row(i).minCoeff(&idx[i]);
 
-        m = VectorXi::Zero(k);
+//*************************************************************************************************************
+
+void KMeans::setMiniBatch(qint32 p_iBatchSize)
+{
+    m_iBatchSize = p_iBatchSize > 0 ? p_iBatchSize : 0;
+}
+
+
+//*************************************************************************************************************
+
+bool KMeans::replicate(const MatrixXd& X, const RowVectorXd& Xmins, const RowVectorXd& Xmaxs, VectorXi& idx, MatrixXd& C, VectorXd& sumD, MatrixXd& D)
+{
+    if (m_sStart.compare("uniform") == 0)
+    {
+        C = MatrixXd::Zero(k,p);
+        for(qint32 i = 0; i < k; ++i)
+            for(qint32 j = 0; j < p; ++j)
+                C(i,j) = unifrnd(Xmins[j], Xmaxs[j]);
+        // For 'cosine' and 'correlation', these are uniform inside a subset
+        // of the unit hypersphere.  Still need to center them for
+        // 'correlation'.  (Re)normalization for 'cosine'/'correlation' is
+        // done at each iteration.
+        if (m_sDistance.compare("correlation") == 0)
+            C.array() -= (C.array().rowwise().sum()/p).replicate(1, p).array();
+    }
+    else if (m_sStart.compare("sample") == 0)
+    {
+        C = MatrixXd::Zero(k,p);
         for(qint32 i = 0; i < k; ++i)
-            for (qint32 j = 0; j < idx.rows(); ++j)
-                if(idx[j] == i)
-                    ++ m[i];
+            C.row(i) = X.row(randi(n));
+    }
+    else if (m_sStart.compare("plus") == 0)
+        initPlus(X, C);
+//    else if (start.compare("cluster") == 0)
+//    {
+//        Xsubset = X(randsample(n,floor(.1*n)),:);
+//        [dum, C] = kmeans(Xsubset, k, varargin{:}, 'start','sample', 'replicates',1);
+//    }
+//    else if (start.compare("numeric") == 0)
+//    {
+//        C = CC(:,:,rep);
+//    }
 
-        try // catch empty cluster errors and move on to next rep
-        {
-            // Begin phase one:  batch reassignments
-            bool converged = batchUpdate(X, C, idx);
+    // Large data sets: fit the centroids on mini-batches first, the batch reassignments
+    // below then only need a few iterations and the single reassignments are skipped
+    bool t_bMiniBatch = m_iBatchSize > 0 && n > 2*m_iBatchSize;
+    if (t_bMiniBatch)
+        miniBatchUpdate(X, C);
 
-            // Begin phase two:  single reassignments
-            if (m_bOnline)
-                converged = onlineUpdate(X, C, idx);
+    bool t_bOnline = m_bOnline && !t_bMiniBatch;
+    if (t_bOnline)
+    {
+        Del = MatrixXd(n,k);
+        Del.fill(std::numeric_limits<double>::quiet_NaN());// reassignment criterion
+    }
+
+    // Compute the distance from every point to each cluster centroid and the
+    // initial assignment of points to clusters
+    D = distfun(X, C);
+    idx = VectorXi::Zero(D.rows());
+    d = VectorXd::Zero(D.rows());
+
+    for(qint32 i = 0; i < D.rows(); ++i)
+        d[i] = D.row(i).minCoeff(&idx[i]);
+
+    m = VectorXi::Zero(k);
+    for (qint32 j = 0; j < idx.rows(); ++j)
+        ++ m[idx[j]];
 
-            if (!converged)
-                printf("Failed To Converge during replicate %d\n", rep);
+    try // catch empty cluster errors and move on to next rep
+    {
+        // Begin phase one:  batch reassignments
+        bool converged = batchUpdate(X, C, idx);
+
+        // Begin phase two:  single reassignments
+        if (t_bOnline)
+            converged = onlineUpdate(X, C, idx);
+
+        if (!converged)
+            printf("Failed To Converge during replicate\n");
 
-            // Calculate cluster-wise sums of distances
-            VectorXi nonempties = VectorXi::Zero(m.rows());
-            quint32 count = 0;
-            for(qint32 i = 0; i < m.rows(); ++i)
+        // Calculate cluster-wise sums of distances
+        VectorXi nonempties = VectorXi::Zero(m.rows());
+        quint32 count = 0;
+        for(qint32 i = 0; i < m.rows(); ++i)
+        {
+            if(m[i] > 0)
             {
-                if(m[i] > 0)
-                {
-                    nonempties[i] = 1;
-                    ++count;
-                }
+                nonempties[i] = 1;
+                ++count;
             }
-            MatrixXd C_tmp(count,C.cols());
-            count = 0;
-            for(qint32 i = 0; i < nonempties.rows(); ++i)
+        }
+        MatrixXd C_tmp(count,C.cols());
+        count = 0;
+        for(qint32 i = 0; i < nonempties.rows(); ++i)
+        {
+            if(nonempties[i])
             {
-                if(nonempties[i])
-                {
-                    C_tmp.row(count) = C.row(i);
-                    ++count;
-                }
+                C_tmp.row(count) = C.row(i);
+                ++count;
             }
+        }
 
-            MatrixXd D_tmp = distfun(X, C_tmp);//, iter);
-            count = 0;
-            for(qint32 i = 0; i < nonempties.rows(); ++i)
+        MatrixXd D_tmp = distfun(X, C_tmp);
+        count = 0;
+        for(qint32 i = 0; i < nonempties.rows(); ++i)
+        {
+            if(nonempties[i])
             {
-                if(nonempties[i])
-                {
-                    D.col(i) = D_tmp.col(count);
-                    C.row(i) = C_tmp.row(count);
-                    ++count;
-                }
+                D.col(i) = D_tmp.col(count);
+                C.row(i) = C_tmp.row(count);
+                ++count;
             }
+        }
 
-            d = VectorXd::Zero(n);
-            for(qint32 i = 0; i < n; ++i)
-                d[i] += D.array()(idx[i]*n+i);//Colum Major
+        d = VectorXd::Zero(n);
+        for(qint32 i = 0; i < n; ++i)
+            d[i] += D.array()(idx[i]*n+i);//Colum Major
 
-            sumD = VectorXd::Zero(k);
-            for(qint32 i = 0; i < k; ++i)
-                for (qint32 j = 0; j < idx.rows(); ++j)
-                    if(idx[j] == i)
-                        sumD[i] += d[j];
+        sumD = VectorXd::Zero(k);
+        for (qint32 j = 0; j < idx.rows(); ++j)
+            sumD[idx[j]] += d[j];
 
-            totsumD = sumD.array().sum();
+        totsumD = sumD.array().sum();
 
-//            printf("%d iterations, total sum of distances = %f\n", iter, totsumD);
+//        printf("%d iterations, total sum of distances = %f\n", iter, totsumD);
+    }
+    catch (int e)
+    {
+        if(e == 0)
+            return false;
+    } // catch
 
-            // Save the best solution so far
-            if (totsumD < totsumDBest)
-            {
-                totsumDBest = totsumD;
-                idxBest = idx;
-                Cbest = C;
-                sumDBest = sumD;
-                Dbest = D;
-            }
-        }
-        catch (int e)
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+void KMeans::initPlus(const MatrixXd& X, MatrixXd& C)
+{
+    C = MatrixXd::Zero(k,p);
+
+    VectorXd Xnorm2;
+    if (m_sDistance.compare("sqeuclidean") == 0)
+        Xnorm2 = squaredRowNorms(X);
+
+    // Distance of every point to its closest centroid chosen so far
+    VectorXd minD = VectorXd::Constant(n, std::numeric_limits<double>::max());
+    VectorXd Di;
+
+    qint32 sample = randi(n);
+    for(qint32 i = 0; i < k; ++i)
+    {
+        if(i > 0)
         {
-            if(e == 0)
+            // Draw the next centroid with a probability proportional to minD
+            double r = rand01() * minD.sum();
+            sample = -1;
+            for(qint32 j = 0; j < n; ++j)
             {
-                // If an empty cluster error occurred in one of multiple replicates, catch
-                // it, warn, and move on to next replicate.  Error only when all replicates
-                // fail.  Rethrow an other kind of error.
-                if (m_iReps == 1)
-                    return false;
-                else
+                if(minD[j] > 0)
                 {
-                    emptyErrCnt = emptyErrCnt + 1;
-//                    printf("Replicate %d terminated: empty cluster created at iteration %d.\n", rep, iter);
-                    if (emptyErrCnt == m_iReps)
-                    {
-//                        error(message('EmptyClusterAllReps'));
-                        return false;
-                    }
-
+                    sample = j;
+                    r -= minD[j];
+                    if(r < 0)
+                        break;
                 }
             }
-        } // catch
+            // All points coincide with a centroid
+            if(sample < 0)
+                sample = randi(n);
+        }
 
-    } // replicates
+        C.row(i) = X.row(sample);
 
-    // Return the best solution
-    idx = idxBest;
-    C = Cbest;
-    sumD = sumDBest;
-    D = Dbest;
+        if (m_sDistance.compare("sqeuclidean") == 0)
+        {
+            Di = Xnorm2 - 2.0 * X * C.row(i).transpose();
+            Di.array() += C.row(i).squaredNorm();
+            Di = Di.array().max(0.0);
+        }
+        else
+            Di = distfun(X, C.row(i)).col(0);
 
-//if hadNaNs
-//    idx = statinsertnan(wasnan, idx);
-//end
-    return true;
+        minD = minD.cwiseMin(Di);
+    }
+}
+
+
+//*************************************************************************************************************
+
+void KMeans::miniBatchUpdate(const MatrixXd& X, MatrixXd& C)
+{
+    // Points assigned to each centroid so far, the learning rate of a centroid is 1/count.
+    // The initial centroid counts as one point, so that the initialization isn't discarded.
+    VectorXi counts = VectorXi::Ones(k);
+
+    MatrixXd Xbatch(m_iBatchSize, p);
+    MatrixXd C_prev;
+    qint32 c;
+
+    for(iter = 0; iter < m_iMaxit; ++iter)
+    {
+        for(qint32 i = 0; i < m_iBatchSize; ++i)
+            Xbatch.row(i) = X.row(randi(n));
+
+        MatrixXd Dbatch = distfun(Xbatch, C);
+
+        // Gradient steps towards the batch means; cityblock medians are approximated
+        // by the means here and recovered by the batch reassignments
+        C_prev = C;
+        for(qint32 i = 0; i < m_iBatchSize; ++i)
+        {
+            Dbatch.row(i).minCoeff(&c);
+            ++counts[c];
+            C.row(c) += (Xbatch.row(i) - C.row(c)) / counts[c];
+        }
+
+        // The centroids settled
+        if((C - C_prev).squaredNorm() <= 1e-8 * C.squaredNorm())
+            break;
+    }
 }
 
 
@@ -583,6 +750,11 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
     }
     changed.conservativeResize(count);
 
+    // Squared norms of the points, the distances to a centroid are then one matrix-vector product
+    VectorXd Xnorm2;
+    if (m_sDistance.compare("sqeuclidean") == 0)
+        Xnorm2 = squaredRowNorms(X);
+
     qint32 lastmoved = 0;
     qint32 nummoved = 0;
     qint32 iter1 = iter;
@@ -619,7 +791,10 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
 
                 Del.col(i) = ((double)m[i] / ((double)m[i] + sgn.cast<double>().array()));
 
-                Del.col(i).array() *= (X - C.row(i).replicate(n,1)).array().pow(2).rowwise().sum().array();
+                // ||x - c||^2 = ||x||^2 - 2 x c' + ||c||^2
+                VectorXd Di = Xnorm2 - 2.0 * X * C.row(i).transpose();
+                Di.array() += C.row(i).squaredNorm();
+                Del.col(i).array() *= Di.array().max(0.0);
             }
         }
         else if (m_sDistance.compare("cityblock") == 0)
@@ -680,10 +855,6 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
                 Del.col(i) = 1 + sgn.cast<double>().array()*
                         (A - (B + 2 * sgn.cast<double>().array() * m[i] * XCi.array() + 1).sqrt());
 
-                std::cout << "Del.col(i)\n" << Del.col(i) << std::endl;
-
-
-
 //                Del(:,i) = 1 + sgn .*...
 //                      (m(i).*normC(i) - sqrt((m(i).*normC(i)).^2 + 2.*sgn.*m(i).*XCi + 1));
             }
@@ -849,7 +1020,7 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
         else if (m_sDistance.compare("cosine") == 0 || m_sDistance.compare("correlation") == 0)
         {
             C.row(nidx[0]).array() += (X.row(moved[0]) - C.row(nidx[0])).array() / m[nidx[0]];
-            C.row(oidx).array() += (X.row(moved[0]) - C.row(oidx)).array() / m[oidx];
+            C.row(oidx).array() -= (X.row(moved[0]) - C.row(oidx)).array() / m[oidx];
         }
         else if (m_sDistance.compare("hamming") == 0)
         {
@@ -874,20 +1045,18 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
 
 //*************************************************************************************************************
 //DISTFUN Calculate point to cluster centroid distances.
-MatrixXd KMeans::distfun(const MatrixXd& X, MatrixXd& C)//, qint32 iter)
+MatrixXd KMeans::distfun(const MatrixXd& X, const MatrixXd& C)
 {
-    MatrixXd D = MatrixXd::Zero(n,C.rows());
+    MatrixXd D = MatrixXd::Zero(X.rows(),C.rows());
     qint32 nclusts = C.rows();
 
     if (m_sDistance.compare("sqeuclidean") == 0)
     {
-        for(qint32 i = 0; i < nclusts; ++i)
-        {
-            D.col(i) = (X.col(0).array() - C(i,0)).pow(2);
-
-            for(qint32 j = 1; j < p; ++j)
-                D.col(i) = D.col(i).array() + (X.col(j).array() - C(i,j)).pow(2);
-        }
+        // ||x - c||^2 = ||x||^2 - 2 x c' + ||c||^2, the cross terms of all pairs are one matrix product
+        D.noalias() = -2.0 * X * C.transpose();
+        D.colwise() += squaredRowNorms(X);
+        D.rowwise() += C.rowwise().squaredNorm().transpose();
+        D = D.array().max(0.0); // cancellation may leave small negative values
     }
     else if (m_sDistance.compare("cityblock") == 0)
     {
@@ -903,17 +1072,12 @@ MatrixXd KMeans::distfun(const MatrixXd& X, MatrixXd& C)//, qint32 iter)
     else if (m_sDistance.compare("cosine") == 0 || m_sDistance.compare("correlation") == 0)
     {
         // The points are normalized, centroids are not, so normalize them
-        MatrixXd normC = C.array().pow(2).rowwise().sum().sqrt();
+        VectorXd normC = C.rowwise().norm();
 //        if any(normC < eps(class(normC))) % small relative to unit-length data points
 //            error('Zero cluster centroid created at iteration %d.',iter);
-        for (qint32 i = 0; i < nclusts; ++i)
-        {
-            MatrixXd C_tmp = (C.row(i).array() / normC(i,0)).transpose();
-            D.col(i) = X * C_tmp;//max(1 - X * (C(i,:)./normC(i))', 0);
-            for(qint32 j = 0; j < D.rows(); ++j)
-                if(D(j,i) < 0)
-                    D(j,i) = 0;
-        }
+        MatrixXd Cn = C.array() / normC.replicate(1,p).array();
+        D.noalias() = X * Cn.transpose();
+        D = (1.0 - D.array()).max(0.0); // max(1 - X * (C(i,:)./normC(i))', 0)
     }
 //case 'hamming'
 //    for i = 1:nclusts
@@ -939,36 +1103,33 @@ void KMeans::gcentroids(const MatrixXd& X, const VectorXi& index, const VectorXi
     centroids.fill(std::numeric_limits<double>::quiet_NaN());
     counts = VectorXi::Zero(num);
 
-    VectorXi members;
+    // Position of each cluster in clusts, -1 for clusters which are not requested
+    VectorXi pos = VectorXi::Constant(k, -1);
+    for(qint32 i = 0; i < num; ++i)
+        pos[clusts[i]] = i;
 
-    qint32 c;
+    for(qint32 j = 0; j < index.rows(); ++j)
+        if(pos[index[j]] >= 0)
+            ++counts[pos[index[j]]];
 
-    for(qint32 i = 0; i < num; ++i)
+    if(m_sDistance.compare("sqeuclidean") == 0 || m_sDistance.compare("cosine") == 0 || m_sDistance.compare("correlation") == 0)
     {
-        c = 0;
-        members = VectorXi::Zero(index.rows());
+        // Sum up all clusters within one pass through the points
+        MatrixXd sums = MatrixXd::Zero(num,p);
         for(qint32 j = 0; j < index.rows(); ++j)
-        {
-            if(index[j] == clusts[i])
-            {
-                members[c] = j;
-                ++c;
-            }
-        }
-        members.conservativeResize(c);
-        if (c > 0)
-        {
-            counts[i] = c;
-            if(m_sDistance.compare("sqeuclidean") == 0)
-            {
-                //Initialize
-                if(members.rows() > 0)
-                    centroids.row(i) = RowVectorXd::Zero(centroids.cols());
+            if(pos[index[j]] >= 0)
+                sums.row(pos[index[j]]) += X.row(j);
 
-                for(qint32 j = 0; j < members.rows(); ++j)
-                    centroids.row(i).array() += X.row(members[j]).array() / counts[i];
-            }
-            else if(m_sDistance.compare("cityblock") == 0)
+        for(qint32 i = 0; i < num; ++i)
+            if(counts[i] > 0)
+                centroids.row(i) = sums.row(i) / counts[i]; // unnormalized for cosine and correlation
+    }
+    else if(m_sDistance.compare("cityblock") == 0)
+    {
+        qint32 c;
+        for(qint32 i = 0; i < num; ++i)
+        {
+            if (counts[i] > 0)
             {
                 // Separate out sorted coords for points in i'th cluster,
                 // and use to compute a fast median, component-wise
@@ -993,18 +1154,13 @@ void KMeans::gcentroids(const MatrixXd& X, const VectorXi& index, const VectorXi
                 else
                     centroids.row(i) = Xsorted.row(nn+1);
             }
-            else if(m_sDistance.compare("cosine") == 0 || m_sDistance.compare("correlation") == 0)
-            {
-                for(qint32 j = 0; j < members.rows(); ++j)
-                    centroids.row(i).array() += X.row(members[j]).array() / counts[i]; // unnormalized
-            }
-//            else if(m_sDistance.compare("hamming") == 0)
-//            {
-//                % Compute a fast median for binary data, component-wise
-//                centroids(i,:) = .5*sign(2*sum(X(members,:), 1) - counts(i)) + .5;
-//            }
         }
     }
+//    else if(m_sDistance.compare("hamming") == 0)
+//    {
+//        % Compute a fast median for binary data, component-wise
+//        centroids(i,:) = .5*sign(2*sum(X(members,:), 1) - counts(i)) + .5;
+//    }
 }// function
 
 
@@ -1020,7 +1176,29 @@ double KMeans::unifrnd(double a, double b)
     double mu = a2+b2;
     double sig = b2-a2;
 
-    double r = mu + sig * (2.0* (rand() % 1000)/1000 -1.0);
+    double r = mu + sig * (2.0 * rand01() - 1.0);
 
     return r;
 }
+
+
+//*************************************************************************************************************
+
+double KMeans::rand01()
+{
+    // xorshift32, the state is never zero
+    m_iRandState ^= m_iRandState << 13;
+    m_iRandState ^= m_iRandState >> 17;
+    m_iRandState ^= m_iRandState << 5;
+
+    return m_iRandState / 4294967296.0;
+}
+
+
+//*************************************************************************************************************
+
+qint32 KMeans::randi(qint32 a)
+{
+    qint32 r = (qint32)(rand01() * a);
+    return r < a ? r : a - 1;
+}
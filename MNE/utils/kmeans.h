@@ -90,7 +90,7 @@ public:
     typedef QSharedPointer<const KMeans> ConstSPtr; /**< Const shared pointer type for KMeans. */
 
     //distance {'sqeuclidean','cityblock','cosine','correlation','hamming'};
-    //startNames = {'uniform','sample','cluster'};
+    //startNames = {'uniform','sample','plus','cluster'};
     //emptyactNames = {'error','drop','singleton'};
 
     //=========================================================================================================
@@ -98,8 +98,8 @@ public:
     * Constructs a KMeans algorithm object.
     *
     * @param[in] distance   (optional) K-Means distance measure: "sqeuclidean" (default), "cityblock" , "cosine", "correlation", "hamming"
-    * @param[in] start      (optional) Cluster initialization: "sample" (default), "uniform", "cluster"
-    * @param[in] replicates (optional) Number of K-Means replicates, which are generated. Best is returned.
+    * @param[in] start      (optional) Cluster initialization: "sample" (default), "uniform", "plus" (k-means++), "cluster"
+    * @param[in] replicates (optional) Number of K-Means replicates, which are generated in parallel. Best is returned.
     * @param[in] emptyact   (optional) What happens if a cluster wents empty: "error" (default), "drop", "singleton"
     * @param[in] online     (optional) If centroids should be updated during iterations: true (default), false
     * @param[in] maxit      (optional) maximal number of iterations per replicate; 100 by default
@@ -119,8 +119,57 @@ public:
     */
     bool calculate( MatrixXd X, qint32 kClusters, VectorXi& idx, MatrixXd& C, VectorXd& sumD, MatrixXd& D);
 
+    //=========================================================================================================
+    /**
+    * Sets the mini-batch mode for large data sets. If the number of points exceeds twice the batch size, the
+    * centroids are first fitted on random batches of points, followed by batch reassignments of all points.
+    * The single reassignment phase (online update) is skipped.
+    *
+    * @param[in] p_iBatchSize   Number of points per mini-batch; 0 (default) disables the mini-batch mode.
+    */
+    void setMiniBatch(qint32 p_iBatchSize);
+
 
 private:
+    struct Replicate;
+    friend struct Replicate;
+
+    //=========================================================================================================
+    /**
+    * Runs one K-Means replicate.
+    *
+    * @param[in] X          Input data (rows = points; cols = p dimensional space)
+    * @param[in] Xmins      Minimal coordinates of X, used by the uniform initialization
+    * @param[in] Xmaxs      Maximal coordinates of X, used by the uniform initialization
+    * @param[out] idx       The cluster indeces to which cluster the input points belong to
+    * @param[out] C         Cluster centroids k x p
+    * @param[out] sumD      Summation of the distances to the centroid within one cluster
+    * @param[out] D         Cluster distances to the centroid
+    *
+    * @return true if successful, false if an empty cluster error occured
+    */
+    bool replicate(const MatrixXd& X, const RowVectorXd& Xmins, const RowVectorXd& Xmaxs, VectorXi& idx, MatrixXd& C, VectorXd& sumD, MatrixXd& D);
+
+    //=========================================================================================================
+    /**
+    * k-means++ initialization: the first centroid is a random point, each following centroid is a point drawn
+    * with a probability proportional to its distance to the closest centroid chosen so far.
+    *
+    * @param[in] X      Input data
+    * @param[out] C     The initial centroids
+    */
+    void initPlus(const MatrixXd& X, MatrixXd& C);
+
+    //=========================================================================================================
+    /**
+    * Mini-batch updates of the centroids: each iteration assigns a random batch of points to their closest
+    * centroids and moves the centroids towards them with a per-centroid learning rate.
+    *
+    * @param[in] X          Input data
+    * @param[in, out] C     Cluster centroids
+    */
+    void miniBatchUpdate(const MatrixXd& X, MatrixXd& C);
+
     //=========================================================================================================
     /**
     * Calculate point to cluster centroid distances.
@@ -130,7 +179,7 @@ private:
     *
     * @return Cluster centroid distances
     */
-    MatrixXd distfun(const MatrixXd& X, MatrixXd& C);//, qint32 iter);
+    MatrixXd distfun(const MatrixXd& X, const MatrixXd& C);
 
     //=========================================================================================================
     /**
@@ -181,13 +230,33 @@ private:
     */
     double unifrnd(double a, double b);
 
+    //=========================================================================================================
+    /**
+    * Uniform random generator in the intervall [0, 1), with the state of this instance (xorshift).
+    *
+    * @return random number
+    */
+    double rand01();
+
+    //=========================================================================================================
+    /**
+    * Uniform random integer generator in the intervall [0, a).
+    *
+    * @param[in] a      upper boundary
+    *
+    * @return random integer
+    */
+    qint32 randi(qint32 a);
+
 
     QString m_sDistance;    /**< Distance measurement to use: "sqeuclidean" (default), "cityblock" , "cosine", "correlation", "hamming". */
-    QString m_sStart;       /**< Initialization to use: "sample" (default), "uniform", "cluster". */
+    QString m_sStart;       /**< Initialization to use: "sample" (default), "uniform", "plus", "cluster". */
     qint32 m_iReps;         /**< Number of K-Means replicates, which should be generated. */
     QString m_sEmptyact;    /**< What should be done if a cluster wents empty: "error" (default), "drop", "singleton" */
     qint32 m_iMaxit;        /**< Maximal number of iterations per replicate */
     bool m_bOnline;         /**< If online update should be performed */
+    qint32 m_iBatchSize;    /**< Number of points per mini-batch; 0 if the mini-batch mode is disabled */
+    quint32 m_iRandState;   /**< State of the random generator */
 
     qint32 emptyErrCnt;     /**< Counts the occurence of empty errors */
 
@@ -358,6 +358,71 @@ qint32 MNEMath::rank(const MatrixXd& A, double tol)
 }
 
 
+//*************************************************************************************************************
+
+bool MNEMath::svd_gram(const MatrixXd& A, VectorXd& s, MatrixXd& U, MatrixXd& V, double tol)
+{
+    //
+    //  A' = V*diag(s)*U' for tall matrices, so the Gram matrix is always the small one
+    //
+    if(A.rows() > A.cols())
+        return svd_gram(A.transpose(), s, V, U, tol);
+
+    qint32 m = A.rows();
+    qint32 n = A.cols();
+    qint32 i, r;
+
+    MatrixXd t_matGram = MatrixXd::Zero(m, m);
+    t_matGram.selfadjointView<Lower>().rankUpdate(A);
+    SelfAdjointEigenSolver<MatrixXd> t_eig(t_matGram);
+
+    bool t_bGram = t_eig.info() == Success;
+    if(t_bGram)
+    {
+        //
+        //  Eigenvalues are ascending, singular values descending
+        //
+        s.resize(m);
+        U.resize(m, m);
+        for(i = 0; i < m; ++i)
+        {
+            s[i] = sqrt(std::max(t_eig.eigenvalues()[m-1-i], 0.0));
+            U.col(i) = t_eig.eigenvectors().col(m-1-i);
+        }
+
+        for(r = 0; r < m && s[r] > tol*s[0]; ++r);
+
+        V.resize(n, m);
+        V.leftCols(r).noalias() = A.transpose()*U.leftCols(r);
+        for(i = 0; i < r; ++i)
+            V.col(i) /= s[i];
+        V.rightCols(m-r).setZero();
+        s.tail(m-r).setZero();
+
+        //
+        //  Squaring the condition number may have cost too much accuracy: V has to be orthonormal
+        //
+        if(r > 0)
+        {
+            MatrixXd t_matVtV = V.leftCols(r).transpose()*V.leftCols(r);
+            t_matVtV.diagonal().array() -= 1.0;
+            t_bGram = t_matVtV.cwiseAbs().maxCoeff() < 1e-6;
+        }
+    }
+
+    if(!t_bGram)
+    {
+        printf("Gram matrix decomposition not accurate enough, falling back to JacobiSVD.\n");
+        JacobiSVD<MatrixXd> t_svd(A, ComputeThinU | ComputeThinV);
+        s = t_svd.singularValues();
+        U = t_svd.matrixU();
+        V = t_svd.matrixV();
+    }
+
+    return t_bGram;
+}
+
+
 //*************************************************************************************************************
 
 MatrixXd MNEMath::rescale(const MatrixXd &data, const RowVectorXf &times, QPair<QVariant,QVariant> baseline, QString mode)
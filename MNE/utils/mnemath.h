@@ -261,6 +261,24 @@ public:
     */
     static MatrixXd rescale(const MatrixXd &data, const RowVectorXf &times, QPair<QVariant,QVariant> baseline, QString mode);
 
+    //=========================================================================================================
+    /**
+    * Thin singular value decomposition A = U*diag(s)*V' of a wide (or tall) matrix, e.g. a lead field with a few
+    * hundred channels and thousands of sources. Instead of a JacobiSVD of A, the small Gram matrix A*A' is
+    * eigendecomposed and V is recovered as A'*U*diag(1/s). Singular values below tol times the largest one are set to
+    * zero together with their columns of V. The result is checked by the orthonormality of V; if it is violated
+    * the decomposition falls back to JacobiSVD.
+    *
+    * @param[in] A      Matrix to decompose
+    * @param[out] s     Singular values in descending order
+    * @param[out] U     Left singular vectors (thin)
+    * @param[out] V     Right singular vectors (thin)
+    * @param[in] tol    Relative threshold below which singular values are considered zero
+    *
+    * @return true if the Gram decomposition was used, false if it fell back to JacobiSVD
+    */
+    static bool svd_gram(const MatrixXd& A, VectorXd& s, MatrixXd& U, MatrixXd& V, double tol = 1e-6);
+
     //=========================================================================================================
     /**
     * Sorts a vector (ascending order) in place and returns the track of the original indeces
@@ -375,7 +375,10 @@ bool RawModel::loadFiffData(QFile* qFile)
         int start = m_iAbsFiffCursor;
         int end = start + m_iWindowSize - 1;
 
-        if(!m_pfiffIO->m_qlistRaw[0]->read_raw_segment(t_data, t_times, start, end))
+        //prefetch one window ahead in scrolling direction and keep one behind
+        m_pRawReader = FiffRawReader::SPtr(new FiffRawReader(*m_pfiffIO->m_qlistRaw[0], m_iWindowSize, 1, 1));
+
+        if(!m_pRawReader->read(t_data, t_times, start, end))
             return false;
 
         newDataPackage = QSharedPointer<DataPackage>(new DataPackage(t_data, (MatrixXdR)t_times));
@@ -448,7 +451,7 @@ bool RawModel::writeFiffData(QIODevice *p_IODevice)
         qDebug("Writing...");
         if (first_buffer) {
            if (first > 0)
-               outfid->write_int(FIFF_FIRST_SAMPLE,&first);
+               outfid->write_raw_first_sample(first);
            first_buffer = false;
         }
         outfid->write_raw_buffer(data,mult);
@@ -482,6 +485,7 @@ void RawModel::loadFiffInfos()
 void RawModel::clearModel()
 {
     //FiffIO object
+    m_pRawReader.clear();
     m_pfiffIO.clear();
     m_fiffInfo.clear();
     m_chInfolist.clear();
@@ -528,7 +532,7 @@ void RawModel::resetPosition(qint32 position)
     int end = start + m_iWindowSize - 1;
 
     m_Mutex.lock();
-    if(!m_pfiffIO->m_qlistRaw[0]->read_raw_segment(t_data, t_times, start, end))
+    if(!m_pRawReader->read(t_data, t_times, start, end))
         qDebug() << "RawModel: Error resetting position of Fiff file!";
     m_Mutex.unlock();
 
@@ -613,10 +617,8 @@ QPair<MatrixXd,MatrixXd> RawModel::readSegment(fiff_int_t from, fiff_int_t to)
     QPair<MatrixXd,MatrixXd> datatime;
 
     m_Mutex.lock();
-    if(!m_pfiffIO->m_qlistRaw[0]->read_raw_segment(datatime.first, datatime.second, from, to)) {
+    if(!m_pRawReader->read(datatime.first, datatime.second, from, to))
         printf("RawModel: Error when reading raw data!");
-        return datatime;
-    }
     m_Mutex.unlock();
 
     return datatime;
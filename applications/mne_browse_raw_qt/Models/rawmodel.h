@@ -180,6 +180,7 @@ public:
     QList<FiffChInfo>                           m_chInfolist;   /**< List of FiffChInfo objects that holds the corresponding channels information */
     FiffInfo                                    m_fiffInfo;     /**< fiff info of whole fiff file */
     QSharedPointer<FiffIO>                      m_pfiffIO;      /**< FiffIO objects, which holds all the information of the fiff data (excluding the samples!) */
+    FiffRawReader::SPtr                         m_pRawReader;   /**< Prefetching reader for the raw data windows, keeps the neighbouring windows decoded in the background */
     QMap<QString,QSharedPointer<MNEOperator> >  m_Operators;    /**< generated MNEOperator types (FilterOperator,PCA etc.) */
 
 private:
@@ -44,6 +44,8 @@
 #include "Windows/mainwindow.h"
 #include "Utils/info.h"
 
+#include <fiff/fiff_stream.h>
+
 
 //*************************************************************************************************************
 //=============================================================================================================
@@ -63,6 +65,7 @@
 //=============================================================================================================
 
 using namespace MNEBrowseRawQt;
+using namespace FIFFLIB;
 
 
 //*************************************************************************************************************
@@ -117,6 +120,9 @@ int main(int argc, char *argv[])
     QCoreApplication::setOrganizationName(CInfo::OrganizationName());
     QCoreApplication::setApplicationName(CInfo::AppNameShort());
 
+    //reuse the tag directories of raw files without one when they are opened again
+    FiffStream::setDirCacheEnabled(true);
+
     //show splash screen for 1 second
     QPixmap pixmap(":/Resources/Images/splashscreen_mne_browse_raw_qt.png");
     QSplashScreen splash(pixmap);
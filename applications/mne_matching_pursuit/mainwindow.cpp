@@ -2610,7 +2610,7 @@ void SaveFifFile::save_fif_file(QString source_path, QString save_path, fiff_int
                 if (first_buffer)
                 {
                     if (first > 0)
-                        outfid->write_int(FIFF_FIRST_SAMPLE, &first);
+                        outfid->write_raw_first_sample(first);
                     first_buffer = false;
                 }
                 outfid->write_raw_buffer(data, cals);
@@ -2642,7 +2642,7 @@ void SaveFifFile::save_fif_file(QString source_path, QString save_path, fiff_int
             if (first_buffer)
             {
                 if (start_change > 0)
-                    outfid->write_int(FIFF_FIRST_SAMPLE, &start_change);
+                    outfid->write_raw_first_sample(start_change);
                 first_buffer = false;
             }
             outfid->write_raw_buffer(data, cals);
@@ -41,6 +41,8 @@
 #include "fiffproducer.h"
 #include "fiffsimulator.h"
 
+#include <fiff/fiff_raw_reader.h>
+
 
 //*************************************************************************************************************
 //=============================================================================================================
@@ -98,11 +100,6 @@ void FiffProducer::run()
 {
     m_bIsRunning = true;
 
-    // reopen file in this thread
-    QFile t_File(m_pFiffSimulator->m_RawInfo.info.filename);
-    FiffStream::SPtr p_pStream(new FiffStream(&t_File));
-    m_pFiffSimulator->m_RawInfo.file = p_pStream;
-
     //
     //   Set up the reading parameters
     //
@@ -137,9 +134,13 @@ void FiffProducer::run()
 //    for(qint32 i = 0; i < nchan; ++i)
 //        inv_calsMat.insert(i, i) = 1.0f/m_pFiffSimulator->m_RawInfo.info.chs[i].cal;
 
-    //Not good cause production time is not accurate
-    //loading and thread sleep is longer than thread sleep time - better to have a extra loading thread
-    // ToDo restructure this producer as laoding buffer --> and thread sleep to simulator buffer
+    //
+    //   Disk access and decoding happen in the reader's prefetch thread, so the producer never stalls on the file.
+    //   The look-ahead wraps around, the simulation restarts from the beginning of the file.
+    //
+    FiffRawReader t_reader(m_pFiffSimulator->m_RawInfo, quantum, 4, 0);
+    t_reader.setWrapAround(true);
+
     fiff_int_t t_iDiff;
     bool t_bRestart = false;
 
@@ -154,7 +155,7 @@ void FiffProducer::run()
             last = to;
         }
 
-        if (!m_pFiffSimulator->m_RawInfo.read_raw_segment(data,times,first,last))
+        if (!t_reader.read(data,times,first,last))
         {
             printf("error during read_raw_segment\n");
         }
@@ -171,7 +172,7 @@ void FiffProducer::run()
             first = from;
             last = first+t_iDiff-1;
 
-            if (!m_pFiffSimulator->m_RawInfo.read_raw_segment(data,times,first,last))
+            if (!t_reader.read(data,times,first,last))
             {
                 printf("error during read_raw_segment\n");
             }
@@ -196,8 +197,4 @@ void FiffProducer::run()
         // call blocks until there is free space in the buffer
         m_pFiffSimulator->m_pRawMatrixBuffer->push(&tmp);
     }
-
-    // close datastream in this thread
-//    delete m_pFiffSimulator->m_RawInfo.file;
-//    m_pFiffSimulator->m_RawInfo.file = NULL;
 }
@@ -339,39 +339,6 @@ void BabyMEG::RecvHPIFiffInfo(FiffInfo info)
     qDebug()<<"HPI"<< info.dig.at(0).kind << info.dig.at(0).r[0];
 }
 
-//*************************************************************************************************************
-
-void BabyMEG::splitRecordingFile()
-{
-    qDebug() << "Split recording file";
-    ++m_iSplitCount;
-    QString nextFileName = m_sRecordFile.remove("_raw.fif");
-    nextFileName += QString("-%1_raw.fif").arg(m_iSplitCount);
-
-    /*
-    * Write the link to the next file
-    */
-    qint32 data;
-    m_pOutfid->start_block(FIFFB_REF);
-    data = FIFFV_ROLE_NEXT_FILE;
-    m_pOutfid->write_int(FIFF_REF_ROLE,&data);
-    m_pOutfid->write_string(FIFF_REF_FILE_NAME, nextFileName);
-    m_pOutfid->write_id(FIFF_REF_FILE_ID);//ToDo meas_id
-    data = m_iSplitCount - 1;
-    m_pOutfid->write_int(FIFF_REF_FILE_NUM, &data);
-    m_pOutfid->end_block(FIFFB_REF);
-
-    //finish file
-    m_pOutfid->finish_writing_raw();
-
-    //start next file
-    m_qFileOut.setFileName(nextFileName);
-    m_pOutfid = Fiff::start_writing_raw(m_qFileOut, *m_pFiffInfo, m_cals);
-    fiff_int_t first = 0;
-    m_pOutfid->write_int(FIFF_FIRST_SAMPLE, &first);
-}
-
-
 //*************************************************************************************************************
 
 void BabyMEG::toggleRecordingFile()
@@ -383,16 +350,16 @@ void BabyMEG::toggleRecordingFile()
     //Setup writing to file
     if(m_bWriteToFile)
     {
-        m_pOutfid->finish_writing_raw();
+        //Stop the producer first, buffers pushed meanwhile are rejected by the finished stream
+        m_qMutexOutfid.lock();
         m_bWriteToFile = false;
+        m_qMutexOutfid.unlock();
+        m_pOutfid->finish_writing_raw();
         m_pTimerRecordingChange->stop();
         m_pActionRecordFile->setIcon(QIcon(":/images/record.png"));
-        m_iSplitCount = 0;
     }
     else
     {
-        m_iSplitCount = 0;
-
         if(!m_pFiffInfo)
         {
             QMessageBox msgBox;
@@ -419,11 +386,16 @@ void BabyMEG::toggleRecordingFile()
         for(int i = 0; i<m_pFiffInfo->projs.size(); i++)
             m_pFiffInfo->projs[i].active = false;
 
-        m_pOutfid = Fiff::start_writing_raw(m_qFileOut, *m_pFiffInfo, m_cals);
+        FiffStream::SPtr t_pOutfid = Fiff::start_writing_raw(m_qFileOut, *m_pFiffInfo, m_cals);
         fiff_int_t first = 0;
-        m_pOutfid->write_int(FIFF_FIRST_SAMPLE, &first);
+        t_pOutfid->write_raw_first_sample(first);
+        t_pOutfid->setSplitSize(MAX_DATA_LEN);//Continuation files are started by the stream
+        t_pOutfid->start_async_writing();
 
+        m_qMutexOutfid.lock();
+        m_pOutfid = t_pOutfid;
         m_bWriteToFile = true;
+        m_qMutexOutfid.unlock();
 
         m_pTimerRecordingChange = QSharedPointer<QTimer>(new QTimer);
         connect(m_pTimerRecordingChange.data(), &QTimer::timeout, this, &BabyMEG::changeRecordingButton);
@@ -744,8 +716,6 @@ void BabyMEG::run()
 
     MatrixXf matValue;
 
-    qint32 size = 0;
-
     while(m_bIsRunning)
     {
         if(m_pRawMatrixBuffer)
@@ -753,21 +723,12 @@ void BabyMEG::run()
             //pop matrix
             matValue = m_pRawMatrixBuffer->pop();
 
-            //Write raw data to fif file
-            if(m_bWriteToFile)
-            {
-                size += matValue.rows()*matValue.cols() * 4;
-
-                if(size > MAX_DATA_LEN)
-                {
-                    size = 0;
-                    this->splitRecordingFile();
-                }
-
-                m_pOutfid->write_raw_buffer(matValue.cast<double>());
-            }
-            else
-                size = 0;
+            //Write raw data to fif file, the local reference keeps the stream alive if the recording is stopped meanwhile
+            m_qMutexOutfid.lock();
+            FiffStream::SPtr t_pOutfid = m_bWriteToFile ? m_pOutfid : FiffStream::SPtr();
+            m_qMutexOutfid.unlock();
+            if(t_pOutfid)
+                t_pOutfid->write_raw_buffer_async(matValue.cast<double>());
 
             if(m_pRTMSABabyMEG)
                 m_pRTMSABabyMEG->data()->setValue(this->calibrate(matValue));
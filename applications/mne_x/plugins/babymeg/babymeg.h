@@ -204,12 +204,6 @@ public:
 
     void showSqdCtrlDialog();
 
-    //=========================================================================================================
-    /**
-    * Determines current file. And starts a new one.
-    */
-    void splitRecordingFile();
-
     //=========================================================================================================
     /**
     * Starts or stops a file recording depending on the current recording state.
@@ -325,9 +319,9 @@ private:
     QString             m_sCurrentSubject;  /**< The current subject which is part of the filename to be recorded.*/
     QString             m_sCurrentParadigm; /**< The current paradigm which is part of the filename to be recorded.*/
     QString             m_sRecordFile;      /**< Current record file. */
-    qint32              m_iSplitCount;      /**< File split count */
     QFile               m_qFileOut;         /**< QFile for writing to fif file.*/
     FiffStream::SPtr    m_pOutfid;          /**< FiffStream to write to.*/
+    QMutex              m_qMutexOutfid;     /**< Guards m_bWriteToFile and m_pOutfid between the GUI and the acquisition thread.*/
 
     QString                 m_sFiffHeader;  /**< Fiff header information */
     QString                 m_sBadChannels; /**< Filename which contains a list of bad channels */
@@ -568,9 +568,12 @@ void EEGoSports::run()
                 m_qTimerTrigger.restart();
             }
 
-            //Write raw data to fif file
-            if(m_bWriteToFile)
-                m_pOutfid->write_raw_buffer(matValue.cast<double>(), m_cals);
+            //Write raw data to fif file, the local reference keeps the stream alive if the recording is stopped meanwhile
+            m_qMutexOutfid.lock();
+            FiffStream::SPtr t_pOutfid = m_bWriteToFile ? m_pOutfid : FiffStream::SPtr();
+            m_qMutexOutfid.unlock();
+            if(t_pOutfid)
+                t_pOutfid->write_raw_buffer_async(matValue.cast<double>(), m_cals);
 
             // Use preprocessing if wanted by the user
             if(m_bUseFiltering)
@@ -589,8 +592,11 @@ void EEGoSports::run()
     //Close the fif output stream
     if(m_bWriteToFile)
     {
-        m_pOutfid->finish_writing_raw();
+        //Stop the producer first, buffers pushed meanwhile are rejected by the finished stream
+        m_qMutexOutfid.lock();
         m_bWriteToFile = false;
+        m_qMutexOutfid.unlock();
+        m_pOutfid->finish_writing_raw();
         m_pTimerRecordingChange->stop();
         m_pActionStartRecording->setIcon(QIcon(":/images/record.png"));
     }
@@ -623,8 +629,11 @@ void EEGoSports::showStartRecording()
     //Setup writing to file
     if(m_bWriteToFile)
     {
-        m_pOutfid->finish_writing_raw();
+        //Stop the producer first, buffers pushed meanwhile are rejected by the finished stream
+        m_qMutexOutfid.lock();
         m_bWriteToFile = false;
+        m_qMutexOutfid.unlock();
+        m_pOutfid->finish_writing_raw();
         m_pTimerRecordingChange->stop();
         m_pActionStartRecording->setIcon(QIcon(":/images/record.png"));
     }
@@ -670,11 +679,15 @@ void EEGoSports::showStartRecording()
             dir.mkpath(fileDir);
         }
 
-        m_pOutfid = Fiff::start_writing_raw(m_fileOut, *m_pFiffInfo, m_cals);
+        FiffStream::SPtr t_pOutfid = Fiff::start_writing_raw(m_fileOut, *m_pFiffInfo, m_cals);
         fiff_int_t first = 0;
-        m_pOutfid->write_int(FIFF_FIRST_SAMPLE, &first);
+        t_pOutfid->write_raw_first_sample(first);
+        t_pOutfid->start_async_writing();
 
+        m_qMutexOutfid.lock();
+        m_pOutfid = t_pOutfid;
         m_bWriteToFile = true;
+        m_qMutexOutfid.unlock();
 
         m_pTimerRecordingChange = QSharedPointer<QTimer>(new QTimer);
         connect(m_pTimerRecordingChange.data(), &QTimer::timeout, this, &EEGoSports::changeRecordingButton);
@@ -258,6 +258,7 @@ private:
     MatrixXf                            m_matOldMatrix;                     /**< Last received sample matrix by the tmsiproducer/tmsidriver class. Used for simple HP filtering.*/
 
     QMutex                              m_qMutex;                           /**< Holds the threads mutex.*/
+    QMutex                              m_qMutexOutfid;                     /**< Guards m_bWriteToFile and m_pOutfid between the GUI and the acquisition thread.*/
 
     QAction*                            m_pActionSetupProject;              /**< shows setup project dialog */
     QAction*                            m_pActionStartRecording;            /**< starts to record data */
@@ -336,13 +336,16 @@ void MNE::updateInvOp(MNEInverseOperator::SPtr p_pInvOp)
 
     QString method("dSPM"); //"MNE" | "dSPM" | "sLORETA"
 
-    m_qMutex.lock();
-    m_pMinimumNorm = MinimumNorm::SPtr(new MinimumNorm(*m_pInvOp.data(), lambda2, method));
+    MinimumNorm::SPtr t_pMinimumNorm(new MinimumNorm(*m_pInvOp.data(), lambda2, method));
     //
     //   Set up the inverse according to the parameters
     //
-    m_pMinimumNorm->doInverseSetup(m_iNumAverages,false);
-    m_qMutex.unlock();
+    t_pMinimumNorm->doInverseSetup(m_iNumAverages,false);
+
+    //
+    //   Publish the set up kernel, the data path picks it up with its next frame
+    //
+    m_minimumNormHolder.publish(t_pMinimumNorm);
 }
 
 
@@ -377,7 +380,7 @@ void MNE::run()
     m_pRtInvOp = RtInvOp::SPtr(new RtInvOp(m_pFiffInfo, m_pClusteredFwd));
     connect(m_pRtInvOp.data(), &RtInvOp::invOperatorCalculated, this, &MNE::updateInvOp);
 
-    m_pMinimumNorm.reset();
+    m_minimumNormHolder.reset();
 
     //
     // Start the rt helpers
@@ -389,49 +392,53 @@ void MNE::run()
     //
     m_bProcessData = true;
 
-    qint32 skip_count = 0;
+    QVector<FiffEvoked> t_qVecFiffEvoked;
 
     while(m_bIsRunning)
     {
         m_qMutex.lock();
-        qint32 t_covSize = m_qVecFiffCov.size();
-        m_qMutex.unlock();
-        if(t_covSize > 0)
+        if(m_qVecFiffCov.size() > 0)
         {
-            m_qMutex.lock();
             m_pRtInvOp->appendNoiseCov(m_qVecFiffCov[0]);
             m_qVecFiffCov.pop_front();
-            m_qMutex.unlock();
         }
-
-        m_qMutex.lock();
-        qint32 t_evokedSize = m_qVecFiffEvoked.size();
+        t_qVecFiffEvoked.swap(m_qVecFiffEvoked);
         m_qMutex.unlock();
-        if(t_evokedSize > 0)
+
+        if(t_qVecFiffEvoked.isEmpty())
+        {
+            msleep(1);
+            continue;
+        }
+
+        //
+        // The kernel is held for the whole block, operator updates never wait for it
+        //
+        MinimumNorm::SPtr t_pMinimumNorm = m_minimumNormHolder.acquire();
+        if(t_pMinimumNorm)
         {
-            if(m_pMinimumNorm && ((skip_count % 4) == 0))
+            const MNESourceSpace &t_src = t_pMinimumNorm->getSourceSpace();
+            m_sourceEstimate.vertices.resize(t_src[0].vertno.size() + t_src[1].vertno.size());
+            m_sourceEstimate.vertices << t_src[0].vertno, t_src[1].vertno;
+
+            for(qint32 i = 0; i < t_qVecFiffEvoked.size(); ++i)
             {
-                m_qMutex.lock();
-                FiffEvoked t_fiffEvoked = m_qVecFiffEvoked[0];
-                m_qVecFiffEvoked.pop_front();
-                m_qMutex.unlock();
+                const FiffEvoked &t_fiffEvoked = t_qVecFiffEvoked[i];
 
-                float tmin = ((float)t_fiffEvoked.first) / t_fiffEvoked.info.sfreq;
-                float tstep = 1/t_fiffEvoked.info.sfreq;
+                //
+                // The fused kernel is applied into the kept buffers, no allocation once they have the block size
+                //
+                t_pMinimumNorm->applyKernel(t_fiffEvoked.data, m_sourceEstimate.data, m_matKernelWork);
 
-                m_qMutex.lock();
-                MNESourceEstimate sourceEstimate = m_pMinimumNorm->calculateInverse(t_fiffEvoked.data, tmin, tstep);
-                m_qMutex.unlock();
+                m_sourceEstimate.tmin = ((float)t_fiffEvoked.first) / t_fiffEvoked.info.sfreq;
+                m_sourceEstimate.tstep = 1/t_fiffEvoked.info.sfreq;
+                m_sourceEstimate.times.resize(m_sourceEstimate.data.cols());
+                for(qint32 j = 0; j < m_sourceEstimate.times.size(); ++j)
+                    m_sourceEstimate.times[j] = m_sourceEstimate.tmin + j*m_sourceEstimate.tstep;
 
-                m_pRTSEOutput->data()->setValue(sourceEstimate);
-            }
-            else
-            {
-                m_qMutex.lock();
-                m_qVecFiffEvoked.pop_front();
-                m_qMutex.unlock();
+                m_pRTSEOutput->data()->setValue(m_sourceEstimate);
             }
-            ++skip_count;
         }
+        t_qVecFiffEvoked.clear();
     }
 }
@@ -55,6 +55,7 @@
 #include <mne/mne_sourceestimate.h>
 #include <inverse/minimumNorm/minimumnorm.h>
 #include <rtInv/rtinvop.h>
+#include <rtInv/rtkernelholder.h>
 
 #include <xMeas/realtimesourceestimate.h>
 #include <xMeas/realtimecov.h>
@@ -239,7 +240,9 @@ private:
     RtInvOp::SPtr               m_pRtInvOp;         /**< Real-time inverse operator. */
     MNEInverseOperator::SPtr    m_pInvOp;           /**< The inverse operator. */
 
-    MinimumNorm::SPtr           m_pMinimumNorm;     /**< Minimum Norm Estimation. */
+    RtKernelHolder<MinimumNorm> m_minimumNormHolder;    /**< Minimum Norm Estimation, swapped without blocking the data path. */
+    MNESourceEstimate           m_sourceEstimate;   /**< Source estimate the kernel is applied into, kept across data blocks. */
+    Eigen::MatrixXd             m_matKernelWork;    /**< Workspace of the kernel application, kept across data blocks. */
     qint32                      m_iDownSample;      /**< Sampling rate */
 
 //    RealTimeSourceEstimate::SPtr m_pRTSE_MNE; /**< Source Estimate output channel. */
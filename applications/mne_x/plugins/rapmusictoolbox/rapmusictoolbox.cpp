@@ -317,6 +317,7 @@ void RapMusicToolbox::run()
     m_pPwlRapMusic.reset();
 
     m_pPwlRapMusic = RapMusic::SPtr(new RapMusic(*m_pClusteredFwd, false, numDipolePairs));
+    m_pPwlRapMusic->setStreaming(true);
 
     //
     // start processing data
@@ -344,7 +345,7 @@ void RapMusicToolbox::run()
             {
                 m_qMutex.lock();
                 FiffEvoked t_fiffEvoked = m_qVecFiffEvoked[0];
-                m_pPwlRapMusic->setStcAttr(t_fiffEvoked.data.cols()/4.0,0.0);
+                m_pPwlRapMusic->setStcAttr(t_fiffEvoked.data.cols()/4.0,0.5);
                 m_qVecFiffEvoked.pop_front();
                 m_qMutex.unlock();
 
@@ -63,6 +63,7 @@
 //=============================================================================================================
 
 #include <QtCore/QCoreApplication>
+#include <QDir>
 
 
 //*************************************************************************************************************
@@ -151,8 +152,9 @@ int main(int argc, char *argv[])
     MNEInverseOperator inverse_operator(t_fileInv);
 
     //
-    // Compute inverse solution
+    // Compute inverse solution, the kernel of the operator file is cached across runs
     //
+    MinimumNorm::setKernelCacheDir(QDir::temp().filePath("mne-cpp-kernels"));
     MinimumNorm minimumNorm(inverse_operator, lambda2, method);
     MNESourceEstimate sourceEstimate = minimumNorm.calculateInverse(evoked);
 
@@ -675,7 +675,7 @@ int main(int argc, char *argv[])
 
     FiffStream::SPtr m_pOutfid = Fiff::start_writing_raw(m_fileOut, raw.info, m_cals);
     fiff_int_t first = 0;
-    m_pOutfid->write_int(FIFF_FIRST_SAMPLE, &first);
+    m_pOutfid->write_raw_first_sample(first);
     //m_pOutfid->finish_writing_raw();
 
     Eigen::MatrixXd eData = evoked.data;
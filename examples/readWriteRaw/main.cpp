@@ -162,7 +162,7 @@ int main(int argc, char *argv[])
         if (first_buffer)
         {
            if (first > 0)
-               outfid->write_int(FIFF_FIRST_SAMPLE,&first);
+               outfid->write_raw_first_sample(first);
            first_buffer = false;
         }
         outfid->write_raw_buffer(data,cals);
@@ -113,5 +113,37 @@ int main(int argc, char *argv[])
     testStart(testName);
     testResult = t_TestMneLibs.checkFwdRead();
     testEnd(testName,testResult);
+
+    //
+    // Gram SVD test
+    //
+    testName = QString("Gram SVD");
+    testStart(testName);
+    testResult = t_TestMneLibs.checkSvdGram();
+    testEnd(testName,testResult);
+
+    //
+    // Raw split test
+    //
+    testName = QString("Raw Split");
+    testStart(testName);
+    testResult = t_TestMneLibs.checkRawSplit();
+    testEnd(testName,testResult);
+
+    //
+    // RAP MUSIC scan test
+    //
+    testName = QString("RAP MUSIC Scan");
+    testStart(testName);
+    testResult = t_TestMneLibs.checkRapMusicScan();
+    testEnd(testName,testResult);
+
+    //
+    // K-Means test
+    //
+    testName = QString("K-Means");
+    testStart(testName);
+    testResult = t_TestMneLibs.checkKMeans();
+    testEnd(testName,testResult);
     return a.exec();
 }
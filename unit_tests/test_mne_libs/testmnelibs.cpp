@@ -46,7 +46,29 @@
 // MNE INCLUDES
 //=============================================================================================================
 
+#include <fiff/fiff.h>
 #include <mne/mne.h>
+#include <utils/mnemath.h>
+#include <utils/kmeans.h>
+#include <inverse/rapMusic/rapmusicscan.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QDir>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 
 //*************************************************************************************************************
@@ -55,7 +77,146 @@
 //=============================================================================================================
 
 using namespace MNEUNITTESTS;
+using namespace FIFFLIB;
 using namespace MNELIB;
+using namespace UTILSLIB;
+using namespace INVERSELIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC FUNCTIONS
+//=============================================================================================================
+
+namespace
+{
+
+//=============================================================================================================
+/**
+* Subspace correlation of a dipole pair like RapMusic::subcorr: SVD of the pair block, components with singular
+* values below 1e-5 dropped (RapMusic::getRank), largest singular value of U_A^T * U_B.
+*/
+double subcorrSvd(const MatrixXd &p_matPair, const MatrixXd &p_matU_B)
+{
+    JacobiSVD<MatrixXd> t_svdPair(p_matPair, ComputeThinU);
+    const VectorXd &t_vecSigma = t_svdPair.singularValues();
+
+    qint32 t_iRank;
+    for(t_iRank = t_vecSigma.size()-1; t_iRank > 0; --t_iRank)
+        if(t_vecSigma[t_iRank] > 0.00001)
+            break;
+    ++t_iRank;
+
+    JacobiSVD<MatrixXd> t_svdCor(t_svdPair.matrixU().leftCols(t_iRank).transpose() * p_matU_B);
+    return t_svdCor.singularValues()[0];
+}
+
+
+//=============================================================================================================
+/**
+* Makes dipole 1 a copy of dipole 0, dipole 2 rank one and scales dipole 3 below the rank cut.
+*/
+void makeDegenerateDipoles(MatrixXd &p_matGain, double p_dTinyScale)
+{
+    p_matGain.middleCols(3, 3) = p_matGain.middleCols(0, 3);
+    p_matGain.col(7) = 2.0*p_matGain.col(6);
+    p_matGain.col(8) = -p_matGain.col(6);
+    p_matGain.middleCols(9, 3) *= p_dTinyScale;
+}
+
+
+//=============================================================================================================
+/**
+* Largest deviation of the scan correlations from the SVD based correlations over all pairs.
+*/
+double maxPairError(const RapMusicScan &p_scan, const MatrixXd &p_matGain, const MatrixXd &p_matU_B)
+{
+    double t_dMaxErr = 0;
+    MatrixXd t_matPair(p_matGain.rows(), 6);
+    for(qint32 i = 0; i < p_scan.numDipoles(); ++i)
+    {
+        for(qint32 j = i; j < p_scan.numDipoles(); ++j)
+        {
+            t_matPair << p_matGain.middleCols(3*i, 3), p_matGain.middleCols(3*j, 3);
+            t_dMaxErr = std::max(t_dMaxErr, fabs(subcorrSvd(t_matPair, p_matU_B) - p_scan.correlation(i, j)));
+        }
+    }
+    return t_dMaxErr;
+}
+
+//=============================================================================================================
+/**
+* Three well separated clusters of 100 points in 4 dimensions, spread by +-0.5 around the points at distance 10
+* on the first three axes, so that both squared euclidean and cosine clustering recover them.
+*/
+MatrixXd makeSeparableClusters(VectorXi &p_vecLabels)
+{
+    qint32 t_iPerCluster = 100;
+    MatrixXd t_matX = 0.5 * MatrixXd::Random(3*t_iPerCluster, 4);
+    p_vecLabels.resize(3*t_iPerCluster);
+    for(qint32 i = 0; i < t_matX.rows(); ++i)
+    {
+        p_vecLabels[i] = i / t_iPerCluster;
+        t_matX(i, p_vecLabels[i]) += 10.0;
+    }
+    return t_matX;
+}
+
+
+//=============================================================================================================
+/**
+* Whether the cluster indeces reproduce the labels up to a permutation of the clusters.
+*/
+bool sameClustering(const VectorXi &p_vecIdx, const VectorXi &p_vecLabels, qint32 p_iK)
+{
+    VectorXi t_vecMap = VectorXi::Constant(p_iK, -1);
+    VectorXi t_vecUsed = VectorXi::Zero(p_iK);
+    for(qint32 i = 0; i < p_vecLabels.size(); ++i)
+    {
+        qint32 t_iLabel = p_vecLabels[i];
+        if(p_vecIdx[i] < 0 || p_vecIdx[i] >= p_iK)
+            return false;
+        if(t_vecMap[t_iLabel] < 0)
+        {
+            if(t_vecUsed[p_vecIdx[i]])
+                return false;
+            t_vecMap[t_iLabel] = p_vecIdx[i];
+            t_vecUsed[p_vecIdx[i]] = 1;
+        }
+        else if(t_vecMap[t_iLabel] != p_vecIdx[i])
+            return false;
+    }
+    return true;
+}
+
+
+//=============================================================================================================
+/**
+* Largest deviation, relative to 1 + the distance, of the point to centroid distances of KMeans::calculate from
+* a direct evaluation: the squared euclidean distance or 1 - the cosine similarity.
+*/
+double maxDistanceError(const MatrixXd &p_matX, const MatrixXd &p_matC, const MatrixXd &p_matD, bool p_bCosine)
+{
+    if(p_matD.rows() != p_matX.rows() || p_matD.cols() != p_matC.rows())
+        return std::numeric_limits<double>::max();
+
+    double t_dMaxErr = 0;
+    for(qint32 i = 0; i < p_matX.rows(); ++i)
+    {
+        for(qint32 j = 0; j < p_matC.rows(); ++j)
+        {
+            double t_dDist;
+            if(p_bCosine)
+                t_dDist = 1.0 - p_matX.row(i).dot(p_matC.row(j)) / (p_matX.row(i).norm() * p_matC.row(j).norm());
+            else
+                t_dDist = (p_matX.row(i) - p_matC.row(j)).squaredNorm();
+            t_dMaxErr = std::max(t_dMaxErr, fabs(p_matD(i, j) - t_dDist) / (1.0 + t_dDist));
+        }
+    }
+    return t_dMaxErr;
+}
+
+} // NAMESPACE
 
 
 //*************************************************************************************************************
@@ -132,3 +293,233 @@ bool TestMNELibs::checkFwdRead()
         return false;
     }
 }
+
+
+//*************************************************************************************************************
+
+bool TestMNELibs::checkSvdGram()
+{
+    //
+    //  Lead field sized matrix with a decaying spectrum and one projected out direction
+    //
+    qint32 nchan = 306;
+    qint32 nsrc = 3*2000;
+    MatrixXd A = MatrixXd::Random(nchan, nsrc);
+    VectorXd u = VectorXd::Random(nchan).normalized();
+    VectorXd d(nchan);
+    for(qint32 i = 0; i < nchan; ++i)
+        d[i] = pow(10.0, -3.0*i/nchan);
+    A = (MatrixXd::Identity(nchan, nchan) - u*u.transpose()) * d.asDiagonal() * A;
+
+    VectorXd s;
+    MatrixXd U, V;
+    bool t_bGram = MNEMath::svd_gram(A, s, U, V);
+
+    JacobiSVD<MatrixXd> t_svd(A, ComputeThinU | ComputeThinV);
+
+    double t_dSingErr = (s - t_svd.singularValues()).cwiseAbs().maxCoeff() / t_svd.singularValues()[0];
+    double t_dReconErr = (U * s.asDiagonal() * V.transpose() - A).cwiseAbs().maxCoeff() / A.cwiseAbs().maxCoeff();
+
+    printf("Gram path used: %s; singular value error: %e; reconstruction error: %e\n", t_bGram ? "yes" : "no", t_dSingErr, t_dReconErr);
+
+    if(!t_bGram || t_dSingErr > 1e-10 || t_dReconErr > 1e-10)
+    {
+        emit checkupFailed(2);
+        return false;
+    }
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+bool TestMNELibs::checkRawSplit()
+{
+    //
+    //  Small measurement info, calibration 1 so that the data read back are the written ones
+    //
+    qint32 nchan = 8;
+    qint32 nsamp = 1000;
+    qint32 nbuffers = 40;
+    fiff_int_t first = 1234;
+
+    FiffInfo t_info;
+    t_info.nchan = nchan;
+    t_info.sfreq = 1000.0f;
+    t_info.highpass = 0.0f;
+    t_info.lowpass = 500.0f;
+    for(qint32 k = 0; k < nchan; ++k)
+    {
+        FiffChInfo t_ch;
+        t_ch.scanno = k+1;
+        t_ch.logno = k+1;
+        t_ch.kind = FIFFV_MISC_CH;
+        t_ch.range = 1.0f;
+        t_ch.cal = 1.0f;
+        t_ch.unit = FIFF_UNIT_V;
+        t_ch.ch_name = QString("MISC%1").arg(k+1);
+        t_info.chs.append(t_ch);
+        t_info.ch_names.append(t_ch.ch_name);
+    }
+
+    MatrixXd t_matData = MatrixXd::Random(nchan, nsamp*nbuffers);
+
+    //
+    //  Write asynchronously, about 1.3 MB with a split size of 256 KB
+    //
+    QString t_sFileName = QDir::tempPath() + QString("/test_mne_libs_split_raw.fif");
+    QFile t_fileOut(t_sFileName);
+    RowVectorXd cals;
+    FiffStream::SPtr t_pOutfid = FiffStream::start_writing_raw(t_fileOut, t_info, cals);
+    if(!t_pOutfid)
+    {
+        emit checkupFailed(3);
+        return false;
+    }
+    t_pOutfid->setSplitSize(256*1024);
+    t_pOutfid->write_raw_first_sample(first);
+    t_pOutfid->start_async_writing(nbuffers);
+
+    for(qint32 k = 0; k < nbuffers; ++k)
+        t_pOutfid->write_raw_buffer_async(t_matData.block(0, k*nsamp, nchan, nsamp), cals);
+
+    t_pOutfid->finish_writing_raw();
+    qint32 t_iSplitCount = t_pOutfid->splitCount();
+    t_pOutfid.clear();
+
+    //
+    //  Read the chain back
+    //
+    QFile t_fileIn(t_sFileName);
+    FiffRawData t_raw(t_fileIn);
+
+    MatrixXd t_matRead, t_matTimes;
+    bool t_bRead = t_raw.read_raw_segment(t_matRead, t_matTimes);
+
+    double t_dErr = -1.0;
+    if(t_bRead && t_matRead.rows() == nchan && t_matRead.cols() == t_matData.cols())
+        t_dErr = (t_matRead - t_matData).cwiseAbs().maxCoeff();
+
+    printf("Continuation files: %d; first sample: %d; samples: %d of %d; max error: %e\n", t_iSplitCount, t_raw.first_samp, (qint32)t_matRead.cols(), (qint32)t_matData.cols(), t_dErr);
+
+    QFile::remove(t_sFileName);
+    for(qint32 k = 1; k <= t_iSplitCount; ++k)
+        QFile::remove(QDir::tempPath() + QString("/test_mne_libs_split-%1_raw.fif").arg(k));
+
+    if(t_iSplitCount < 1 || t_raw.first_samp != first || t_dErr < 0 || t_dErr > 1e-6)
+    {
+        emit checkupFailed(3);
+        return false;
+    }
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+bool TestMNELibs::checkRapMusicScan()
+{
+    qint32 nchan = 256;
+    qint32 ndip = 30;
+    qint32 rank = 5;
+
+    //
+    //  Signal subspace from Hadamard columns, orthonormal and exact in single precision
+    //
+    MatrixXd t_matU_B(nchan, rank);
+    for(qint32 i = 0; i < nchan; ++i)
+    {
+        for(qint32 k = 0; k < rank; ++k)
+        {
+            qint32 t_iParity = 0;
+            for(qint32 t_iBits = i & (k+1); t_iBits; t_iBits >>= 1)
+                t_iParity ^= t_iBits & 1;
+            t_matU_B(i, k) = (t_iParity ? -1.0 : 1.0) / sqrt((double)nchan);
+        }
+    }
+
+    //
+    //  Double precision
+    //
+    MatrixXd t_matGain = MatrixXd::Random(nchan, 3*ndip);
+    makeDegenerateDipoles(t_matGain, 1e-8);
+
+    RapMusicScan t_scan;
+    t_scan.init(t_matGain, t_matU_B);
+    double t_dErrDouble = maxPairError(t_scan, t_matGain, t_matU_B);
+
+    //
+    //  Single precision, with multiples of 1/16 so that the float Gram products are exact and the tolerance
+    //  bounds the pair solution rather than the rounding of the input
+    //
+    MatrixXd t_matGainDyadic(nchan, 3*ndip);
+    for(qint32 j = 0; j < t_matGainDyadic.cols(); ++j)
+        for(qint32 i = 0; i < nchan; ++i)
+            t_matGainDyadic(i, j) = (rand() % 33 - 16) / 16.0;
+    makeDegenerateDipoles(t_matGainDyadic, ldexp(1.0, -24));
+
+    MatrixXf t_matGainFloat = t_matGainDyadic.cast<float>();
+    RapMusicScan t_scanFloat;
+    t_scanFloat.init(t_matGainFloat, t_matU_B);
+    double t_dErrFloat = maxPairError(t_scanFloat, t_matGainDyadic, t_matU_B);
+
+    printf("Max correlation error double: %e; float: %e\n", t_dErrDouble, t_dErrFloat);
+
+    if(t_dErrDouble > 5e-13 || t_dErrFloat > 1e-7)
+    {
+        emit checkupFailed(4);
+        return false;
+    }
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+bool TestMNELibs::checkKMeans()
+{
+    qint32 k = 3;
+    VectorXi t_vecLabels;
+    MatrixXd t_matX = makeSeparableClusters(t_vecLabels);
+
+    VectorXi idx;
+    MatrixXd C;
+    VectorXd sumD;
+    MatrixXd D;
+
+    //
+    //  k-means++, squared euclidean
+    //
+    KMeans t_kMeansEucl(QString("sqeuclidean"), QString("plus"));
+    bool t_bEucl = t_kMeansEucl.calculate(t_matX, k, idx, C, sumD, D) && sameClustering(idx, t_vecLabels, k);
+    double t_dErrEucl = maxDistanceError(t_matX, C, D, false);
+
+    //
+    //  k-means++, cosine
+    //
+    KMeans t_kMeansCos(QString("cosine"), QString("plus"));
+    bool t_bCos = t_kMeansCos.calculate(t_matX, k, idx, C, sumD, D) && sameClustering(idx, t_vecLabels, k);
+    double t_dErrCos = maxDistanceError(t_matX, C, D, true);
+
+    //
+    //  Mini-batch, batches of 32 points are used since there are more than twice as many points
+    //
+    KMeans t_kMeansBatch(QString("sqeuclidean"), QString("plus"));
+    t_kMeansBatch.setMiniBatch(32);
+    bool t_bBatch = t_kMeansBatch.calculate(t_matX, k, idx, C, sumD, D) && sameClustering(idx, t_vecLabels, k);
+    double t_dErrBatch = maxDistanceError(t_matX, C, D, false);
+
+    printf("Clusters recovered sqeuclidean: %d; cosine: %d; mini-batch: %d\n", t_bEucl, t_bCos, t_bBatch);
+    printf("Max distance error sqeuclidean: %e; cosine: %e; mini-batch: %e\n", t_dErrEucl, t_dErrCos, t_dErrBatch);
+
+    if(!t_bEucl || !t_bCos || !t_bBatch || t_dErrEucl > 1e-12 || t_dErrCos > 1e-12 || t_dErrBatch > 1e-12)
+    {
+        emit checkupFailed(5);
+        return false;
+    }
+
+    return true;
+}
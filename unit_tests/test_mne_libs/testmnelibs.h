@@ -90,6 +90,50 @@ public:
     */
     bool checkFwdRead();
 
+    //=========================================================================================================
+    /**
+    * Test ID #2
+    *
+    * Checks the Gram matrix based SVD (MNEMath::svd_gram) against JacobiSVD for a rank deficient lead field sized
+    * matrix
+    *
+    * @return true if successful false otherwise
+    */
+    bool checkSvdGram();
+
+    //=========================================================================================================
+    /**
+    * Test ID #3
+    *
+    * Writes raw data asynchronously past a small split size and checks that the chain of split files reads back
+    * as one raw data set
+    *
+    * @return true if successful false otherwise
+    */
+    bool checkRawSplit();
+
+    //=========================================================================================================
+    /**
+    * Test ID #4
+    *
+    * Checks the Gram block pair correlations of RapMusicScan against the SVD based subspace correlation
+    * (RapMusic::subcorr) in double and single precision, including degenerate pairs and pairs below the rank cut
+    *
+    * @return true if successful false otherwise
+    */
+    bool checkRapMusicScan();
+
+    //=========================================================================================================
+    /**
+    * Test ID #5
+    *
+    * Checks the point to centroid distances of KMeans against a direct evaluation (squared euclidean and
+    * 1 - cosine similarity) and that k-means++ and mini-batch clustering recover a small separable data set
+    *
+    * @return true if successful false otherwise
+    */
+    bool checkKMeans();
+
 signals:
     void checkupFailed(int ID);
 
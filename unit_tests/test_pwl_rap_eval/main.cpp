@@ -0,0 +1,313 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   MNE-CPP authors
+* @version  1.0
+* @date     October, 2026
+*
+* @section  LICENSE
+*
+* Copyright (C) 2026, MNE-CPP authors. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Benchmark of the Powell RAP MUSIC search against the exhaustive RAP MUSIC scan
+*
+*/
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <fs/annotationset.h>
+
+#include <fiff/fiff_evoked.h>
+#include <mne/mne_forwardsolution.h>
+
+#include <inverse/rapMusic/rapmusic.h>
+#include <inverse/rapMusic/pwlrapmusic.h>
+
+#include <stdio.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QCommandLineParser>
+#include <QStringList>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace MNELIB;
+using namespace FSLIB;
+using namespace FIFFLIB;
+using namespace INVERSELIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC DEFINITIONS
+//=============================================================================================================
+
+namespace
+{
+
+//=============================================================================================================
+/**
+* Runs a RAP MUSIC variant and returns the elapsed time in ms.
+*
+* @param[in] p_rapMusic     The initialized RAP MUSIC algorithm.
+* @param[in] p_matData      The measurement.
+* @param[in] p_iRuns        Number of runs, the time is averaged.
+* @param[out] p_RapDipoles  The dipole pairs found by the last run.
+*
+* @return the mean elapsed time in ms.
+*/
+double runRapMusic(const RapMusic &p_rapMusic, const MatrixXd &p_matData, qint32 p_iRuns, QList< DipolePair<double> > &p_RapDipoles)
+{
+    QElapsedTimer t_timer;
+    t_timer.start();
+
+    for(qint32 i = 0; i < p_iRuns; ++i)
+        p_rapMusic.calculateInverse(p_matData, p_RapDipoles);
+
+    return (double)t_timer.elapsed() / (double)p_iRuns;
+}
+
+
+//=============================================================================================================
+/**
+* Returns the localization error of a dipole pair with respect to a reference pair. The dipoles are matched in
+* the order which gives the smaller error.
+*
+* @param[in] p_matSourceRR  The source positions.
+* @param[in] p_pair         The dipole pair.
+* @param[in] p_pairRef      The reference dipole pair.
+*
+* @return the mean distance of the matched dipoles in mm.
+*/
+double pairDistance(const MatrixX3f &p_matSourceRR, const DipolePair<double> &p_pair, const DipolePair<double> &p_pairRef)
+{
+    double t_dDirect = (p_matSourceRR.row(p_pair.m_iIdx1) - p_matSourceRR.row(p_pairRef.m_iIdx1)).norm()
+                     + (p_matSourceRR.row(p_pair.m_iIdx2) - p_matSourceRR.row(p_pairRef.m_iIdx2)).norm();
+    double t_dCrossed = (p_matSourceRR.row(p_pair.m_iIdx1) - p_matSourceRR.row(p_pairRef.m_iIdx2)).norm()
+                      + (p_matSourceRR.row(p_pair.m_iIdx2) - p_matSourceRR.row(p_pairRef.m_iIdx1)).norm();
+
+    return 1000.0 * (t_dDirect < t_dCrossed ? t_dDirect : t_dCrossed) / 2.0;
+}
+
+} // anonymous namespace
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("Powell RAP MUSIC Evaluation");
+    QCoreApplication::setApplicationVersion("Revision 1");
+
+    ///////////////////////////////////// #1 CLI Parser /////////////////////////////////////
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks the Powell RAP MUSIC search against the exhaustive RAP MUSIC scan on clustered grids of increasing density.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    // MEG Source Directory
+    QCommandLineOption srcDirectoryOption(QStringList() << "s" << "meg-source-directory",
+            QCoreApplication::translate("main", "Read MEG (fwd, ave) source files from <directory>."),
+            QCoreApplication::translate("main", "directory"),
+            "./MNE-sample-data/MEG/sample/");
+    parser.addOption(srcDirectoryOption);
+
+    // Forward Solution File
+    QCommandLineOption fwdFileOption(QStringList() << "fwd" << "forward-solution",
+            QCoreApplication::translate("main", "The forward solution <file>."),
+            QCoreApplication::translate("main", "file"),
+            "sample_audvis-meg-eeg-oct-6-fwd.fif");
+    parser.addOption(fwdFileOption);
+
+    // Evoked File
+    QCommandLineOption aveFileOption(QStringList() << "ave" << "evoked-file",
+            QCoreApplication::translate("main", "The evoked <file>."),
+            QCoreApplication::translate("main", "file"),
+            "sample_audvis-ave.fif");
+    parser.addOption(aveFileOption);
+
+    // FS Subject Directory
+    QCommandLineOption subjDirectoryOption(QStringList() << "subjdir" << "subject-directory",
+            QCoreApplication::translate("main", "The FreeSurfer <subjects directory>."),
+            QCoreApplication::translate("main", "directory"),
+            "./MNE-sample-data/subjects");
+    parser.addOption(subjDirectoryOption);
+
+    // FS Subject
+    QCommandLineOption subjIdOption(QStringList() << "subjid" << "subject-id",
+            QCoreApplication::translate("main", "The FreeSurfer <subject id>."),
+            QCoreApplication::translate("main", "subject id"),
+            "sample");
+    parser.addOption(subjIdOption);
+
+    // Cluster Sizes
+    QCommandLineOption clusterSizesOption(QStringList() << "c" << "cluster-sizes",
+            QCoreApplication::translate("main", "Comma separated <cluster sizes> of the grids to evaluate (smaller = denser grid)."),
+            QCoreApplication::translate("main", "cluster sizes"),
+            "40,20,10");
+    parser.addOption(clusterSizesOption);
+
+    // Number of Dipole Pairs
+    QCommandLineOption numDipolePairsOption(QStringList() << "n" << "num-dipole-pairs",
+            QCoreApplication::translate("main", "The <number> of dipole pairs to search."),
+            QCoreApplication::translate("main", "number"),
+            "2");
+    parser.addOption(numDipolePairsOption);
+
+    // Number of Runs
+    QCommandLineOption numRunsOption(QStringList() << "r" << "runs",
+            QCoreApplication::translate("main", "The <number> of runs the times are averaged over."),
+            QCoreApplication::translate("main", "number"),
+            "3");
+    parser.addOption(numRunsOption);
+
+    // tmin
+    QCommandLineOption tMinOption(QStringList() << "tmin" << "t-min",
+            QCoreApplication::translate("main", "The starting time point <tmin>."),
+            QCoreApplication::translate("main", "tmin"),
+            "0.05");
+    parser.addOption(tMinOption);
+
+    // tmax
+    QCommandLineOption tMaxOption(QStringList() << "tmax" << "t-max",
+            QCoreApplication::translate("main", "The end time point <tmax>."),
+            QCoreApplication::translate("main", "tmax"),
+            "0.15");
+    parser.addOption(tMaxOption);
+
+    // Single Precision
+    QCommandLineOption singlePrecisionOption(QStringList() << "single",
+            QCoreApplication::translate("main", "Store the gain matrix in single precision."));
+    parser.addOption(singlePrecisionOption);
+
+    // Process the actual command line arguments given by the user
+    parser.process(app);
+
+
+    //////////////////////////////// #2 get parsed values /////////////////////////////////
+
+    QString sFwdName = parser.value(srcDirectoryOption)+parser.value(fwdFileOption);
+    QString sAveName = parser.value(srcDirectoryOption)+parser.value(aveFileOption);
+    QString t_sSubjectsDir = parser.value(subjDirectoryOption);
+    QString t_sSubject = parser.value(subjIdOption);
+
+    QList<qint32> t_qListClusterSizes;
+    QStringList t_qListSizes = parser.value(clusterSizesOption).split(",", QString::SkipEmptyParts);
+    for(qint32 i = 0; i < t_qListSizes.size(); ++i)
+        t_qListClusterSizes << t_qListSizes[i].toInt();
+
+    qint32 numDipolePairs = parser.value(numDipolePairsOption).toInt();
+    qint32 numRuns = parser.value(numRunsOption).toInt() > 0 ? parser.value(numRunsOption).toInt() : 1;
+    float tmin = parser.value(tMinOption).toFloat();
+    float tmax = parser.value(tMaxOption).toFloat();
+    bool bSinglePrecision = parser.isSet(singlePrecisionOption);
+
+
+    //////////////////////////////////// #3 load data ////////////////////////////////////
+
+    QFile t_fileFwd(sFwdName);
+    MNEForwardSolution t_Fwd(t_fileFwd);
+    if(t_Fwd.isEmpty())
+        return 1;
+
+    QFile t_fileEvoked(sAveName);
+    QPair<QVariant, QVariant> baseline(QVariant(), 0);
+    FiffEvoked evoked(t_fileEvoked, 0, baseline);
+    if(evoked.isEmpty())
+        return 1;
+
+    FiffEvoked pickedEvoked = evoked.pick_channels(t_Fwd.info.ch_names);
+
+    //Time window
+    qint32 t_iFirst = 0;
+    while(t_iFirst < pickedEvoked.times.size()-1 && pickedEvoked.times[t_iFirst] < tmin)
+        ++t_iFirst;
+    qint32 t_iLast = t_iFirst;
+    while(t_iLast < pickedEvoked.times.size()-1 && pickedEvoked.times[t_iLast+1] <= tmax)
+        ++t_iLast;
+
+    MatrixXd t_matData = pickedEvoked.data.middleCols(t_iFirst, t_iLast-t_iFirst+1);
+
+    AnnotationSet t_annotationSet(t_sSubject, 2, "aparc.a2009s", t_sSubjectsDir);
+
+
+    ///////////////////////////////////// #4 benchmark /////////////////////////////////////
+
+    printf("\n%10s %8s %14s %14s %9s %8s %14s %14s\n", "clustersize", "sources", "RAP MUSIC [ms]", "PWL [ms]", "speedup", "source", "roh ratio", "distance [mm]");
+
+    for(qint32 c = 0; c < t_qListClusterSizes.size(); ++c)
+    {
+        MNEForwardSolution t_clusteredFwd = t_Fwd.cluster_forward_solution(t_annotationSet, t_qListClusterSizes[c]);
+
+        RapMusic t_rapMusic(t_clusteredFwd, false, numDipolePairs);
+        PwlRapMusic t_pwlRapMusic(t_clusteredFwd, false, numDipolePairs);
+        t_rapMusic.setSinglePrecision(bSinglePrecision);
+        t_pwlRapMusic.setSinglePrecision(bSinglePrecision);
+
+        QList< DipolePair<double> > t_RapDipoles;
+        QList< DipolePair<double> > t_PwlDipoles;
+
+        double t_dRapTime = runRapMusic(t_rapMusic, t_matData, numRuns, t_RapDipoles);
+        double t_dPwlTime = runRapMusic(t_pwlRapMusic, t_matData, numRuns, t_PwlDipoles);
+
+        qint32 t_iNumSources = t_RapDipoles.size() < t_PwlDipoles.size() ? t_RapDipoles.size() : t_PwlDipoles.size();
+
+        printf("%10d %8d %14.1f %14.1f %9.2f\n", t_qListClusterSizes[c], (qint32)t_clusteredFwd.nsource, t_dRapTime, t_dPwlTime, t_dPwlTime > 0 ? t_dRapTime/t_dPwlTime : 0.0);
+
+        for(qint32 i = 0; i < t_iNumSources; ++i)
+        {
+            double t_dRohRatio = t_RapDipoles[i].m_vCorrelation > 0 ? t_PwlDipoles[i].m_vCorrelation/t_RapDipoles[i].m_vCorrelation : 0.0;
+
+            printf("%10s %8s %14s %14s %9s %8d %14.6f %14.2f\n", "", "", "", "", "", i+1, t_dRohRatio, pairDistance(t_clusteredFwd.source_rr, t_PwlDipoles[i], t_RapDipoles[i]));
+        }
+    }
+
+    return 0;
+}
@@ -42,7 +42,8 @@ SUBDIRS += \
     test_mne_rt \
     mne_x_plugin_com \
     test_mne_future \
-    test_ssp
+    test_ssp \
+    test_pwl_rap_eval
 
 contains(MNECPP_CONFIG, withGui) {
     SUBDIRS += \